@@ -0,0 +1,573 @@
+/**
+ * @file autoplace.c
+ * @brief Implementation of functions defined in autoplace.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "autoplace.h"
+#include "utils.h"
+
+#define AUTOPLACE_MAX_CACHES 16 ///< Number of cache indexes of CPU searched for L3
+#define AUTOPLACE_CPU_WORDS (PLACEMENT_MAX_CPUS / PLACEMENT_LONG_BITS) ///< Words of CPU mask
+
+autoplace_conf_t autoplace_conf = {
+      .enabled = false,
+      .rebalance_ms = DEFAULT_AUTOPLACE_REBALANCE_MS,
+      .threshold_perc = DEFAULT_AUTOPLACE_THRESHOLD,
+};
+
+/**
+ * @brief Chain and its load used for ordering of chains by autoplace_plan
+ * */
+typedef struct autoplace_chain_s {
+   uint64_t load; ///< Sum of loads of instances of the chain
+   uint32_t idx; ///< Index of the chain
+} autoplace_chain_t;
+
+static autoplace_topology_t topology = { .cnt = 0 }; ///< Domains of the system
+static uint64_t last_rebalance_ms = 0; ///< Time of last rebalancing
+
+/**
+ * @brief Chains of instances built by the first start of instance of a starting pass
+ * */
+static struct {
+   bool valid; ///< Whether chains match instances, see autoplace_invalidate()
+   uint32_t chains_cnt; ///< Number of chains
+   int32_t *chain_domain; ///< Domain of each chain or -1 if no instance of it is placed yet
+} graph = { .valid = false, .chains_cnt = 0, .chain_domain = NULL };
+
+
+/**
+ * @brief Reads small sysfs file and strips trailing whitespace.
+ * @return Length of content or -1 on error
+ * */
+static ssize_t autoplace_read_file(const char *path, char *buf, size_t size);
+
+/**
+ * @brief Reads sysfs file with list of CPUs or nodes, empty list gives empty mask.
+ * @return -1 on error, 0 on success
+ * */
+static int autoplace_read_list(const char *path, unsigned long *mask, uint32_t max_bits);
+
+/**
+ * @brief Reads CPUs sharing L3 cache with given CPU.
+ * @return -1 if system doesn't report L3 cache of the CPU, 0 on success
+ * */
+static int autoplace_cpu_l3(const char *sysfs_root, uint32_t cpu, unsigned long *mask);
+
+/**
+ * @brief Finds representative of chain of given instance and compresses the path to it
+ * */
+static uint32_t autoplace_find(uint32_t *parent, uint32_t idx);
+
+/**
+ * @brief Returns index of domain with the lowest load per CPU
+ * */
+static uint32_t autoplace_least_loaded(const autoplace_topology_t *topo);
+
+/**
+ * @brief Returns difference of the highest and the lowest load per CPU of domains
+ *  in % of average load per CPU.
+ * */
+static uint64_t autoplace_imbalance(const autoplace_topology_t *topo);
+
+/**
+ * @brief Returns load of instance used for planning, i.e. its measured CPU usage
+ * */
+static inline uint64_t autoplace_inst_load(const inst_t *inst);
+
+/**
+ * @brief Splits insts_v into chains and assigns domains of already placed instances to them.
+ * @return -1 on error, 0 on success
+ * */
+static int autoplace_graph_build();
+
+
+int autoplace_init()
+{
+   unsigned long allowed[AUTOPLACE_CPU_WORDS];
+
+   if (placement_get_cpu_mask(0, allowed) == -1
+       || autoplace_topology_load("/sys", allowed, &topology) == -1) {
+      VERBOSE(V2, "Failed to load CPU topology, automatic placement is disabled")
+      topology.cnt = 0;
+      return -1;
+   }
+
+   for (uint32_t i = 0; i < topology.cnt; i++) {
+      char cpus[PLACEMENT_LIST_LEN];
+
+      if (placement_format_list(topology.domains[i].cpus, PLACEMENT_MAX_CPUS, cpus,
+                                sizeof(cpus)) == -1) {
+         strcpy(cpus, "...");
+      }
+      VERBOSE(V2, "Placement domain %u: node %d, CPUs %s", i, topology.domains[i].node, cpus)
+   }
+
+   return 0;
+}
+
+void autoplace_deinit()
+{
+   NULLP_TEST_AND_FREE(graph.chain_domain)
+   graph.chains_cnt = 0;
+   graph.valid = false;
+}
+
+void autoplace_invalidate()
+{
+   graph.valid = false;
+}
+
+void autoplace_inst_prepare(inst_t *inst, placement_t *pl)
+{
+   autoplace_domain_t *domain;
+   int32_t d;
+
+   inst->auto_domain = -1;
+   if (autoplace_conf.enabled == false || topology.cnt == 0 || pl->has_cpus) {
+      return;
+   }
+   if (graph.valid == false && autoplace_graph_build() == -1) {
+      return;
+   }
+
+   // The first started instance of a chain chooses domain for the whole chain
+   d = graph.chain_domain[inst->auto_chain];
+   if (d == -1) {
+      d = (int32_t) autoplace_least_loaded(&topology);
+      graph.chain_domain[inst->auto_chain] = d;
+   }
+   domain = &topology.domains[d];
+   domain->load += autoplace_inst_load(inst);
+
+   inst->auto_domain = d;
+   memcpy(pl->cpus, domain->cpus, sizeof(pl->cpus));
+   pl->has_cpus = true;
+   VERBOSE(V2, "Instance '%s' is placed to domain %d (node %d)", inst->name, d, domain->node)
+}
+
+void autoplace_rebalance()
+{
+   uint64_t now = get_mono_time_ms();
+   uint32_t cnt = insts_v.total;
+   uint32_t *chain_of = NULL;
+   uint64_t *chain_load = NULL;
+   int32_t *chain_domain = NULL;
+   uint64_t imbalance;
+   uint64_t planned_imbalance;
+   uint32_t moved = 0;
+   int chains_cnt;
+   inst_t *inst;
+
+   if (autoplace_conf.enabled == false || topology.cnt < 2 || cnt == 0
+       || now - last_rebalance_ms < autoplace_conf.rebalance_ms) {
+      return;
+   }
+   last_rebalance_ms = now;
+
+   chain_of = malloc(cnt * sizeof(uint32_t));
+   if (chain_of == NULL) {
+      NO_MEM_ERR
+      return;
+   }
+   chains_cnt = autoplace_chains((inst_t **) insts_v.items, cnt, chain_of);
+   if (chains_cnt == -1) {
+      goto cleanup;
+   }
+   chain_load = calloc((size_t) chains_cnt, sizeof(uint64_t));
+   chain_domain = malloc((size_t) chains_cnt * sizeof(int32_t));
+   if (chain_load == NULL || chain_domain == NULL) {
+      NO_MEM_ERR
+      goto cleanup;
+   }
+
+   // Only running instances placed automatically can be moved
+   for (uint32_t d = 0; d < topology.cnt; d++) {
+      topology.domains[d].load = 0;
+   }
+   for (uint32_t i = 0; i < cnt; i++) {
+      inst = insts_v.items[i];
+      if (INST_RUNNING(inst) && inst->auto_domain != -1) {
+         topology.domains[inst->auto_domain].load += autoplace_inst_load(inst);
+         chain_load[chain_of[i]] += autoplace_inst_load(inst);
+      }
+   }
+
+   imbalance = autoplace_imbalance(&topology);
+   if (imbalance < autoplace_conf.threshold_perc) {
+      goto cleanup;
+   }
+   if (autoplace_plan(chain_load, (uint32_t) chains_cnt, &topology, chain_domain) == -1) {
+      goto cleanup;
+   }
+   planned_imbalance = autoplace_imbalance(&topology);
+   if (planned_imbalance >= imbalance) {
+      VERBOSE(V3, "Rebalancing wouldn't lower imbalance %" PRIu64 "%% of domains", imbalance)
+      goto cleanup;
+   }
+
+   for (uint32_t i = 0; i < cnt; i++) {
+      inst = insts_v.items[i];
+      if (INST_RUNNING(inst) == false || inst->auto_domain == -1
+          || inst->auto_domain == chain_domain[chain_of[i]]) {
+         continue;
+      }
+      if (placement_set_cpus(INST_PID(inst), topology.domains[chain_domain[chain_of[i]]].cpus) == -1) {
+         VERBOSE(N_ERR, "Failed to move instance '%s' (PID=%d) to domain %d", inst->name,
+                 INST_PID(inst), chain_domain[chain_of[i]])
+         continue;
+      }
+      inst->auto_domain = chain_domain[chain_of[i]];
+      moved++;
+   }
+   VERBOSE(V1, "Rebalanced chains of instances: moved %u instances, imbalance of domains "
+           "%" PRIu64 "%% -> %" PRIu64 "%%", moved, imbalance, planned_imbalance)
+
+cleanup:
+   // Domains of chains for instances started next are taken from moved instances
+   graph.valid = false;
+   NULLP_TEST_AND_FREE(chain_of)
+   NULLP_TEST_AND_FREE(chain_load)
+   NULLP_TEST_AND_FREE(chain_domain)
+}
+
+int autoplace_topology_load(const char *sysfs_root, const unsigned long *allowed,
+                            autoplace_topology_t *topo)
+{
+   char path[PATH_MAX];
+   unsigned long online[AUTOPLACE_CPU_WORDS];
+   unsigned long assigned[AUTOPLACE_CPU_WORDS];
+   unsigned long l3[AUTOPLACE_CPU_WORDS];
+   unsigned long node_cpus[AUTOPLACE_CPU_WORDS];
+   unsigned long nodes[PLACEMENT_MAX_NODES / PLACEMENT_LONG_BITS];
+   autoplace_domain_t *domain;
+   bool has_nodes;
+
+   topo->cnt = 0;
+
+   snprintf(path, sizeof(path), "%s/devices/system/cpu/online", sysfs_root);
+   if (autoplace_read_list(path, online, PLACEMENT_MAX_CPUS) == -1) {
+      return -1;
+   }
+   for (uint32_t w = 0; allowed != NULL && w < AUTOPLACE_CPU_WORDS; w++) {
+      online[w] &= allowed[w];
+   }
+   // Kernel without NUMA doesn't have node directory at all
+   snprintf(path, sizeof(path), "%s/devices/system/node/online", sysfs_root);
+   has_nodes = (autoplace_read_list(path, nodes, PLACEMENT_MAX_NODES) == 0);
+
+   memset(assigned, 0, sizeof(assigned));
+   for (uint32_t cpu = 0; cpu < PLACEMENT_MAX_CPUS; cpu++) {
+      uint32_t w = cpu / PLACEMENT_LONG_BITS;
+      unsigned long bit = 1UL << (cpu % PLACEMENT_LONG_BITS);
+
+      if ((online[w] & bit) == 0 || (assigned[w] & bit) != 0) {
+         continue;
+      }
+      if (topo->cnt == AUTOPLACE_MAX_DOMAINS) {
+         VERBOSE(N_ERR, "Topology has more than %d domains, CPUs from %u are not used",
+                 AUTOPLACE_MAX_DOMAINS, cpu)
+         break;
+      }
+      domain = &topo->domains[topo->cnt];
+      memcpy(domain->cpus, online, sizeof(domain->cpus));
+      domain->node = -1;
+      domain->load = 0;
+
+      if (autoplace_cpu_l3(sysfs_root, cpu, l3) == 0) {
+         for (uint32_t i = 0; i < AUTOPLACE_CPU_WORDS; i++) {
+            domain->cpus[i] &= l3[i];
+         }
+      }
+      // L3 can span more nodes, e.g. with sub-NUMA clustering
+      for (uint32_t node = 0; has_nodes && node < PLACEMENT_MAX_NODES; node++) {
+         if ((nodes[node / PLACEMENT_LONG_BITS] & (1UL << (node % PLACEMENT_LONG_BITS))) == 0) {
+            continue;
+         }
+         snprintf(path, sizeof(path), "%s/devices/system/node/node%u/cpulist", sysfs_root, node);
+         if (autoplace_read_list(path, node_cpus, PLACEMENT_MAX_CPUS) == 0
+             && (node_cpus[w] & bit) != 0) {
+            for (uint32_t i = 0; i < AUTOPLACE_CPU_WORDS; i++) {
+               domain->cpus[i] &= node_cpus[i];
+            }
+            domain->node = (int) node;
+            break;
+         }
+      }
+
+      domain->cpus_cnt = 0;
+      for (uint32_t i = 0; i < AUTOPLACE_CPU_WORDS; i++) {
+         assigned[i] |= domain->cpus[i];
+         for (unsigned long word = domain->cpus[i]; word != 0; word &= word - 1) {
+            domain->cpus_cnt++;
+         }
+      }
+      topo->cnt++;
+   }
+
+   return (topo->cnt > 0 ? 0 : -1);
+}
+
+int autoplace_chains(inst_t **insts, uint32_t cnt, uint32_t *chain_of)
+{
+   uint32_t *parent = NULL;
+   uint32_t *chain_ids = NULL;
+   inst_link_t *links = NULL;
+   int links_cnt;
+   uint32_t chains_cnt = 0;
+   uint32_t root;
+
+   links_cnt = insts_links(insts, cnt, &links);
+   if (links_cnt == -1) {
+      return -1;
+   }
+   parent = malloc((cnt + 1) * sizeof(uint32_t));
+   chain_ids = malloc((cnt + 1) * sizeof(uint32_t));
+   if (parent == NULL || chain_ids == NULL) {
+      NO_MEM_ERR
+      NULLP_TEST_AND_FREE(parent)
+      NULLP_TEST_AND_FREE(chain_ids)
+      NULLP_TEST_AND_FREE(links)
+      return -1;
+   }
+
+   for (uint32_t i = 0; i < cnt; i++) {
+      parent[i] = i;
+      chain_ids[i] = UINT32_MAX;
+   }
+   // Every link joins producer with its consumer
+   for (int l = 0; l < links_cnt; l++) {
+      parent[autoplace_find(parent, links[l].producer)] = autoplace_find(parent, links[l].consumer);
+   }
+
+   for (uint32_t i = 0; i < cnt; i++) {
+      root = autoplace_find(parent, i);
+      if (chain_ids[root] == UINT32_MAX) {
+         chain_ids[root] = chains_cnt++;
+      }
+      chain_of[i] = chain_ids[root];
+   }
+
+   NULLP_TEST_AND_FREE(parent)
+   NULLP_TEST_AND_FREE(chain_ids)
+   NULLP_TEST_AND_FREE(links)
+
+   return (int) chains_cnt;
+}
+
+int autoplace_plan(const uint64_t *chain_load, uint32_t chains_cnt,
+                   autoplace_topology_t *topo, int32_t *chain_domain)
+{
+   autoplace_chain_t *chains = NULL;
+   uint32_t d;
+
+   for (d = 0; d < topo->cnt; d++) {
+      topo->domains[d].load = 0;
+   }
+   if (chains_cnt == 0) {
+      return 0;
+   }
+
+   chains = malloc(chains_cnt * sizeof(autoplace_chain_t));
+   if (chains == NULL) {
+      NO_MEM_ERR
+      return -1;
+   }
+   for (uint32_t i = 0; i < chains_cnt; i++) {
+      chains[i].load = chain_load[i];
+      chains[i].idx = i;
+   }
+   // Insertion sort keeps order of chains with equal load, so the plan is stable
+   for (uint32_t i = 1; i < chains_cnt; i++) {
+      autoplace_chain_t chain = chains[i];
+      uint32_t j = i;
+
+      for (; j > 0 && chains[j - 1].load < chain.load; j--) {
+         chains[j] = chains[j - 1];
+      }
+      chains[j] = chain;
+   }
+
+   for (uint32_t i = 0; i < chains_cnt; i++) {
+      d = autoplace_least_loaded(topo);
+      chain_domain[chains[i].idx] = (int32_t) d;
+      topo->domains[d].load += chains[i].load;
+   }
+
+   NULLP_TEST_AND_FREE(chains)
+   return 0;
+}
+
+static ssize_t autoplace_read_file(const char *path, char *buf, size_t size)
+{
+   ssize_t len;
+   int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+   if (fd == -1) {
+      return -1;
+   }
+   len = read(fd, buf, size - 1);
+   close(fd);
+   if (len == -1) {
+      return -1;
+   }
+   while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == ' ')) {
+      len--;
+   }
+   buf[len] = '\0';
+
+   return len;
+}
+
+static int autoplace_read_list(const char *path, unsigned long *mask, uint32_t max_bits)
+{
+   char buf[PLACEMENT_LIST_LEN * 4];
+   ssize_t len = autoplace_read_file(path, buf, sizeof(buf));
+
+   if (len == -1) {
+      return -1;
+   }
+   if (len == 0) {
+      // e.g. memory-only node
+      memset(mask, 0, max_bits / 8);
+      return 0;
+   }
+
+   return placement_parse_list(buf, mask, max_bits);
+}
+
+static int autoplace_cpu_l3(const char *sysfs_root, uint32_t cpu, unsigned long *mask)
+{
+   char path[PATH_MAX];
+   char level[8];
+
+   for (uint32_t i = 0; i < AUTOPLACE_MAX_CACHES; i++) {
+      snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%u/cache/index%u/level",
+               sysfs_root, cpu, i);
+      if (autoplace_read_file(path, level, sizeof(level)) == -1) {
+         break;
+      }
+      if (strcmp(level, "3") == 0) {
+         snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%u/cache/index%u/shared_cpu_list",
+                  sysfs_root, cpu, i);
+         return autoplace_read_list(path, mask, PLACEMENT_MAX_CPUS);
+      }
+   }
+
+   return -1;
+}
+
+static uint32_t autoplace_find(uint32_t *parent, uint32_t idx)
+{
+   uint32_t root = idx;
+   uint32_t next;
+
+   while (parent[root] != root) {
+      root = parent[root];
+   }
+   while (parent[idx] != root) {
+      next = parent[idx];
+      parent[idx] = root;
+      idx = next;
+   }
+
+   return root;
+}
+
+static uint32_t autoplace_least_loaded(const autoplace_topology_t *topo)
+{
+   uint32_t best = 0;
+
+   // load_a / cpus_a < load_b / cpus_b without division
+   for (uint32_t d = 1; d < topo->cnt; d++) {
+      if (topo->domains[d].load * topo->domains[best].cpus_cnt
+          < topo->domains[best].load * topo->domains[d].cpus_cnt) {
+         best = d;
+      }
+   }
+
+   return best;
+}
+
+static uint64_t autoplace_imbalance(const autoplace_topology_t *topo)
+{
+   uint64_t total_load = 0;
+   uint64_t total_cpus = 0;
+   uint64_t min = UINT64_MAX;
+   uint64_t max = 0;
+   uint64_t per_cpu;
+
+   for (uint32_t d = 0; d < topo->cnt; d++) {
+      total_load += topo->domains[d].load;
+      total_cpus += topo->domains[d].cpus_cnt;
+      per_cpu = topo->domains[d].load / topo->domains[d].cpus_cnt;
+      min = (per_cpu < min ? per_cpu : min);
+      max = (per_cpu > max ? per_cpu : max);
+   }
+   if (total_load / total_cpus == 0) {
+      return 0;
+   }
+
+   return (max - min) * 100 / (total_load / total_cpus);
+}
+
+static inline uint64_t autoplace_inst_load(const inst_t *inst)
+{
+   return (inst->cpu_load > AUTOPLACE_MIN_LOAD ? inst->cpu_load : AUTOPLACE_MIN_LOAD);
+}
+
+static int autoplace_graph_build()
+{
+   uint32_t cnt = insts_v.total;
+   uint32_t *chain_of = NULL;
+   int32_t *chain_domain = NULL;
+   int chains_cnt;
+   inst_t *inst;
+
+   chain_of = malloc((cnt + 1) * sizeof(uint32_t));
+   if (chain_of == NULL) {
+      NO_MEM_ERR
+      return -1;
+   }
+   chains_cnt = autoplace_chains((inst_t **) insts_v.items, cnt, chain_of);
+   if (chains_cnt == -1) {
+      NULLP_TEST_AND_FREE(chain_of)
+      return -1;
+   }
+   chain_domain = realloc(graph.chain_domain, ((size_t) chains_cnt + 1) * sizeof(int32_t));
+   if (chain_domain == NULL) {
+      NO_MEM_ERR
+      NULLP_TEST_AND_FREE(chain_of)
+      return -1;
+   }
+   graph.chain_domain = chain_domain;
+   graph.chains_cnt = (uint32_t) chains_cnt;
+   for (uint32_t c = 0; c < graph.chains_cnt; c++) {
+      graph.chain_domain[c] = -1;
+   }
+
+   // Running instances keep their domains, chains follow them
+   for (uint32_t d = 0; d < topology.cnt; d++) {
+      topology.domains[d].load = 0;
+   }
+   for (uint32_t i = 0; i < cnt; i++) {
+      inst = insts_v.items[i];
+      inst->auto_chain = chain_of[i];
+      if (INST_RUNNING(inst) && inst->auto_domain != -1) {
+         topology.domains[inst->auto_domain].load += autoplace_inst_load(inst);
+         if (graph.chain_domain[chain_of[i]] == -1) {
+            graph.chain_domain[chain_of[i]] = inst->auto_domain;
+         }
+      }
+   }
+
+   NULLP_TEST_AND_FREE(chain_of)
+   graph.valid = true;
+   return 0;
+}
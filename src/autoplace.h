@@ -0,0 +1,120 @@
+/**
+ * @file autoplace.h
+ * @brief Automatic topology-aware CPU placement of producer/consumer chains of instances.
+ * @details Instances connected by OUT->IN interface pairs (same UNIX socket or TCP port)
+ *  form a chain. Every chain is placed into one domain, i.e. set of CPUs sharing L3 cache
+ *  on one NUMA node read from /sys/devices/system, so that data passed between its
+ *  instances stays in shared cache and local memory. Unrelated chains are spread across
+ *  domains by their measured CPU usage.
+ *
+ *  Domain is chosen when the first instance of a chain is started, other instances of the
+ *  chain follow it. Once in rebalance-period, chains are re-planned according to measured
+ *  CPU usage and running instances are moved if load of domains differs by more than
+ *  rebalance-threshold. Instances with explicitly configured placement/cpus are not touched.
+ */
+
+#ifndef AUTOPLACE_H
+#define AUTOPLACE_H
+
+#include "module.h"
+
+#define AUTOPLACE_MAX_DOMAINS 64 ///< Maximum number of domains of topology
+#define AUTOPLACE_MIN_LOAD 50 ///< Load assumed for instance without measured CPU usage,
+                              ///<  in thousandths of one CPU
+#define DEFAULT_AUTOPLACE_REBALANCE_MS 60000 ///< Default period of rebalancing of chains
+#define DEFAULT_AUTOPLACE_THRESHOLD 25 ///< Default imbalance of domains in % that triggers rebalancing
+
+/**
+ * @brief Configuration of automatic placement loaded from /supervisor/auto-placement.
+ * */
+typedef struct autoplace_conf_s {
+   bool enabled; ///< Whether instances without placement/cpus are placed automatically
+   uint32_t rebalance_ms; ///< Period of rebalancing of chains according to their CPU usage
+   uint8_t threshold_perc; ///< Rebalancing is done only if load of the most loaded domain
+                           ///<  exceeds load of the least loaded one by this many % of average
+} autoplace_conf_t;
+
+/**
+ * @brief Set of CPUs sharing L3 cache on one NUMA node.
+ * */
+typedef struct autoplace_domain_s {
+   unsigned long cpus[PLACEMENT_MAX_CPUS / PLACEMENT_LONG_BITS]; ///< CPUs of the domain
+   uint32_t cpus_cnt; ///< Number of CPUs of the domain
+   int node; ///< NUMA node of the domain or -1 if system doesn't report nodes
+   uint64_t load; ///< Sum of loads of instances placed into the domain
+} autoplace_domain_t;
+
+/**
+ * @brief Domains of the system
+ * */
+typedef struct autoplace_topology_s {
+   autoplace_domain_t domains[AUTOPLACE_MAX_DOMAINS]; ///< Loaded domains
+   uint32_t cnt; ///< Number of loaded domains
+} autoplace_topology_t;
+
+extern autoplace_conf_t autoplace_conf; ///< Configuration of automatic placement
+
+/**
+ * @brief Loads topology of the system supervisor is allowed to run on.
+ * @details Without topology, automatic placement is off regardless of configuration.
+ * @return -1 if topology couldn't be loaded, 0 on success
+ * */
+extern int autoplace_init();
+
+/**
+ * @brief Frees chains of instances built by autoplace_inst_prepare.
+ * */
+extern void autoplace_deinit();
+
+/**
+ * @brief Drops producer/consumer graph so that it is rebuilt by next start of instance.
+ * @details Has to be called whenever instances or their interfaces might have changed,
+ *  e.g. at the beginning of each pass starting instances.
+ * */
+extern void autoplace_invalidate();
+
+/**
+ * @brief Sets CPUs of domain of chain of given instance to placement it is started with.
+ * @details Instance with configured placement/cpus is left as it is.
+ * @param inst Instance about to be started
+ * @param pl Placement of the instance to update
+ * */
+extern void autoplace_inst_prepare(inst_t *inst, placement_t *pl);
+
+/**
+ * @brief Re-plans chains according to measured CPU usage and moves running instances.
+ * @details Does nothing if automatic placement is off or rebalance-period didn't pass yet.
+ * */
+extern void autoplace_rebalance();
+
+/**
+ * @brief Loads domains of topology from sysfs.
+ * @param sysfs_root Mount point of sysfs, i.e. "/sys"
+ * @param allowed CPUs that can be used or NULL for all online CPUs
+ * @param topo Loaded topology
+ * @return -1 on error, 0 on success
+ * */
+extern int autoplace_topology_load(const char *sysfs_root, const unsigned long *allowed,
+                                   autoplace_topology_t *topo);
+
+/**
+ * @brief Splits instances into chains connected by their interfaces.
+ * @param insts Instances
+ * @param cnt Number of instances
+ * @param chain_of Index of chain of each instance
+ * @return Number of chains or -1 on error
+ * */
+extern int autoplace_chains(inst_t **insts, uint32_t cnt, uint32_t *chain_of);
+
+/**
+ * @brief Assigns chains to domains, the heaviest chain first to the least loaded domain.
+ * @param chain_load Load of each chain
+ * @param chains_cnt Number of chains
+ * @param topo Topology, loads of its domains are reset and planned
+ * @param chain_domain Planned domain of each chain
+ * @return -1 on error, 0 on success
+ * */
+extern int autoplace_plan(const uint64_t *chain_load, uint32_t chains_cnt,
+                          autoplace_topology_t *topo, int32_t *chain_domain);
+
+#endif
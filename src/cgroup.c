@@ -0,0 +1,515 @@
+/**
+ * @file cgroup.c
+ * @brief Implementation of functions defined in cgroup.h
+ */
+
+#include <sys/stat.h>
+#include "cgroup.h"
+#include "proc_stats.h"
+
+#define CGROUP_IO_STAT_BUF_SIZE 4096 ///< io.stat has one line per block device
+#define CGROUP_LOG_PATH_LEN 1024 ///< Cgroup paths are truncated to it in messages
+
+bool cgroups_enabled = false;
+
+static int instances_fd = -1; ///< Directory CGROUP_INSTANCES_DIR of supervisor subtree
+
+
+/**
+ * @brief Finds path of cgroup v2 of supervisor process from /proc/self/cgroup
+ * @param path Buffer for path relative to CGROUP_MOUNT_PATH
+ * @param size Size of path
+ * @return -1 if process isn't member of cgroup v2 hierarchy, 0 on success
+ * */
+static int cgroup_own_path(char *path, size_t size);
+
+/**
+ * @brief Checks whether no process other than supervisor is member of given cgroup
+ * @param dir_fd Cgroup directory
+ * @return true if cgroup contains only supervisor or nothing
+ * */
+static bool cgroup_is_exclusive(int dir_fd);
+
+/**
+ * @brief Writes given value to file of cgroup
+ * @param dir_fd Cgroup directory
+ * @param file Name of file inside the directory
+ * @param val Value to write
+ * @return -1 on error with errno set, 0 on success
+ * */
+static int cgroup_write(int dir_fd, const char *file, const char *val);
+
+/**
+ * @brief Enables controllers of CGROUP_CONTROLLERS for children of given cgroup
+ * @details Controllers are enabled one by one, so that missing one doesn't disable others.
+ * @param dir_fd Cgroup directory
+ * @return -1 if cpu or memory controller can't be enabled, 0 on success
+ * */
+static int cgroup_enable_controllers(int dir_fd);
+
+/**
+ * @brief Scans value of given key from flat keyed file like cpu.stat
+ * @return -1 if key is not present, 0 on success
+ * */
+static int cgroup_scan_key(const char *buf, size_t len, const char *key, uint64_t *val);
+
+/**
+ * @brief Reads single number file like memory.current
+ * @return -1 on error, 0 on success
+ * */
+static int cgroup_read_u64(int fd, uint64_t *val);
+
+/**
+ * @brief Reads oom_kill counter of memory.events of leaf
+ * @param dir_fd Leaf directory
+ * @param val Loaded counter
+ * @return -1 on error, 0 on success
+ * */
+static int cgroup_read_oom_kills(int dir_fd, uint64_t *val);
+
+
+static int cgroup_own_path(char *path, size_t size)
+{
+   char buf[PROC_READ_BUF_SIZE];
+   char *line;
+   char *end;
+   ssize_t len;
+   int fd = open("/proc/self/cgroup", O_RDONLY | O_CLOEXEC);
+
+   if (fd == -1) {
+      return -1;
+   }
+   len = proc_pread(fd, buf, sizeof(buf));
+   close(fd);
+   if (len == -1) {
+      return -1;
+   }
+
+   // Entry of v2 hierarchy is "0::/path"
+   for (line = buf; line != NULL && *line != '\0'; line = strchr(line, '\n')) {
+      if (*line == '\n') {
+         line++;
+      }
+      if (strncmp(line, "0::/", 4) != 0) {
+         continue;
+      }
+      line += 3;
+      end = strchr(line, '\n');
+      if (end != NULL) {
+         *end = '\0';
+      }
+      if (strlen(line) >= size) {
+         return -1;
+      }
+      strcpy(path, line);
+      return 0;
+   }
+
+   return -1;
+}
+
+static bool cgroup_is_exclusive(int dir_fd)
+{
+   char buf[PROC_READ_BUF_SIZE];
+   char *endptr;
+   ssize_t len;
+   pid_t me = getpid();
+   int fd = openat(dir_fd, "cgroup.procs", O_RDONLY | O_CLOEXEC);
+
+   if (fd == -1) {
+      return false;
+   }
+   len = proc_pread(fd, buf, sizeof(buf));
+   close(fd);
+   if (len == -1 || len == (ssize_t) sizeof(buf) - 1) {
+      return false;
+   }
+
+   for (char *p = buf; *p != '\0'; p = endptr) {
+      while (*p == '\n') {
+         p++;
+      }
+      if (*p == '\0') {
+         break;
+      }
+      if ((pid_t) strtol(p, &endptr, 10) != me || endptr == p) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+static int cgroup_write(int dir_fd, const char *file, const char *val)
+{
+   int rc = 0;
+   size_t len = strlen(val);
+   int fd = openat(dir_fd, file, O_WRONLY | O_CLOEXEC);
+
+   if (fd == -1) {
+      return -1;
+   }
+   if (write(fd, val, len) != (ssize_t) len) {
+      rc = -1;
+   }
+   close(fd);
+
+   return rc;
+}
+
+static int cgroup_enable_controllers(int dir_fd)
+{
+   char controllers[] = CGROUP_CONTROLLERS;
+   char *saveptr = NULL;
+
+   for (char *ctl = strtok_r(controllers, " ", &saveptr); ctl != NULL;
+        ctl = strtok_r(NULL, " ", &saveptr)) {
+      if (cgroup_write(dir_fd, "cgroup.subtree_control", ctl) == -1) {
+         VERBOSE(V2, "cgroup: Failed to enable controller '%s' (errno=%d)", ctl + 1, errno)
+         if (strcmp(ctl, "+io") != 0) {
+            return -1;
+         }
+      }
+   }
+
+   return 0;
+}
+
+int cgroup_init()
+{
+   char own[PATH_MAX];
+   char path[PATH_MAX + sizeof(CGROUP_MOUNT_PATH)];
+   char pid_str[16];
+   size_t own_len;
+   size_t leaf_len = strlen("/"CGROUP_SUPERVISOR_LEAF);
+   int base_fd = -1;
+   int leaf_fd = -1;
+
+   if (cgroup_own_path(own, sizeof(own)) == -1) {
+      VERBOSE(V1, "cgroup: cgroup v2 is not available, instances are not placed into cgroups")
+      return -1;
+   }
+
+   // Restarted supervisor is already inside its leaf
+   own_len = strlen(own);
+   if (own_len > leaf_len && strcmp(own + own_len - leaf_len, "/"CGROUP_SUPERVISOR_LEAF) == 0) {
+      own[own_len - leaf_len] = '\0';
+   }
+   snprintf(path, sizeof(path), "%s%s", CGROUP_MOUNT_PATH, own);
+
+   base_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if (base_fd == -1 || faccessat(base_fd, "cgroup.subtree_control", W_OK, 0) == -1) {
+      VERBOSE(V1, "cgroup: Cgroup %.*s is not writable, instances are not placed into cgroups",
+              CGROUP_LOG_PATH_LEN, path)
+      goto err_cleanup;
+   }
+   if (cgroup_is_exclusive(base_fd) == false) {
+      VERBOSE(V1, "cgroup: Cgroup %.*s is shared with other processes, it has to be delegated"
+                  " to supervisor. Instances are not placed into cgroups",
+              CGROUP_LOG_PATH_LEN, path)
+      goto err_cleanup;
+   }
+
+   // Cgroup with enabled controllers can't have processes, supervisor moves to a leaf
+   if (mkdirat(base_fd, CGROUP_SUPERVISOR_LEAF, 0755) == -1 && errno != EEXIST) {
+      VERBOSE(N_ERR, "cgroup: Failed to create %.*s/"CGROUP_SUPERVISOR_LEAF" (errno=%d)",
+              CGROUP_LOG_PATH_LEN, path, errno)
+      goto err_cleanup;
+   }
+   leaf_fd = openat(base_fd, CGROUP_SUPERVISOR_LEAF, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   snprintf(pid_str, sizeof(pid_str), "%d", getpid());
+   if (leaf_fd == -1 || cgroup_write(leaf_fd, "cgroup.procs", pid_str) == -1) {
+      VERBOSE(N_ERR, "cgroup: Failed to move supervisor to %.*s/"CGROUP_SUPERVISOR_LEAF
+              " (errno=%d)", CGROUP_LOG_PATH_LEN, path, errno)
+      goto err_cleanup;
+   }
+
+   if (cgroup_enable_controllers(base_fd) == -1) {
+      goto err_cleanup;
+   }
+   if (mkdirat(base_fd, CGROUP_INSTANCES_DIR, 0755) == -1 && errno != EEXIST) {
+      VERBOSE(N_ERR, "cgroup: Failed to create %.*s/"CGROUP_INSTANCES_DIR" (errno=%d)",
+              CGROUP_LOG_PATH_LEN, path, errno)
+      goto err_cleanup;
+   }
+   instances_fd = openat(base_fd, CGROUP_INSTANCES_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if (instances_fd == -1 || cgroup_enable_controllers(instances_fd) == -1) {
+      goto err_cleanup;
+   }
+
+   close(leaf_fd);
+   close(base_fd);
+   cgroups_enabled = true;
+   VERBOSE(V2, "cgroup: Instances are placed into %.*s/"CGROUP_INSTANCES_DIR,
+           CGROUP_LOG_PATH_LEN, path)
+
+   return 0;
+
+err_cleanup:
+   if (instances_fd != -1) {
+      close(instances_fd);
+      instances_fd = -1;
+   }
+   if (leaf_fd != -1) {
+      close(leaf_fd);
+   }
+   if (base_fd != -1) {
+      close(base_fd);
+   }
+   return -1;
+}
+
+void cgroup_deinit()
+{
+   if (instances_fd != -1) {
+      close(instances_fd);
+      instances_fd = -1;
+   }
+   cgroups_enabled = false;
+}
+
+int cgroup_inst_prepare(inst_t *inst)
+{
+   char val[32];
+   inst_cgroup_t *cg = &inst->cg;
+
+   if (cg->dir_fd == -1) {
+      if (mkdirat(instances_fd, inst->name, 0755) == -1 && errno != EEXIST) {
+         VERBOSE(N_ERR, "cgroup: Failed to create leaf of inst '%s' (errno=%d)",
+                 inst->name, errno)
+         return -1;
+      }
+      cg->dir_fd = openat(instances_fd, inst->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (cg->dir_fd == -1) {
+         goto err_cleanup;
+      }
+      cg->procs_fd = openat(cg->dir_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+      cg->cpu_stat_fd = openat(cg->dir_fd, "cpu.stat", O_RDONLY | O_CLOEXEC);
+      cg->mem_current_fd = openat(cg->dir_fd, "memory.current", O_RDONLY | O_CLOEXEC);
+      // Available since Linux 5.19
+      cg->mem_peak_fd = openat(cg->dir_fd, "memory.peak", O_RDONLY | O_CLOEXEC);
+      cg->io_stat_fd = openat(cg->dir_fd, "io.stat", O_RDONLY | O_CLOEXEC);
+      if (cg->procs_fd == -1 || cg->cpu_stat_fd == -1 || cg->mem_current_fd == -1) {
+         goto err_cleanup;
+      }
+      // Reused leaf might have counted OOM kills of previous processes
+      if (cgroup_read_oom_kills(cg->dir_fd, &cg->oom_kills) == -1) {
+         cg->oom_kills = 0;
+      }
+   }
+
+   // Limits are written on every start since configuration might have changed
+   if (cgroup_write(cg->dir_fd, "cpu.max", inst->cpu_max != NULL ? inst->cpu_max : "max") == -1) {
+      VERBOSE(N_ERR, "cgroup: Failed to set cpu.max of inst '%s' to '%s' (errno=%d)",
+              inst->name, inst->cpu_max != NULL ? inst->cpu_max : "max", errno)
+   }
+   if (inst->memory_max != 0) {
+      snprintf(val, sizeof(val), "%"PRIu64, inst->memory_max);
+   } else {
+      strcpy(val, "max");
+   }
+   if (cgroup_write(cg->dir_fd, "memory.max", val) == -1) {
+      VERBOSE(N_ERR, "cgroup: Failed to set memory.max of inst '%s' to '%s' (errno=%d)",
+              inst->name, val, errno)
+   }
+
+   return 0;
+
+err_cleanup:
+   VERBOSE(N_ERR, "cgroup: Failed to open leaf of inst '%s' (errno=%d)", inst->name, errno)
+   cgroup_inst_release(inst);
+   return -1;
+}
+
+int cgroup_inst_sample(const inst_t *inst, cgroup_stats_t *stats)
+{
+   char buf[CGROUP_IO_STAT_BUF_SIZE];
+   ssize_t len;
+
+   memset(stats, 0, sizeof(cgroup_stats_t));
+
+   len = proc_pread(inst->cg.cpu_stat_fd, buf, PROC_READ_BUF_SIZE);
+   if (len == -1 || cgroup_parse_cpu_stat(buf, (size_t) len, stats) == -1) {
+      return -1;
+   }
+   if (cgroup_read_u64(inst->cg.mem_current_fd, &stats->mem_current) == -1) {
+      return -1;
+   }
+   if (inst->cg.mem_peak_fd != -1) {
+      (void) cgroup_read_u64(inst->cg.mem_peak_fd, &stats->mem_peak);
+   }
+   if (inst->cg.io_stat_fd != -1) {
+      len = proc_pread(inst->cg.io_stat_fd, buf, sizeof(buf));
+      if (len != -1) {
+         (void) cgroup_parse_io_stat(buf, (size_t) len, stats);
+      }
+   }
+
+   return 0;
+}
+
+int cgroup_inst_oom_killed(inst_t *inst)
+{
+   uint64_t oom_kills;
+   bool killed;
+
+   if (inst->cg.dir_fd == -1 || cgroup_read_oom_kills(inst->cg.dir_fd, &oom_kills) == -1) {
+      return -1;
+   }
+   killed = (oom_kills > inst->cg.oom_kills);
+   inst->cg.oom_kills = oom_kills;
+
+   return (killed ? 1 : 0);
+}
+
+int cgroup_inst_kill(const inst_t *inst)
+{
+   // Available since Linux 5.14
+   if (inst->cg.dir_fd == -1 || cgroup_write(inst->cg.dir_fd, "cgroup.kill", "1") == -1) {
+      return -1;
+   }
+   return 0;
+}
+
+void cgroup_inst_release(inst_t *inst)
+{
+   inst_cgroup_t *cg = &inst->cg;
+   int *fds[] = { &cg->procs_fd, &cg->cpu_stat_fd, &cg->mem_current_fd, &cg->mem_peak_fd,
+                  &cg->io_stat_fd, &cg->dir_fd };
+
+   if (cg->dir_fd == -1) {
+      return;
+   }
+   for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+      if (*fds[i] != -1) {
+         close(*fds[i]);
+         *fds[i] = -1;
+      }
+   }
+
+   // Fails with EBUSY while some process of instance is still alive, leaf is reused then
+   if (instances_fd != -1 && unlinkat(instances_fd, inst->name, AT_REMOVEDIR) == -1
+       && errno != EBUSY && errno != ENOENT) {
+      VERBOSE(V2, "cgroup: Failed to remove leaf of inst '%s' (errno=%d)", inst->name, errno)
+   }
+}
+
+static int cgroup_scan_key(const char *buf, size_t len, const char *key, uint64_t *val)
+{
+   const char *end = buf + len;
+   const char *p = buf;
+   size_t key_len = strlen(key);
+   uint64_t num = 0;
+
+   while (p < end) {
+      if ((size_t) (end - p) > key_len && memcmp(p, key, key_len) == 0 && p[key_len] == ' ') {
+         p += key_len + 1;
+         if (p == end || *p < '0' || *p > '9') {
+            return -1;
+         }
+         while (p < end && *p >= '0' && *p <= '9') {
+            num = num * 10 + (uint64_t) (*p - '0');
+            p++;
+         }
+         *val = num;
+         return 0;
+      }
+      p = memchr(p, '\n', (size_t) (end - p));
+      if (p == NULL) {
+         break;
+      }
+      p++;
+   }
+
+   return -1;
+}
+
+static int cgroup_read_oom_kills(int dir_fd, uint64_t *val)
+{
+   char buf[PROC_READ_BUF_SIZE];
+   ssize_t len;
+   int fd;
+
+   // Read only when process dies by SIGKILL, so it isn't kept open
+   fd = openat(dir_fd, "memory.events", O_RDONLY | O_CLOEXEC);
+   if (fd == -1) {
+      return -1;
+   }
+   len = proc_pread(fd, buf, sizeof(buf));
+   close(fd);
+   if (len == -1) {
+      return -1;
+   }
+
+   return cgroup_scan_key(buf, (size_t) len, "oom_kill", val);
+}
+
+static int cgroup_read_u64(int fd, uint64_t *val)
+{
+   char buf[32];
+   char *endptr;
+   ssize_t len = proc_pread(fd, buf, sizeof(buf));
+
+   if (len <= 0) {
+      return -1;
+   }
+   *val = strtoull(buf, &endptr, 10);
+   if (endptr == buf) {
+      return -1;
+   }
+   return 0;
+}
+
+int cgroup_parse_cpu_stat(const char *buf, size_t len, cgroup_stats_t *stats)
+{
+   if (cgroup_scan_key(buf, len, "user_usec", &stats->user_usec) == -1
+       || cgroup_scan_key(buf, len, "system_usec", &stats->system_usec) == -1) {
+      return -1;
+   }
+   return 0;
+}
+
+int cgroup_parse_io_stat(const char *buf, size_t len, cgroup_stats_t *stats)
+{
+   const char *end = buf + len;
+   const char *p = buf;
+   uint64_t *dst;
+   uint64_t num;
+
+   stats->io_rbytes = 0;
+   stats->io_wbytes = 0;
+
+   // "MAJ:MIN rbytes=N wbytes=N rios=N wios=N dbytes=N dios=N" per device
+   while (p < end) {
+      dst = NULL;
+      if ((size_t) (end - p) > 7 && memcmp(p, "rbytes=", 7) == 0) {
+         dst = &stats->io_rbytes;
+      } else if ((size_t) (end - p) > 7 && memcmp(p, "wbytes=", 7) == 0) {
+         dst = &stats->io_wbytes;
+      }
+
+      if (dst != NULL) {
+         p += 7;
+         if (*p < '0' || *p > '9') {
+            return -1;
+         }
+         num = 0;
+         while (p < end && *p >= '0' && *p <= '9') {
+            num = num * 10 + (uint64_t) (*p - '0');
+            p++;
+         }
+         *dst += num;
+         continue;
+      }
+
+      // Next word
+      while (p < end && *p != ' ' && *p != '\n') {
+         p++;
+      }
+      while (p < end && (*p == ' ' || *p == '\n')) {
+         p++;
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file cgroup.h
+ * @brief Placement of instances into cgroup v2 leaves and cgroup based accounting.
+ * @details Supervisor moves itself into leaf "supervisor" of the cgroup it was started
+ *  in and creates a leaf for every started instance under "instances":
+ *
+ *    <own cgroup>/supervisor
+ *    <own cgroup>/instances/<instance name>
+ *
+ *  The cgroup has to be delegated to supervisor, i.e. no other process may be member of
+ *  it (e.g. systemd service with Delegate=yes). If cgroup v2 is not available,
+ *  instances are not placed and their resources usage is sampled from /proc.
+ */
+
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include "module.h"
+
+#define CGROUP_MOUNT_PATH "/sys/fs/cgroup" ///< Mount point of cgroup v2 hierarchy
+#define CGROUP_SUPERVISOR_LEAF "supervisor" ///< Leaf supervisor process itself is moved to
+#define CGROUP_INSTANCES_DIR "instances" ///< Parent of leaves of instances
+#define CGROUP_CONTROLLERS "+cpu +memory +io" ///< Controllers enabled for leaves of instances
+
+/**
+ * @brief Accounting read from leaf of instance
+ * */
+typedef struct cgroup_stats_s {
+   uint64_t user_usec; ///< CPU time in user mode of all processes of the leaf
+   uint64_t system_usec; ///< CPU time in kernel mode of all processes of the leaf
+   uint64_t mem_current; ///< Memory charged to the leaf in bytes
+   uint64_t mem_peak; ///< Maximum of mem_current in bytes or 0 if kernel doesn't report it
+   uint64_t io_rbytes; ///< Bytes read from block devices
+   uint64_t io_wbytes; ///< Bytes written to block devices
+} cgroup_stats_t;
+
+extern bool cgroups_enabled; ///< Whether instances are placed into cgroup leaves
+
+/**
+ * @brief Sets up supervisor subtree of cgroup v2 hierarchy.
+ * @details Failure is not fatal, cgroups_enabled stays false then.
+ * @return -1 if cgroups can't be used, 0 on success
+ * */
+extern int cgroup_init();
+
+/**
+ * @brief Closes supervisor subtree, leaves are kept so that running instances stay in them.
+ * */
+extern void cgroup_deinit();
+
+/**
+ * @brief Creates leaf of given instance if needed, applies its limits and opens its files.
+ * @details Has to be called before instance process is spawned.
+ * @param inst Instance about to be started
+ * @return -1 on error, 0 on success
+ * */
+extern int cgroup_inst_prepare(inst_t *inst);
+
+/**
+ * @brief Reads accounting of leaf of given instance
+ * @param inst Instance with prepared leaf
+ * @param stats Loaded accounting
+ * @return -1 on error, 0 on success
+ * */
+extern int cgroup_inst_sample(const inst_t *inst, cgroup_stats_t *stats);
+
+/**
+ * @brief Checks whether the OOM killer killed some process of leaf of given instance since
+ *  the last check (or since the leaf was prepared).
+ * @param inst Instance with prepared leaf
+ * @return 1 if some process was killed, 0 if not, -1 if it can't be told
+ * */
+extern int cgroup_inst_oom_killed(inst_t *inst);
+
+/**
+ * @brief Kills all processes of leaf of given instance at once via cgroup.kill.
+ * @param inst Instance with prepared leaf
+ * @return -1 if leaf can't be killed this way (e.g. kernel older than 5.14), 0 on success
+ * */
+extern int cgroup_inst_kill(const inst_t *inst);
+
+/**
+ * @brief Closes files of leaf of given instance and removes the leaf if it is empty.
+ * @param inst Instance to use
+ * */
+extern void cgroup_inst_release(inst_t *inst);
+
+/**
+ * @brief Parses content of cpu.stat
+ * @param buf Content of the file
+ * @param len Length of content
+ * @param stats Where user_usec and system_usec are loaded
+ * @return -1 if content is malformed, 0 on success
+ * */
+extern int cgroup_parse_cpu_stat(const char *buf, size_t len, cgroup_stats_t *stats);
+
+/**
+ * @brief Parses content of io.stat, bytes of all devices are summed up.
+ * @param buf Content of the file
+ * @param len Length of content
+ * @param stats Where io_rbytes and io_wbytes are loaded
+ * @return -1 if content is malformed, 0 on success
+ * */
+extern int cgroup_parse_io_stat(const char *buf, size_t len, cgroup_stats_t *stats);
+
+#endif
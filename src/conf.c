@@ -7,6 +7,7 @@
 #include <sysrepo/xpath.h>
 #include "conf.h"
 #include "module.h"
+#include "autoplace.h"
 
 bool daemon_flag = false;
 char *logs_path = NULL;
@@ -135,6 +136,15 @@ int ns_startup_config_load(sr_session_ctx_t *sess)
    char av_mods_xpath[] = NS_ROOT_XPATH"/available-module";
    char insts_xpath[] = NS_ROOT_XPATH"/instance";
 
+   rc = intervals_load(sess);
+   if (rc != SR_ERR_OK) {
+      goto err_cleanup;
+   }
+   rc = autoplace_conf_load(sess);
+   if (rc != SR_ERR_OK) {
+      goto err_cleanup;
+   }
+
    { // load /available-modules
       rc = sr_get_items(sess, av_mods_xpath, &vals, &vals_cnt);
       if (FOUND_AND_ERR(rc)) {
@@ -183,6 +193,77 @@ err_cleanup:
    return rc;
 }
 
+int intervals_load(sr_session_ctx_t *sess)
+{
+   int rc;
+   intervals_t loaded = {
+         .liveness_ms = DEFAULT_LIVENESS_PERIOD_MS,
+         .resources_ms = DEFAULT_RESOURCES_PERIOD_MS,
+         .service_ifc_ms = DEFAULT_SERVICE_IFC_PERIOD_MS,
+         .changed = true,
+   };
+
+   rc = load_sr_num(sess, NS_ROOT_XPATH"/intervals", "/liveness-check",
+                    &(loaded.liveness_ms), SR_UINT32_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/intervals/liveness-check", NS_ROOT_XPATH)
+      return rc;
+   }
+   rc = load_sr_num(sess, NS_ROOT_XPATH"/intervals", "/resources-sampling",
+                    &(loaded.resources_ms), SR_UINT32_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/intervals/resources-sampling", NS_ROOT_XPATH)
+      return rc;
+   }
+   rc = load_sr_num(sess, NS_ROOT_XPATH"/intervals", "/service-ifc-polling",
+                    &(loaded.service_ifc_ms), SR_UINT32_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/intervals/service-ifc-polling", NS_ROOT_XPATH)
+      return rc;
+   }
+
+   intervals = loaded;
+   VERBOSE(V3, "Loaded intervals: liveness=%u ms, resources=%u ms, service ifc=%u ms",
+           intervals.liveness_ms, intervals.resources_ms, intervals.service_ifc_ms)
+
+   return SR_ERR_OK;
+}
+
+int autoplace_conf_load(sr_session_ctx_t *sess)
+{
+   int rc;
+   autoplace_conf_t loaded = {
+         .enabled = false,
+         .rebalance_ms = DEFAULT_AUTOPLACE_REBALANCE_MS,
+         .threshold_perc = DEFAULT_AUTOPLACE_THRESHOLD,
+   };
+
+   rc = load_sr_num(sess, NS_ROOT_XPATH"/auto-placement", "/enabled",
+                    &(loaded.enabled), SR_BOOL_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/auto-placement/enabled", NS_ROOT_XPATH)
+      return rc;
+   }
+   rc = load_sr_num(sess, NS_ROOT_XPATH"/auto-placement", "/rebalance-period",
+                    &(loaded.rebalance_ms), SR_UINT32_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/auto-placement/rebalance-period", NS_ROOT_XPATH)
+      return rc;
+   }
+   rc = load_sr_num(sess, NS_ROOT_XPATH"/auto-placement", "/rebalance-threshold",
+                    &(loaded.threshold_perc), SR_UINT8_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/auto-placement/rebalance-threshold", NS_ROOT_XPATH)
+      return rc;
+   }
+
+   autoplace_conf = loaded;
+   VERBOSE(V3, "Loaded auto-placement: enabled=%d, rebalance period=%u ms, threshold=%u%%",
+           autoplace_conf.enabled, autoplace_conf.rebalance_ms, autoplace_conf.threshold_perc)
+
+   return SR_ERR_OK;
+}
+
 int av_module_load_by_name(sr_session_ctx_t *sess, const char *module_name)
 {
    int rc;
@@ -273,6 +354,10 @@ inst_load(sr_session_ctx_t *sess, char *xpath)
    pid_t last_pid = 0;
    char *mod_ref = NULL;
    char *ifc_xpath = NULL;
+   char *cpus = NULL;
+   char *mem_policy = NULL;
+   char *mem_nodes = NULL;
+   char *log_capture = NULL;
    size_t ifc_cnt = 0;
    sr_val_t *ifces = NULL;
 
@@ -283,22 +368,22 @@ inst_load(sr_session_ctx_t *sess, char *xpath)
    }
    IF_NO_MEM_INT_ERR(inst)
 
-   if (vector_add(&insts_v, inst) != 0) {
-      NO_MEM_ERR
-      return SR_ERR_NOMEM;
-   }
-
    rc = load_sr_str(sess, xpath, "/name", &(inst->name));
    if (FOUND_AND_ERR(rc)) {
       VERBOSE(N_ERR, "Failed to load xpath %s/name", xpath)
       goto err_cleanup;
    }
+   inst->stats_xpath = stats_xpath_alloc(inst->name, NULL);
+   if (inst->stats_xpath == NULL) {
+      rc = SR_ERR_NOMEM;
+      goto err_cleanup;
+   }
    rc = load_sr_str(sess, xpath, "/module-ref", &mod_ref);
    if (FOUND_AND_ERR(rc)) {
       VERBOSE(N_ERR, "Failed to load xpath %s/module-ref", xpath)
       goto err_cleanup;
    }
-   rc = load_sr_num(sess, xpath, "/enabled", &(inst->enabled), SR_BOOL_T);
+   rc = load_sr_num(sess, xpath, "/enabled", &(INST_ENABLED(inst)), SR_BOOL_T);
    if (FOUND_AND_ERR(rc)) {
       VERBOSE(N_ERR, "Failed to load xpath %s/enabled", xpath)
       goto err_cleanup;
@@ -309,6 +394,49 @@ inst_load(sr_session_ctx_t *sess, char *xpath)
       VERBOSE(N_ERR, "Failed to load xpath %s/max-restarts-per-min", xpath)
       goto err_cleanup;
    }
+   rc = load_sr_num(sess, xpath, "/restart-policy/initial-backoff",
+                    &(inst->restart_policy.initial_backoff_ms), SR_UINT32_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/restart-policy/initial-backoff", xpath)
+      goto err_cleanup;
+   }
+   rc = load_sr_num(sess, xpath, "/restart-policy/max-backoff",
+                    &(inst->restart_policy.max_backoff_ms), SR_UINT32_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/restart-policy/max-backoff", xpath)
+      goto err_cleanup;
+   }
+   rc = load_sr_num(sess, xpath, "/restart-policy/jitter",
+                    &(inst->restart_policy.jitter_perc), SR_UINT8_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/restart-policy/jitter", xpath)
+      goto err_cleanup;
+   }
+   rc = load_sr_num(sess, xpath, "/restart-policy/stable-uptime",
+                    &(inst->restart_policy.stable_uptime_ms), SR_UINT32_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/restart-policy/stable-uptime", xpath)
+      goto err_cleanup;
+   }
+   rc = load_sr_num(sess, xpath, "/restart-policy/restart-on-exec-failure",
+                    &(inst->restart_policy.restart_on_exec_failure), SR_BOOL_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/restart-policy/restart-on-exec-failure", xpath)
+      goto err_cleanup;
+   }
+   rc = load_sr_num(sess, xpath, "/restart-policy/immediate-restart-on-oom-kill",
+                    &(inst->restart_policy.immediate_restart_on_oom_kill), SR_BOOL_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/restart-policy/immediate-restart-on-oom-kill",
+              xpath)
+      goto err_cleanup;
+   }
+   if (inst->restart_policy.max_backoff_ms < inst->restart_policy.initial_backoff_ms) {
+      inst->restart_policy.max_backoff_ms = inst->restart_policy.initial_backoff_ms;
+   }
+   if (inst->restart_policy.jitter_perc > 100) {
+      inst->restart_policy.jitter_perc = 100;
+   }
    rc = load_sr_str(sess, xpath, "/params", &(inst->params));
    if (FOUND_AND_ERR(rc)) {
       VERBOSE(N_ERR, "Failed to load xpath %s/params", xpath)
@@ -324,21 +452,102 @@ inst_load(sr_session_ctx_t *sess, char *xpath)
       VERBOSE(N_ERR, "Failed to load xpath %s/use-sysrepo", xpath)
       goto err_cleanup;
    }
+   rc = load_sr_num(sess, xpath, "/socket-activation", &(inst->socket_activation), SR_BOOL_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/socket-activation", xpath)
+      goto err_cleanup;
+   }
    rc = load_sr_num(sess, xpath, "/last-pid", &last_pid, SR_UINT32_T);
    if (FOUND_AND_ERR(rc)) {
       VERBOSE(N_ERR, "Failed to load xpath %s/last-pid", xpath)
       goto err_cleanup;
    }
+   rc = load_sr_num(sess, xpath, "/intervals/resources-sampling",
+                    &(inst->resources_period_ms), SR_UINT32_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/intervals/resources-sampling", xpath)
+      goto err_cleanup;
+   }
+   rc = load_sr_num(sess, xpath, "/intervals/service-ifc-polling",
+                    &(inst->service_ifc_period_ms), SR_UINT32_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/intervals/service-ifc-polling", xpath)
+      goto err_cleanup;
+   }
+   rc = load_sr_str(sess, xpath, "/limits/cpu-max", &(inst->cpu_max));
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/limits/cpu-max", xpath)
+      goto err_cleanup;
+   }
+   rc = load_sr_num(sess, xpath, "/limits/memory-max", &(inst->memory_max), SR_UINT64_T);
+   if (FOUND_AND_ERR(rc)) {
+      VERBOSE(N_ERR, "Failed to load xpath %s/limits/memory-max", xpath)
+      goto err_cleanup;
+   }
 
-   { // assign available-module name to pointer
-      av_module_t *mod;
-      for (int i = 0; i < avmods_v.total; i++) {
-         mod = avmods_v.items[i];
-         if (strcmp(mod->name, mod_ref) == 0) {
-            inst->mod_ref = mod;
-            break;
-         }
+   { // load logs
+      rc = load_sr_str(sess, xpath, "/logs/capture", &log_capture);
+      if (FOUND_AND_ERR(rc)) {
+         VERBOSE(N_ERR, "Failed to load xpath %s/logs/capture", xpath)
+         goto err_cleanup;
+      }
+      if (log_capture != NULL && strcmp(log_capture, "file") == 0) {
+         inst->log_conf.capture = LOG_CAPTURE_FILE;
+      }
+      NULLP_TEST_AND_FREE(log_capture)
+      rc = load_sr_num(sess, xpath, "/logs/max-size", &(inst->log_conf.max_size),
+                       SR_UINT64_T);
+      if (FOUND_AND_ERR(rc)) {
+         VERBOSE(N_ERR, "Failed to load xpath %s/logs/max-size", xpath)
+         goto err_cleanup;
+      }
+      rc = load_sr_num(sess, xpath, "/logs/rotate-interval", &(inst->log_conf.rotate_interval_s),
+                       SR_UINT32_T);
+      if (FOUND_AND_ERR(rc)) {
+         VERBOSE(N_ERR, "Failed to load xpath %s/logs/rotate-interval", xpath)
+         goto err_cleanup;
+      }
+      rc = load_sr_num(sess, xpath, "/logs/keep", &(inst->log_conf.keep), SR_UINT8_T);
+      if (FOUND_AND_ERR(rc)) {
+         VERBOSE(N_ERR, "Failed to load xpath %s/logs/keep", xpath)
+         goto err_cleanup;
+      }
+      rc = load_sr_num(sess, xpath, "/logs/rate-limit", &(inst->log_conf.rate_limit),
+                       SR_UINT32_T);
+      if (FOUND_AND_ERR(rc)) {
+         VERBOSE(N_ERR, "Failed to load xpath %s/logs/rate-limit", xpath)
+         goto err_cleanup;
+      }
+   }
+
+   { // load placement, configured lists are needed only until they are parsed
+      rc = load_sr_str(sess, xpath, "/placement/cpus", &cpus);
+      if (FOUND_AND_ERR(rc)) {
+         VERBOSE(N_ERR, "Failed to load xpath %s/placement/cpus", xpath)
+         goto err_cleanup;
+      }
+      rc = load_sr_str(sess, xpath, "/placement/mem-policy", &mem_policy);
+      if (FOUND_AND_ERR(rc)) {
+         VERBOSE(N_ERR, "Failed to load xpath %s/placement/mem-policy", xpath)
+         goto err_cleanup;
+      }
+      rc = load_sr_str(sess, xpath, "/placement/mem-nodes", &mem_nodes);
+      if (FOUND_AND_ERR(rc)) {
+         VERBOSE(N_ERR, "Failed to load xpath %s/placement/mem-nodes", xpath)
+         goto err_cleanup;
       }
+      if (placement_load(&inst->placement, cpus, mem_policy, mem_nodes) != 0) {
+         VERBOSE(N_ERR, "Invalid placement of instance '%s'", inst->name)
+         rc = SR_ERR_VALIDATION_FAILED;
+         goto err_cleanup;
+      }
+      NULLP_TEST_AND_FREE(cpus)
+      NULLP_TEST_AND_FREE(mem_policy)
+      NULLP_TEST_AND_FREE(mem_nodes)
+   }
+
+   { // assign available-module name to pointer
+      inst->mod_ref = (mod_ref != NULL ? av_module_get_by_name(mod_ref) : NULL);
       if (inst->mod_ref == NULL) {
          VERBOSE(N_ERR, "Failed to load module '%s' since it's available module "
                "'%s' is not loaded.", inst->name, mod_ref)
@@ -376,6 +585,13 @@ inst_load(sr_session_ctx_t *sess, char *xpath)
       goto err_cleanup;
    }
 
+   // Added once fully loaded, so that it is indexed under its name and module
+   if (insts_add(inst) != 0) {
+      NO_MEM_ERR
+      rc = SR_ERR_NOMEM;
+      goto err_cleanup;
+   }
+
    if (last_pid > 0) {
       VERBOSE(V3, "Restoring PID=%d for %s", last_pid, inst->name)
       inst_pid_restore(last_pid, inst, sess);
@@ -390,7 +606,10 @@ err_cleanup:
    }
    NULLP_TEST_AND_FREE(ifc_xpath)
    NULLP_TEST_AND_FREE(mod_ref)
-   vector_delete(&insts_v, insts_v.total - 1);
+   NULLP_TEST_AND_FREE(cpus)
+   NULLP_TEST_AND_FREE(mem_policy)
+   NULLP_TEST_AND_FREE(mem_nodes)
+   NULLP_TEST_AND_FREE(log_capture)
    inst_free(inst);
 
    return rc;
@@ -402,11 +621,6 @@ av_module_load(sr_session_ctx_t *sess, char *xpath)
    av_module_t *amod = av_module_alloc();
    IF_NO_MEM_INT_ERR(amod)
 
-   if (vector_add(&avmods_v, amod) != 0) {
-      NO_MEM_ERR
-      return SR_ERR_NOMEM;
-   }
-
    int rc;
 
    rc = load_sr_str(sess, xpath, "/name", &(amod->name));
@@ -430,10 +644,18 @@ av_module_load(sr_session_ctx_t *sess, char *xpath)
       goto err_cleanup;
    }
 
+   // Added once its name is loaded, so that it is indexed under it
+   if (av_modules_add(amod) != 0) {
+      NO_MEM_ERR
+      rc = SR_ERR_NOMEM;
+      goto err_cleanup;
+   }
+
    return 0;
 
 err_cleanup:
    VERBOSE(N_ERR, "Failed to load module from xpath %s", xpath)
+   av_module_free(amod);
    return rc;
 }
 
@@ -537,6 +759,11 @@ interface_load(sr_session_ctx_t *sess, char *xpath, inst_t *inst)
       NO_MEM_ERR
       goto err_cleanup;
    }
+   ifc->stats_xpath = stats_xpath_alloc(inst->name, ifc->name);
+   if (ifc->stats_xpath == NULL) {
+      rc = SR_ERR_NOMEM;
+      goto err_cleanup;
+   }
 
    if (inst_interface_add(inst, ifc) != 0) {
       NO_MEM_ERR
@@ -760,9 +987,14 @@ inst_pid_restore(pid_t last_pid, inst_t *inst,
 
    if (strcmp(run_path, inst->mod_ref->path) == 0) {
       // Process under PID last_pid is really this inst
-      inst->pid = last_pid;
-      inst->running = true;
+      INST_PID(inst) = last_pid;
+      INST_RUNNING(inst) = true;
       inst->is_my_child = false;
+      if (inst_pidfd_open(inst) == -1 && errno == ESRCH) {
+         // Process exited in the meantime
+         INST_PID(inst) = 0;
+         INST_RUNNING(inst) = false;
+      }
    }
 
    // Might be good to compare even /proc/{pid}/cmdline
@@ -815,6 +1047,9 @@ load_sr_num(sr_session_ctx_t *sess, char *base_xpath, char *node_xpath,
       case SR_UINT32_T:
          *((uint32_t *) where) = val->data.uint32_val;
          break;
+      case SR_UINT64_T:
+         *((uint64_t *) where) = val->data.uint64_val;
+         break;
 
       default:
          VERBOSE(N_ERR, "Invalid usage of load_sr_num for data type %d", data_type);
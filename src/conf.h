@@ -19,6 +19,24 @@ extern char *logs_path; ///< Path to where logs directory should reside
 extern int ns_startup_config_load(sr_session_ctx_t *sess);
 
 
+/**
+ * @brief Loads periods of supervisor subsystems from /supervisor/intervals into intervals.
+ * @details Leaves that are not set keep their default values. Sets intervals.changed
+ *  so that supervisor_routine re-arms its timers.
+ * @param sess Sysrepo session to use
+ * @return sysrepo error code
+ * */
+extern int intervals_load(sr_session_ctx_t *sess);
+
+/**
+ * @brief Loads configuration of automatic placement from /supervisor/auto-placement
+ *  into autoplace_conf.
+ * @details Leaves that are not set keep their default values.
+ * @param sess Sysrepo session to use
+ * @return sysrepo error code
+ * */
+extern int autoplace_conf_load(sr_session_ctx_t *sess);
+
 /**
  * @brief Loads module structure of given name from sysrepo.
  * @param sess Sysrepo session to use
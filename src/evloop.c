@@ -0,0 +1,260 @@
+/**
+ * @file evloop.c
+ * @brief Implementation of evloop.h
+ */
+
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "evloop.h"
+
+evloop_t main_evloop = {
+      .epfd = -1,
+      .wakeup_src = NULL,
+      .lock = NULL,
+      .garbage = {.total = 0, .capacity = 0, .items = NULL},
+      .woken_up = false,
+};
+
+/**
+ * @brief Drains eventfd used for waking the loop up
+ * @param events Epoll events
+ * @param priv Pointer to evloop_t the eventfd belongs to
+ * */
+static void evloop_wakeup_handler(uint32_t events, void *priv);
+
+/**
+ * @brief Frees all sources removed from given loop
+ * @param loop Loop to clean
+ * */
+static void evloop_collect_garbage(evloop_t *loop);
+
+
+int evloop_init(evloop_t *loop, pthread_mutex_t *lock)
+{
+   int wakeup_fd;
+
+   loop->lock = lock;
+   loop->woken_up = false;
+   loop->wakeup_src = NULL;
+
+   if (vector_init(&loop->garbage, 10) != 0) {
+      return -1;
+   }
+
+   loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+   if (loop->epfd == -1) {
+      VERBOSE(N_ERR, "Failed to create epoll instance (errno=%d)", errno)
+      vector_free(&loop->garbage);
+      return -1;
+   }
+
+   wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if (wakeup_fd == -1) {
+      VERBOSE(N_ERR, "Failed to create eventfd (errno=%d)", errno)
+      goto err_cleanup;
+   }
+
+   loop->wakeup_src = evloop_add(loop, wakeup_fd, EPOLLIN, evloop_wakeup_handler, loop);
+   if (loop->wakeup_src == NULL) {
+      close(wakeup_fd);
+      goto err_cleanup;
+   }
+   loop->wakeup_src->owns_fd = true;
+
+   return 0;
+
+err_cleanup:
+   close(loop->epfd);
+   loop->epfd = -1;
+   vector_free(&loop->garbage);
+   return -1;
+}
+
+ev_source_t * evloop_add(evloop_t *loop, int fd, uint32_t events,
+                         ev_handler_fn handler, void *priv)
+{
+   struct epoll_event ev;
+   ev_source_t *src = NULL;
+
+   if (loop->epfd == -1 || fd < 0) {
+      return NULL;
+   }
+
+   src = (ev_source_t *) calloc(1, sizeof(ev_source_t));
+   IF_NO_MEM_NULL_ERR(src)
+
+   src->fd = fd;
+   src->handler = handler;
+   src->priv = priv;
+   src->removed = false;
+   src->owns_fd = false;
+   src->is_timer = false;
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = events;
+   ev.data.ptr = src;
+   if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+      VERBOSE(N_ERR, "Failed to add fd %d to epoll (errno=%d)", fd, errno)
+      NULLP_TEST_AND_FREE(src)
+      return NULL;
+   }
+
+   return src;
+}
+
+int evloop_mod(evloop_t *loop, ev_source_t *src, uint32_t events)
+{
+   struct epoll_event ev;
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = events;
+   ev.data.ptr = src;
+   if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, src->fd, &ev) == -1) {
+      VERBOSE(N_ERR, "Failed to modify fd %d in epoll (errno=%d)", src->fd, errno)
+      return -1;
+   }
+
+   return 0;
+}
+
+void evloop_del(evloop_t *loop, ev_source_t *src)
+{
+   if (src == NULL || src->removed) {
+      return;
+   }
+
+   // Fails only when fd was already closed, which removes it from epoll anyway
+   (void) epoll_ctl(loop->epfd, EPOLL_CTL_DEL, src->fd, NULL);
+   if (src->owns_fd) {
+      close(src->fd);
+   }
+   src->fd = -1;
+   src->removed = true;
+
+   if (vector_add(&loop->garbage, src) != 0) {
+      /* This should never happen and the source is leaked rather than freed
+       * while it might be still referenced */
+      NO_MEM_ERR
+   }
+}
+
+ev_source_t * evloop_add_timer(evloop_t *loop, uint32_t period_ms,
+                               ev_handler_fn handler, void *priv)
+{
+   int fd;
+   ev_source_t *src = NULL;
+   struct itimerspec its;
+
+   fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   if (fd == -1) {
+      VERBOSE(N_ERR, "Failed to create timerfd (errno=%d)", errno)
+      return NULL;
+   }
+
+   its.it_interval.tv_sec = period_ms / 1000;
+   its.it_interval.tv_nsec = (period_ms % 1000) * 1000000L;
+   its.it_value = its.it_interval;
+   if (timerfd_settime(fd, 0, &its, NULL) == -1) {
+      VERBOSE(N_ERR, "Failed to arm timerfd (errno=%d)", errno)
+      close(fd);
+      return NULL;
+   }
+
+   src = evloop_add(loop, fd, EPOLLIN, handler, priv);
+   if (src == NULL) {
+      close(fd);
+      return NULL;
+   }
+   src->owns_fd = true;
+   src->is_timer = true;
+
+   return src;
+}
+
+int evloop_run_once(evloop_t *loop, int timeout_ms)
+{
+   int nfds;
+   uint64_t expirations;
+   ev_source_t *src = NULL;
+   struct epoll_event events[EVLOOP_MAX_EVENTS];
+
+   nfds = epoll_wait(loop->epfd, events, EVLOOP_MAX_EVENTS, timeout_ms);
+   if (nfds == -1) {
+      if (errno == EINTR) {
+         return 0;
+      }
+      VERBOSE(N_ERR, "epoll_wait failed (errno=%d)", errno)
+      return -1;
+   }
+
+   if (loop->lock != NULL) {
+      pthread_mutex_lock(loop->lock);
+   }
+
+   for (int i = 0; i < nfds; i++) {
+      src = events[i].data.ptr;
+      // Source might have been removed by handler of previous event
+      if (src->removed) {
+         continue;
+      }
+      if (src->is_timer) {
+         if (read(src->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            continue;
+         }
+      }
+      src->handler(events[i].events, src->priv);
+   }
+   evloop_collect_garbage(loop);
+
+   if (loop->lock != NULL) {
+      pthread_mutex_unlock(loop->lock);
+   }
+
+   return nfds;
+}
+
+void evloop_wakeup(evloop_t *loop)
+{
+   uint64_t one = 1;
+
+   if (loop->wakeup_src == NULL) {
+      return;
+   }
+   if (write(loop->wakeup_src->fd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+      VERBOSE(V2, "Failed to wake up event loop (errno=%d)", errno)
+   }
+}
+
+void evloop_free(evloop_t *loop)
+{
+   if (loop->epfd == -1) {
+      return;
+   }
+
+   evloop_del(loop, loop->wakeup_src);
+   loop->wakeup_src = NULL;
+   evloop_collect_garbage(loop);
+   vector_free(&loop->garbage);
+
+   close(loop->epfd);
+   loop->epfd = -1;
+}
+
+static void evloop_wakeup_handler(uint32_t events, void *priv)
+{
+   uint64_t cnt;
+   evloop_t *loop = priv;
+
+   // Eventfd counter is reset by read, EAGAIN means it was already drained
+   (void) read(loop->wakeup_src->fd, &cnt, sizeof(cnt));
+   loop->woken_up = true;
+}
+
+static void evloop_collect_garbage(evloop_t *loop)
+{
+   for (uint32_t i = 0; i < loop->garbage.total; i++) {
+      NULLP_TEST_AND_FREE(loop->garbage.items[i])
+   }
+   loop->garbage.total = 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file evloop.h
+ * @brief Small epoll based event loop. Supervisor routine waits inside it for signals, timers, instance and service interface events instead of sleeping for fixed period.
+ */
+
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include "utils.h"
+
+#define EVLOOP_MAX_EVENTS 64 ///< Maximum number of events fetched by one epoll_wait call
+
+/**
+ * @brief Handler called when registered file descriptor becomes ready
+ * @param events Epoll events that occured (EPOLLIN, EPOLLHUP, ...)
+ * @param priv Private pointer given at registration
+ * */
+typedef void (*ev_handler_fn)(uint32_t events, void *priv);
+
+/**
+ * @brief Single file descriptor registered inside event loop.
+ * */
+typedef struct ev_source_s {
+   int fd; ///< Watched file descriptor
+   ev_handler_fn handler; ///< Function to call once fd is ready
+   void *priv; ///< Private pointer passed to handler
+   bool removed; ///< Source was removed, but might still be referenced by fetched events
+   bool owns_fd; ///< Whether to close fd when source is removed
+   bool is_timer; ///< Expiration count is read from timerfd before handler is called
+} ev_source_t;
+
+/**
+ * @brief Event loop structure.
+ * @details Sources removed from loop are not freed immediately since epoll_wait might have
+ *  already returned events pointing to them. They are kept in garbage vector and freed
+ *  after all fetched events are dispatched.
+ * */
+typedef struct evloop_s {
+   int epfd; ///< Epoll file descriptor or -1 if loop is not initialized
+   ev_source_t *wakeup_src; ///< Eventfd used to interrupt epoll_wait from other threads
+   pthread_mutex_t *lock; ///< Mutex held during dispatching of events or NULL
+   vector_t garbage; ///< Removed sources waiting to be freed
+   bool woken_up; ///< Set when loop was woken up by evloop_wakeup
+} evloop_t;
+
+extern evloop_t main_evloop; ///< Event loop of supervisor_routine
+
+/**
+ * @brief Initializes given event loop.
+ * @param loop Loop to initialize
+ * @param lock Mutex to hold while dispatching events or NULL
+ * @return 0 on success, -1 on error
+ * */
+extern int evloop_init(evloop_t *loop, pthread_mutex_t *lock);
+
+/**
+ * @brief Registers file descriptor inside event loop.
+ * @details Functions modifying registered sources are expected to be called with loop's
+ *  lock held in case the loop has one.
+ * @param loop Loop to use
+ * @param fd File descriptor to watch
+ * @param events Epoll events to watch for
+ * @param handler Function to call once fd is ready
+ * @param priv Private pointer passed to handler
+ * @return Pointer to new source or NULL on error
+ * */
+extern ev_source_t * evloop_add(evloop_t *loop, int fd, uint32_t events,
+                                ev_handler_fn handler, void *priv);
+
+/**
+ * @brief Changes watched events of given source.
+ * @param loop Loop to use
+ * @param src Source to modify
+ * @param events New set of epoll events
+ * @return 0 on success, -1 on error
+ * */
+extern int evloop_mod(evloop_t *loop, ev_source_t *src, uint32_t events);
+
+/**
+ * @brief Removes source from event loop. Source gets freed after current dispatch ends.
+ * @details File descriptor is closed only if source owns it (see evloop_add_timer).
+ * @param loop Loop to use
+ * @param src Source to remove, NULL is ignored
+ * */
+extern void evloop_del(evloop_t *loop, ev_source_t *src);
+
+/**
+ * @brief Creates periodic timer and registers it inside event loop.
+ * @param loop Loop to use
+ * @param period_ms Period of timer in milliseconds
+ * @param handler Function to call on each expiration
+ * @param priv Private pointer passed to handler
+ * @return Pointer to new source that owns the timer fd or NULL on error
+ * */
+extern ev_source_t * evloop_add_timer(evloop_t *loop, uint32_t period_ms,
+                                      ev_handler_fn handler, void *priv);
+
+/**
+ * @brief Waits for events at most timeout_ms milliseconds and dispatches them.
+ * @param loop Loop to use
+ * @param timeout_ms Timeout for epoll_wait, -1 to block
+ * @return Number of dispatched events or -1 on error
+ * */
+extern int evloop_run_once(evloop_t *loop, int timeout_ms);
+
+/**
+ * @brief Interrupts epoll_wait of given loop. Safe to call from other threads.
+ * @param loop Loop to wake up
+ * */
+extern void evloop_wakeup(evloop_t *loop);
+
+/**
+ * @brief Frees removed sources, wakeup eventfd and closes epoll file descriptor.
+ * @details Sources still registered by callers have to be removed by them beforehand.
+ * @param loop Loop to free
+ * */
+extern void evloop_free(evloop_t *loop);
+
+#endif
@@ -3,25 +3,126 @@
  * @brief Takes care of starting and stopping of instances.
  */
 
+#include <poll.h>
+#include <sys/resource.h>
 #include <libtrap/trap.h>
 #include "utils.h"
 #include "inst_control.h"
+#include "cgroup.h"
+#include "autoplace.h"
+#include "spawn.h"
+#include "startup.h"
+#include "sockact.h"
 
 /**
  * @brief Releases child process of supervisor and cleans socket files
  * @details When supervisor kills instance it started (its child) or fails to start
  *  instance in forked process, the process stays as zombie in the system and needs
- *  to be released via waitpid(WNOHANG) inside this function.
+ *  to be released via wait4(WNOHANG) inside this function.
  *  Some instances are also leaving their libtrap socket files in the filesystem so
  *  those get removed in this function as well.
  * @param inst Instance to clean after
  * */
 static inline void clean_after_child(inst_t * inst);
 
+static tw_timer_t startup_timer; ///< Armed while some instance waits for its producers
+
+/**
+ * @brief Expire function of startup_timer, wakes up supervisor routine to start instances
+ *  which producers got ready meanwhile.
+ * @param priv Unused
+ * */
+static void startup_timer_cb(void *priv);
+
+/**
+ * @brief Checks whether some enabled instance is not running.
+ * @return true if insts_start has something to start
+ * */
+static bool insts_start_needed();
+
+/**
+ * @brief Formats message written to stdout log of instance right before execv.
+ * @param inst Instance being started
+ * @param len Length of the message
+ * @return Allocated message or NULL on error
+ * */
+static char * inst_exec_msg(const inst_t *inst, size_t *len);
+
 /**
- * @brief Loop over all instances and call clean_after_child for each
+ * @brief Sends SIGINT to instance process and arms stop_timer for SIGKILL.
+ * @details Instance that is not running gets INST_STOP_REAPED state right away.
+ * @param inst Instance to stop
  * */
-static void clean_after_children();
+static void inst_stop(inst_t *inst);
+
+/**
+ * @brief Expire function of stop_timer, moves stop state machine of instance forward.
+ * @details Sends SIGKILL once grace period after SIGINT passes. Removed instance
+ *  gets released once its process is gone.
+ * @param priv Instance being stopped
+ * */
+static void inst_stop_timer_cb(void *priv);
+
+/**
+ * @brief Sets INST_STOP_REAPED state to instance being stopped in case its process is gone.
+ * @param inst Instance to check
+ * @return true if instance is in INST_STOP_REAPED state
+ * */
+static bool inst_stop_check_gone(inst_t *inst);
+
+/**
+ * @brief Expire function of restart_timer, closes restart window of instance.
+ * @param priv Instance
+ * */
+static void inst_restart_window_cb(void *priv);
+
+/**
+ * @brief Removes given instance from dying_insts_v and frees it.
+ * @param inst Dying instance
+ * */
+static void dying_inst_release(inst_t *inst);
+
+/**
+ * @brief Checks whether any instance is still being stopped.
+ * @return true if some instance waits for SIGKILL or for its process to be released
+ * */
+static bool insts_stopping();
+
+/**
+ * @brief Checks whether process of instance that is being stopped is gone.
+ * @param inst Instance to check
+ * @return true if process doesn't exist anymore
+ * */
+static bool inst_process_gone(inst_t *inst);
+
+/**
+ * @brief Starts stopping of instance that was removed from insts_v.
+ * @details If the process is still running, instance is moved to dying_insts_v and
+ *  freed once the process is gone, otherwise it's freed right away.
+ * @param inst Instance removed from insts_v
+ * @return 1 if instance was moved to dying_insts_v, 0 if it was freed
+ * */
+static int inst_stop_remove(inst_t *inst);
+
+/**
+ * @brief Checks whether removed instance with the same name is still being stopped.
+ * @param inst Instance to check
+ * @return true if instance has to wait with its start
+ * */
+static bool inst_has_dying_twin(const inst_t *inst);
+
+/**
+ * @brief Frees modules from dying_avmods_v that are not referenced by any dying instance.
+ * */
+static void dying_avmods_free_unused();
+
+/**
+ * @brief Records exit status of reaped instance process and marks instance as not running.
+ * @param inst Instance which process was reaped
+ * @param status Status returned by wait4
+ * @param usage Resource usage returned by wait4
+ * */
+static void inst_handle_reaped(inst_t *inst, int status, const struct rusage *usage);
 
 /**
  * @brief Start single instance process
@@ -29,20 +130,54 @@ static void clean_after_children();
  * */
 static void inst_start(inst_t *inst);
 
+/**
+ * @brief Classifies exit of reaped process of given instance.
+ * @details SIGKILL that supervisor didn't send is attributed to the OOM killer if oom_kill
+ *  counter in memory.events of the cgroup leaf of the instance grew. Without leaf there is
+ *  no reliable way to tell, such exit is reported as plain signal.
+ * @param inst Instance which process was reaped
+ * @param status Status returned by wait4
+ * @return Reason of the exit
+ * */
+static inst_exit_reason_t inst_exit_classify(inst_t *inst, int status);
+
+/**
+ * @brief Decides when instance which process exited gets restarted according to its
+ *  restart_policy and arms its backoff_timer.
+ * @details Instance which binary couldn't be executed is disabled unless its policy says
+ *  otherwise. Instance killed by the OOM killer is restarted right away.
+ * @param inst Enabled instance which process exited on its own
+ * @param now Current monotonic time in milliseconds
+ * */
+static void inst_restart_plan(inst_t *inst, uint64_t now);
+
+/**
+ * @brief Randomizes delay of restart by up to jitter_perc % in both directions.
+ * @param backoff_ms Delay to randomize
+ * @param jitter_perc Maximum deviation in % of backoff_ms
+ * @return Randomized delay
+ * */
+static uint32_t inst_backoff_jitter(uint32_t backoff_ms, uint8_t jitter_perc);
+
+/**
+ * @brief Expire function of backoff_timer, wakes up supervisor routine to restart instance.
+ * @param priv Instance
+ * */
+static void inst_backoff_timer_cb(void *priv);
+
 
 uint32_t get_running_insts_cnt()
 {
    uint32_t some_inst_running = 0;
 
    inst_t *inst;
-   for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
-
-      if (inst->pid <= 0) {
+   for (uint32_t s = 0; s < insts_hot.used; s++) {
+      if (insts_hot.listed[s] == false || insts_hot.pid[s] <= 0) {
          continue;
       }
+      inst = insts_hot.inst[s];
       inst_set_running_status(inst);
-      some_inst_running += inst->running ? 1 : 0;
+      some_inst_running += INST_RUNNING(inst) ? 1 : 0;
    }
 
    return some_inst_running;
@@ -50,109 +185,77 @@ uint32_t get_running_insts_cnt()
 
 void insts_stop_sigkill()
 {
-   // Find running status of each instance first
-   (void) get_running_insts_cnt();
-
-   bool should_be_killed;
    inst_t *inst;
-   for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
-      should_be_killed = (inst->enabled == false || inst->should_die);
 
-      if (inst->running
-          && inst->sigint_sent
-          && should_be_killed) {
+   // Release processes that already exited
+   insts_reap_children();
 
-         // Only running instance that is disabled or has group disabled
-         VERBOSE(V2, "Stopping inst (%s). Sending SIGKILL",
-                 inst->name)
-         kill(inst->pid, SIGKILL);
+   // SIGKILL itself is sent by stop_timer, here are only released dying instances
+   for (uint32_t i = 0; i < dying_insts_v.total; i++) {
+      inst = dying_insts_v.items[i];
+      if (inst_stop_check_gone(inst)) {
+         dying_inst_release(inst);
+         i--;
       }
    }
-   clean_after_children();
+   dying_avmods_free_unused();
 }
 
 void insts_stop_sigint()
 {
    bool should_be_killed;
    inst_t *inst;
-   for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
-
-      should_be_killed = (inst->enabled == false|| inst->should_die);
-
-      if (inst->running
-          && inst->root_perm_needed == false
-          && inst->sigint_sent == false
-          && should_be_killed) {
+   for (uint32_t s = 0; s < insts_hot.used; s++) {
+      should_be_killed = (insts_hot.enabled[s] == false || insts_hot.should_die[s]);
+      if (insts_hot.listed[s] == false || insts_hot.running[s] == false
+          || should_be_killed == false) {
+         continue;
+      }
 
-            VERBOSE(V2, "Stopping inst (%s). Sending SIGINT", inst->name)
-            kill(inst->pid, SIGINT);
-            inst->sigint_sent = true;
-            inst->restarts_cnt = 0;
+      // Only instances that should be killed are dereferenced
+      inst = insts_hot.inst[s];
+      if (inst->root_perm_needed == false && inst->stop_state == INST_STOP_NONE) {
+         inst_stop(inst);
       }
    }
-   usleep(WAIT_FOR_INSTS_TO_HANDLE_SIGINT);
-   clean_after_children();
+   insts_reap_children();
 }
 
 void av_module_stop_remove_by_name(const char *name)
 {
-   uint32_t fi; // Index of found module
    av_module_t *mod = NULL;
+   inst_t *inst;
+   bool mod_referenced = false;
 
    VERBOSE(V2, "Stopping instances of module '%s'", name)
 
-   { // find module structure by name
-      av_module_t *tmp = NULL;
-      for (uint32_t i = 0; i < avmods_v.total; i++) {
-         tmp = avmods_v.items[i];
-         if (strcmp(tmp->name, name) == 0) {
-            fi = i;
-            mod = tmp;
-            break;
-         }
-      }
-
-      if (mod == NULL) {
-         // Module was not found, no need to do anything
-         return;
-      }
+   mod = av_module_get_by_name(name);
+   if (mod == NULL) {
+      // Module was not found, no need to do anything
+      return;
    }
 
-   inst_t *inst;
-   for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
-      if (strcmp(inst->mod_ref->name, name) == 0) {
-         if (inst->pid > 0) {
-            kill(inst->pid, SIGINT);
-         }
-      }
-   }
-   usleep(WAIT_FOR_INSTS_TO_HANDLE_SIGINT);
-   for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
-      if (strcmp(inst->mod_ref->name, name) == 0) {
-         VERBOSE(V3, "Stopping instance '%s'", inst->name)
-         if (inst->pid > 0) {
-            kill(inst->pid, SIGKILL);
-         }
-         clean_after_child(inst);
-         vector_delete(&insts_v, i);
-         inst_free(inst);
-         i--;
+   // Instances of the module are known from its reverse index, which outlives their removal
+   insts_delete_module(mod);
+   for (uint32_t i = 0; i < mod->insts.total; i++) {
+      inst = mod->insts.items[i];
+      VERBOSE(V3, "Stopping instance '%s'", inst->name)
+      if (inst_stop_remove(inst) == 1) {
+         mod_referenced = true;
       }
    }
+   vector_free(&mod->insts);
 
-
-   vector_delete(&avmods_v, fi);
-   av_module_free(mod);
+   av_modules_delete(mod);
+   // Socket files of dying instances are cleaned according to their module
+   if (mod_referenced == false || vector_add(&dying_avmods_v, mod) != 0) {
+      av_module_free(mod);
+   }
 }
 
 void inst_stop_remove_by_name(const char *name)
 {
-   uint32_t fi; // Index of found instance
-   inst_t *inst = inst_get_by_name(name, &fi);
+   inst_t *inst = inst_get_by_name(name, NULL);
 
    if (inst == NULL) {
       // Instance was not found, no need to do anything
@@ -160,89 +263,147 @@ void inst_stop_remove_by_name(const char *name)
    }
    VERBOSE(V2, "Stopping instance '%s'", inst->name)
 
-   if (inst->pid > 0) {
-      kill(inst->pid, SIGINT);
-      usleep(WAIT_FOR_INSTS_TO_HANDLE_SIGINT);
-      kill(inst->pid, SIGKILL);
-      clean_after_child(inst);
-   }
-
-   vector_delete(&insts_v, fi);
-   inst_free(inst);
+   insts_delete(inst);
+   (void) inst_stop_remove(inst);
 }
 
 void insts_terminate()
 {
    inst_t *inst = NULL;
+   uint64_t deadline = get_mono_time_ms() + 2 * INST_STOP_GRACE_MS + TW_TICK_MS;
+
    pthread_mutex_lock(&config_lock);
+   tw_cancel(&main_wheel, &startup_timer);
    for (uint32_t i = 0; i < insts_v.total; i++) {
       inst = insts_v.items[i];
 
-      if (inst->enabled) {
-         inst->enabled = false;
+      if (INST_ENABLED(inst)) {
+         INST_ENABLED(inst) = false;
       }
    }
 
    VERBOSE(V3, "Killing all instances")
-   // Ensure they get killed
    insts_stop_sigint();
-   usleep(WAIT_FOR_INSTS_TO_HANDLE_SIGINT);
-   (void) get_running_insts_cnt();
-   insts_stop_sigkill();
+   // Supervisor is exiting, so waiting here doesn't block anything
+   while (insts_stopping() && get_mono_time_ms() < deadline) {
+      usleep(INST_STOP_POLL_MICSEC);
+      insts_stop_sigkill();
+      for (uint32_t i = 0; i < insts_v.total; i++) {
+         (void) inst_stop_check_gone(insts_v.items[i]);
+      }
+      // Sends SIGKILL to instances which grace period passed
+      tw_advance(&main_wheel, get_mono_time_ms());
+   }
    // No need for waitpid since supervisor as a parent is terminated anyway
    pthread_mutex_unlock(&config_lock);
 }
 
 void insts_start()
 {
-   time_t time_now;
+   uint64_t now = get_mono_time_ms();
    VERBOSE(V3, "Updating instances status")
 
+   startup_order_t order;
+   bool waiting = false;
+   uint32_t idx;
    inst_t *inst;
+
+   if (insts_start_needed() == false) {
+      return;
+   }
+
+   // Instances or their interfaces might have changed since the last pass
+   autoplace_invalidate();
+   if (startup_order_build((inst_t **) insts_v.items, insts_v.total, &order) == -1) {
+      VERBOSE(N_ERR, "Failed to order instances by their dependencies, "
+              "starting them as configured")
+   }
+
    for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
+      idx = (order.order != NULL ? order.order[i] : i);
+      inst = insts_v.items[idx];
 
-      if (inst->enabled == false || inst->running == true) {
+      if (INST_ENABLED(inst) == false || INST_RUNNING(inst) == true) {
          continue;
       }
 
-      time(&time_now);
+      if (inst_has_dying_twin(inst)) {
+         VERBOSE(V3, "Instance '%s' waits for its removed predecessor to stop", inst->name)
+         continue;
+      }
+
+      // Failed instance is restarted once its backoff delay expires
+      if (tw_armed(&inst->backoff_timer)) {
+         continue;
+      }
+
+      // Waiting doesn't count as start attempt, so restart limit isn't burnt by it
+      if (startup_inst_waits(&order, (inst_t **) insts_v.items, idx, now)) {
+         VERBOSE(V3, "Instance '%s' waits for its producers to get ready", inst->name)
+         waiting = true;
+         continue;
+      }
 
       // Has it been less than minute since last start attempt?
-      if (time_now - inst->restart_time <= 60) {
+      if (tw_armed(&inst->restart_timer)) {
          inst->restarts_cnt++;
          if (inst->restarts_cnt == inst->max_restarts_minute) {
             VERBOSE(V2,
                     "Instance '%s' reached restart limit. Disabling.",
                     inst->name)
-            inst->enabled = false;
+            INST_ENABLED(inst) = false;
          } else {
             inst_start(inst);
          }
       } else {
          inst->restarts_cnt = 0;
-         inst->restart_time = time_now;
+         tw_timer_init(&inst->restart_timer, inst_restart_window_cb, inst);
+         tw_arm(&main_wheel, &inst->restart_timer, now, INST_RESTART_WINDOW_MS);
          inst_start(inst);
       }
    }
+   startup_order_free(&order);
+
+   // Readiness of producers is polled until all their consumers are started
+   if (waiting && tw_armed(&startup_timer) == false) {
+      tw_timer_init(&startup_timer, startup_timer_cb, NULL);
+      tw_arm(&main_wheel, &startup_timer, now, STARTUP_POLL_MS);
+   }
 
    // Clean after instances that failed to start
-   clean_after_children();
+   insts_reap_children();
+}
+
+static void startup_timer_cb(void *priv)
+{
+   evloop_wakeup(&main_evloop);
+}
+
+static bool insts_start_needed()
+{
+   for (uint32_t s = 0; s < insts_hot.used; s++) {
+      if (insts_hot.listed[s] && insts_hot.enabled[s] && insts_hot.running[s] == false) {
+         return true;
+      }
+   }
+
+   return false;
 }
 
 static inline void clean_after_child(inst_t * inst)
 {
    pid_t result;
    int status;
+   struct rusage usage;
 
-   if (inst->pid > 0 && inst->is_my_child) {
-      /* waitpid releases children that failed to execute execv in inst_start.
+   if (INST_PID(inst) > 0 && inst->is_my_child) {
+      /* wait4 releases children that failed to execute execv in inst_start.
        * if this would be left out, processes would stay there as zombies */
-      result = waitpid(inst->pid , &status, WNOHANG);
+      result = wait4(INST_PID(inst), &status, WNOHANG, &usage);
       switch (result) {
          case 0:
-            if (inst->sigint_sent) {
-               VERBOSE(V1, "waitpid: Instance (%s) is still running after killing",
+            if (inst->stop_state != INST_STOP_NONE) {
+               VERBOSE(V1, "wait4: Instance (%s) is still running after killing",
                        inst->name)
             }
             break;
@@ -252,41 +413,358 @@ static inline void clean_after_child(inst_t * inst)
                // Process with PID doesn't exist or isn't supervisor's child
                inst->is_my_child = false;
             }
-            VERBOSE(V2, "waitpid: Some error occured, but inst %s is not running",
+            VERBOSE(V2, "wait4: Some error occured, but inst %s is not running",
                     inst->name)
-            inst->running = false;
-            if (inst->enabled == false) {
-               inst->should_die = true;
+            INST_RUNNING(inst) = false;
+            inst_pidfd_close(inst);
+            if (INST_ENABLED(inst) == false) {
+               INST_SHOULD_DIE(inst) = true;
             }
             inst_clear_socks(inst);
             break;
 
          default: // Instance is not running
-            VERBOSE(V2, "waitpid: Instance %s is not running. waitpid result=%d", inst->name, result)
-            inst->running = false;
-            inst->pid = 0; // because of waitpid it is removed from process tree
-            if (inst->enabled == false) {
-               inst->should_die = true;
-               inst_clear_socks(inst);
-            }
+            inst_handle_reaped(inst, status, &usage);
+      }
+   }
+}
+
+static void inst_handle_reaped(inst_t *inst, int status, const struct rusage *usage)
+{
+   inst_exit_info_t *info = &inst->last_exit;
+
+   info->valid = true;
+   time(&info->time);
+   if (WIFSIGNALED(status)) {
+      info->code = -1;
+      info->signal = WTERMSIG(status);
+      info->core_dumped = WCOREDUMP(status) ? true : false;
+      VERBOSE(V2, "wait4: Instance %s (PID: %d) was terminated by signal %d%s",
+              inst->name, INST_PID(inst), info->signal,
+              info->core_dumped ? " (core dumped)" : "")
+   } else {
+      info->code = WEXITSTATUS(status);
+      info->signal = 0;
+      info->core_dumped = false;
+      VERBOSE(V2, "wait4: Instance %s (PID: %d) exited with code %d",
+              inst->name, INST_PID(inst), info->code)
+   }
+   info->cpu_user_us = (uint64_t) usage->ru_utime.tv_sec * 1000000 + usage->ru_utime.tv_usec;
+   info->cpu_kern_us = (uint64_t) usage->ru_stime.tv_sec * 1000000 + usage->ru_stime.tv_usec;
+   info->max_rss = (uint64_t) usage->ru_maxrss;
+
+   info->reason = inst_exit_classify(inst, status);
+
+   INST_RUNNING(inst) = false;
+   inst_pidfd_close(inst);
+   inst_proc_close(inst);
+   INST_PID(inst) = 0; // because of wait4 it is removed from process tree
+   // Process stopped by supervisor is restarted (e.g. with new configuration) right away
+   if (INST_ENABLED(inst) && inst->stop_state == INST_STOP_NONE) {
+      inst_restart_plan(inst, get_mono_time_ms());
+   }
+   if (INST_ENABLED(inst) == false) {
+      INST_SHOULD_DIE(inst) = true;
+      inst_clear_socks(inst);
+   }
+}
+
+static inst_exit_reason_t inst_exit_classify(inst_t *inst, int status)
+{
+   if (inst->exec_failed) {
+      return INST_EXIT_EXEC_FAILED;
+   }
+   if (WIFSIGNALED(status) == false) {
+      return INST_EXIT_CODE;
+   }
+   if (WTERMSIG(status) != SIGKILL || inst->stop_state != INST_STOP_NONE) {
+      return INST_EXIT_SIGNAL;
+   }
+   if (inst->cg.dir_fd != -1 && cgroup_inst_oom_killed(inst) == 1) {
+      return INST_EXIT_OOM_KILL;
+   }
+
+   return INST_EXIT_SIGNAL;
+}
+
+static void inst_restart_plan(inst_t *inst, uint64_t now)
+{
+   restart_policy_t *rp = &inst->restart_policy;
+   uint32_t delay;
+
+   // Healthy run forgives previous failures
+   if (inst->start_ms != 0 && now - inst->start_ms >= rp->stable_uptime_ms) {
+      inst->backoff_ms = 0;
+   }
+
+   switch (inst->last_exit.reason) {
+      case INST_EXIT_EXEC_FAILED:
+         if (rp->restart_on_exec_failure == false) {
+            VERBOSE(N_ERR, "Instance '%s' couldn't be executed, it is disabled until its "
+                    "configuration changes", inst->name)
+            INST_ENABLED(inst) = false;
+            return;
+         }
+         break;
+      case INST_EXIT_OOM_KILL:
+         if (rp->immediate_restart_on_oom_kill) {
+            VERBOSE(N_ERR, "Instance '%s' was killed by the OOM killer, restarting it right away",
+                    inst->name)
+            return;
+         }
+         break;
+      default:
+         break;
+   }
+
+   if (inst->backoff_ms == 0) {
+      inst->backoff_ms = rp->initial_backoff_ms;
+   } else if (inst->backoff_ms < rp->max_backoff_ms / 2) {
+      inst->backoff_ms *= 2;
+   } else {
+      inst->backoff_ms = rp->max_backoff_ms;
+   }
+   if (inst->backoff_ms > rp->max_backoff_ms) {
+      inst->backoff_ms = rp->max_backoff_ms;
+   }
+
+   delay = inst_backoff_jitter(inst->backoff_ms, rp->jitter_perc);
+   if (delay == 0) {
+      return;
+   }
+   VERBOSE(V2, "Instance '%s' will be restarted in %u ms", inst->name, delay)
+   tw_timer_init(&inst->backoff_timer, inst_backoff_timer_cb, inst);
+   tw_arm(&main_wheel, &inst->backoff_timer, now, delay);
+}
+
+static uint32_t inst_backoff_jitter(uint32_t backoff_ms, uint8_t jitter_perc)
+{
+   static unsigned int seed = 0;
+   uint64_t spread = (uint64_t) backoff_ms * jitter_perc / 100;
+
+   if (spread == 0) {
+      return backoff_ms;
+   }
+   if (seed == 0) {
+      seed = (unsigned int) (get_mono_time_ms() ^ (uint64_t) getpid()) | 1U;
+   }
+
+   // Uniformly from backoff_ms - spread to backoff_ms + spread
+   return (uint32_t) (backoff_ms - spread + (uint64_t) rand_r(&seed) % (2 * spread + 1));
+}
+
+static void inst_backoff_timer_cb(void *priv)
+{
+   evloop_wakeup(&main_evloop);
+}
+
+static void inst_stop(inst_t *inst)
+{
+   if (inst->stop_state != INST_STOP_NONE) {
+      return;
+   }
+
+   if (INST_RUNNING(inst) == false || inst_process_gone(inst)) {
+      inst->stop_state = INST_STOP_REAPED;
+      return;
+   }
+
+   VERBOSE(V2, "Stopping inst (%s). Sending SIGINT", inst->name)
+   inst_send_signal(inst, SIGINT);
+   inst->stop_state = INST_STOP_SIGINT_SENT;
+   inst->restarts_cnt = 0;
+   tw_timer_init(&inst->stop_timer, inst_stop_timer_cb, inst);
+   tw_arm(&main_wheel, &inst->stop_timer, get_mono_time_ms(), INST_STOP_GRACE_MS);
+}
+
+static void inst_stop_timer_cb(void *priv)
+{
+   inst_t *inst = priv;
+
+   // Process might have exited without supervisor noticing yet
+   insts_reap_children();
+   if (inst_stop_check_gone(inst)) {
+      // Frees the instance in case it was removed from configuration
+      dying_inst_release(inst);
+      return;
+   }
+
+   if (inst->stop_state == INST_STOP_SIGINT_SENT) {
+      VERBOSE(V2, "Stopping inst (%s). Sending SIGKILL", inst->name)
+      // Kills also processes forked by the instance
+      if (cgroup_inst_kill(inst) == -1) {
+         inst_send_signal(inst, SIGKILL);
+      }
+      inst->stop_state = INST_STOP_SIGKILL_SENT;
+   } else {
+      VERBOSE(V1, "Instance (%s) is still running after SIGKILL", inst->name)
+   }
+   tw_arm(&main_wheel, &inst->stop_timer, get_mono_time_ms(), INST_STOP_GRACE_MS);
+}
+
+static bool inst_stop_check_gone(inst_t *inst)
+{
+   if (inst->stop_state == INST_STOP_SIGINT_SENT
+       || inst->stop_state == INST_STOP_SIGKILL_SENT) {
+      if (inst_process_gone(inst) == false) {
+         return false;
+      }
+      inst->stop_state = INST_STOP_REAPED;
+      INST_RUNNING(inst) = false;
+      INST_PID(inst) = 0;
+      tw_cancel(&main_wheel, &inst->stop_timer);
+   }
+
+   return inst->stop_state == INST_STOP_REAPED;
+}
+
+static void inst_restart_window_cb(void *priv)
+{
+   inst_t *inst = priv;
+   inst->restarts_cnt = 0;
+}
+
+static void dying_inst_release(inst_t *inst)
+{
+   for (uint32_t i = 0; i < dying_insts_v.total; i++) {
+      if (dying_insts_v.items[i] == inst) {
+         VERBOSE(V3, "Removed instance '%s' was stopped", inst->name)
+         vector_delete(&dying_insts_v, i);
+         sockact_inst_release(inst);
+         inst_free(inst);
+         break;
       }
    }
 }
 
-static void clean_after_children()
+static bool insts_stopping()
 {
    inst_t *inst;
-   for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
-      clean_after_child(inst);
+
+   for (uint32_t i = 0; i < insts_v.total + dying_insts_v.total; i++) {
+      if (i < insts_v.total) {
+         inst = insts_v.items[i];
+      } else {
+         inst = dying_insts_v.items[i - insts_v.total];
+      }
+      if (inst->stop_state == INST_STOP_SIGINT_SENT
+          || inst->stop_state == INST_STOP_SIGKILL_SENT) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+static bool inst_process_gone(inst_t *inst)
+{
+   if (INST_PID(inst) <= 0) {
+      return true;
+   }
+   if (inst->is_my_child) {
+      // Exit is reported by reaping
+      return false;
+   }
+   if (inst->pidfd != -1) {
+      // pidfd becomes readable once the process exits
+      struct pollfd pfd = {.fd = inst->pidfd, .events = POLLIN, .revents = 0};
+      return poll(&pfd, 1, 0) == 1;
+   }
+
+   // Adopted process without pidfd has to be polled
+   return kill(INST_PID(inst), 0) == -1 && errno == ESRCH;
+}
+
+static int inst_stop_remove(inst_t *inst)
+{
+   INST_ENABLED(inst) = false;
+   INST_SHOULD_DIE(inst) = true;
+   inst_stop(inst);
+
+   if (inst->stop_state != INST_STOP_REAPED) {
+      // Dying instance is no longer sampled
+      tw_cancel(&main_wheel, &inst->resources_timer);
+      tw_cancel(&main_wheel, &inst->service_ifc_timer);
+      if (vector_add(&dying_insts_v, inst) == 0) {
+         return 1;
+      }
+      // Can't wait for the process, it gets released by insts_reap_children later
+      inst_send_signal(inst, SIGKILL);
+   }
+
+   clean_after_child(inst);
+   sockact_inst_release(inst);
+   inst_free(inst);
+   return 0;
+}
+
+static bool inst_has_dying_twin(const inst_t *inst)
+{
+   inst_t *dying;
+
+   for (uint32_t i = 0; i < dying_insts_v.total; i++) {
+      dying = dying_insts_v.items[i];
+      if (strcmp(dying->name, inst->name) == 0) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+static void dying_avmods_free_unused()
+{
+   av_module_t *mod;
+   bool referenced;
+
+   for (uint32_t i = 0; i < dying_avmods_v.total; i++) {
+      mod = dying_avmods_v.items[i];
+      referenced = false;
+      for (uint32_t j = 0; j < dying_insts_v.total; j++) {
+         if (((inst_t *) dying_insts_v.items[j])->mod_ref == mod) {
+            referenced = true;
+            break;
+         }
+      }
+
+      if (referenced == false) {
+         vector_delete(&dying_avmods_v, i);
+         av_module_free(mod);
+         i--;
+      }
+   }
+}
+
+void insts_reap_children()
+{
+   pid_t pid;
+   int status;
+   struct rusage usage;
+   inst_t *inst;
+
+   // Only children that already exited are returned, running ones are not touched
+   while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+      inst = inst_get_by_pid(pid);
+      if (inst == NULL || inst->is_my_child == false) {
+         // Instance was already removed from configuration
+         VERBOSE(V3, "wait4: Released child (PID: %d) of removed instance", pid)
+         continue;
+      }
+      inst_handle_reaped(inst, status, &usage);
    }
 }
 
 void inst_set_running_status(inst_t *inst)
 {
+   if (inst->pid_src != NULL) {
+      // Exit of process is reported via pidfd, no need to poll
+      INST_RUNNING(inst) = true;
+      return;
+   }
+
    // Send SIGHUP to check whether process exists
-   if (inst->pid > 0 && kill(inst->pid, 0) != -1) {
-      inst->running = true;
+   if (INST_PID(inst) > 0 && kill(INST_PID(inst), 0) != -1) {
+      INST_RUNNING(inst) = true;
       inst->root_perm_needed = false;
    } else {
       switch (errno) {
@@ -296,34 +774,68 @@ void inst_set_running_status(inst_t *inst)
                VERBOSE(V2,
                        "kill -0: Does not have permissions to send"
                              "signals to inst '%s' (PID: %d)",
-                       inst->name, inst->pid)
+                       inst->name, INST_PID(inst))
                inst->root_perm_needed = true;
             }
-            inst->running = true;
+            INST_RUNNING(inst) = true;
             break;
 
          case ESRCH:
             // Error: process doesn't exist
             VERBOSE(V3,
                     "kill -0: %s (PID: %d) is not running!",
-                    inst->name, inst->pid)
-            inst->running = false;
+                    inst->name, INST_PID(inst))
+            INST_RUNNING(inst) = false;
 
          default:
-            if (inst->service_sd != -1) {
-               close(inst->service_sd);
-               inst->service_sd = -1;
-            }
-            inst->running = false;
-            inst->service_ifc_connected = false;
+            inst_service_disconnected(inst);
+            INST_RUNNING(inst) = false;
       }
    }
 }
 
+static char * inst_exec_msg(const inst_t *inst, size_t *len)
+{
+   size_t size = PATH_MAX + 128;
+   size_t pos;
+   char *msg;
+
+   for (int i = 0; inst->exec_args[i] != NULL; i++) {
+      size += strlen(inst->exec_args[i]) + 1;
+   }
+   msg = malloc(size);
+   if (msg == NULL) {
+      NO_MEM_ERR
+      return NULL;
+   }
+
+   // Don't even think about rewriting this to VERBOSE macro
+   pos = (size_t) snprintf(msg, size, "[INFO]%s Supervisor executed following command from path=%s: ",
+                           get_formatted_time(), inst->mod_ref->path);
+   for (int i = 0; inst->exec_args[i] != NULL && pos < size; i++) {
+      pos += (size_t) snprintf(msg + pos, size - pos, " %s", inst->exec_args[i]);
+   }
+   if (pos + 1 >= size) {
+      free(msg);
+      return NULL;
+   }
+   msg[pos++] = '\n';
+   msg[pos] = '\0';
+   *len = pos;
+
+   return msg;
+}
+
 void inst_start(inst_t *inst)
 {
    char log_path_out[PATH_MAX];
    char log_path_err[PATH_MAX];
+   placement_t pl = inst->placement;
+   strbuf_t listen_names = { 0 };
+   int *listen_fds = NULL;
+   int listen_cnt = 0;
+   int log_fd_out = -1;
+   int log_fd_err = -1;
 
    VERBOSE(V2, "Starting '%s' from %s", inst->name, inst->mod_ref->path)
 
@@ -336,66 +848,102 @@ void inst_start(inst_t *inst)
    time(&time_now);
 
    // If the instance was killed due to one of these variables, they should be reseted
-   inst->should_die = false;
-   inst->sigint_sent = false;
+   INST_SHOULD_DIE(inst) = false;
+   inst->stop_state = INST_STOP_NONE;
+   tw_cancel(&main_wheel, &inst->stop_timer);
+   inst->start_time = time_now;
+   inst->start_ms = get_mono_time_ms();
+   inst->ready = false;
+   inst->exec_failed = false;
+   // CPU times of previous process are no baseline for the new one
+   inst->last_cpu_umode = 0;
+   inst->last_cpu_kmode = 0;
+   inst->last_total_cpu = 0;
+   inst->cpu_load = 0;
+
+   // Configured placement is kept, domain of chain is used only for instances without CPUs
+   autoplace_inst_prepare(inst, &pl);
+
+   if (cgroups_enabled && cgroup_inst_prepare(inst) == -1) {
+      VERBOSE(N_ERR, "Instance '%s' is started outside of cgroup", inst->name)
+   }
 
-   fflush(stdout);
-   inst->pid = fork();
+   // Sockets created now or kept from previous process of the instance
+   if (inst->socket_activation && inst->out_ifces.total > 0) {
+      listen_fds = malloc(inst->out_ifces.total * sizeof(int));
+      if (listen_fds != NULL) {
+         listen_cnt = sockact_inst_prepare(inst, listen_fds, &listen_names);
+      }
+      if (listen_fds == NULL || listen_cnt == -1) {
+         VERBOSE(N_ERR, "Instance '%s' is started without listening sockets of supervisor",
+                 inst->name)
+         listen_cnt = 0;
+      }
+   }
 
-   if (inst->pid == -1) {
-      inst->running = false;
-      VERBOSE(N_ERR,"Fork: could not fork supervisor process!")
-      return;
+   // Process opens the files itself if pipes can't be created
+   if (inst->log_conf.capture == LOG_CAPTURE_PIPE) {
+      log_fd_out = logpipe_open(&inst->log_out, log_path_out, PERM_LOGSDIR);
+      log_fd_err = logpipe_open(&inst->log_err, log_path_err, PERM_LOGSDIR);
    }
 
-   if (inst->pid != 0) {
-      // Running as parent
-      inst->is_my_child = true;
-      inst->running = true;
-   } else {
-      // Running as forked child
-      int fd_stdout = open(log_path_out, O_RDWR | O_CREAT | O_APPEND, PERM_LOGSDIR);
-      int fd_stderr = open(log_path_err, O_RDWR | O_CREAT | O_APPEND, PERM_LOGSDIR);
+   spawn_args_t args = {
+      .path = inst->mod_ref->path,
+      .argv = inst->exec_args,
+      .stdout_path = log_path_out,
+      .stderr_path = log_path_err,
+      .stdout_fd = log_fd_out,
+      .stderr_fd = log_fd_err,
+      .log_perm = PERM_LOGSDIR,
+      .cgroup_procs_fd = inst->cg.dir_fd != -1 ? inst->cg.procs_fd : -1,
+      .pl = &pl,
+      .listen_fds = listen_fds,
+      .listen_fds_cnt = (uint32_t) listen_cnt,
+      .listen_fdnames = listen_names.data,
+   };
+   char *exec_msg = inst_exec_msg(inst, &args.exec_msg_len);
+   args.exec_msg = exec_msg;
+
+   INST_PID(inst) = spawn_process(&args);
+   NULLP_TEST_AND_FREE(exec_msg)
+   NULLP_TEST_AND_FREE(listen_fds)
+   strbuf_free(&listen_names);
+   // Only the child writes to the pipes, EOF is seen once it exits
+   if (log_fd_out != -1) {
+      close(log_fd_out);
+   }
+   if (log_fd_err != -1) {
+      close(log_fd_err);
+   }
 
-      if (fd_stdout != -1) {
-         dup2(fd_stdout, 1); //stdout
-         close(fd_stdout);
-      }
-      if (fd_stderr != -1) {
-         dup2(fd_stderr, 2); //stderr
-         close(fd_stderr);
-      }
+   if (INST_PID(inst) == -1) {
+      INST_RUNNING(inst) = false;
+      VERBOSE(N_ERR, "Spawn: could not create process of inst '%s' (errno=%d)!",
+              inst->name, errno)
+      return;
+   }
 
-      /*
-       * Important for sending SIGINT to supervisor.
-       * */
-      setsid();
+   inst->is_my_child = true;
+   INST_RUNNING(inst) = true;
+   // Child can't be reaped before this, so pidfd_open can't fail with ESRCH
+   (void) inst_pidfd_open(inst);
 
-      // Don't even think about rewriting this to VERBOSE macro
-      fprintf(stdout, "[INFO]%s Supervisor executed following command from path=%s: ",
-              get_formatted_time(), inst->mod_ref->path);
-      for(int i = 0; inst->exec_args[i] != NULL; i++) {
-         fprintf(stdout, " %s", inst->exec_args[i]);
-      }
-      fprintf(stdout, "\n");
-      VERBOSE(V1, "")
-
-      // Make sure execution message gets written to logs files
-      fflush(stdout);
-      fflush(stderr);
-
-      execv(inst->mod_ref->path, inst->exec_args);
-
-      { // If correctly started, this won't be executed
-         VERBOSE(N_ERR,
-                 "Could not execute '%s' binary! (execvp errno=%d)",
-                 inst->name,
-                 errno)
-         fflush(stdout);
-         //terminate_supervisor(false);
-         close(fd_stdout);
-         close(fd_stderr);
-         _exit(EXIT_FAILURE);
-      }
+   if (args.cgroup_errno != 0) {
+      VERBOSE(N_ERR, "Inst '%s' failed to enter its cgroup (errno=%d)", inst->name,
+              args.cgroup_errno)
+   }
+   if (args.placement_errno != 0) {
+      VERBOSE(N_ERR, "Inst '%s' failed to apply CPU or memory placement (errno=%d)",
+              inst->name, args.placement_errno)
+   }
+   if (args.listen_errno != 0) {
+      VERBOSE(N_ERR, "Inst '%s' failed to inherit listening sockets (errno=%d)", inst->name,
+              args.listen_errno)
+   }
+   if (args.exec_errno != 0) {
+      // Child already exited, it gets reaped as any other exited instance
+      inst->exec_failed = true;
+      VERBOSE(N_ERR, "Could not execute '%s' binary! (execv errno=%d)", inst->name,
+              args.exec_errno)
    }
 }
\ No newline at end of file
@@ -9,12 +9,23 @@
 #include "module.h"
 
 /**
- * @details Time in micro seconds between sending SIGINT and SIGKILL to running
- *  modules_ll. Service thread sends SIGINT to stop running module, after time
- *  defined by this constant it checks modules_ll status and if the module is still
- *  running, service thread sends SIGKILL to stop it.
+ * @details Time in milliseconds between sending SIGINT and SIGKILL to running
+ *  instance. Supervisor sends SIGINT to stop running instance and arms its stop
+ *  timer to this constant. If the instance is still running once the timer
+ *  expires, SIGKILL is sent to stop it.
  */
-#define WAIT_FOR_INSTS_TO_HANDLE_SIGINT 500000
+#define INST_STOP_GRACE_MS 500
+
+/**
+ * @brief Length of window in milliseconds in which number of instance restarts is limited
+ *  by max_restarts_minute
+ */
+#define INST_RESTART_WINDOW_MS 60000
+
+/**
+ * @brief Time in micro seconds between checks of stopped instances during supervisor termination
+ */
+#define INST_STOP_POLL_MICSEC 10000
 
 /**
  * @brief Permissions of directory with stdout and stderr logs of instances
@@ -30,29 +41,42 @@ extern char *logs_path; ///< Path to where logs directory should reside
  * */
 extern uint32_t get_running_insts_cnt();
 
+/**
+ * @brief Releases exited children of supervisor and updates their running status
+ * @details Only children that already exited are reaped (one wait4(-1, WNOHANG) loop),
+ *  their exit status and resource usage gets recorded to inst_t.last_exit.
+ * */
+extern void insts_reap_children();
+
 /**
  * @brief Checks and assigns running status of single instance
  * */
 extern void inst_set_running_status(inst_t *inst);
 
 /**
- * @brief Sends SIGINT signal to all instances that have (.enabled=false || .should_die=true) && .sigint_sent=false
+ * @brief Sends SIGINT signal to all instances that have (.enabled=false || .should_die=true) && .stop_state=INST_STOP_NONE
+ * @details Does not wait for instances to exit, SIGKILL follows from insts_stop_sigkill
+ *  once INST_STOP_GRACE_MS passes.
  * */
 extern void insts_stop_sigint();
 
 /**
- * @brief Sends SIGKILL signal to all instances that (.enabled=false || .should_die=true) && .sigint_sent=true
+ * @brief Releases removed instances which processes are gone.
+ * @details SIGKILL itself is sent once stop timer of instance in main_wheel expires.
  * */
 extern void insts_stop_sigkill();
 
 /**
  * @brief Stops all instances of given module, removes all their structures and structure of module.
+ * @details Does not wait for instances to exit. Instances which processes are still
+ *  running are moved to dying_insts_v and stopped by supervisor routine.
  * @param name Name of module
  * */
 extern void av_module_stop_remove_by_name(const char *name);
 
 /**
- * @brief Stops instance of given name
+ * @brief Stops instance of given name and removes it from insts_v
+ * @details Does not wait for instance to exit, see av_module_stop_remove_by_name.
  * @param name Name of instance to stop
  * */
 extern void inst_stop_remove_by_name(const char *name);
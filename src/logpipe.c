@@ -0,0 +1,303 @@
+/**
+ * @file logpipe.c
+ * @brief Implementation of functions defined in logpipe.h
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include "logpipe.h"
+
+static int logpipe_null_fd = -1; ///< /dev/null discarded data are spliced to
+
+/**
+ * @brief Handler of read end of the pipe registered in main_evloop
+ * @param events Epoll events
+ * @param priv Pointer to log_stream_t
+ * */
+static void logpipe_handler(uint32_t events, void *priv);
+
+/**
+ * @brief Moves up to len bytes from the pipe to given descriptor. Plain read and write are
+ *  used for descriptors splice doesn't support.
+ * @param pipe_fd Read end of the pipe
+ * @param out_fd Target descriptor
+ * @param len Number of bytes to move
+ * @param stored Set to number of bytes that reached out_fd
+ * @return Number of bytes consumed from the pipe
+ * */
+static size_t logpipe_move(int pipe_fd, int out_fd, size_t len, size_t *stored);
+
+/**
+ * @brief Opens log file of stream at its end
+ * @param ls Stream with path set
+ * @param perm Permissions of the file if it is created
+ * @param now Monotonic time in milliseconds
+ * @return 0 on success, -1 on error
+ * */
+static int logpipe_file_open(log_stream_t *ls, mode_t perm, uint64_t now);
+
+/**
+ * @brief Closes read end of the pipe and removes it from main_evloop
+ * @param ls Stream of instance
+ * */
+static void logpipe_pipe_close(log_stream_t *ls);
+
+
+void log_conf_init(log_conf_t *conf)
+{
+   conf->capture = LOG_CAPTURE_PIPE;
+   conf->max_size = DEFAULT_LOG_MAX_SIZE;
+   conf->rotate_interval_s = 0;
+   conf->keep = DEFAULT_LOG_KEEP;
+   conf->rate_limit = 0;
+}
+
+void logpipe_init(log_stream_t *ls, const log_conf_t *conf)
+{
+   memset(ls, 0, sizeof(log_stream_t));
+   ls->conf = conf;
+   ls->file_fd = -1;
+   ls->pipe_fd = -1;
+}
+
+static int logpipe_file_open(log_stream_t *ls, mode_t perm, uint64_t now)
+{
+   off_t end;
+
+   // splice refuses files opened with O_APPEND, supervisor is the only writer anyway
+   ls->file_fd = open(ls->path, O_WRONLY | O_CREAT | O_CLOEXEC, perm);
+   if (ls->file_fd == -1) {
+      VERBOSE(N_ERR, "Failed to open log file %s (errno=%d)", ls->path, errno)
+      return -1;
+   }
+   end = lseek(ls->file_fd, 0, SEEK_END);
+   ls->size = (end > 0 ? (uint64_t) end : 0);
+   ls->opened_ms = now;
+
+   return 0;
+}
+
+static void logpipe_pipe_close(log_stream_t *ls)
+{
+   evloop_del(&main_evloop, ls->pipe_src);
+   ls->pipe_src = NULL;
+   if (ls->pipe_fd != -1) {
+      close(ls->pipe_fd);
+      ls->pipe_fd = -1;
+   }
+}
+
+int logpipe_open(log_stream_t *ls, const char *path, mode_t perm)
+{
+   uint64_t now = get_mono_time_ms();
+   int fds[2];
+
+   // Whatever previous process left in its pipe belongs before output of the new one
+   if (ls->pipe_fd != -1) {
+      logpipe_drain(ls, now);
+      logpipe_pipe_close(ls);
+   }
+
+   if (ls->path == NULL || strcmp(ls->path, path) != 0) {
+      if (ls->file_fd != -1) {
+         close(ls->file_fd);
+         ls->file_fd = -1;
+      }
+      NULLP_TEST_AND_FREE(ls->path)
+      ls->path = strdup(path);
+      if (ls->path == NULL) {
+         NO_MEM_ERR
+         return -1;
+      }
+   }
+   ls->perm = perm;
+   if (ls->file_fd == -1 && logpipe_file_open(ls, perm, now) == -1) {
+      return -1;
+   }
+
+   if (pipe2(fds, O_CLOEXEC) == -1) {
+      VERBOSE(N_ERR, "Failed to create log pipe for %s (errno=%d)", ls->path, errno)
+      return -1;
+   }
+   // Only supervisor's end is non-blocking, the module writes as to any other file
+   if (fcntl(fds[0], F_SETFL, O_NONBLOCK) == -1) {
+      goto err_cleanup;
+   }
+   // Bigger pipe absorbs bursts between two drains, default size is kept on failure
+   (void) fcntl(fds[1], F_SETPIPE_SZ, LOGPIPE_PIPE_SIZE);
+
+   ls->pipe_src = evloop_add(&main_evloop, fds[0], EPOLLIN, logpipe_handler, ls);
+   if (ls->pipe_src == NULL) {
+      goto err_cleanup;
+   }
+   ls->pipe_fd = fds[0];
+
+   return fds[1];
+
+err_cleanup:
+   close(fds[0]);
+   close(fds[1]);
+   return -1;
+}
+
+static size_t logpipe_move(int pipe_fd, int out_fd, size_t len, size_t *stored)
+{
+   char buf[4096];
+   size_t consumed = 0;
+   ssize_t n;
+   ssize_t w;
+
+   *stored = 0;
+   while (consumed < len) {
+      n = splice(pipe_fd, NULL, out_fd, NULL, len - consumed,
+                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (n > 0) {
+         consumed += (size_t) n;
+         *stored += (size_t) n;
+         continue;
+      }
+      if (n == 0 || errno != EINVAL) {
+         break;
+      }
+
+      // E.g. file system without splice support
+      n = read(pipe_fd, buf, (len - consumed < sizeof(buf) ? len - consumed : sizeof(buf)));
+      if (n <= 0) {
+         break;
+      }
+      consumed += (size_t) n;
+      w = write(out_fd, buf, (size_t) n);
+      if (w > 0) {
+         *stored += (size_t) w;
+      }
+      if (w != n) {
+         break;
+      }
+   }
+
+   return consumed;
+}
+
+int logpipe_rotate(log_stream_t *ls, uint64_t now)
+{
+   char from[PATH_MAX];
+   char to[PATH_MAX];
+
+   if (ls->file_fd != -1) {
+      close(ls->file_fd);
+      ls->file_fd = -1;
+   }
+
+   if (ls->conf->keep == 0) {
+      unlink(ls->path);
+   } else {
+      // Missing older files are fine, rename of the oldest one replaces the dropped one
+      for (int i = ls->conf->keep - 1; i > 0; i--) {
+         snprintf(from, sizeof(from), "%s.%d", ls->path, i);
+         snprintf(to, sizeof(to), "%s.%d", ls->path, i + 1);
+         rename(from, to);
+      }
+      snprintf(to, sizeof(to), "%s.1", ls->path);
+      if (rename(ls->path, to) == -1) {
+         VERBOSE(N_ERR, "Failed to rotate log file %s (errno=%d)", ls->path, errno)
+         unlink(ls->path);
+      }
+   }
+
+   return logpipe_file_open(ls, ls->perm, now);
+}
+
+void logpipe_drain(log_stream_t *ls, uint64_t now)
+{
+   const log_conf_t *conf = ls->conf;
+   size_t stored = 0;
+   size_t consumed = 0;
+   size_t allowed;
+   uint64_t refill;
+   int avail = 0;
+
+   if (ls->pipe_fd == -1 || ioctl(ls->pipe_fd, FIONREAD, &avail) == -1 || avail <= 0) {
+      return;
+   }
+   allowed = (size_t) avail;
+
+   if (conf->rate_limit != 0) {
+      // The bucket starts full
+      if (ls->refill_ms == 0) {
+         ls->tokens = conf->rate_limit;
+         ls->refill_ms = now;
+      } else {
+         /* Only time turned into whole tokens is consumed, otherwise frequent drains would
+          * round every refill down to nothing */
+         refill = (now - ls->refill_ms) * conf->rate_limit / 1000;
+         ls->tokens += refill;
+         ls->refill_ms += refill * 1000 / conf->rate_limit;
+      }
+      if (ls->tokens >= conf->rate_limit) {
+         ls->tokens = conf->rate_limit;
+         ls->refill_ms = now;
+      }
+      if (allowed > ls->tokens) {
+         allowed = (size_t) ls->tokens;
+      }
+   }
+
+   if (allowed > 0) {
+      if ((conf->max_size != 0 && ls->size > 0 && ls->size + allowed > conf->max_size)
+          || (conf->rotate_interval_s != 0
+              && now - ls->opened_ms >= (uint64_t) conf->rotate_interval_s * 1000)) {
+         (void) logpipe_rotate(ls, now);
+      }
+      if (ls->file_fd != -1) {
+         consumed = logpipe_move(ls->pipe_fd, ls->file_fd, allowed, &stored);
+      }
+      ls->size += stored;
+      ls->bytes_written += stored;
+      ls->bytes_dropped += consumed - stored;
+      if (conf->rate_limit != 0) {
+         ls->tokens -= (stored < ls->tokens ? stored : ls->tokens);
+      }
+   }
+
+   // Rest is over the limit or couldn't be written, the module mustn't block on full pipe
+   if ((size_t) avail > consumed) {
+      if (logpipe_null_fd == -1) {
+         logpipe_null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+      }
+      consumed = logpipe_move(ls->pipe_fd, logpipe_null_fd, (size_t) avail - consumed, &stored);
+      ls->bytes_dropped += consumed;
+   }
+}
+
+static void logpipe_handler(uint32_t events, void *priv)
+{
+   log_stream_t *ls = (log_stream_t *) priv;
+
+   logpipe_drain(ls, get_mono_time_ms());
+
+   // All writers are gone and everything was consumed, pipe is replaced at next start
+   if (events & EPOLLHUP) {
+      logpipe_pipe_close(ls);
+   }
+}
+
+void logpipe_close(log_stream_t *ls)
+{
+   if (ls->pipe_fd != -1) {
+      logpipe_drain(ls, get_mono_time_ms());
+      logpipe_pipe_close(ls);
+   }
+   if (ls->file_fd != -1) {
+      close(ls->file_fd);
+      ls->file_fd = -1;
+   }
+   NULLP_TEST_AND_FREE(ls->path)
+}
@@ -0,0 +1,112 @@
+/**
+ * @file logpipe.h
+ * @brief Capturing of stdout and stderr of instances through pipes drained by supervisor.
+ * @details Instead of writing to its log files directly, the process gets write end of a pipe
+ *  as stdout and stderr. Read end is registered in main_evloop and whatever arrives is moved
+ *  to the log file by splice, so the data doesn't pass through memory of supervisor.
+ *
+ *  Since supervisor is the only writer of the file, it knows its size and rotates it once it
+ *  exceeds configured size or gets older than configured interval: NAME.1 becomes NAME.2, ...,
+ *  NAME becomes NAME.1 and new NAME is created, at most keep rotated files are kept.
+ *
+ *  Optional rate limit is a token bucket refilled by rate_limit bytes per second with
+ *  capacity of one second. Data over the limit, as well as data that couldn't be written
+ *  (e.g. full disk), are discarded and counted, the module is never blocked by its logs.
+ */
+
+#ifndef LOGPIPE_H
+#define LOGPIPE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "evloop.h"
+
+#define DEFAULT_LOG_MAX_SIZE (10 * 1024 * 1024) ///< Default size of log file that triggers rotation
+#define DEFAULT_LOG_KEEP 5 ///< Default number of rotated log files kept
+#define LOGPIPE_PIPE_SIZE (1024 * 1024) ///< Requested capacity of pipe, kernel may give less
+
+/**
+ * @brief How output of instance process gets to its log files
+ * */
+typedef enum log_capture_e {
+   LOG_CAPTURE_PIPE, ///< Through pipe drained by supervisor, see logpipe.h
+   LOG_CAPTURE_FILE, ///< Process appends to the files itself, nothing is rotated or limited
+} log_capture_t;
+
+/**
+ * @brief Configuration of log files of instance, shared by its stdout and stderr
+ * */
+typedef struct log_conf_s {
+   log_capture_t capture; ///< How output is captured
+   uint64_t max_size; ///< Size in bytes file is rotated at or 0 for no limit
+   uint32_t rotate_interval_s; ///< Age in seconds file is rotated at or 0 for no limit
+   uint8_t keep; ///< Number of rotated files kept, 0 means file is just truncated
+   uint32_t rate_limit; ///< Bytes per second written to file or 0 for no limit
+} log_conf_t;
+
+/**
+ * @brief One captured output stream (stdout or stderr) of instance and its log file
+ * */
+typedef struct log_stream_s {
+   const log_conf_t *conf; ///< Configuration of instance the stream belongs to
+   char *path; ///< Path of current log file or NULL before first open
+   mode_t perm; ///< Permissions log file is created with
+   int file_fd; ///< Log file opened for writing at its end or -1
+   int pipe_fd; ///< Read end of the pipe or -1 while no pipe is used
+   ev_source_t *pipe_src; ///< pipe_fd registered in main_evloop
+   uint64_t size; ///< Current size of log file
+   uint64_t opened_ms; ///< Monotonic time log file was opened or rotated at
+   uint64_t tokens; ///< Bytes that may be written before rate limit is hit
+   uint64_t refill_ms; ///< Monotonic time tokens were refilled at
+   uint64_t bytes_written; ///< Total bytes written to log files
+   uint64_t bytes_dropped; ///< Total bytes discarded due to rate limit or write errors
+} log_stream_t;
+
+/**
+ * @brief Sets default values of given configuration.
+ * @param conf Configuration to initialize
+ * */
+extern void log_conf_init(log_conf_t *conf);
+
+/**
+ * @brief Initializes stream without any open descriptors.
+ * @param ls Stream to initialize
+ * @param conf Configuration the stream follows, it has to outlive the stream
+ * */
+extern void logpipe_init(log_stream_t *ls, const log_conf_t *conf);
+
+/**
+ * @brief Prepares new pipe for process about to be started.
+ * @details Log file is opened (or reopened if path changed) and previous pipe, if any, is
+ *  drained and closed. Read end of the new pipe is registered in main_evloop.
+ * @param ls Stream of instance
+ * @param path Path of log file
+ * @param perm Permissions of log file if it doesn't exist yet
+ * @return Write end to be passed to the process and closed by caller afterwards or -1
+ *  in case output can't be captured and process should open the file itself
+ * */
+extern int logpipe_open(log_stream_t *ls, const char *path, mode_t perm);
+
+/**
+ * @brief Moves data available in the pipe to log file, rotates the file if needed.
+ * @param ls Stream of instance
+ * @param now Monotonic time in milliseconds
+ * */
+extern void logpipe_drain(log_stream_t *ls, uint64_t now);
+
+/**
+ * @brief Rotates log file of stream regardless of its size and age.
+ * @param ls Stream of instance
+ * @param now Monotonic time in milliseconds
+ * @return 0 on success, -1 if new log file couldn't be opened
+ * */
+extern int logpipe_rotate(log_stream_t *ls, uint64_t now);
+
+/**
+ * @brief Drains what's left in the pipe and closes pipe and log file.
+ * @param ls Stream to close
+ * */
+extern void logpipe_close(log_stream_t *ls);
+
+#endif
@@ -4,87 +4,129 @@
  */
 
 #include <stdarg.h>
+#include <signal.h>
+#include <sys/syscall.h>
 #include <libtrap/trap.h>
 #include <sysrepo/xpath.h>
 #include "module.h"
+#include "cgroup.h"
+#include "sockact.h"
 
 pthread_mutex_t config_lock; ///< Mutex for operations on m_groups_ll and modules_ll
 
 vector_t avmods_v = {.total = 0, .capacity = 0, .items = NULL};
 vector_t insts_v = {.total = 0, .capacity = 0, .items = NULL};
+vector_t dying_insts_v = {.total = 0, .capacity = 0, .items = NULL};
+vector_t dying_avmods_v = {.total = 0, .capacity = 0, .items = NULL};
+static name_index_t avmods_by_name = {.capacity = 0, .total = 0, .entries = NULL}; ///< Index of avmods_v
+static name_index_t insts_by_name = {.capacity = 0, .total = 0, .entries = NULL}; ///< Index of insts_v
+insts_hot_t insts_hot = {.capacity = 0, .used = 0, .free_cnt = 0};
+intervals_t intervals = {
+      .liveness_ms = DEFAULT_LIVENESS_PERIOD_MS,
+      .resources_ms = DEFAULT_RESOURCES_PERIOD_MS,
+      .service_ifc_ms = DEFAULT_SERVICE_IFC_PERIOD_MS,
+      .changed = false,
+};
 
 /**
- * @brief Converts TCP interface params according to libtrap's IFC SPEC to string required by CLI.
+ * @brief Endpoint of interface, OUT and IN interfaces with equal endpoints are connected
+ * */
+typedef struct ifc_endpoint_s {
+   interface_type_t type; ///< NS_IF_TYPE_UNIX, NS_IF_TYPE_TCP or NS_IF_TYPE_TCP_TLS
+   uint16_t port; ///< Port of TCP interfaces
+   const char *socket_name; ///< Socket name of UNIX interfaces
+   uint32_t inst_idx; ///< Index of instance the interface belongs to
+} ifc_endpoint_t;
+
+/**
+ * @brief Appends TCP interface params according to libtrap's IFC SPEC to CLI argument.
  * @param ifc Interface for which params string should be generated
- * @return Part of params CLI string or NULL on error
+ * @param sb Buffer to append to
+ * @return -1 on error, 0 on success
  * */
-static char * tcp_ifc_to_cli_arg(const interface_t *ifc);
+static int tcp_ifc_to_cli_arg(const interface_t *ifc, strbuf_t *sb);
 
 
 /**
- * @brief Converts TCP-TLS interface params according to libtrap's IFC SPEC to string required by CLI.
+ * @brief Appends TCP-TLS interface params according to libtrap's IFC SPEC to CLI argument.
  * @param ifc Interface for which params string should be generated
- * @return Part of params CLI string or NULL on error
+ * @param sb Buffer to append to
+ * @return -1 on error, 0 on success
  * */
-static char * tcp_tls_ifc_to_cli_arg(const interface_t *ifc);
+static int tcp_tls_ifc_to_cli_arg(const interface_t *ifc, strbuf_t *sb);
 
 
 /**
- * @brief Converts UNIX interface params according to libtrap's IFC SPEC to string required by CLI.
+ * @brief Appends UNIX interface params according to libtrap's IFC SPEC to CLI argument.
  * @param ifc Interface for which params string should be generated
- * @return Part of params CLI string or NULL on error
+ * @param sb Buffer to append to
+ * @return -1 on error, 0 on success
  * */
-static char * unix_ifc_to_cli_arg(const interface_t *ifc);
+static int unix_ifc_to_cli_arg(const interface_t *ifc, strbuf_t *sb);
 
 
 /**
- * @brief Converts FILE interface params according to libtrap's IFC SPEC to string required by CLI.
+ * @brief Appends FILE interface params according to libtrap's IFC SPEC to CLI argument.
  * @param ifc Interface for which params string should be generated
- * @return Part of params CLI string or NULL on error
+ * @param sb Buffer to append to
+ * @return -1 on error, 0 on success
  * */
-static char * file_ifc_to_cli_arg(const interface_t *ifc);
+static int file_ifc_to_cli_arg(const interface_t *ifc, strbuf_t *sb);
 
 
 /**
- * @brief Converts BLACKHOLE interface params according to libtrap's IFC SPEC to string required by CLI.
+ * @brief Appends BLACKHOLE interface params according to libtrap's IFC SPEC to CLI argument.
  * @param ifc Interface for which params string should be generated
- * @return Part of params CLI string or NULL on error
+ * @param sb Buffer to append to
+ * @return -1 on error, 0 on success
  * */
-static char * bh_ifc_to_cli_arg(const interface_t *ifc);
+static int bh_ifc_to_cli_arg(const interface_t *ifc, strbuf_t *sb);
 
 
 /**
- * @brief Converts interfaces settings according to libtrap's IFC SPEC to string argument required by CLI.
+ * @brief Appends interfaces settings according to libtrap's IFC SPEC as CLI argument
+ *  of -i, interfaces are separated by commas.
  * @param inst Instance for which string should be generated.
- * @return CLI params string or NULL on error
+ * @param sb Buffer to append to
+ * @return -1 on error, 0 on success
  * */
-static inline char * inst_get_ifcs_as_arg(inst_t *inst);
+static int inst_ifcs_to_arg(const inst_t *inst, strbuf_t *sb);
 
+/**
+ * @brief Splits instance's params string into separate CLI params and appends each of them
+ *  terminated by '\0' to given buffer.
+ * @param sb Buffer to append to, it is left untouched on error
+ * @param[out] params_num Number of appended params
+ * @return -1 on error, 0 on success
+ * */
+static int inst_params_to_arr(const inst_t *inst, strbuf_t *sb, uint32_t *params_num);
 
 /**
- * @brief Concatenates as many char * arguments as much is given in first parameter.
- * @param cnt Number of passed strings.
- * @return Concatenated string or NULL on error
+ * @brief Appends given ifc param prefixed by ':'. Only param_s or param_u can be given
+ * @param sb Buffer to append to
+ * @param param_s String param
+ * @param param_u uint param
+ * @return -1 on error, 0 on success
  * */
-static char * strcat_many(uint8_t cnt, ...);
+static int ifc_param_append(strbuf_t *sb, const char *param_s, uint16_t param_u);
+
 
 /**
- * @brief Converts instance's params string into array of separate CLI params that ends with NULL.
- * @param[out] params_num Number of params in the array
- * @return Pointer to array of params or NULL on error
+ * @brief Handler of instance pidfd inside main_evloop, called once process exits.
+ * @param events Epoll events
+ * @param priv Instance which process exited
  * */
-static char **inst_params_to_arr(const inst_t *inst, uint32_t *params_num,
-                                 int *rc);
+static void inst_pidfd_handler(uint32_t events, void *priv);
 
 /**
- * @brief Concatenates given ifc param with base. Only param_s or param_u can be given
- * @param base Base to which the passed param is concatenated
- * @param param_s String param
- * @param param_u uint param
- * @return Concatenated string or NULL on error
+ * @brief Wrapper of pidfd_open syscall which might be missing in libc
  * */
-static char *ifc_param_concat(char *base, char *param_s, uint16_t param_u);
+static inline int sys_pidfd_open(pid_t pid);
 
+/**
+ * @brief Wrapper of pidfd_send_signal syscall which might be missing in libc
+ * */
+static inline int sys_pidfd_send_signal(int pidfd, int sig);
 
 /**
  * @brief Frees dynamic memory for specific interface params
@@ -92,6 +134,38 @@ static char *ifc_param_concat(char *base, char *param_s, uint16_t param_u);
  * */
 static inline void interface_specific_params_free(interface_t *ifc);
 
+/**
+ * @brief Fills endpoint of given interface
+ * @return false if interface can't connect instances (e.g. file interface)
+ * */
+static bool ifc_endpoint(const interface_t *ifc, uint32_t inst_idx, ifc_endpoint_t *ep);
+
+/**
+ * @brief Compares endpoints by their type and port or socket name
+ * */
+static int ifc_endpoint_cmp(const void *a, const void *b);
+
+/**
+ * @brief Moves arrays of insts_hot to one block for given number of slots
+ * @param capacity New number of slots
+ * @return 0 on success or -1 on error
+ * */
+static int insts_hot_resize(uint32_t capacity);
+
+/**
+ * @brief Assigns free slot of insts_hot to given instance, its hot state is cleared
+ * @param inst Instance to assign slot to
+ * @return 0 on success or -1 on error
+ * */
+static int insts_hot_slot_alloc(inst_t *inst);
+
+/**
+ * @brief Returns slot of given instance to insts_hot, table is freed once all its slots
+ *  are free
+ * @param inst Instance which slot is released
+ * */
+static void insts_hot_slot_release(inst_t *inst);
+
 
 int inst_interface_add(inst_t *inst, interface_t *ifc)
 {
@@ -122,9 +196,9 @@ void inst_print(inst_t *inst)
 {
    VERBOSE(V3, "Module instance: %s of %s", inst->name, inst->mod_ref->name)
    VERBOSE(V3, " params=%s", inst->params)
-   VERBOSE(V3, " pid=%d", inst->pid)
-   VERBOSE(V3, " enabled=%s", inst->enabled ? "true" : "false")
-   VERBOSE(V3, " running=%s", inst->running ? "true" : "false")
+   VERBOSE(V3, " pid=%d", INST_PID(inst))
+   VERBOSE(V3, " enabled=%s", INST_ENABLED(inst) ? "true" : "false")
+   VERBOSE(V3, " running=%s", INST_RUNNING(inst) ? "true" : "false")
    VERBOSE(V3, " restart_cnt=%d", inst->restarts_cnt)
    VERBOSE(V3, " max_restarts_minute=%d", inst->max_restarts_minute)
    VERBOSE(V3, " use_sysrepo=%d", inst->use_sysrepo)
@@ -191,30 +265,71 @@ inst_t * inst_alloc()
    inst_t * inst = (inst_t *) calloc(1, sizeof(inst_t));
    IF_NO_MEM_NULL_ERR(inst)
 
-   inst->enabled = false;
    inst->use_sysrepo = false;
-   inst->running = false;
-   inst->should_die = false;
+   inst->socket_activation = false;
    inst->root_perm_needed = false;
    inst->is_my_child = false;
-   inst->sigint_sent = false;
+   inst->stop_state = INST_STOP_NONE;
    inst->service_ifc_connected = false;
    inst->name = NULL;
+   inst->stats_xpath = NULL;
    inst->params = NULL;
    inst->exec_args = NULL;
+   log_conf_init(&inst->log_conf);
+   logpipe_init(&inst->log_out, &inst->log_conf);
+   logpipe_init(&inst->log_err, &inst->log_conf);
    inst->mod_ref = NULL;
    inst->restarts_cnt = 0;
    inst->max_restarts_minute = 0;
-   inst->restart_time = 0;
-   inst->pid = 0;
+   inst->restart_policy.initial_backoff_ms = DEFAULT_RESTART_INITIAL_BACKOFF_MS;
+   inst->restart_policy.max_backoff_ms = DEFAULT_RESTART_MAX_BACKOFF_MS;
+   inst->restart_policy.jitter_perc = DEFAULT_RESTART_JITTER_PERC;
+   inst->restart_policy.stable_uptime_ms = DEFAULT_RESTART_STABLE_UPTIME_MS;
+   inst->restart_policy.restart_on_exec_failure = false;
+   inst->restart_policy.immediate_restart_on_oom_kill = true;
+   inst->backoff_ms = 0;
+   inst->exec_failed = false;
+   inst->start_time = 0;
+   inst->start_ms = 0;
+   inst->ready = false;
+   memset(&inst->last_exit, 0, sizeof(inst->last_exit));
    inst->mem_vms = 0;
    inst->mem_rss = 0;
    inst->last_cpu_kmode = 0;
    inst->last_cpu_perc_kmode = 0;
    inst->last_cpu_umode = 0;
    inst->last_cpu_perc_umode = 0;
-   inst->service_ifc_conn_timer = 0;
-   inst->service_sd = -1;
+   inst->last_total_cpu = 0;
+   inst->cpu_load = 0;
+   inst->proc_pid = 0;
+   inst->proc_stat_fd = -1;
+   inst->proc_statm_fd = -1;
+   inst->cg.dir_fd = -1;
+   inst->cg.procs_fd = -1;
+   inst->cg.cpu_stat_fd = -1;
+   inst->cg.mem_current_fd = -1;
+   inst->cg.mem_peak_fd = -1;
+   inst->cg.io_stat_fd = -1;
+   inst->cg.oom_kills = 0;
+   inst->cpu_max = NULL;
+   inst->memory_max = 0;
+   inst->mem_peak = 0;
+   inst->io_read_bytes = 0;
+   inst->io_write_bytes = 0;
+   inst->placement.has_cpus = false;
+   inst->placement.has_mem_policy = false;
+   inst->auto_domain = -1;
+   inst->auto_chain = 0;
+   inst->pidfd = -1;
+   inst->pid_src = NULL;
+   // Expire functions are set by users of the timers
+   tw_timer_init(&inst->stop_timer, NULL, inst);
+   tw_timer_init(&inst->restart_timer, NULL, inst);
+   tw_timer_init(&inst->backoff_timer, NULL, inst);
+   tw_timer_init(&inst->resources_timer, NULL, inst);
+   tw_timer_init(&inst->service_ifc_timer, NULL, inst);
+   inst->resources_period_ms = 0;
+   inst->service_ifc_period_ms = 0;
 
    int rc;
 
@@ -227,6 +342,16 @@ inst_t * inst_alloc()
    rc = vector_init(&inst->out_ifces, 1);
    if (rc != 0) {
       NO_MEM_ERR
+      vector_free(&inst->in_ifces);
+      free(inst);
+      return NULL;
+   }
+
+   // Slot is claimed last, failed allocation leaves no freed instance in insts_hot
+   if (insts_hot_slot_alloc(inst) != 0) {
+      NO_MEM_ERR
+      vector_free(&inst->in_ifces);
+      vector_free(&inst->out_ifces);
       free(inst);
       return NULL;
    }
@@ -245,6 +370,7 @@ interface_t * interface_alloc()
    }
 
    interface->name = NULL;
+   interface->stats_xpath = NULL;
    interface->buffer = NULL;
    interface->autoflush = NULL;
    interface->timeout = NULL;
@@ -355,6 +481,7 @@ void av_modules_free()
       av_module_free(avmods_v.items[i]);
    }
    vector_free(&avmods_v);
+   name_index_free(&avmods_by_name);
 }
 
 void insts_free()
@@ -363,6 +490,174 @@ void insts_free()
       inst_free(insts_v.items[i]);
    }
    vector_free(&insts_v);
+   name_index_free(&insts_by_name);
+   for (uint32_t i = 0; i < avmods_v.total; i++) {
+      vector_free(&((av_module_t *) avmods_v.items[i])->insts);
+   }
+
+   for (uint32_t i = 0; i < dying_insts_v.total; i++) {
+      inst_free(dying_insts_v.items[i]);
+   }
+   vector_free(&dying_insts_v);
+   for (uint32_t i = 0; i < dying_avmods_v.total; i++) {
+      av_module_free(dying_avmods_v.items[i]);
+   }
+   vector_free(&dying_avmods_v);
+   sockacts_close();
+}
+
+int av_modules_add(av_module_t *mod)
+{
+   if (vector_add(&avmods_v, mod) != 0) {
+      return -1;
+   }
+   if (mod->name != NULL && name_index_add(&avmods_by_name, mod->name, mod) != 0) {
+      avmods_v.total--;
+      return -1;
+   }
+
+   return 0;
+}
+
+void av_modules_delete(av_module_t *mod)
+{
+   if (mod->name != NULL) {
+      name_index_delete(&avmods_by_name, mod->name, mod);
+   }
+   (void) vector_remove_item(&avmods_v, mod);
+}
+
+int insts_add(inst_t *inst)
+{
+   if (vector_add(&insts_v, inst) != 0) {
+      return -1;
+   }
+   if (inst->name != NULL && name_index_add(&insts_by_name, inst->name, inst) != 0) {
+      insts_v.total--;
+      return -1;
+   }
+   // Reverse index of mod_ref, instances of module are stopped without scanning insts_v
+   if (inst->mod_ref != NULL && vector_add(&inst->mod_ref->insts, inst) != 0) {
+      if (inst->name != NULL) {
+         name_index_delete(&insts_by_name, inst->name, inst);
+      }
+      insts_v.total--;
+      return -1;
+   }
+   insts_hot.listed[inst->slot] = true;
+
+   return 0;
+}
+
+static int insts_hot_resize(uint32_t capacity)
+{
+   insts_hot_t hot = insts_hot;
+   size_t slot_size = sizeof(inst_t *) + sizeof(uint32_t) + sizeof(pid_t) + 6 * sizeof(bool);
+   char *block = calloc(capacity, slot_size);
+
+   IF_NO_MEM_INT_ERR(block)
+
+   // One block for all arrays, arrays of larger items first so that all stay aligned
+   hot.inst = (inst_t **) block;
+   hot.free_slots = (uint32_t *) (hot.inst + capacity);
+   hot.pid = (pid_t *) (hot.free_slots + capacity);
+   hot.listed = (bool *) (hot.pid + capacity);
+   hot.enabled = hot.listed + capacity;
+   hot.running = hot.enabled + capacity;
+   hot.should_die = hot.running + capacity;
+   hot.resources_due = hot.should_die + capacity;
+   hot.service_ifc_due = hot.resources_due + capacity;
+
+   if (insts_hot.capacity > 0) {
+      memcpy(hot.inst, insts_hot.inst, insts_hot.used * sizeof(inst_t *));
+      memcpy(hot.free_slots, insts_hot.free_slots, insts_hot.free_cnt * sizeof(uint32_t));
+      memcpy(hot.pid, insts_hot.pid, insts_hot.used * sizeof(pid_t));
+      memcpy(hot.listed, insts_hot.listed, insts_hot.used * sizeof(bool));
+      memcpy(hot.enabled, insts_hot.enabled, insts_hot.used * sizeof(bool));
+      memcpy(hot.running, insts_hot.running, insts_hot.used * sizeof(bool));
+      memcpy(hot.should_die, insts_hot.should_die, insts_hot.used * sizeof(bool));
+      memcpy(hot.resources_due, insts_hot.resources_due, insts_hot.used * sizeof(bool));
+      memcpy(hot.service_ifc_due, insts_hot.service_ifc_due, insts_hot.used * sizeof(bool));
+      free(insts_hot.inst);
+   }
+   hot.capacity = capacity;
+   insts_hot = hot;
+
+   return 0;
+}
+
+static int insts_hot_slot_alloc(inst_t *inst)
+{
+   uint32_t slot;
+
+   if (insts_hot.free_cnt > 0) {
+      slot = insts_hot.free_slots[--insts_hot.free_cnt];
+   } else {
+      if (insts_hot.used == insts_hot.capacity
+          && insts_hot_resize(insts_hot.capacity == 0 ? 64 : insts_hot.capacity * 2) != 0) {
+         return -1;
+      }
+      slot = insts_hot.used++;
+   }
+
+   inst->slot = slot;
+   insts_hot.inst[slot] = inst;
+   insts_hot.listed[slot] = false;
+   insts_hot.enabled[slot] = false;
+   insts_hot.running[slot] = false;
+   insts_hot.should_die[slot] = false;
+   insts_hot.resources_due[slot] = false;
+   insts_hot.service_ifc_due[slot] = false;
+   insts_hot.pid[slot] = 0;
+
+   return 0;
+}
+
+static void insts_hot_slot_release(inst_t *inst)
+{
+   uint32_t slot = inst->slot;
+
+   insts_hot.inst[slot] = NULL;
+   insts_hot.listed[slot] = false;
+   insts_hot.pid[slot] = 0;
+   insts_hot.free_slots[insts_hot.free_cnt++] = slot;
+
+   if (insts_hot.free_cnt == insts_hot.used) {
+      NULLP_TEST_AND_FREE(insts_hot.inst)
+      memset(&insts_hot, 0, sizeof(insts_hot));
+   }
+}
+
+void insts_delete(inst_t *inst)
+{
+   insts_hot.listed[inst->slot] = false;
+   if (inst->name != NULL) {
+      name_index_delete(&insts_by_name, inst->name, inst);
+   }
+   if (inst->mod_ref != NULL) {
+      (void) vector_remove_item(&inst->mod_ref->insts, inst);
+   }
+   (void) vector_remove_item(&insts_v, inst);
+}
+
+void insts_delete_module(av_module_t *mod)
+{
+   inst_t *inst;
+   uint32_t kept = 0;
+
+   // Compacts insts_v once instead of searching and shifting it for every instance
+   for (uint32_t i = 0; i < insts_v.total; i++) {
+      inst = insts_v.items[i];
+      if (inst->mod_ref != mod) {
+         insts_v.items[kept++] = inst;
+         continue;
+      }
+      insts_hot.listed[inst->slot] = false;
+      if (inst->name != NULL) {
+         name_index_delete(&insts_by_name, inst->name, inst);
+      }
+   }
+   insts_v.total = kept;
 }
 
 void inst_clear_socks(inst_t *inst)
@@ -372,13 +667,16 @@ void inst_clear_socks(inst_t *inst)
    char service_sock_spec[14];
    interface_t *ifc = NULL;
 
+   // Listening sockets still wanted by other instances are kept along with their files
+   sockact_inst_release(inst);
+
    if (inst->mod_ref->trap_ifces_cli) {
       for (uint32_t i = 0; i < inst->out_ifces.total; i++) {
          ifc = inst->out_ifces.items[i];
 
          // Remove all UNIX socket files
          if (ifc->type != NS_IF_TYPE_UNIX ||
-             ifc->specific_params.nix->socket_name == NULL) {
+             ifc->specific_params.nix->socket_name == NULL || sockact_find(ifc) != NULL) {
             continue;
          }
 
@@ -392,9 +690,9 @@ void inst_clear_socks(inst_t *inst)
    }
 
    // Delete unix-socket created by module's service interface
-   if (inst->mod_ref->trap_mon && inst->pid > 0) {
+   if (inst->mod_ref->trap_mon && INST_PID(inst) > 0) {
       memset(service_sock_spec, 0, 14 * sizeof(char));
-      sprintf(service_sock_spec, "service_%d", inst->pid);
+      sprintf(service_sock_spec, "service_%d", INST_PID(inst));
       sprintf(buffer, trap_default_socket_path_format, service_sock_spec);
       VERBOSE(V2, "Deleting socket %s of %s", buffer, inst->name)
       unlink(buffer);
@@ -403,22 +701,178 @@ void inst_clear_socks(inst_t *inst)
 
 void av_module_free(av_module_t *mod)
 {
+   vector_free(&mod->insts);
    NULLP_TEST_AND_FREE(mod->path)
    NULLP_TEST_AND_FREE(mod->name)
    NULLP_TEST_AND_FREE(mod)
 }
 
+void inst_service_disconnected(inst_t *inst)
+{
+   inst->service_ifc_connected = false;
+}
+
+static inline int sys_pidfd_open(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+   return (int) syscall(SYS_pidfd_open, pid, 0);
+#else
+   errno = ENOSYS;
+   return -1;
+#endif
+}
+
+static inline int sys_pidfd_send_signal(int pidfd, int sig)
+{
+#ifdef SYS_pidfd_send_signal
+   return (int) syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0);
+#else
+   errno = ENOSYS;
+   return -1;
+#endif
+}
+
+int inst_pidfd_open(inst_t *inst)
+{
+   int fd;
+
+   if (inst->pid_src != NULL) {
+      return 0;
+   }
+   if (INST_PID(inst) <= 0) {
+      errno = ESRCH;
+      return -1;
+   }
+
+   fd = sys_pidfd_open(INST_PID(inst));
+   if (fd == -1) {
+      if (errno != ESRCH) {
+         VERBOSE(V2, "pidfd_open: Falling back to polling of inst '%s' (errno=%d)",
+                 inst->name, errno)
+      }
+      return -1;
+   }
+
+   inst->pid_src = evloop_add(&main_evloop, fd, EPOLLIN, inst_pidfd_handler, inst);
+   if (inst->pid_src == NULL) {
+      close(fd);
+      return -1;
+   }
+   inst->pid_src->owns_fd = true;
+   inst->pidfd = fd;
+
+   return 0;
+}
+
+void inst_pidfd_close(inst_t *inst)
+{
+   // pidfd is owned by the source and gets closed with it
+   evloop_del(&main_evloop, inst->pid_src);
+   inst->pid_src = NULL;
+   inst->pidfd = -1;
+}
+
+int inst_proc_open(inst_t *inst)
+{
+   char path[DEFAULT_SIZE_OF_BUFFER];
+
+   if (inst->proc_pid == INST_PID(inst) && inst->proc_stat_fd != -1) {
+      return 0;
+   }
+   inst_proc_close(inst);
+
+   snprintf(path, DEFAULT_SIZE_OF_BUFFER, "/proc/%d/stat", INST_PID(inst));
+   inst->proc_stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+   snprintf(path, DEFAULT_SIZE_OF_BUFFER, "/proc/%d/statm", INST_PID(inst));
+   inst->proc_statm_fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (inst->proc_stat_fd == -1 || inst->proc_statm_fd == -1) {
+      VERBOSE(V2, "Failed to open stats files of '%s' (PID=%d)", inst->name, INST_PID(inst))
+      inst_proc_close(inst);
+      return -1;
+   }
+   inst->proc_pid = INST_PID(inst);
+
+   return 0;
+}
+
+void inst_proc_close(inst_t *inst)
+{
+   if (inst->proc_stat_fd != -1) {
+      close(inst->proc_stat_fd);
+      inst->proc_stat_fd = -1;
+   }
+   if (inst->proc_statm_fd != -1) {
+      close(inst->proc_statm_fd);
+      inst->proc_statm_fd = -1;
+   }
+   inst->proc_pid = 0;
+}
+
+int inst_send_signal(inst_t *inst, int sig)
+{
+   if (inst->pidfd == -1) {
+      return kill(INST_PID(inst), sig);
+   }
+   if (sys_pidfd_send_signal(inst->pidfd, sig) == 0) {
+      return 0;
+   }
+   // Only kernel without pidfd_send_signal falls back to PID
+   if (errno == ENOSYS || errno == EINVAL) {
+      return kill(INST_PID(inst), sig);
+   }
+   /* ESRCH means the process exited, its PID might already belong to other process.
+    * Exit is reported through pidfd, nothing is signalled. */
+   return -1;
+}
+
+static void inst_pidfd_handler(uint32_t events, void *priv)
+{
+   inst_t *inst = priv;
+
+   VERBOSE(V2, "pidfd: Instance '%s' (PID: %d) exited", inst->name, INST_PID(inst))
+   INST_RUNNING(inst) = false;
+   inst_service_disconnected(inst);
+   inst_pidfd_close(inst);
+   inst_proc_close(inst);
+   if (inst->is_my_child == false) {
+      // Adopted process can't be waited for, PID can be forgotten right away
+      INST_PID(inst) = 0;
+   }
+
+   // Let supervisor_routine reap, clean after and restart the instance
+   evloop_wakeup(&main_evloop);
+}
+
+uint32_t inst_resources_period(const inst_t *inst)
+{
+   return inst->resources_period_ms != 0 ? inst->resources_period_ms : intervals.resources_ms;
+}
+
+uint32_t inst_service_ifc_period(const inst_t *inst)
+{
+   return inst->service_ifc_period_ms != 0 ? inst->service_ifc_period_ms : intervals.service_ifc_ms;
+}
+
 void inst_free(inst_t *inst)
 {
+   inst_pidfd_close(inst);
+   inst_proc_close(inst);
+   cgroup_inst_release(inst);
+   logpipe_close(&inst->log_out);
+   logpipe_close(&inst->log_err);
+   tw_cancel(&main_wheel, &inst->stop_timer);
+   tw_cancel(&main_wheel, &inst->restart_timer);
+   tw_cancel(&main_wheel, &inst->backoff_timer);
+   tw_cancel(&main_wheel, &inst->resources_timer);
+   tw_cancel(&main_wheel, &inst->service_ifc_timer);
    NULLP_TEST_AND_FREE(inst->name)
+   NULLP_TEST_AND_FREE(inst->stats_xpath)
    NULLP_TEST_AND_FREE(inst->params)
-   if (inst->exec_args != NULL) {
-      for (int i = 0; inst->exec_args[i] != NULL; i++) {
-         NULLP_TEST_AND_FREE(inst->exec_args[i])
-      }
-      NULLP_TEST_AND_FREE(inst->exec_args)
-   }
+   NULLP_TEST_AND_FREE(inst->cpu_max)
+   NULLP_TEST_AND_FREE(inst->exec_args)
+   strbuf_free(&inst->exec_args_buf);
    interfaces_free(inst);
+   insts_hot_slot_release(inst);
    NULLP_TEST_AND_FREE(inst)
 }
 
@@ -440,6 +894,7 @@ void interface_free(interface_t *ifc)
 {
    if (ifc != NULL) {
       NULLP_TEST_AND_FREE(ifc->name);
+      NULLP_TEST_AND_FREE(ifc->stats_xpath);
       NULLP_TEST_AND_FREE(ifc->buffer);
       NULLP_TEST_AND_FREE(ifc->autoflush);
       NULLP_TEST_AND_FREE(ifc->timeout);
@@ -464,26 +919,193 @@ void interface_stats_free(interface_t *ifc)
    }
 }
 
+int stats_xpath_format(char *buf, size_t size, const char *inst_name, const char *ifc_name)
+{
+   inst_name = (inst_name != NULL ? inst_name : "");
+   if (ifc_name == NULL) {
+      return snprintf(buf, size, INST_STATS_XPATH_FMT, inst_name);
+   }
+   return snprintf(buf, size, IFC_STATS_XPATH_FMT, inst_name, ifc_name);
+}
+
+char * stats_xpath_alloc(const char *inst_name, const char *ifc_name)
+{
+   int len = stats_xpath_format(NULL, 0, inst_name, ifc_name);
+   char *xpath;
+
+   if (len < 0) {
+      return NULL;
+   }
+   xpath = malloc((size_t) len + 1);
+   if (xpath == NULL) {
+      NO_MEM_ERR
+      return NULL;
+   }
+   stats_xpath_format(xpath, (size_t) len + 1, inst_name, ifc_name);
+
+   return xpath;
+}
+
 inst_t * inst_get_by_name(const char *name, uint32_t *index)
 {
-   uint32_t fi; // Index of found instance
-   inst_t *inst = NULL;
-
-   for (fi = 0; fi < insts_v.total; fi++) {
-      inst = insts_v.items[fi];
-      if (strcmp(inst->name, name) == 0) {
-         // Instance was found
-         if (index != NULL) {
-            *index = fi;
-         }
-         return inst;
+   inst_t *inst = name_index_get(&insts_by_name, name);
+
+   if (inst == NULL || index == NULL) {
+      return inst;
+   }
+
+   // Only pointers are compared, callers need index just to remove the instance
+   for (uint32_t fi = 0; fi < insts_v.total; fi++) {
+      if (insts_v.items[fi] == inst) {
+         *index = fi;
+         break;
+      }
+   }
+
+   return inst;
+}
+
+av_module_t * av_module_get_by_name(const char *name)
+{
+   return name_index_get(&avmods_by_name, name);
+}
+
+inst_t * inst_get_by_pid(pid_t pid)
+{
+   // Slots cover instances of insts_v as well as dying ones, only PIDs are read
+   for (uint32_t s = 0; s < insts_hot.used; s++) {
+      if (insts_hot.pid[s] == pid && insts_hot.inst[s] != NULL) {
+         return insts_hot.inst[s];
       }
    }
 
-   // Instance was not found
    return NULL;
 }
 
+int insts_links(inst_t **insts, uint32_t cnt, inst_link_t **links)
+{
+   ifc_endpoint_t *outs = NULL;
+   ifc_endpoint_t ep;
+   inst_link_t *found = NULL;
+   inst_link_t *tmp;
+   uint32_t outs_cnt = 0;
+   uint32_t found_cnt = 0;
+   uint32_t found_size = 0;
+   uint32_t lo;
+   uint32_t hi;
+   uint32_t mid;
+   interface_t *ifc;
+
+   for (uint32_t i = 0; i < cnt; i++) {
+      outs_cnt += insts[i]->out_ifces.total;
+   }
+   outs = malloc((outs_cnt + 1) * sizeof(ifc_endpoint_t));
+   if (outs == NULL) {
+      NO_MEM_ERR
+      return -1;
+   }
+
+   outs_cnt = 0;
+   for (uint32_t i = 0; i < cnt; i++) {
+      for (uint32_t j = 0; j < insts[i]->out_ifces.total; j++) {
+         ifc = insts[i]->out_ifces.items[j];
+         if (ifc_endpoint(ifc, i, &outs[outs_cnt])) {
+            outs_cnt++;
+         }
+      }
+   }
+   qsort(outs, outs_cnt, sizeof(ifc_endpoint_t), ifc_endpoint_cmp);
+
+   // Every IN interface is linked with all instances producing to its endpoint
+   for (uint32_t i = 0; i < cnt; i++) {
+      for (uint32_t j = 0; j < insts[i]->in_ifces.total; j++) {
+         ifc = insts[i]->in_ifces.items[j];
+         if (ifc_endpoint(ifc, i, &ep) == false) {
+            continue;
+         }
+         lo = 0;
+         hi = outs_cnt;
+         while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if (ifc_endpoint_cmp(&outs[mid], &ep) < 0) {
+               lo = mid + 1;
+            } else {
+               hi = mid;
+            }
+         }
+         for (; lo < outs_cnt && ifc_endpoint_cmp(&outs[lo], &ep) == 0; lo++) {
+            // Instance reading its own output doesn't depend on anything
+            if (outs[lo].inst_idx == i) {
+               continue;
+            }
+            if (found_cnt == found_size) {
+               found_size = (found_size == 0 ? 16 : found_size * 2);
+               tmp = realloc(found, found_size * sizeof(inst_link_t));
+               if (tmp == NULL) {
+                  NO_MEM_ERR
+                  NULLP_TEST_AND_FREE(found)
+                  NULLP_TEST_AND_FREE(outs)
+                  return -1;
+               }
+               found = tmp;
+            }
+            found[found_cnt].producer = outs[lo].inst_idx;
+            found[found_cnt].consumer = i;
+            found_cnt++;
+         }
+      }
+   }
+
+   NULLP_TEST_AND_FREE(outs)
+   *links = found;
+   return (int) found_cnt;
+}
+
+static bool ifc_endpoint(const interface_t *ifc, uint32_t inst_idx, ifc_endpoint_t *ep)
+{
+   ep->type = ifc->type;
+   ep->port = 0;
+   ep->socket_name = NULL;
+   ep->inst_idx = inst_idx;
+
+   switch (ifc->type) {
+      case NS_IF_TYPE_UNIX:
+         if (ifc->specific_params.nix == NULL || ifc->specific_params.nix->socket_name == NULL) {
+            return false;
+         }
+         ep->socket_name = ifc->specific_params.nix->socket_name;
+         return true;
+      case NS_IF_TYPE_TCP:
+         if (ifc->specific_params.tcp == NULL) {
+            return false;
+         }
+         ep->port = ifc->specific_params.tcp->port;
+         return true;
+      case NS_IF_TYPE_TCP_TLS:
+         if (ifc->specific_params.tcp_tls == NULL) {
+            return false;
+         }
+         ep->port = ifc->specific_params.tcp_tls->port;
+         return true;
+      default:
+         return false;
+   }
+}
+
+static int ifc_endpoint_cmp(const void *a, const void *b)
+{
+   const ifc_endpoint_t *ea = a;
+   const ifc_endpoint_t *eb = b;
+
+   if (ea->type != eb->type) {
+      return (ea->type < eb->type ? -1 : 1);
+   }
+   if (ea->type == NS_IF_TYPE_UNIX) {
+      return strcmp(ea->socket_name, eb->socket_name);
+   }
+   return (ea->port < eb->port ? -1 : (ea->port > eb->port ? 1 : 0));
+}
+
 static inline void interface_specific_params_free(interface_t *ifc)
 {
    switch (ifc->type) {
@@ -525,280 +1147,138 @@ static inline void interface_specific_params_free(interface_t *ifc)
  */
 int inst_gen_exec_args(inst_t *inst)
 {
-
-   char **cfg_params = NULL; // All configured params but interface params
+   strbuf_t *sb = &inst->exec_args_buf;
    char **exec_args = NULL;
-   char *ifc_spec = NULL;
    uint32_t module_params_num = 0;
-   uint32_t exec_args_cnt = 2; // at least the name of the future process and terminating NULL pointer
-   uint32_t exec_args_pos = 0;
-   int rc = 0; // Status of success for inst_params_to_arr function
+   uint32_t exec_args_cnt = 1; // at least the name of the future process
+   uint32_t pos = 0;
    uint32_t total_ifc_cnt = inst->in_ifces.total + inst->out_ifces.total;
+   bool gen_ifc_spec = (inst->mod_ref->trap_ifces_cli && total_ifc_cnt > 0);
 
-   // if the inst has trap interfaces, one argument for "-i" and one for interfaces specifier
-   if (inst->mod_ref->trap_ifces_cli && total_ifc_cnt > 0) {
-      exec_args_cnt += 2;
-   }
+   NULLP_TEST_AND_FREE(inst->exec_args)
+   sb->len = 0;
 
-   if (inst->use_sysrepo) {
-      // prepare space for '-x' and 'XPATH' arguments
-      exec_args_cnt += 2;
-   } else if (inst->params != NULL) {
-      // if the inst has non-empty params, try to parse them
-      cfg_params = inst_params_to_arr(inst, &module_params_num, &rc);
-      if (rc == -1) {
-         VERBOSE(N_ERR, "Failed to parse inst params")
-         return -1;
-      }
-      // after successful params parsing, increment the number of binary arguments
-      exec_args_cnt += module_params_num;
+   // Usual arguments fit at once, buffer keeps its capacity for next generation
+   if (strbuf_reserve(sb, 2 * (uint32_t) strlen(inst->name) + 8
+                          + (inst->params != NULL ? (uint32_t) strlen(inst->params) + 1 : 0)
+                          + (gen_ifc_spec ? 64 * total_ifc_cnt : 0)) != 0) {
+      goto err_cleanup;
    }
 
-   exec_args = (char **) calloc(exec_args_cnt, sizeof(char *));
-   IF_NO_MEM_INT_ERR(exec_args)
-
    // First argument to execv is a name of the future process
-   exec_args[0] = strdup(inst->name);
-   if (exec_args[0] == NULL) {
-      NO_MEM_ERR
+   if (strbuf_append(sb, inst->name) != 0 || strbuf_append_char(sb, '\0') != 0) {
       goto err_cleanup;
    }
 
-   // last pointer is NULL because of execv function
-   exec_args[exec_args_cnt - 1] = NULL;
-   exec_args_pos = 1;
-
    if (inst->use_sysrepo) {
       // add -x "INSTANCE_NAME"
-      exec_args[exec_args_pos] = strdup("-x"); // It's easier for freeing later
-      if (exec_args[exec_args_pos] == NULL) {
-         NO_MEM_ERR
+      if (strbuf_append(sb, "-x") != 0 || strbuf_append_char(sb, '\0') != 0
+          || strbuf_append(sb, inst->name) != 0 || strbuf_append_char(sb, '\0') != 0) {
          goto err_cleanup;
       }
-      exec_args_pos++;
-
-      exec_args[exec_args_pos] = strdup(inst->name);
-      if (exec_args[exec_args_pos] == NULL) {
-         NO_MEM_ERR
+      exec_args_cnt += 2;
+   } else if (inst->params != NULL) {
+      // if the inst has non-empty params, try to parse them
+      if (inst_params_to_arr(inst, sb, &module_params_num) != 0) {
+         VERBOSE(N_ERR, "Failed to parse inst params")
          goto err_cleanup;
       }
-      exec_args_pos++;
-   } else {
-      // copy already allocated inst params strings returned by inst_params_to_arr function
-      if (cfg_params != NULL && module_params_num > 0) {
-         for (int i = 0; i < module_params_num; i++) {
-            exec_args[exec_args_pos] = cfg_params[i];
-            exec_args_pos++;
-         }
-         NULLP_TEST_AND_FREE(cfg_params)
-      }
+      exec_args_cnt += module_params_num;
    }
 
-   // Do not generate -i args
-   if (inst->mod_ref->trap_ifces_cli == false || total_ifc_cnt == 0) {
-      inst->exec_args = exec_args;
-      return 0;
+   // if the inst has trap interfaces, one argument for "-i" and one for interfaces specifier
+   if (gen_ifc_spec) {
+      if (strbuf_append(sb, "-i") != 0 || strbuf_append_char(sb, '\0') != 0
+          || inst_ifcs_to_arg(inst, sb) != 0 || strbuf_append_char(sb, '\0') != 0) {
+         goto err_cleanup;
+      }
+      exec_args_cnt += 2;
    }
 
-   ifc_spec = inst_get_ifcs_as_arg(inst);
-   if (ifc_spec == NULL) {
+   // Buffer doesn't move anymore, arguments are pointed to right inside it
+   exec_args = (char **) calloc(exec_args_cnt + 1, sizeof(char *));
+   if (exec_args == NULL) {
       NO_MEM_ERR
       goto err_cleanup;
    }
-
-   exec_args[exec_args_pos] = strdup("-i"); // It's easier for freeing later
-   if (exec_args[exec_args_pos] == NULL) {
-      NO_MEM_ERR
-      goto err_cleanup;
+   for (uint32_t i = 0; i < exec_args_cnt; i++) {
+      exec_args[i] = sb->data + pos;
+      pos += (uint32_t) strlen(exec_args[i]) + 1;
    }
-   exec_args_pos++;
-   exec_args[exec_args_pos] = ifc_spec;
+   // last pointer is NULL because of execv function
+   exec_args[exec_args_cnt] = NULL;
    inst->exec_args = exec_args;
 
    return 0;
 
 err_cleanup:
-   if (cfg_params != NULL) {
-      for (int i = 0; i < module_params_num; i++) {
-         NULLP_TEST_AND_FREE(cfg_params[i]);
-      }
-      NULLP_TEST_AND_FREE(cfg_params)
+   sb->len = 0;
+   if (sb->data != NULL) {
+      sb->data[0] = '\0';
    }
 
-   if (exec_args != NULL) {
-      for (int i = 0; i < module_params_num; i++) {
-         NULLP_TEST_AND_FREE(exec_args[i])
-      }
-      NULLP_TEST_AND_FREE(exec_args)
-   }
-
-
    return -1;
 }
 
 
-static inline char * inst_get_ifcs_as_arg(inst_t *inst)
+static int inst_ifcs_to_arg(const inst_t *inst, strbuf_t *sb)
 {
-   char *ifc_spec = NULL;
-   char *new_ifc_spec = NULL;
-   char *cur_ifc_params = NULL;
-   char *tmp = NULL;
    interface_t *cur_ifc;
+   bool first = true;
 
-   vector_t *ifces_vec[2] = { &(inst->in_ifces), &(inst->out_ifces) };
+   const vector_t *ifces_vec[2] = { &(inst->in_ifces), &(inst->out_ifces) };
 
    // For loop for both interface directions list
    for (int j = 0; j < 2; j++) {
       for (int i = 0; i < ifces_vec[j]->total; i++) {
          cur_ifc = ifces_vec[j]->items[i];
-         cur_ifc_params = cur_ifc->ifc_to_cli_arg_fn(cur_ifc);
-         if (cur_ifc_params == NULL) {
-            NO_MEM_ERR
-            goto err_cleanup;
+         if (first == false && strbuf_append_char(sb, ',') != 0) {
+            return -1;
+         }
+         first = false;
+
+         if (cur_ifc->ifc_to_cli_arg_fn(cur_ifc, sb) != 0) {
+            return -1;
          }
 
          // Only for OUT type, YANG ensures it won't be set for IN
          if (cur_ifc->buffer != NULL) {
-            tmp = strcat_many(2, "buffer=", cur_ifc->buffer);
-            if (tmp == NULL) {
-               NO_MEM_ERR
-               goto err_cleanup;
-            }
-            cur_ifc_params = ifc_param_concat(cur_ifc_params, tmp, 0);
-            NULLP_TEST_AND_FREE(tmp)
-            if (cur_ifc_params == NULL) {
-               NO_MEM_ERR
-               goto err_cleanup;
+            if (strbuf_append(sb, ":buffer=") != 0 || strbuf_append(sb, cur_ifc->buffer) != 0) {
+               return -1;
             }
          }
 
          // Only for OUT type, YANG ensures it won't be set for IN
          if (cur_ifc->autoflush != NULL) {
-            tmp = strcat_many(2, "autoflush=", cur_ifc->autoflush);
-            if (tmp == NULL) {
-               NO_MEM_ERR
-               goto err_cleanup;
-            }
-            cur_ifc_params = ifc_param_concat(cur_ifc_params, tmp, 0);
-            NULLP_TEST_AND_FREE(tmp)
-            if (cur_ifc_params == NULL) {
-               NO_MEM_ERR
-               goto err_cleanup;
+            if (strbuf_append(sb, ":autoflush=") != 0
+                || strbuf_append(sb, cur_ifc->autoflush) != 0) {
+               return -1;
             }
          }
 
          // Common for IN/OUT type
          if (cur_ifc->timeout != NULL) {
-            tmp = strcat_many(2, "timeout=", cur_ifc->timeout);
-            if (tmp == NULL) {
-               NO_MEM_ERR
-               goto err_cleanup;
-            }
-            cur_ifc_params = ifc_param_concat(cur_ifc_params, tmp, 0);
-            NULLP_TEST_AND_FREE(tmp)
-            if (cur_ifc_params == NULL) {
-               NO_MEM_ERR
-               goto err_cleanup;
-            }
-         }
-
-         // Append to ifc_spec
-         if (ifc_spec == NULL) {
-            ifc_spec = cur_ifc_params;
-         } else {
-            new_ifc_spec = strcat_many(3, ifc_spec, ",", cur_ifc_params);
-            if (new_ifc_spec == NULL) {
-               NO_MEM_ERR
-               goto err_cleanup;
+            if (strbuf_append(sb, ":timeout=") != 0 || strbuf_append(sb, cur_ifc->timeout) != 0) {
+               return -1;
             }
-            NULLP_TEST_AND_FREE(ifc_spec)
-            NULLP_TEST_AND_FREE(cur_ifc_params);
-            ifc_spec = new_ifc_spec;
-            new_ifc_spec = NULL;
          }
       }
    }
 
-   return ifc_spec;
-
-err_cleanup:
-   NULLP_TEST_AND_FREE(cur_ifc_params)
-   NULLP_TEST_AND_FREE(new_ifc_spec)
-   NULLP_TEST_AND_FREE(ifc_spec)
-
-   return NULL;
-}
-
-// Only param_s or param_u should be passed, base is freed
-static char * ifc_param_concat(char *base, char *param_s, uint16_t param_u)
-{
-   char *result = NULL;
-   char *param = NULL; // Converted parameter to be concatenated
-   uint16_t len;
-   bool integer_passed = (param_s == NULL);
-
-   if (integer_passed) {
-      len = (uint16_t) snprintf(NULL, 0, "%d", param_u);
-      param = (char *) calloc(len + 1, sizeof(char));
-      if (param == NULL) {
-         NO_MEM_ERR
-         goto err_cleanup;
-      }
-
-      sprintf(param, "%u", param_u);
-   } else {
-      param = param_s;
-   }
-
-   result = strcat_many(3, base, ":", param);
-   if (result == NULL) {
-      NO_MEM_ERR
-      goto err_cleanup;
-   }
-
-   if (integer_passed) {
-      // param was created dynamically in this function, clean it
-      NULLP_TEST_AND_FREE(param);
-   }
-   NULLP_TEST_AND_FREE(base);
-
-   return result;
-
-err_cleanup:
-   if (integer_passed) {
-      NULLP_TEST_AND_FREE(param);
-   }
-   NULLP_TEST_AND_FREE(result);
-   NULLP_TEST_AND_FREE(base);
-
-   return NULL;
+   return 0;
 }
 
-static char * strcat_many(uint8_t cnt, ...)
+// Only param_s or param_u should be passed
+static int ifc_param_append(strbuf_t *sb, const char *param_s, uint16_t param_u)
 {
-   va_list args;
-   char *tmp, *result;
-   size_t len = 0;
-
-   // Count overall length of result string
-   va_start(args, cnt);
-   for (uint8_t i = 0; i < cnt; i++) {
-      tmp = va_arg(args, char *);
-      len += strlen(tmp);
+   if (strbuf_append_char(sb, ':') != 0) {
+      return -1;
    }
-   va_end(args);
-
-   result = (char *) calloc(len + 1, sizeof(char));
-   IF_NO_MEM_NULL_ERR(result)
-
-   va_start(args, cnt);
-   for (uint8_t i = 0; i < cnt; i++) {
-      tmp = va_arg(args, char *);
-      strcat(result, tmp);
+   if (param_s == NULL) {
+      return strbuf_append_uint(sb, param_u);
    }
-   va_end(args);
 
-   return result;
+   return strbuf_append(sb, param_s);
 }
 
 
@@ -808,133 +1288,127 @@ static char * strcat_many(uint8_t cnt, ...)
  * IN or only for OUT type.
  * */
 
-static char * tcp_ifc_to_cli_arg(const interface_t *ifc)
+static int tcp_ifc_to_cli_arg(const interface_t *ifc, strbuf_t *sb)
 {
-   char *params = strdup("t"); // strdup used so that ifc_param_concat can be used
-   IF_NO_MEM_NULL_ERR(params)
+   if (strbuf_append_char(sb, 't') != 0) {
+      return -1;
+   }
 
    if (ifc->specific_params.tcp->host != NULL) {
-      params = ifc_param_concat(params, ifc->specific_params.tcp->host, 0);
-      IF_NO_MEM_NULL_ERR(params)
+      if (ifc_param_append(sb, ifc->specific_params.tcp->host, 0) != 0) {
+         return -1;
+      }
    }
 
-   params = ifc_param_concat(params, NULL, ifc->specific_params.tcp->port);
-   IF_NO_MEM_NULL_ERR(params)
+   if (ifc_param_append(sb, NULL, ifc->specific_params.tcp->port) != 0) {
+      return -1;
+   }
 
    if (ifc->specific_params.tcp->max_clients > 0) {
-      params = ifc_param_concat(params, NULL, ifc->specific_params.tcp->max_clients);
-      IF_NO_MEM_NULL_ERR(params)
+      if (ifc_param_append(sb, NULL, ifc->specific_params.tcp->max_clients) != 0) {
+         return -1;
+      }
    }
 
-   return params;
+   return 0;
 }
-static char * tcp_tls_ifc_to_cli_arg(const interface_t *ifc)
+static int tcp_tls_ifc_to_cli_arg(const interface_t *ifc, strbuf_t *sb)
 {
-
-   char *params = strdup("T");
-   IF_NO_MEM_NULL_ERR(params)
+   if (strbuf_append_char(sb, 'T') != 0) {
+      return -1;
+   }
 
    if (ifc->specific_params.tcp_tls->host != NULL) {
-      params = ifc_param_concat(params, ifc->specific_params.tcp->host, 0);
-      IF_NO_MEM_NULL_ERR(params)
+      if (ifc_param_append(sb, ifc->specific_params.tcp_tls->host, 0) != 0) {
+         return -1;
+      }
+   }
+   if (ifc_param_append(sb, NULL, ifc->specific_params.tcp_tls->port) != 0) {
+      return -1;
    }
-   params = ifc_param_concat(params, NULL, ifc->specific_params.tcp_tls->port);
-   IF_NO_MEM_NULL_ERR(params)
 
    if (ifc->specific_params.tcp_tls->max_clients > 0) {
-      params = ifc_param_concat(params, NULL, ifc->specific_params.tcp_tls->max_clients);
-      IF_NO_MEM_NULL_ERR(params)
+      if (ifc_param_append(sb, NULL, ifc->specific_params.tcp_tls->max_clients) != 0) {
+         return -1;
+      }
    }
 
-   params = ifc_param_concat(params, ifc->specific_params.tcp_tls->keyfile, 0);
-   IF_NO_MEM_NULL_ERR(params)
-   params = ifc_param_concat(params, ifc->specific_params.tcp_tls->certfile, 0);
-   IF_NO_MEM_NULL_ERR(params)
-   params = ifc_param_concat(params, ifc->specific_params.tcp_tls->cafile, 0);
-   IF_NO_MEM_NULL_ERR(params)
+   if (ifc_param_append(sb, ifc->specific_params.tcp_tls->keyfile, 0) != 0
+       || ifc_param_append(sb, ifc->specific_params.tcp_tls->certfile, 0) != 0
+       || ifc_param_append(sb, ifc->specific_params.tcp_tls->cafile, 0) != 0) {
+      return -1;
+   }
 
-   return params;
+   return 0;
 }
 
-static char * unix_ifc_to_cli_arg(const interface_t *ifc)
+static int unix_ifc_to_cli_arg(const interface_t *ifc, strbuf_t *sb)
 {
-   char *params = strdup("u");
-   IF_NO_MEM_NULL_ERR(params)
-
-   params = ifc_param_concat(params, ifc->specific_params.nix->socket_name, 0);
-   IF_NO_MEM_NULL_ERR(params)
+   if (strbuf_append_char(sb, 'u') != 0
+       || ifc_param_append(sb, ifc->specific_params.nix->socket_name, 0) != 0) {
+      return -1;
+   }
 
    if (ifc->specific_params.nix->max_clients > 0) {
-      params = ifc_param_concat(params, NULL, ifc->specific_params.nix->max_clients);
-      IF_NO_MEM_NULL_ERR(params)
+      if (ifc_param_append(sb, NULL, ifc->specific_params.nix->max_clients) != 0) {
+         return -1;
+      }
    }
 
-   return params;
+   return 0;
 }
 
-static char * file_ifc_to_cli_arg(const interface_t *ifc)
+static int file_ifc_to_cli_arg(const interface_t *ifc, strbuf_t *sb)
 {
-   char *params = strdup("f");
-   IF_NO_MEM_NULL_ERR(params)
-
-   params = ifc_param_concat(params, ifc->specific_params.file->name, 0);
-   IF_NO_MEM_NULL_ERR(params)
+   if (strbuf_append_char(sb, 'f') != 0
+       || ifc_param_append(sb, ifc->specific_params.file->name, 0) != 0) {
+      return -1;
+   }
 
    if (ifc->specific_params.file->mode != NULL) {
-      params = ifc_param_concat(params, ifc->specific_params.file->mode, 0);
-      IF_NO_MEM_NULL_ERR(params)
+      if (ifc_param_append(sb, ifc->specific_params.file->mode, 0) != 0) {
+         return -1;
+      }
    }
 
    if (ifc->specific_params.file->size > 0) {
-      params = ifc_param_concat(params, NULL, ifc->specific_params.file->size);
-      IF_NO_MEM_NULL_ERR(params)
+      if (ifc_param_append(sb, NULL, ifc->specific_params.file->size) != 0) {
+         return -1;
+      }
    }
 
    if (ifc->specific_params.file->time > 0) {
-      params = ifc_param_concat(params, NULL, ifc->specific_params.file->time);
-      IF_NO_MEM_NULL_ERR(params)
+      if (ifc_param_append(sb, NULL, ifc->specific_params.file->time) != 0) {
+         return -1;
+      }
    }
 
-   return params;
+   return 0;
 }
 
-static char * bh_ifc_to_cli_arg(const interface_t *ifc)
+static int bh_ifc_to_cli_arg(const interface_t *ifc, strbuf_t *sb)
 {
-   char *params = strdup("b");
-   IF_NO_MEM_NULL_ERR(params)
-
-   return params;
+   return strbuf_append_char(sb, 'b');
 }
 
 
-static char **inst_params_to_arr(const inst_t *inst,
-                                 uint32_t *params_num,
-                                 int *rc)
+static int inst_params_to_arr(const inst_t *inst, strbuf_t *sb, uint32_t *params_num)
 {
-   uint32_t params_arr_size = 5,
-         params_cnt = 0;
+   uint32_t params_cnt = 0;
    uint32_t x = 0,
          y = 0,
          act_param_len = 0;
-   char *buffer = NULL;
    uint32_t params_len = (uint32_t) strlen(inst->params);
-   char **params = NULL;
-
-   *rc = 0;
-   params = (char **) calloc(params_arr_size, sizeof(char *));
-   if (params == NULL) {
-      NO_MEM_ERR
-      goto err_cleanup;
-   }
+   uint32_t start_len = sb->len;
 
    if (params_len < 1) {
       VERBOSE(V2, "Empty string in '%s' params element.", inst->name)
       goto err_cleanup;
    }
 
-   buffer = (char *) calloc(params_len + 1, sizeof(char));
-   if (buffer == NULL) {
-      NO_MEM_ERR
+   // Every parsed param is followed by delimiter or closing quote in params, or it is the last
+   //  one, so params with their terminating zeros are never longer than params_len + 1
+   if (strbuf_reserve(sb, params_len + 1) != 0) {
       goto err_cleanup;
    }
 
@@ -957,7 +1431,7 @@ static char **inst_params_to_arr(const inst_t *inst,
                   x = y;
                   goto add_param;
                } else { // add character to parameter in apostrophes
-                  buffer[act_param_len] = inst->params[y];
+                  sb->data[sb->len++] = inst->params[y];
                   act_param_len++;
                }
             }
@@ -984,7 +1458,7 @@ static char **inst_params_to_arr(const inst_t *inst,
                   x = y;
                   goto add_param;
                } else if (inst->params[y] != '\'') { // add character to parameter in quotes
-                  buffer[act_param_len] = inst->params[y];
+                  sb->data[sb->len++] = inst->params[y];
                   act_param_len++;
                } else {
                   VERBOSE(V2, "Found apostrophe in '%s' params element in quotes.", inst->name);
@@ -1005,16 +1479,8 @@ static char **inst_params_to_arr(const inst_t *inst,
             }
 
          add_param:
-            if (params_cnt == params_arr_size) {
-               // if needed, resize the array of parsed parameters
-               params_arr_size += params_arr_size;
-               params = (char **) realloc(params, sizeof(char *) * params_arr_size);
-               memset(params + (params_arr_size / 2), 0, ((params_arr_size / 2) * sizeof(char *)));
-            }
-
-            params[params_cnt] = strdup(buffer);
+            sb->data[sb->len++] = '\0';
             params_cnt++;
-            memset(buffer, 0, (params_len + 1) * sizeof(char));
             act_param_len = 0;
             break;
          }
@@ -1022,7 +1488,7 @@ static char **inst_params_to_arr(const inst_t *inst,
          // adding one character to parameter out of quotes and apostrophes
          default:
          {
-            buffer[act_param_len] = inst->params[x];
+            sb->data[sb->len++] = inst->params[x];
             act_param_len++;
 
             if (x == (params_len - 1)) { // if last character of the params element was added, add current module parameter to the params array
@@ -1038,21 +1504,17 @@ static char **inst_params_to_arr(const inst_t *inst,
       goto err_cleanup;
    }
 
+   sb->data[sb->len] = '\0';
    *params_num = params_cnt;
-   NULLP_TEST_AND_FREE(buffer);
 
-   return params;
+   return 0;
 
 err_cleanup:
-   if (params != NULL) {
-      for (x = 0; x < params_cnt; x++) {
-         NULLP_TEST_AND_FREE(params[x]);
-      }
-      NULLP_TEST_AND_FREE(params)
+   if (sb->data != NULL) {
+      sb->len = start_len;
+      sb->data[sb->len] = '\0';
    }
-   NULLP_TEST_AND_FREE(buffer);
    *params_num = 0;
-   *rc = -1;
 
-   return NULL;
+   return -1;
 }
@@ -15,6 +15,21 @@
 #include <pthread.h>
 #include <fcntl.h>
 #include "utils.h"
+#include "evloop.h"
+#include "timerwheel.h"
+#include "placement.h"
+#include "logpipe.h"
+
+#define DEFAULT_LIVENESS_PERIOD_MS 1500 ///< Default period of fallback liveness check of instances
+#define DEFAULT_RESOURCES_PERIOD_MS 1500 ///< Default period of CPU and memory usage sampling
+#define DEFAULT_SERVICE_IFC_PERIOD_MS 1500 ///< Default period of service interface stats requests
+#define DEFAULT_RESTART_INITIAL_BACKOFF_MS 100 ///< Default delay of the first restart after failure
+#define DEFAULT_RESTART_MAX_BACKOFF_MS 30000 ///< Default upper bound of delay of restart
+#define DEFAULT_RESTART_JITTER_PERC 20 ///< Default random deviation of delay of restart in %
+#define DEFAULT_RESTART_STABLE_UPTIME_MS 60000 ///< Default uptime after which backoff is reset
+
+#define INST_STATS_XPATH_FMT NS_ROOT_XPATH"/instance[name='%s']/stats" ///< Stats of instance
+#define IFC_STATS_XPATH_FMT NS_ROOT_XPATH"/instance[name='%s']/interface[name='%s']/stats" ///< Stats of interface
 
 /**
  * @brief Direction of module interface
@@ -46,6 +61,19 @@ typedef struct ifc_in_stats_s {
    uint64_t recv_buff_cnt;
 } ifc_in_stats_t;
 
+/**
+ * @brief Descriptors of cgroup v2 leaf of instance, kept open while the leaf is used.
+ * */
+typedef struct inst_cgroup_s {
+   int dir_fd; ///< Leaf directory or -1 if instance isn't placed into cgroup
+   int procs_fd; ///< cgroup.procs, spawned child moves itself to the leaf through it
+   int cpu_stat_fd; ///< cpu.stat
+   int mem_current_fd; ///< memory.current
+   int mem_peak_fd; ///< memory.peak or -1 if kernel doesn't provide it
+   int io_stat_fd; ///< io.stat or -1 if io controller is not enabled
+   uint64_t oom_kills; ///< Value of oom_kill of memory.events seen last time
+} inst_cgroup_t;
+
 /**
  * @brief Interface statistics for OUT direction
  * */
@@ -131,6 +159,7 @@ typedef union specific_ifc_params_u {
  * */
 typedef struct interface_s {
    char *name; ///< Interface name
+   char *stats_xpath; ///< XPATH of stats container of the interface, built when loaded
    char *buffer; ///< Specifies buffering of data and whether to send in larger
                  ///<  bulks (increases troughput).
    char *autoflush; ///< Normally data are not sent until the buffer is full. When
@@ -139,10 +168,10 @@ typedef struct interface_s {
    interface_dir_t direction; ///< Enum of interface direction - for faster comparison
    interface_type_t type; ///< Enum of interface type - for faster comparison
    specific_ifc_params_t specific_params; ///< Parameters specific for given interaface type.
-   char * (*ifc_to_cli_arg_fn)(const struct interface_s *); ///< Pointer to function that converts
-                                                          ///<  interface to CLI arguments string
-                                                          ///<  and is specific for given
-                                                          ///<  interface type.
+   int (*ifc_to_cli_arg_fn)(const struct interface_s *, strbuf_t *); ///< Pointer to function
+                                                          ///<  that appends interface as CLI
+                                                          ///<  argument to given buffer and is
+                                                          ///<  specific for given interface type.
    void *stats; ///< Pointer to in_ifc_stats_t or out_ifc_stats_t depending on whether
                 ///<  this is in/out iface
 } interface_t;
@@ -156,8 +185,85 @@ typedef struct av_module_s {
    bool sr_rdy; ///< Is module sysrepo ready?
    bool trap_mon; ///< Is module monitorable via TRAP's service interface?
    bool trap_ifces_cli; ///< Is passing TRAP interfaces params at CLI?
+   vector_t insts; ///< Instances in insts_v referencing this module, see insts_add()
 } av_module_t;
 
+/**
+ * @brief Periods of supervisor subsystems loaded from /supervisor/intervals.
+ * @details Instance can override resources and service interface periods,
+ *  see inst_resources_period() and inst_service_ifc_period().
+ * */
+typedef struct intervals_s {
+   uint32_t liveness_ms; ///< Period of fallback liveness check of instances
+   uint32_t resources_ms; ///< Default period of CPU and memory usage sampling
+   uint32_t service_ifc_ms; ///< Default period of service interface stats requests
+   bool changed; ///< Set when intervals got reloaded, timers are re-armed by supervisor_routine
+} intervals_t;
+
+/**
+ * @brief State of stopping of instance process.
+ * @details Stopping advances on timer and exit events so that nothing has to sleep
+ *  while holding config_lock.
+ * */
+typedef enum inst_stop_state_e {
+   INST_STOP_NONE, ///< Instance is not being stopped
+   INST_STOP_SIGINT_SENT, ///< SIGINT was sent, SIGKILL follows once stop_timer expires
+   INST_STOP_SIGKILL_SENT, ///< SIGKILL was sent, waiting for process to be released
+   INST_STOP_REAPED, ///< Process is gone
+} inst_stop_state_t;
+
+/**
+ * @brief Reason of exit of instance process, decides how the instance is restarted.
+ * */
+typedef enum inst_exit_reason_e {
+   INST_EXIT_CODE, ///< Process exited on its own
+   INST_EXIT_SIGNAL, ///< Process was terminated by signal
+   INST_EXIT_OOM_KILL, ///< Process was killed by the OOM killer
+   INST_EXIT_EXEC_FAILED, ///< Binary of module couldn't be executed
+} inst_exit_reason_t;
+
+/**
+ * @brief Pacing of restarts of instance, loaded from /instance/restart-policy.
+ * @details Delay of restart starts at initial_backoff_ms, doubles with every exit up to
+ *  max_backoff_ms and is reset once the process runs for stable_uptime_ms.
+ * */
+typedef struct restart_policy_s {
+   uint32_t initial_backoff_ms; ///< Delay of the first restart after failure
+   uint32_t max_backoff_ms; ///< Upper bound of delay of restart
+   uint8_t jitter_perc; ///< Random deviation of every delay in % of it
+   uint32_t stable_uptime_ms; ///< Uptime after which process is considered healthy again
+   bool restart_on_exec_failure; ///< Whether instance which binary can't be executed is
+                                 ///<  restarted, otherwise it gets disabled
+   bool immediate_restart_on_oom_kill; ///< Whether instance killed by the OOM killer is
+                                       ///<  restarted without delay
+} restart_policy_t;
+
+/**
+ * @brief Information about last exit of instance process gathered once it was reaped.
+ * @details Available only for instances started by supervisor since status of
+ *  adopted processes can't be waited for.
+ * */
+typedef struct inst_exit_info_s {
+   bool valid; ///< Whether instance process exited at least once
+   bool core_dumped; ///< Whether process dumped core
+   int code; ///< Exit code or -1 if process was terminated by signal
+   int signal; ///< Signal that terminated process or 0
+   inst_exit_reason_t reason; ///< Classification of the exit
+   time_t time; ///< Time of exit
+   uint64_t cpu_user_us; ///< CPU time spent in user mode in microseconds
+   uint64_t cpu_kern_us; ///< CPU time spent in kernel mode in microseconds
+   uint64_t max_rss; ///< Maximum resident set size in kB
+} inst_exit_info_t;
+
+/**
+ * @brief Producer/consumer pair of instances, i.e. OUT interface of producer and IN interface
+ *  of consumer use the same UNIX socket or TCP port
+ * */
+typedef struct inst_link_s {
+   uint32_t producer; ///< Index of producing instance
+   uint32_t consumer; ///< Index of consuming instance
+} inst_link_t;
+
 /**
  * @brief Structure that holds an instance.
  * */
@@ -165,44 +271,116 @@ typedef struct inst_s {
    vector_t in_ifces; ///< Vector of IN interfaces
    vector_t out_ifces; ///< Vector of OUT interfaces
 
-   bool enabled; ///< Specifies whether module is enabled.
+   uint32_t slot; ///< Slot of hot state in insts_hot, see INST_ENABLED() and others
    bool use_sysrepo; ///< Specifies whether to use sysrepo. This option can be true only to sysrepo ready modules
    bool is_my_child; ///< Specifies whether supervisor started this module.
+   bool socket_activation; ///< Whether supervisor creates listening sockets of UNIX and TCP OUT
+                           ///<  interfaces and passes them to the process, see sockact.h
    char *name; ///< Module name (loaded from config file).
+   char *stats_xpath; ///< XPATH of stats container of the instance, built when name is loaded
    char *params; ///< Module parameter (loaded from config file).
    char **exec_args; ///< Array of arguments to execv function. Module name at first
                      ///<  place inside the array and NULL at the last, e.g.
                      ///<  ["module_name", "-a", "blah", NULL]
+   strbuf_t exec_args_buf; ///< Arena holding all strings exec_args point to
+   log_conf_t log_conf; ///< Capturing, rotation and rate limit of stdout and stderr logs
+   log_stream_t log_out; ///< Captured stdout of the process, see logpipe.h
+   log_stream_t log_err; ///< Captured stderr of the process, see logpipe.h
 
 
    av_module_t *mod_ref; ///< Module executable of this process
    bool root_perm_needed; ///< Does module require root permissions?
-   bool running; ///< Is module running?
-   bool should_die; ///< Whether instance is marked for kill
-   bool sigint_sent; ///< Specifies whether SIGKILL was sent to module.
-   pid_t pid; ///< Module process PID.
+   inst_stop_state_t stop_state; ///< Progress of stopping of the instance process
+   tw_timer_t stop_timer; ///< Advances stop_state once grace period passes
+   int pidfd; ///< Process file descriptor of pid or -1 if not opened
+   ev_source_t *pid_src; ///< pidfd registered in main_evloop, exit of process is reported
+                         ///<  through it. If NULL, running status is polled via kill
    uint8_t restarts_cnt; ///< Number of attempts at starting the module in last
-                         ///<  minute from restarts_timer
+                         ///<  minute from restart_timer
    uint8_t max_restarts_minute; ///< Maximum number of restarts per minute
-   time_t restart_time; ///< Time used for monitoring max number of restarts/minute.
+   tw_timer_t restart_timer; ///< Armed while restart window of last start is open,
+                             ///<  resets restarts_cnt once it expires
+   restart_policy_t restart_policy; ///< Pacing of restarts after exits of the process
+   uint32_t backoff_ms; ///< Current delay of restart without jitter or 0 after stable run
+   tw_timer_t backoff_timer; ///< Armed until instance which process exited may be restarted
+   bool exec_failed; ///< Whether last started process failed to execute the binary
+   time_t start_time; ///< Time of last start by supervisor or 0
+   uint64_t start_ms; ///< Monotonic time of last start by supervisor, see startup.h
+   bool ready; ///< Whether process created its sockets since last start, see startup.h
+   inst_exit_info_t last_exit; ///< Exit status of last reaped process
 
    uint64_t mem_vms;  ///< Loaded from /proc/PID/stat in B
-   uint64_t mem_rss;  ///< Loaded from /proc/PID/status in kB
+   uint64_t mem_rss;  ///< In kB, cgroup memory.current of instance leaf or /proc/PID/statm resident pages
    uint64_t last_cpu_perc_kmode; ///< Percentage of CPU usage in last period in kernel mode.
    uint64_t last_cpu_kmode; ///< CPU usage in last period in kernel mode.
    uint64_t last_cpu_perc_umode; ///< Percentage of CPU usage in last period in user mode.
    uint64_t last_cpu_umode; ///< CPU usage in last period in user mode.
-
-   int service_sd; ///< Socket descriptor of the service connection or -1 if not set
-   bool service_ifc_connected; ///< Is supervisor connected to module?
-   uint64_t service_ifc_conn_timer; ///< Indicator of whether to attempt to connect to service ifc.
-   ///<  Gets incremented once every supervisor_routine loop to
-   ///<  connect each NUM_SERVICE_IFC_PERIOD
+   uint64_t last_total_cpu; ///< Total CPU time of system at last sample of instance or 0,
+                            ///<  in units of last_cpu_umode and last_cpu_kmode
+   uint64_t cpu_load; ///< CPU usage in last period in thousandths of one CPU
+   pid_t proc_pid; ///< PID proc_stat_fd and proc_statm_fd were opened for or 0
+   int proc_stat_fd; ///< Descriptor of /proc/PID/stat kept open while process runs or -1
+   int proc_statm_fd; ///< Descriptor of /proc/PID/statm kept open while process runs or -1
+
+   inst_cgroup_t cg; ///< Leaf of instance, CPU and memory are accounted through it if present
+   char *cpu_max; ///< Value for cpu.max of the leaf ("QUOTA PERIOD" in us) or NULL for no limit
+   uint64_t memory_max; ///< Value for memory.max of the leaf in bytes or 0 for no limit
+   uint64_t mem_peak; ///< Peak memory usage of the leaf in kB
+   uint64_t io_read_bytes; ///< Bytes read from block devices by the leaf
+   uint64_t io_write_bytes; ///< Bytes written to block devices by the leaf
+
+   placement_t placement; ///< CPUs and memory policy the process is started with
+   int32_t auto_domain; ///< Domain the process was placed to by autoplace or -1
+   uint32_t auto_chain; ///< Chain of producers/consumers of the instance, see autoplace
+
+   bool service_ifc_connected; ///< Did the collector thread receive stats from service ifc?
+
+   uint32_t resources_period_ms; ///< Period of CPU and memory usage sampling or 0 for default
+   uint32_t service_ifc_period_ms; ///< Period of service interface requests or 0 for default
+   tw_timer_t resources_timer; ///< Marks instance for next resources sampling pass
+   tw_timer_t service_ifc_timer; ///< Marks instance for next service interface pass
 } inst_t;
 
+/**
+ * @brief Hot state of all allocated instances, struct of arrays indexed by inst_t slot.
+ * @details Passes of supervisor_routine over all instances check just a few flags of each
+ *  of them. These are kept here densely packed instead of inside inst_t, so that a pass
+ *  reads few arrays instead of chasing a pointer and pulling cache lines of every instance.
+ *  The rest of inst_t is touched only for instances the flags select.
+ *
+ *  Slot is assigned by inst_alloc() and kept until inst_free(), also while the instance is
+ *  dying. Table is accessed with config_lock held only, arrays move when the table grows,
+ *  so pointers into them mustn't be kept.
+ * */
+typedef struct insts_hot_s {
+   uint32_t capacity; ///< Number of slots arrays are allocated for
+   uint32_t used; ///< Number of slots assigned at least once, passes scan slots below it
+   uint32_t free_cnt; ///< Number of released slots in free_slots
+   uint32_t *free_slots; ///< Released slots, reused before new ones
+   struct inst_s **inst; ///< Instance of slot or NULL if the slot is free
+   bool *listed; ///< Whether instance is in insts_v, see insts_add()
+   bool *enabled; ///< Specifies whether module is enabled.
+   bool *running; ///< Is module running?
+   bool *should_die; ///< Whether instance is marked for kill
+   bool *resources_due; ///< Instance is sampled by next resources pass
+   bool *service_ifc_due; ///< Instance is handled by next service interface pass
+   pid_t *pid; ///< Module process PID.
+} insts_hot_t;
+
+#define INST_ENABLED(inst) (insts_hot.enabled[(inst)->slot]) ///< Hot state of instance, lvalue
+#define INST_RUNNING(inst) (insts_hot.running[(inst)->slot]) ///< Hot state of instance, lvalue
+#define INST_SHOULD_DIE(inst) (insts_hot.should_die[(inst)->slot]) ///< Hot state of instance, lvalue
+#define INST_RESOURCES_DUE(inst) (insts_hot.resources_due[(inst)->slot]) ///< Hot state of instance, lvalue
+#define INST_SERVICE_IFC_DUE(inst) (insts_hot.service_ifc_due[(inst)->slot]) ///< Hot state of instance, lvalue
+#define INST_PID(inst) (insts_hot.pid[(inst)->slot]) ///< Hot state of instance, lvalue
+
 extern pthread_mutex_t config_lock;
 extern vector_t avmods_v;
 extern vector_t insts_v;
+extern vector_t dying_insts_v; ///< Removed instances which processes are still being stopped
+extern vector_t dying_avmods_v; ///< Removed modules still referenced by dying instances
+extern intervals_t intervals; ///< Periods of supervisor subsystems
+extern insts_hot_t insts_hot; ///< Hot state of instances
 
 
 /**
@@ -237,10 +415,65 @@ extern void print_ifc(interface_t *ifc);
 extern void av_modules_free();
 
 /**
- * @brief Frees the insts_v array of instances.
+ * @brief Adds module to avmods_v and to index of modules by name.
+ * @details Modules mustn't be added to avmods_v by vector_add directly, they wouldn't be
+ *  found by av_module_get_by_name. Name of module has to be loaded already.
+ * @param mod Module to add
+ * @return 0 on success or -1 on error
+ * */
+extern int av_modules_add(av_module_t *mod);
+
+/**
+ * @brief Removes module from avmods_v and from index by name. Module isn't freed.
+ * @param mod Module to remove, it has to be in avmods_v
+ * */
+extern void av_modules_delete(av_module_t *mod);
+
+/**
+ * @brief Adds instance to insts_v, to index of instances by name and to instances of
+ *  its module.
+ * @details Instances mustn't be added to insts_v by vector_add directly, they wouldn't be
+ *  found by inst_get_by_name. Name and mod_ref of instance have to be set already.
+ * @param inst Instance to add
+ * @return 0 on success or -1 on error
+ * */
+extern int insts_add(inst_t *inst);
+
+/**
+ * @brief Removes instance from insts_v, from index by name and from instances of its
+ *  module. Instance isn't freed.
+ * @param inst Instance to remove, it has to be in insts_v
+ * */
+extern void insts_delete(inst_t *inst);
+
+/**
+ * @brief Removes all instances of module from insts_v and from index by name in one pass
+ *  over insts_v. Instances aren't freed.
+ * @details Removed instances are left in mod->insts, so that caller can stop them. Caller
+ *  has to free mod->insts by vector_free afterwards.
+ * @param mod Module which instances are removed
+ * */
+extern void insts_delete_module(av_module_t *mod);
+
+/**
+ * @brief Frees the insts_v array of instances and removed instances that are still being stopped.
  * */
 extern void insts_free();
 
+/**
+ * @brief Returns period of CPU and memory usage sampling of given instance.
+ * @param inst Instance
+ * @return Instance override or default from intervals, in milliseconds
+ * */
+extern uint32_t inst_resources_period(const inst_t *inst);
+
+/**
+ * @brief Returns period of service interface stats requests of given instance.
+ * @param inst Instance
+ * @return Instance override or default from intervals, in milliseconds
+ * */
+extern uint32_t inst_service_ifc_period(const inst_t *inst);
+
 /**
  * @brief Frees single given instance.
  * @param inst Instance to free
@@ -306,20 +539,118 @@ extern int interface_specific_params_alloc(interface_t *ifc);
 
 /**
  * @brief Loads exec_args from instance parameters and interfaces.
+ * @details All arguments are written in one pass into exec_args_buf of the instance which
+ *  is reused by every further call, exec_args generated before are released.
  * @param inst Instance for which exec_args should be loaded.
  * @return 0 on success or -1 on error
  * */
 extern int inst_gen_exec_args(inst_t *inst);
 
+/**
+ * @brief Formats XPATH of stats container of instance or of its interface.
+ * @param buf Buffer to format to, might be NULL if size is 0
+ * @param size Size of buf
+ * @param inst_name Name of instance
+ * @param ifc_name Name of interface or NULL for stats of the instance itself
+ * @return Length of whole XPATH like snprintf
+ * */
+extern int stats_xpath_format(char *buf, size_t size, const char *inst_name,
+                              const char *ifc_name);
+
+/**
+ * @brief Allocates XPATH of stats container of instance or of its interface.
+ * @details XPATHs of stats depend just on names, so they are built once when the
+ *  configuration is loaded instead of at every stats request.
+ * @param inst_name Name of instance
+ * @param ifc_name Name of interface or NULL for stats of the instance itself
+ * @return Allocated XPATH or NULL on error
+ * */
+extern char * stats_xpath_alloc(const char *inst_name, const char *ifc_name);
+
 /**
  * @brief Finds instance by it's name inside insts_v and fills it's index inside
  *  vector to index parameter.
+ * @details Instance is looked up in hash index, only the optional index is found by
+ *  scanning insts_v for the pointer.
  * @param name Name of instance to find
  * @param index[out] Found index inside insts_v vector. It's not filled if inst is not found.
  * @return Pointer to found intance or NULL if not found.
  * */
 extern inst_t * inst_get_by_name(const char *name, uint32_t *index);
 
+/**
+ * @brief Finds module by it's name inside avmods_v using hash index.
+ * @param name Name of module to find
+ * @return Pointer to found module or NULL if not found.
+ * */
+extern av_module_t * av_module_get_by_name(const char *name);
+
+/**
+ * @brief Finds instance by PID of its process inside insts_v and dying_insts_v.
+ * @param pid PID to look for
+ * @return Pointer to found instance or NULL if not found.
+ * */
+extern inst_t * inst_get_by_pid(pid_t pid);
+
+/**
+ * @brief Finds all producer/consumer pairs among given instances.
+ * @param insts Instances
+ * @param cnt Number of instances
+ * @param links Found pairs with indexes into insts, has to be freed by caller
+ * @return Number of found pairs or -1 on error
+ * */
+extern int insts_links(inst_t **insts, uint32_t cnt, inst_link_t **links);
+
+/**
+ * @brief Marks service interface connection of given instance as closed.
+ * @details Socket itself is owned by the collector thread (see service.h), which
+ *  notices hang up of the instance process on its own.
+ * @param inst Instance which service connection was closed
+ * */
+extern void inst_service_disconnected(inst_t *inst);
+
+/**
+ * @brief Opens pidfd for PID of given instance and registers it inside main_evloop.
+ * @details Once process exits, instance is marked as not running and main_evloop
+ *  is woken up. Works for children of supervisor as well as for adopted processes.
+ *  In case of failure, running status of instance has to be polled via kill.
+ * @param inst Instance with PID set
+ * @return 0 on success, -1 on error with errno set (ESRCH means process is gone)
+ * */
+extern int inst_pidfd_open(inst_t *inst);
+
+/**
+ * @brief Removes pidfd of given instance from main_evloop and closes it.
+ * @param inst Instance which pidfd should be closed
+ * */
+extern void inst_pidfd_close(inst_t *inst);
+
+/**
+ * @brief Opens /proc/PID/stat and /proc/PID/statm of instance process for resources sampling.
+ * @details Does nothing if they are open for current PID already, descriptors of
+ *  previous process are closed first.
+ * @param inst Running instance
+ * @return -1 on error, 0 on success
+ * */
+extern int inst_proc_open(inst_t *inst);
+
+/**
+ * @brief Closes /proc descriptors of instance process if they are open.
+ * @param inst Instance to use
+ * */
+extern void inst_proc_close(inst_t *inst);
+
+/**
+ * @brief Sends signal to instance process. Uses pidfd if available so that the
+ *  signal can't be delivered to another process that reused the PID.
+ * @details PID is used only if instance has no pidfd or kernel can't signal through it.
+ *  Process that already exited isn't signalled at all.
+ * @param inst Instance to signal
+ * @param sig Signal to send
+ * @return Same as kill, -1 with errno ESRCH if the process exited
+ * */
+extern int inst_send_signal(inst_t *inst, int sig);
+
 /**
  * @brief Clear UNIX socket files left after killed instance.
  * @param inst Instance after which the socket files should be cleaned.
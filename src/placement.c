@@ -0,0 +1,329 @@
+/**
+ * @file placement.c
+ * @brief Implementation of functions defined in placement.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "placement.h"
+#include "utils.h"
+
+/**
+ * @brief Memory policies that can be configured and their MPOL_* modes
+ * */
+static const struct {
+   const char *name; ///< Name used in configuration
+   int mode; ///< MPOL_* mode
+   bool needs_nodes; ///< Whether policy requires nonempty list of nodes
+} mem_policies[] = {
+   { "default", MPOL_DEFAULT, false },
+   { "bind", MPOL_BIND, true },
+   { "preferred", MPOL_PREFERRED, true },
+   { "interleave", MPOL_INTERLEAVE, true },
+   { "local", MPOL_LOCAL, false },
+};
+
+/**
+ * @brief Scans decimal number of list
+ * @param p Position to scan from, moved past the number
+ * @param num Scanned number
+ * @return -1 if there is no number, 0 on success
+ * */
+static int placement_scan_num(const char **p, uint32_t *num);
+
+/**
+ * @brief Checks whether bit of mask is set
+ * */
+static inline bool placement_mask_isset(const unsigned long *mask, uint32_t bit);
+
+/**
+ * @brief Wrapper of sched_setaffinity syscall taking mask of kernel format
+ * */
+static inline int sys_sched_setaffinity(pid_t tid, const unsigned long *mask, size_t size);
+
+/**
+ * @brief Wrapper of sched_getaffinity syscall taking mask of kernel format
+ * */
+static inline int sys_sched_getaffinity(pid_t pid, unsigned long *mask, size_t size);
+
+/**
+ * @brief Wrapper of set_mempolicy syscall which has no wrapper in libc without libnuma
+ * */
+static inline int sys_set_mempolicy(int mode, const unsigned long *nodes, unsigned long maxnode);
+
+
+static int placement_scan_num(const char **p, uint32_t *num)
+{
+   const char *s = *p;
+   uint32_t val = 0;
+
+   if (*s < '0' || *s > '9') {
+      return -1;
+   }
+   while (*s >= '0' && *s <= '9') {
+      if (val > UINT32_MAX / 10) {
+         return -1;
+      }
+      val = val * 10 + (uint32_t) (*s - '0');
+      s++;
+   }
+
+   *p = s;
+   *num = val;
+   return 0;
+}
+
+static inline bool placement_mask_isset(const unsigned long *mask, uint32_t bit)
+{
+   return (mask[bit / PLACEMENT_LONG_BITS] >> (bit % PLACEMENT_LONG_BITS)) & 1UL;
+}
+
+static inline int sys_sched_setaffinity(pid_t tid, const unsigned long *mask, size_t size)
+{
+   return (int) syscall(SYS_sched_setaffinity, tid, size, mask);
+}
+
+static inline int sys_sched_getaffinity(pid_t pid, unsigned long *mask, size_t size)
+{
+   // Raw syscall returns size of kernel mask that was copied instead of 0
+   return (int) syscall(SYS_sched_getaffinity, pid, size, mask);
+}
+
+static inline int sys_set_mempolicy(int mode, const unsigned long *nodes, unsigned long maxnode)
+{
+#ifdef SYS_set_mempolicy
+   return (int) syscall(SYS_set_mempolicy, mode, nodes, maxnode);
+#else
+   errno = ENOSYS;
+   return -1;
+#endif
+}
+
+int placement_parse_list(const char *list, unsigned long *mask, uint32_t max_bits)
+{
+   const char *p = list;
+   uint32_t first;
+   uint32_t last;
+
+   memset(mask, 0, max_bits / 8);
+
+   while (true) {
+      if (placement_scan_num(&p, &first) == -1) {
+         return -1;
+      }
+      last = first;
+      if (*p == '-') {
+         p++;
+         if (placement_scan_num(&p, &last) == -1 || last < first) {
+            return -1;
+         }
+      }
+      if (last >= max_bits) {
+         return -1;
+      }
+      for (uint32_t bit = first; bit <= last; bit++) {
+         mask[bit / PLACEMENT_LONG_BITS] |= 1UL << (bit % PLACEMENT_LONG_BITS);
+      }
+
+      if (*p == '\0') {
+         return 0;
+      }
+      if (*p != ',') {
+         return -1;
+      }
+      p++;
+   }
+}
+
+int placement_format_list(const unsigned long *mask, uint32_t max_bits, char *buf, size_t size)
+{
+   size_t len = 0;
+   int written;
+   uint32_t first;
+
+   buf[0] = '\0';
+   for (uint32_t bit = 0; bit < max_bits; bit++) {
+      if (!placement_mask_isset(mask, bit)) {
+         continue;
+      }
+      first = bit;
+      while (bit + 1 < max_bits && placement_mask_isset(mask, bit + 1)) {
+         bit++;
+      }
+
+      if (first == bit) {
+         written = snprintf(buf + len, size - len, "%s%u", len > 0 ? "," : "", first);
+      } else {
+         written = snprintf(buf + len, size - len, "%s%u-%u", len > 0 ? "," : "", first, bit);
+      }
+      if (written < 0 || (size_t) written >= size - len) {
+         return -1;
+      }
+      len += (size_t) written;
+   }
+
+   return 0;
+}
+
+int placement_load(placement_t *pl, const char *cpus, const char *mem_policy,
+                   const char *mem_nodes)
+{
+   size_t i;
+
+   pl->has_cpus = false;
+   pl->has_mem_policy = false;
+
+   if (cpus != NULL) {
+      if (placement_parse_list(cpus, pl->cpus, PLACEMENT_MAX_CPUS) == -1) {
+         VERBOSE(N_ERR, "Invalid list of CPUs '%s' (at most %d CPUs)", cpus, PLACEMENT_MAX_CPUS)
+         return -1;
+      }
+      pl->has_cpus = true;
+   }
+
+   if (mem_policy == NULL) {
+      if (mem_nodes != NULL) {
+         VERBOSE(N_ERR, "NUMA nodes '%s' are given without memory policy", mem_nodes)
+         return -1;
+      }
+      return 0;
+   }
+
+   for (i = 0; i < sizeof(mem_policies) / sizeof(mem_policies[0]); i++) {
+      if (strcmp(mem_policies[i].name, mem_policy) == 0) {
+         break;
+      }
+   }
+   if (i == sizeof(mem_policies) / sizeof(mem_policies[0])) {
+      VERBOSE(N_ERR, "Unknown memory policy '%s'", mem_policy)
+      return -1;
+   }
+   if (mem_policies[i].needs_nodes != (mem_nodes != NULL)) {
+      VERBOSE(N_ERR, "Memory policy '%s' %s list of NUMA nodes", mem_policy,
+              mem_policies[i].needs_nodes ? "requires" : "doesn't accept")
+      return -1;
+   }
+
+   memset(pl->mem_nodes, 0, sizeof(pl->mem_nodes));
+   if (mem_nodes != NULL
+       && placement_parse_list(mem_nodes, pl->mem_nodes, PLACEMENT_MAX_NODES) == -1) {
+      VERBOSE(N_ERR, "Invalid list of NUMA nodes '%s' (at most %d nodes)", mem_nodes,
+              PLACEMENT_MAX_NODES)
+      return -1;
+   }
+   pl->mem_mode = mem_policies[i].mode;
+   pl->has_mem_policy = true;
+
+   return 0;
+}
+
+int placement_apply(const placement_t *pl)
+{
+   if (pl->has_cpus && sys_sched_setaffinity(0, pl->cpus, sizeof(pl->cpus)) == -1) {
+      return -1;
+   }
+   // Kernel takes maxnode - 1 bits of the mask
+   if (pl->has_mem_policy
+       && sys_set_mempolicy(pl->mem_mode, pl->mem_mode == MPOL_DEFAULT ? NULL : pl->mem_nodes,
+                            pl->mem_mode == MPOL_DEFAULT ? 0 : PLACEMENT_MAX_NODES + 1) == -1) {
+      return -1;
+   }
+
+   return 0;
+}
+
+int placement_set_cpus(pid_t pid, const unsigned long *cpus)
+{
+   char path[PATH_MAX];
+   DIR *dir;
+   struct dirent *ent;
+   pid_t tid;
+   int rc = 0;
+
+   // Affinity is per thread, threads created later inherit it from their creator
+   snprintf(path, sizeof(path), "/proc/%d/task", pid);
+   dir = opendir(path);
+   if (dir == NULL) {
+      return -1;
+   }
+   while ((ent = readdir(dir)) != NULL) {
+      if (ent->d_name[0] < '0' || ent->d_name[0] > '9') {
+         continue;
+      }
+      tid = (pid_t) strtol(ent->d_name, NULL, 10);
+      // Thread might have exited meanwhile
+      if (sys_sched_setaffinity(tid, cpus, PLACEMENT_MAX_CPUS / 8) == -1 && errno != ESRCH) {
+         rc = -1;
+      }
+   }
+   closedir(dir);
+
+   return rc;
+}
+
+int placement_get_cpu_mask(pid_t pid, unsigned long *cpus)
+{
+   memset(cpus, 0, PLACEMENT_MAX_CPUS / 8);
+   if (sys_sched_getaffinity(pid, cpus, PLACEMENT_MAX_CPUS / 8) == -1) {
+      return -1;
+   }
+
+   return 0;
+}
+
+int placement_get_cpus(pid_t pid, char *buf, size_t size)
+{
+   unsigned long mask[PLACEMENT_MAX_CPUS / PLACEMENT_LONG_BITS];
+
+   if (placement_get_cpu_mask(pid, mask) == -1) {
+      return -1;
+   }
+
+   return placement_format_list(mask, PLACEMENT_MAX_CPUS, buf, size);
+}
+
+int placement_get_mem_policy(pid_t pid, char *buf, size_t size)
+{
+   char path[PATH_MAX];
+   char line[PLACEMENT_LIST_LEN];
+   ssize_t len;
+   const char *policy;
+   size_t policy_len;
+   int fd;
+
+   snprintf(path, sizeof(path), "/proc/%d/numa_maps", pid);
+   fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (fd == -1) {
+      return -1;
+   }
+   // Only policy of the first mapping is needed
+   len = read(fd, line, sizeof(line) - 1);
+   close(fd);
+   if (len <= 0) {
+      return -1;
+   }
+   line[len] = '\0';
+
+   // "ADDRESS POLICY file=..."
+   policy = strchr(line, ' ');
+   if (policy == NULL) {
+      return -1;
+   }
+   policy++;
+   policy_len = strcspn(policy, " \n");
+   if (policy_len == 0 || policy_len >= size) {
+      return -1;
+   }
+   memcpy(buf, policy, policy_len);
+   buf[policy_len] = '\0';
+
+   return 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file placement.h
+ * @brief Placement of instance processes on CPUs and NUMA nodes.
+ * @details CPU and node masks use kernel representation (array of unsigned long), so that
+ *  they are passed to sched_setaffinity and set_mempolicy syscalls as they are. Placement is
+ *  applied by spawned child right before execv, both affinity and memory policy are
+ *  inherited through it.
+ */
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define PLACEMENT_MAX_CPUS 1024 ///< Maximum number of CPUs in placement of instance
+#define PLACEMENT_MAX_NODES 1024 ///< Maximum number of NUMA nodes in placement of instance
+#define PLACEMENT_LONG_BITS (8 * sizeof(unsigned long)) ///< Bits of one word of mask
+#define PLACEMENT_LIST_LEN 256 ///< Size of buffer for formatted CPU or node list
+
+/**
+ * @brief CPUs and memory policy instance process is started with
+ * */
+typedef struct placement_s {
+   bool has_cpus; ///< Whether process is bound to cpus
+   bool has_mem_policy; ///< Whether mem_mode is set to process
+   int mem_mode; ///< Memory policy, MPOL_* from linux/mempolicy.h
+   unsigned long cpus[PLACEMENT_MAX_CPUS / PLACEMENT_LONG_BITS]; ///< Allowed CPUs
+   unsigned long mem_nodes[PLACEMENT_MAX_NODES / PLACEMENT_LONG_BITS]; ///< Nodes of mem_mode
+} placement_t;
+
+/**
+ * @brief Parses list of CPUs or nodes in format of cpuset, e.g. "0-3,8,10-11".
+ * @param list List to parse
+ * @param mask Mask of max_bits bits to set, it is cleared first
+ * @param max_bits Number of bits of mask
+ * @return -1 if list is malformed or contains number out of mask, 0 on success
+ * */
+extern int placement_parse_list(const char *list, unsigned long *mask, uint32_t max_bits);
+
+/**
+ * @brief Formats mask to list in format of cpuset, e.g. "0-3,8,10-11".
+ * @param mask Mask to format
+ * @param max_bits Number of bits of mask
+ * @param buf Buffer for the list
+ * @param size Size of buf
+ * @return -1 if list didn't fit into buf, 0 on success
+ * */
+extern int placement_format_list(const unsigned long *mask, uint32_t max_bits,
+                                 char *buf, size_t size);
+
+/**
+ * @brief Loads placement from configuration of instance.
+ * @param pl Placement to load
+ * @param cpus List of CPUs or NULL for no binding
+ * @param mem_policy One of default, bind, preferred, interleave, local or NULL to inherit
+ *  memory policy of supervisor
+ * @param mem_nodes List of nodes for bind, preferred and interleave policies
+ * @return -1 if configuration is invalid, 0 on success
+ * */
+extern int placement_load(placement_t *pl, const char *cpus, const char *mem_policy,
+                          const char *mem_nodes);
+
+/**
+ * @brief Applies placement to calling process.
+ * @details Meant for spawned child before execv, it doesn't allocate nor log.
+ * @param pl Placement to apply
+ * @return -1 on error with errno set, 0 on success
+ * */
+extern int placement_apply(const placement_t *pl);
+
+/**
+ * @brief Binds all threads of running process to given CPUs.
+ * @param pid Process
+ * @param cpus Mask of PLACEMENT_MAX_CPUS bits
+ * @return -1 on error, 0 on success
+ * */
+extern int placement_set_cpus(pid_t pid, const unsigned long *cpus);
+
+/**
+ * @brief Loads CPUs given process is allowed to run on.
+ * @param pid Process or 0 for calling thread
+ * @param cpus Mask of PLACEMENT_MAX_CPUS bits to load
+ * @return -1 on error, 0 on success
+ * */
+extern int placement_get_cpu_mask(pid_t pid, unsigned long *cpus);
+
+/**
+ * @brief Formats CPUs given process is allowed to run on.
+ * @param pid Process
+ * @param buf Buffer for CPU list
+ * @param size Size of buf
+ * @return -1 on error, 0 on success
+ * */
+extern int placement_get_cpus(pid_t pid, char *buf, size_t size);
+
+/**
+ * @brief Formats memory policy given process runs with, e.g. "bind:0" or "default".
+ * @details Policy is read from the first mapping of /proc/PID/numa_maps, i.e. mapping of
+ *  the executable, which uses policy of the process.
+ * @param pid Process
+ * @param buf Buffer for the policy
+ * @param size Size of buf
+ * @return -1 on error (e.g. kernel without NUMA), 0 on success
+ * */
+extern int placement_get_mem_policy(pid_t pid, char *buf, size_t size);
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * @file proc_stats.c
+ * @brief Implementation of functions defined in proc_stats.h
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include "proc_stats.h"
+
+/**
+ * @brief Scans unsigned decimal number preceded by spaces
+ * @param p Position to scan from, moved past the number
+ * @param end End of content
+ * @param val Scanned number
+ * @return -1 if there is no number, 0 on success
+ * */
+static inline int proc_scan_u64(const char **p, const char *end, uint64_t *val);
+
+/**
+ * @brief Skips given number of space separated fields
+ * @return -1 if content ended sooner, 0 on success
+ * */
+static inline int proc_skip_fields(const char **p, const char *end, uint32_t cnt);
+
+
+static inline int proc_scan_u64(const char **p, const char *end, uint64_t *val)
+{
+   const char *s = *p;
+   uint64_t num = 0;
+
+   while (s < end && *s == ' ') {
+      s++;
+   }
+   if (s == end || *s < '0' || *s > '9') {
+      return -1;
+   }
+   while (s < end && *s >= '0' && *s <= '9') {
+      num = num * 10 + (uint64_t) (*s - '0');
+      s++;
+   }
+
+   *p = s;
+   *val = num;
+   return 0;
+}
+
+static inline int proc_skip_fields(const char **p, const char *end, uint32_t cnt)
+{
+   const char *s = *p;
+
+   for (uint32_t i = 0; i < cnt; i++) {
+      while (s < end && *s == ' ') {
+         s++;
+      }
+      if (s == end) {
+         return -1;
+      }
+      while (s < end && *s != ' ') {
+         s++;
+      }
+   }
+
+   *p = s;
+   return 0;
+}
+
+ssize_t proc_pread(int fd, char *buf, size_t size)
+{
+   ssize_t len = pread(fd, buf, size - 1, 0);
+
+   if (len == -1) {
+      return -1;
+   }
+   buf[len] = '\0';
+   return len;
+}
+
+int proc_parse_pid_stat(const char *buf, size_t len, proc_pid_stat_t *st)
+{
+   const char *end = buf + len;
+   const char *p = NULL;
+
+   // Field 2 is "(comm)", comm itself can contain anything
+   for (const char *s = buf; s < end; s++) {
+      if (*s == ')') {
+         p = s + 1;
+      }
+   }
+   if (p == NULL) {
+      return -1;
+   }
+
+   // p is after field 2, fields 3 to 13 are skipped
+   if (proc_skip_fields(&p, end, 11) == -1
+       || proc_scan_u64(&p, end, &st->utime) == -1
+       || proc_scan_u64(&p, end, &st->stime) == -1
+       || proc_skip_fields(&p, end, 7) == -1
+       || proc_scan_u64(&p, end, &st->vsize) == -1) {
+      return -1;
+   }
+
+   return 0;
+}
+
+int proc_parse_statm_rss(const char *buf, size_t len, uint64_t *rss_pages)
+{
+   const char *end = buf + len;
+   const char *p = buf;
+   uint64_t size;
+
+   // "size resident shared text lib data dt" in pages
+   if (proc_scan_u64(&p, end, &size) == -1 || proc_scan_u64(&p, end, rss_pages) == -1) {
+      return -1;
+   }
+
+   return 0;
+}
+
+int proc_parse_total_cpu(const char *buf, size_t len, uint64_t *total)
+{
+   const char *end = buf + len;
+   const char *p = buf;
+   uint64_t num;
+   uint64_t sum = 0;
+
+   if (len < 4 || memcmp(buf, "cpu ", 4) != 0) {
+      return -1;
+   }
+   p += 4;
+
+   // Only the first line sums all CPUs
+   while (proc_scan_u64(&p, end, &num) == 0) {
+      sum += num;
+   }
+   if (p < end && *p != '\n') {
+      return -1;
+   }
+
+   *total = sum;
+   return 0;
+}
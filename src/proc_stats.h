@@ -0,0 +1,62 @@
+/**
+ * @file proc_stats.h
+ * @brief Non-allocating readers of /proc files used for resources sampling of instances. Files are read by pread from offset 0 through descriptors kept open, so sampling doesn't open, allocate or tokenize anything.
+ */
+
+#ifndef PROC_STATS_H
+#define PROC_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define PROC_READ_BUF_SIZE 1024 ///< Size of stack buffer /proc files are read into
+
+/**
+ * @brief Values of /proc/PID/stat used by supervisor
+ * */
+typedef struct proc_pid_stat_s {
+   uint64_t utime; ///< User mode time in clock ticks (field 14)
+   uint64_t stime; ///< Kernel mode time in clock ticks (field 15)
+   uint64_t vsize; ///< Virtual memory size in bytes (field 23)
+} proc_pid_stat_t;
+
+/**
+ * @brief Reads beginning of file from offset 0 and terminates it with zero.
+ * @param fd Descriptor of /proc file opened for reading
+ * @param buf Buffer to read into
+ * @param size Size of buf, at most size - 1 bytes are read
+ * @return Number of bytes read or -1 on error with errno set (ESRCH if process exited)
+ * */
+extern ssize_t proc_pread(int fd, char *buf, size_t size);
+
+/**
+ * @brief Parses content of /proc/PID/stat.
+ * @details Fields are counted from the last ')', so that name of process containing
+ *  spaces or parentheses doesn't shift them.
+ * @param buf Content of the file
+ * @param len Length of content
+ * @param st Parsed values
+ * @return -1 if content is malformed or truncated, 0 on success
+ * */
+extern int proc_parse_pid_stat(const char *buf, size_t len, proc_pid_stat_t *st);
+
+/**
+ * @brief Parses resident set size from content of /proc/PID/statm
+ * @param buf Content of the file
+ * @param len Length of content
+ * @param rss_pages Resident set size in pages
+ * @return -1 if content is malformed, 0 on success
+ * */
+extern int proc_parse_statm_rss(const char *buf, size_t len, uint64_t *rss_pages);
+
+/**
+ * @brief Parses total CPU time of system, i.e. sum of values of "cpu" line of /proc/stat
+ * @param buf Content of the file, only first line is needed
+ * @param len Length of content
+ * @param total Sum of all values of the line in clock ticks
+ * @return -1 if content is malformed, 0 on success
+ * */
+extern int proc_parse_total_cpu(const char *buf, size_t len, uint64_t *total);
+
+#endif
@@ -9,8 +9,10 @@
 #include "module.h"
 #include "conf.h"
 #include "inst_control.h"
+#include "evloop.h"
+#include "statsnap.h"
 
-#define RUN_CHE_STR(che) ((che)->type == RUN_CHE_T_INVAL ? "--" : ((che)->type == RUN_CHE_T_INST ? (che)->inst_name : (che)->mod_name))
+#define RUN_CHE_STR(che) ((che)->type == RUN_CHE_T_INVAL ? "--" : ((che)->type == RUN_CHE_T_INST ? (che)->inst_name : ((che)->type == RUN_CHE_T_INTERVALS ? "intervals" : ((che)->type == RUN_CHE_T_AUTO_PLACEMENT ? "auto-placement" : (che)->mod_name))))
 
 /**
  * @brief Defines type of action to take for changed node (module or group).
@@ -29,6 +31,8 @@ typedef enum run_change_type_e {
 
    RUN_CHE_T_INST, ///< E.g. ../instance[name='x']/enabled
    RUN_CHE_T_MOD, ///< E.g. ../available-module[name='y']/description
+   RUN_CHE_T_INTERVALS, ///< E.g. ../intervals/resources-sampling
+   RUN_CHE_T_AUTO_PLACEMENT, ///< E.g. ../auto-placement/enabled
 } run_change_type_t;
 
 /**
@@ -238,10 +242,16 @@ run_config_change_cb(sr_session_ctx_t *sess,
       goto err_cleanup;
    }
 
+   // Added instances are visible to stats callbacks right away
+   (void) stats_snap_publish();
+
    VERBOSE(V2, "Successfully leaving change callback")
    pthread_mutex_unlock(&config_lock);
    sr_free_change_iter(iter);
 
+   // Let supervisor_routine start changed instances without waiting for its timers
+   evloop_wakeup(&main_evloop);
+
    return SR_ERR_OK;
 
 err_cleanup:
@@ -268,6 +278,17 @@ err_cleanup:
 static inline int
 run_change_replace_same_registered(run_change_t *new, run_change_t *reg)
 {
+   if (new->type == RUN_CHE_T_INTERVALS && reg->type == RUN_CHE_T_INTERVALS) {
+      VERBOSE(V3, "New INTERVALS change is handled by already registered one")
+      run_change_free(&new);
+      return 0;
+   }
+   if (new->type == RUN_CHE_T_AUTO_PLACEMENT && reg->type == RUN_CHE_T_AUTO_PLACEMENT) {
+      VERBOSE(V3, "New AUTO-PLACEMENT change is handled by already registered one")
+      run_change_free(&new);
+      return 0;
+   }
+
    if (new->type == RUN_CHE_T_INST && reg->type == RUN_CHE_T_INST) {
       if (strcmp(new->inst_name, reg->inst_name) == 0) {
          if (new->node_name == NULL) {
@@ -360,7 +381,8 @@ static inline void run_change_add_new_change(vector_t *reg_chgs, run_change_t *n
 
 static inline void run_change_handle_modify(run_change_t *change)
 {
-   if (change->type == RUN_CHE_T_MOD) {
+   if (change->type == RUN_CHE_T_MOD || change->type == RUN_CHE_T_INTERVALS
+       || change->type == RUN_CHE_T_AUTO_PLACEMENT) {
       change->action = RUN_CHE_ACTION_RESTART;
    } else if (change->type == RUN_CHE_T_INST) {
       if (change->node_name != NULL && strcmp(change->node_name, "last-pid") == 0) {
@@ -391,12 +413,16 @@ static inline void run_change_handle_delete(run_change_t *change)
       } else {
          change->action = RUN_CHE_ACTION_DELETE;
       }
+   } else if (change->type == RUN_CHE_T_INTERVALS || change->type == RUN_CHE_T_AUTO_PLACEMENT) {
+      // Deleted intervals and auto-placement leaves fall back to their defaults
+      change->action = RUN_CHE_ACTION_RESTART;
    }
 }
 
 static inline void run_change_handle_create(run_change_t *change)
 {
-   if (change->type == RUN_CHE_T_MOD) {
+   if (change->type == RUN_CHE_T_MOD || change->type == RUN_CHE_T_INTERVALS
+       || change->type == RUN_CHE_T_AUTO_PLACEMENT) {
       change->action = RUN_CHE_ACTION_RESTART;
    } else if (change->type == RUN_CHE_T_INST) {
       if (change->node_name != NULL && strcmp(change->node_name, "last-pid") == 0) {
@@ -427,6 +453,16 @@ static inline int run_change_proc_restart(sr_session_ctx_t *sess, run_change_t *
          av_module_stop_remove_by_name(change->mod_name);
          rc = av_module_load_by_name(sess, change->mod_name);
          break;
+      case RUN_CHE_T_INTERVALS:
+         // Running instances are kept, supervisor_routine just re-arms its timers
+         VERBOSE(V3, "Action reload of intervals")
+         rc = intervals_load(sess);
+         break;
+      case RUN_CHE_T_AUTO_PLACEMENT:
+         // Running instances are moved by the next rebalancing if needed
+         VERBOSE(V3, "Action reload of auto-placement")
+         rc = autoplace_conf_load(sess);
+         break;
       default:
          break;
    }
@@ -559,6 +595,14 @@ run_change_load(sr_change_oper_t op, sr_val_t *old_val, sr_val_t *new_val)
             NO_MEM_ERR
             goto err_cleanup;
          }
+      } else if (strcmp(res, "intervals") == 0) {
+         change->type = RUN_CHE_T_INTERVALS;
+         sr_xpath_recover(&state);
+         return change;
+      } else if (strcmp(res, "auto-placement") == 0) {
+         change->type = RUN_CHE_T_AUTO_PLACEMENT;
+         sr_xpath_recover(&state);
+         return change;
       } else {
          change->type = RUN_CHE_T_INVAL;
          sr_xpath_recover(&state);
@@ -612,6 +656,10 @@ static char * run_change_type_str(run_change_type_t type)
          return "MODULE NODE";
       case RUN_CHE_T_INST:
          return "INSTANCE NODE";
+      case RUN_CHE_T_INTERVALS:
+         return "INTERVALS NODE";
+      case RUN_CHE_T_AUTO_PLACEMENT:
+         return "AUTO-PLACEMENT NODE";
       default: // NS_CHE_T_INVAL
          return "INVALID";
    }
@@ -4,169 +4,709 @@
  */
 #include <netdb.h>
 #include <sys/un.h>
+#include <sys/eventfd.h>
 #include <libtrap/trap.h>
 
 #include "service.h"
+#include "svc_json.h"
 #include "inst_control.h"
 
 /**
- * @brief Timeout period for communication with service interface UNIX socket
+ * @brief Request for statistics of one instance posted to collector thread
  * */
-#define SERVICE_WAIT_BEFORE_TIMEOUT 25000
+typedef struct svc_req_s {
+   pid_t pid; ///< PID of instance process
+   char *inst_name; ///< Name of instance
+   uint32_t in_cnt; ///< Number of IN interfaces of instance
+   uint32_t out_cnt; ///< Number of OUT interfaces of instance
+} svc_req_t;
 
+/**
+ * @brief Collector thread and queues used to communicate with it
+ * */
+typedef struct svc_collector_s {
+   pthread_t thread; ///< Collector thread
+   bool running; ///< Whether the thread was started
+   bool stop; ///< Tells the thread to finish, guarded by lock
+   pthread_mutex_t lock; ///< Guards stop, requests and results
+   vector_t requests; ///< Posted svc_req_t waiting for collector thread
+   vector_t results; ///< svc_result_t waiting to be published by main_evloop
+   evloop_t loop; ///< Event loop of collector thread
+   vector_t conns; ///< Connection table of svc_conn_t, accessed only by collector thread
+   int results_fd; ///< Eventfd signaling new results to main_evloop
+   ev_source_t *results_src; ///< results_fd registered inside main_evloop
+   uint64_t deadline; ///< Nearest deadline of exchanges in flight or 0 if there is none
+} svc_collector_t;
+
+svc_collector_t collector = {
+      .running = false,
+      .stop = false,
+      .lock = PTHREAD_MUTEX_INITIALIZER,
+      .requests = {.total = 0, .capacity = 0, .items = NULL},
+      .results = {.total = 0, .capacity = 0, .items = NULL},
+      .loop = {.epfd = -1, .wakeup_src = NULL, .lock = NULL, .woken_up = false},
+      .conns = {.total = 0, .capacity = 0, .items = NULL},
+      .results_fd = -1,
+      .results_src = NULL,
+      .deadline = 0,
+}; ///< Service interface collector
+
+
+/**
+ * @brief Routine of collector thread, dispatches its event loop until it's stopped.
+ * @param arg unused
+ * @return NULL
+ * */
+static void * collector_routine(void *arg);
+
+/**
+ * @brief Returns timeout of event loop of collector given by shared deadline
+ * @return Timeout in milliseconds or -1 if no exchange is in flight
+ * */
+static int collector_next_timeout();
+
+/**
+ * @brief Aborts exchanges which deadline passed and finds the nearest remaining deadline.
+ * */
+static void collector_expire_deadlines();
+
+/**
+ * @brief Takes posted requests and starts exchanges for them.
+ * @details All exchanges started by one batch of requests share a single deadline.
+ *  Connections that failed to connect are dropped from table once their
+ *  reconnect delay passes, so that table doesn't grow with exited processes.
+ * @return true if collector thread should finish
+ * */
+static bool collector_process_requests();
+
+/**
+ * @brief Connects to instance of given request if needed and starts request for stats.
+ * @param req Request to handle, its inst_name is taken by connection
+ * @param deadline Deadline of exchange
+ * */
+static void collector_handle_request(svc_req_t *req, uint64_t deadline);
+
+/**
+ * @brief Finds connection of given PID in connection table
+ * @param pid PID of instance process
+ * @return Pointer to connection or NULL if not found
+ * */
+static svc_conn_t * collector_conn_get(pid_t pid);
+
+/**
+ * @brief Closes connection, publishes that it was closed and removes it from table.
+ * @param conn Connection to remove
+ * */
+static void collector_conn_remove(svc_conn_t *conn);
 
+/**
+ * @brief Queues result for main_evloop and notifies it.
+ * @param res Result to publish, freed in case it can't be queued
+ * */
+static void collector_publish(svc_result_t *res);
 
 /**
- * @brief Types of service interface messages
+ * @brief Handler of results eventfd inside main_evloop, publishes results to instances.
+ * @details Called with config_lock held.
+ * @param events Epoll events
+ * @param priv unused
  * */
-typedef enum service_msg_header_type_e {
-   SERVICE_GET_COM = 10,
-   SERVICE_OK_REPLY = 12
-} service_msg_header_type_t;
+static void collector_results_handler(uint32_t events, void *priv);
 
 /**
- * @brief Service interface message header structure
+ * @brief Copies statistics of given result into interfaces of given instance.
+ * @param res Result to apply, ids of interfaces are taken from it
+ * @param inst Instance of the same PID as result
  * */
-typedef struct service_msg_header_s {
-   service_msg_header_type_t com; ///< Type of service interface message
-   uint32_t data_size; ///< Length of service interface message
-} service_msg_header_t;
+static void svc_result_apply(svc_result_t *res, inst_t *inst);
 
+/**
+ * @brief Allocates result with interface stats arrays of given sizes
+ * @param pid PID of instance process
+ * @param in_cnt Number of IN interfaces
+ * @param out_cnt Number of OUT interfaces
+ * @return Pointer to new result or NULL on error
+ * */
+static svc_result_t * svc_result_alloc(pid_t pid, uint32_t in_cnt, uint32_t out_cnt);
+
+/**
+ * @brief Frees given result including interface ids it still owns
+ * @param res Result to free
+ * */
+static void svc_result_free(svc_result_t *res);
 
 /**
- * @brief
- * @param
+ * @brief Frees connection, closes its socket if it's open
+ * @param conn Connection to free
+ * */
+static void svc_conn_free(svc_conn_t *conn);
+
+/**
+ * @brief Starts non-blocking connect to service interface of instance of given connection
+ * @param conn Connection in SVC_CONN_CLOSED state
+ * @return -1 on error, 0 on success or if connecting is in progress
+ * */
+static int svc_conn_connect(svc_conn_t *conn);
+
+/**
+ * @brief Closes socket of given connection and removes it from event loop of collector
+ * @param conn Connection to close
+ * */
+static void svc_conn_close(svc_conn_t *conn);
+
+/**
+ * @brief Closes connection that failed to connect, next attempt is postponed.
+ * @param conn Connection that failed to connect
+ * */
+static void svc_conn_connect_failed(svc_conn_t *conn);
+
+/**
+ * @brief Changes epoll events connection's socket is registered for if they differ.
+ * @param conn Connection with open socket
+ * @param events New epoll events
+ * @return -1 on error, 0 on success
+ * */
+static int svc_conn_watch(svc_conn_t *conn, uint32_t events);
+
+/**
+ * @brief Starts sending of request for stats and tries to send it right away.
+ * @param conn Connection in SVC_CONN_IDLE state
  * @return -1 on error, 0 on success
  * */
-static int recv_data(inst_t *inst, uint32_t size, void *data);
+static int svc_conn_start_request(svc_conn_t *conn);
 
 /**
- * @brief Loads statistics from given JSON string
- * @param data JSON string to load statistics from
- * @param inst Instance to load statistics into
+ * @brief Sends as much of request as socket accepts.
+ * @param conn Connection in SVC_CONN_SEND_REQ state
  * @return -1 on error, 0 on success
  * */
-static int load_stats_json(char *data, inst_t *inst);
+static int svc_conn_send(svc_conn_t *conn);
 
+/**
+ * @brief Receives as much of reply as is available, parses and publishes complete reply.
+ * @param conn Connection in SVC_CONN_RECV_HDR or SVC_CONN_RECV_BODY state
+ * @return -1 on error or if peer closed the socket, 0 on success
+ * */
+static int svc_conn_recv(svc_conn_t *conn);
+
+/**
+ * @brief Parses received body of reply and publishes its statistics.
+ * @param conn Connection with complete reply inside buf
+ * @return -1 on error, 0 on success
+ * */
+static int svc_conn_reply_done(svc_conn_t *conn);
+
+/**
+ * @brief Handler of service socket readiness inside event loop of collector.
+ * @details Advances state of exchange or removes connection on error or hang up.
+ * @param events Epoll events
+ * @param priv Connection the socket belongs to
+ * */
+static void svc_conn_handler(uint32_t events, void *priv);
+
+/**
+ * @brief Replaces borrowed interface ids of given result by own copies of changed ones.
+ * @details Ids equal to ones published last time are set to NULL, so that steady state
+ *  of connection doesn't allocate anything.
+ * @param conn Connection the result was parsed from
+ * @param res Result with ids pointing into buf of connection
+ * @return -1 if ids cache can't be allocated, 0 on success
+ * */
+static int svc_conn_take_ifc_ids(svc_conn_t *conn, svc_result_t *res);
+
+/**
+ * @brief Frees cached interface ids of given connection
+ * @param conn Connection to use
+ * */
+static void svc_conn_free_ifc_ids(svc_conn_t *conn);
 
-void disconnect_from_inst(inst_t *inst)
+
+int service_collector_start()
 {
-   if (inst->service_ifc_connected) {
-      VERBOSE(V3,"Disconnecting from inst '%s'", inst->name);
-      // Close if not closed already
-      if (inst->service_sd != -1) {
-         close(inst->service_sd);
-         inst->service_sd = -1;
+   if (collector.running) {
+      return 0;
+   }
+
+   collector.stop = false;
+   if (evloop_init(&collector.loop, NULL) != 0) {
+      VERBOSE(N_ERR, "Failed to initialize event loop of service collector")
+      return -1;
+   }
+
+   collector.results_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if (collector.results_fd == -1) {
+      VERBOSE(N_ERR, "Failed to create eventfd of service collector (errno=%d)", errno)
+      goto err_cleanup;
+   }
+   collector.results_src = evloop_add(&main_evloop, collector.results_fd, EPOLLIN,
+                                      collector_results_handler, NULL);
+   if (collector.results_src == NULL) {
+      close(collector.results_fd);
+      collector.results_fd = -1;
+      goto err_cleanup;
+   }
+   collector.results_src->owns_fd = true;
+
+   if (pthread_create(&collector.thread, NULL, collector_routine, NULL) != 0) {
+      VERBOSE(N_ERR, "Failed to start service collector thread")
+      goto err_cleanup;
+   }
+   collector.running = true;
+
+   return 0;
+
+err_cleanup:
+   evloop_del(&main_evloop, collector.results_src);
+   collector.results_src = NULL;
+   collector.results_fd = -1;
+   evloop_free(&collector.loop);
+   return -1;
+}
+
+void service_collector_stop()
+{
+   svc_req_t *req = NULL;
+
+   if (collector.running == false) {
+      return;
+   }
+
+   pthread_mutex_lock(&collector.lock);
+   collector.stop = true;
+   pthread_mutex_unlock(&collector.lock);
+   evloop_wakeup(&collector.loop);
+   pthread_join(collector.thread, NULL);
+   collector.running = false;
+
+   // Thread is gone, its connection table can be released from here
+   for (uint32_t i = 0; i < collector.conns.total; i++) {
+      svc_conn_free(collector.conns.items[i]);
+   }
+   vector_free(&collector.conns);
+   collector.deadline = 0;
+   evloop_free(&collector.loop);
+
+   for (uint32_t i = 0; i < collector.requests.total; i++) {
+      req = collector.requests.items[i];
+      NULLP_TEST_AND_FREE(req->inst_name)
+      NULLP_TEST_AND_FREE(req)
+   }
+   vector_free(&collector.requests);
+   for (uint32_t i = 0; i < collector.results.total; i++) {
+      svc_result_free(collector.results.items[i]);
+   }
+   vector_free(&collector.results);
+
+   pthread_mutex_lock(&config_lock);
+   evloop_del(&main_evloop, collector.results_src);
+   collector.results_src = NULL;
+   collector.results_fd = -1;
+   pthread_mutex_unlock(&config_lock);
+}
+
+int service_collector_poll(const inst_t *inst)
+{
+   svc_req_t *req = NULL;
+
+   if (collector.running == false) {
+      return -1;
+   }
+
+   req = (svc_req_t *) calloc(1, sizeof(svc_req_t));
+   IF_NO_MEM_INT_ERR(req)
+   req->inst_name = strdup(inst->name);
+   if (req->inst_name == NULL) {
+      NO_MEM_ERR
+      NULLP_TEST_AND_FREE(req)
+      return -1;
+   }
+   req->pid = INST_PID(inst);
+   req->in_cnt = inst->in_ifces.total;
+   req->out_cnt = inst->out_ifces.total;
+
+   pthread_mutex_lock(&collector.lock);
+   if (vector_add(&collector.requests, req) != 0) {
+      pthread_mutex_unlock(&collector.lock);
+      NULLP_TEST_AND_FREE(req->inst_name)
+      NULLP_TEST_AND_FREE(req)
+      return -1;
+   }
+   pthread_mutex_unlock(&collector.lock);
+   evloop_wakeup(&collector.loop);
+
+   return 0;
+}
+
+static void * collector_routine(void *arg)
+{
+   bool stop = false;
+
+   VERBOSE(V3, "Service collector thread started")
+   while (stop == false) {
+      if (evloop_run_once(&collector.loop, collector_next_timeout()) == -1) {
+         break;
+      }
+      if (collector.deadline != 0 && get_mono_time_ms() >= collector.deadline) {
+         collector_expire_deadlines();
+      }
+      if (collector.loop.woken_up) {
+         collector.loop.woken_up = false;
+         stop = collector_process_requests();
       }
-      inst->service_ifc_connected = false;
    }
-   inst->service_ifc_conn_timer = 0;
+   VERBOSE(V3, "Service collector thread finished")
+
+   return NULL;
 }
 
-int recv_ifc_stats(inst_t *inst)
+static int collector_next_timeout()
 {
-   char *buffer = NULL;
-   int rc;
-   uint32_t buffer_size = 0;
-   service_msg_header_t resp_header;
-   resp_header.com = SERVICE_GET_COM;
-   resp_header.data_size = 0;
+   uint64_t now;
 
-   // Check whether the inst is running and is connected with supervisor via service interface
-   if (false == inst->running || false == inst->service_ifc_connected) {
+   if (collector.deadline == 0) {
       return -1;
    }
+   now = get_mono_time_ms();
 
-   VERBOSE(V3, "Receiving reply from inst '%s'", inst->name)
-   // Receive reply header
-   rc = recv_data(inst, sizeof(service_msg_header_t), (void *) &resp_header);
-   if (rc == -1) {
-      VERBOSE(N_ERR, "Error while receiving reply header from inst '%s'.",
-              inst->name)
-      goto err_cleanup;
+   return collector.deadline <= now ? 0 : (int) (collector.deadline - now);
+}
+
+static void collector_expire_deadlines()
+{
+   svc_conn_t *conn = NULL;
+   uint64_t now = get_mono_time_ms();
+   uint64_t next = 0;
+
+   // Backwards since connections can get removed
+   for (uint32_t i = collector.conns.total; i > 0; i--) {
+      conn = collector.conns.items[i - 1];
+      if (conn->state == SVC_CONN_CLOSED || conn->state == SVC_CONN_IDLE) {
+         continue;
+      }
+      if (conn->deadline > now) {
+         if (next == 0 || conn->deadline < next) {
+            next = conn->deadline;
+         }
+         continue;
+      }
+
+      if (conn->state == SVC_CONN_CONNECTING) {
+         VERBOSE(N_ERR, "Timeout while connecting to inst '%s'", conn->inst_name)
+         svc_conn_connect_failed(conn);
+      } else {
+         VERBOSE(N_ERR, "Timeout while communicating with inst '%s'", conn->inst_name)
+         collector_conn_remove(conn);
+      }
    }
 
-   // Check if the reply is OK
-   if (resp_header.com != SERVICE_OK_REPLY) {
-      VERBOSE(N_ERR, "Wrong reply from inst '%s'.", inst->name)
-      goto err_cleanup;
+   collector.deadline = next;
+}
+
+static bool collector_process_requests()
+{
+   bool stop;
+   vector_t reqs;
+   svc_conn_t *conn = NULL;
+   uint64_t now = get_mono_time_ms();
+   uint64_t deadline = now + SERVICE_REPLY_TIMEOUT_MS;
+
+   pthread_mutex_lock(&collector.lock);
+   stop = collector.stop;
+   reqs = collector.requests;
+   memset(&collector.requests, 0, sizeof(collector.requests));
+   pthread_mutex_unlock(&collector.lock);
+
+   for (uint32_t i = 0; i < reqs.total; i++) {
+      if (stop == false) {
+         collector_handle_request(reqs.items[i], deadline);
+      } else {
+         NULLP_TEST_AND_FREE(((svc_req_t *) reqs.items[i])->inst_name)
+      }
+      NULLP_TEST_AND_FREE(reqs.items[i])
    }
+   vector_free(&reqs);
 
-   if (resp_header.data_size > buffer_size) {
-      // Reallocate buffer for incoming data
-      buffer_size += (resp_header.data_size - buffer_size) + 1;
-      buffer = (char *) calloc(1, buffer_size * sizeof(char));
+   // Earlier deadline of previous batch is kept
+   if (collector.deadline == 0) {
+      collector.deadline = deadline;
    }
 
-   VERBOSE(V3, "Receiving stats from inst '%s'", inst->name)
-   // Receive inst stats in json format
-   if (recv_data(inst, resp_header.data_size, (void *) buffer) == -1) {
-      VERBOSE(N_ERR, "Error while receiving stats from inst %s.", inst->name)
-      goto err_cleanup;
+   for (uint32_t i = 0; i < collector.conns.total; i++) {
+      conn = collector.conns.items[i];
+      if (conn->state == SVC_CONN_CLOSED && conn->retry_at <= now) {
+         svc_conn_free(conn);
+         vector_delete(&collector.conns, i);
+         i--;
+      }
    }
 
-   // Decode json and save stats into inst structure
-   VERBOSE(V3, "Received JSON: %s", buffer)
-   if (load_stats_json(buffer, inst) == -1) {
-      VERBOSE(N_ERR, "Error while receiving stats from inst '%s'.", inst->name);
-      goto err_cleanup;
+   return stop;
+}
+
+static void collector_handle_request(svc_req_t *req, uint64_t deadline)
+{
+   svc_conn_t *conn = collector_conn_get(req->pid);
+
+   if (conn != NULL && strcmp(conn->inst_name, req->inst_name) != 0) {
+      // PID got reused by process of other instance
+      collector_conn_remove(conn);
+      conn = NULL;
    }
 
-   NULLP_TEST_AND_FREE(buffer)
+   if (conn == NULL) {
+      conn = (svc_conn_t *) calloc(1, sizeof(svc_conn_t));
+      if (conn == NULL) {
+         NO_MEM_ERR
+         NULLP_TEST_AND_FREE(req->inst_name)
+         return;
+      }
+      conn->pid = req->pid;
+      conn->sd = -1;
+      conn->src = NULL;
+      conn->state = SVC_CONN_CLOSED;
+      conn->buf = NULL;
+      conn->buf_size = 0;
+      conn->ifc_ids = NULL;
+      conn->ifc_ids_cnt = 0;
+      conn->retry_at = 0;
+      if (vector_add(&collector.conns, conn) != 0) {
+         NULLP_TEST_AND_FREE(conn)
+         NULLP_TEST_AND_FREE(req->inst_name)
+         return;
+      }
+      conn->inst_name = req->inst_name;
+   } else {
+      NULLP_TEST_AND_FREE(req->inst_name)
+   }
+   req->inst_name = NULL;
+   conn->in_cnt = req->in_cnt;
+   conn->out_cnt = req->out_cnt;
 
-   return 0;
+   switch (conn->state) {
+      case SVC_CONN_CLOSED:
+         if (get_mono_time_ms() < conn->retry_at) {
+            return;
+         }
+         VERBOSE(V3, "Trying to connect to inst '%s'", conn->inst_name)
+         conn->deadline = deadline;
+         conn->req_queued = true;
+         if (svc_conn_connect(conn) == -1) {
+            svc_conn_connect_failed(conn);
+         }
+         return;
+      case SVC_CONN_IDLE:
+         VERBOSE(V3, "Sending request for stats of instance '%s'", conn->inst_name)
+         conn->deadline = deadline;
+         if (svc_conn_start_request(conn) == -1) {
+            VERBOSE(N_ERR, "Error while sending request to instance '%s'", conn->inst_name)
+            collector_conn_remove(conn);
+         }
+         return;
+      default:
+         // Previous exchange is still in flight, its deadline is kept
+         conn->req_queued = (conn->state == SVC_CONN_CONNECTING);
+         return;
+   }
+}
+
+static svc_conn_t * collector_conn_get(pid_t pid)
+{
+   svc_conn_t *conn = NULL;
+
+   for (uint32_t i = 0; i < collector.conns.total; i++) {
+      conn = collector.conns.items[i];
+      if (conn->pid == pid) {
+         return conn;
+      }
+   }
+
+   return NULL;
+}
+
+static void collector_conn_remove(svc_conn_t *conn)
+{
+   svc_result_t *res = NULL;
+
+   for (uint32_t i = 0; i < collector.conns.total; i++) {
+      if (collector.conns.items[i] == conn) {
+         vector_delete(&collector.conns, i);
+         break;
+      }
+   }
+
+   if (conn->state != SVC_CONN_CLOSED && conn->state != SVC_CONN_CONNECTING) {
+      VERBOSE(V3, "Disconnecting from inst '%s'", conn->inst_name)
+      res = svc_result_alloc(conn->pid, 0, 0);
+      if (res != NULL) {
+         res->connected = false;
+         collector_publish(res);
+      }
+   }
+   svc_conn_free(conn);
+}
+
+static void collector_publish(svc_result_t *res)
+{
+   uint64_t one = 1;
+   int rc;
+
+   pthread_mutex_lock(&collector.lock);
+   rc = vector_add(&collector.results, res);
+   pthread_mutex_unlock(&collector.lock);
+   if (rc != 0) {
+      svc_result_free(res);
+      return;
+   }
+
+   if (write(collector.results_fd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+      VERBOSE(V2, "Failed to notify about service stats (errno=%d)", errno)
+   }
+}
+
+static void collector_results_handler(uint32_t events, void *priv)
+{
+   uint64_t cnt;
+   vector_t results;
+   svc_result_t *res = NULL;
+   inst_t *inst = NULL;
+
+   // Eventfd counter is reset by read, EAGAIN means it was already drained
+   (void) read(collector.results_fd, &cnt, sizeof(cnt));
+
+   pthread_mutex_lock(&collector.lock);
+   results = collector.results;
+   memset(&collector.results, 0, sizeof(collector.results));
+   pthread_mutex_unlock(&collector.lock);
+
+   for (uint32_t i = 0; i < results.total; i++) {
+      res = results.items[i];
+      inst = inst_get_by_pid(res->pid);
+      // Instance might have been removed or restarted in the meantime
+      if (inst != NULL && INST_RUNNING(inst)) {
+         svc_result_apply(res, inst);
+      }
+      svc_result_free(res);
+   }
+   vector_free(&results);
+}
+
+static void svc_result_apply(svc_result_t *res, inst_t *inst)
+{
+   interface_t *ifc = NULL;
+   ifc_in_stats_t *in_stats = NULL;
+   ifc_out_stats_t *out_stats = NULL;
+
+#define TAKE_IFC_ID(stats, res_stats) do { \
+   if ((res_stats)->id != NULL \
+       && ((stats)->id == NULL || strcmp((stats)->id, (res_stats)->id) != 0)) { \
+      NULLP_TEST_AND_FREE((stats)->id) \
+      (stats)->id = (res_stats)->id; \
+      (res_stats)->id = NULL; \
+   } \
+} while (0);
+
+   if (res->connected == false) {
+      inst_service_disconnected(inst);
+      return;
+   }
+
+   if (res->in_cnt != inst->in_ifces.total || res->out_cnt != inst->out_ifces.total) {
+      // Configuration of interfaces changed after the request was posted
+      VERBOSE(V2, "Dropping stats of inst '%s', its interfaces changed", inst->name)
+      return;
+   }
+
+   for (uint32_t i = 0; i < res->in_cnt; i++) {
+      ifc = inst->in_ifces.items[i];
+      in_stats = ifc->stats;
+      in_stats->recv_msg_cnt = res->in_stats[i].recv_msg_cnt;
+      in_stats->recv_buff_cnt = res->in_stats[i].recv_buff_cnt;
+      in_stats->type = res->in_stats[i].type;
+      in_stats->state = res->in_stats[i].state;
+      TAKE_IFC_ID(in_stats, &res->in_stats[i])
+   }
+
+   for (uint32_t i = 0; i < res->out_cnt; i++) {
+      ifc = inst->out_ifces.items[i];
+      out_stats = ifc->stats;
+      out_stats->sent_msg_cnt = res->out_stats[i].sent_msg_cnt;
+      out_stats->dropped_msg_cnt = res->out_stats[i].dropped_msg_cnt;
+      out_stats->sent_buff_cnt = res->out_stats[i].sent_buff_cnt;
+      out_stats->autoflush_cnt = res->out_stats[i].autoflush_cnt;
+      out_stats->num_clients = res->out_stats[i].num_clients;
+      out_stats->type = res->out_stats[i].type;
+      TAKE_IFC_ID(out_stats, &res->out_stats[i])
+   }
+
+   inst->service_ifc_connected = true;
+}
+
+static svc_result_t * svc_result_alloc(pid_t pid, uint32_t in_cnt, uint32_t out_cnt)
+{
+   svc_result_t *res = (svc_result_t *) calloc(1, sizeof(svc_result_t));
+   IF_NO_MEM_NULL_ERR(res)
+
+   res->pid = pid;
+   res->connected = true;
+   res->in_cnt = in_cnt;
+   res->out_cnt = out_cnt;
+   if (in_cnt > 0) {
+      res->in_stats = (ifc_in_stats_t *) calloc(in_cnt, sizeof(ifc_in_stats_t));
+      if (res->in_stats == NULL) {
+         goto err_cleanup;
+      }
+   }
+   if (out_cnt > 0) {
+      res->out_stats = (ifc_out_stats_t *) calloc(out_cnt, sizeof(ifc_out_stats_t));
+      if (res->out_stats == NULL) {
+         goto err_cleanup;
+      }
+   }
+
+   return res;
 
 err_cleanup:
-   disconnect_from_inst(inst);
-   NULLP_TEST_AND_FREE(buffer)
-   return -1;
+   NO_MEM_ERR
+   svc_result_free(res);
+   return NULL;
 }
 
-int send_ifc_stats_request(const inst_t *inst)
+static void svc_result_free(svc_result_t *res)
 {
-   service_msg_header_t req_header;
-   req_header.com = SERVICE_GET_COM;
-   req_header.data_size = 0;
-
-   ssize_t sent = 0;
-   uint32_t req_size = sizeof(req_header);
-   uint32_t num_of_timeouts = 0;
-   uint32_t total_sent = 0;
-
-   while (total_sent < req_size) {
-      sent = send(inst->service_sd, (void *) (&req_header + total_sent),
-                  req_size - total_sent, MSG_DONTWAIT);
-      if (-1 == sent) {
-         if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            num_of_timeouts++;
-            if (num_of_timeouts >= 3) {
-               VERBOSE(N_ERR, "Timeouted while sending to inst '%s'!", inst->name);
-               return -1;
-            } else {
-               usleep(SERVICE_WAIT_BEFORE_TIMEOUT);
-               continue;
-            }
-         }
-         VERBOSE(N_ERR, "Error while sending to inst '%s'!", inst->name);
-         return -1;
+   if (res->in_stats != NULL) {
+      for (uint32_t i = 0; i < res->in_cnt; i++) {
+         NULLP_TEST_AND_FREE(res->in_stats[i].id)
       }
-      total_sent += sent;
+      NULLP_TEST_AND_FREE(res->in_stats)
    }
-   return 0;
+   if (res->out_stats != NULL) {
+      for (uint32_t i = 0; i < res->out_cnt; i++) {
+         NULLP_TEST_AND_FREE(res->out_stats[i].id)
+      }
+      NULLP_TEST_AND_FREE(res->out_stats)
+   }
+   NULLP_TEST_AND_FREE(res)
+}
 
+static void svc_conn_free(svc_conn_t *conn)
+{
+   svc_conn_close(conn);
+   svc_conn_free_ifc_ids(conn);
+   NULLP_TEST_AND_FREE(conn->buf)
+   NULLP_TEST_AND_FREE(conn->inst_name)
+   NULLP_TEST_AND_FREE(conn)
 }
 
-void connect_to_inst(inst_t *inst)
+static int svc_conn_connect(svc_conn_t *conn)
 {
    /* sock_name size is length of "service_PID" where PID is
     *  max 5 chars (8 + 5 + 1 zero terminating) */
    char sock_name[14];
    int sockfd;
-   //tcpip_socket_addr_t addr;
    struct sockaddr_un unix_sa;
 
    memset(sock_name, 0, 14 * sizeof(char));
-   sprintf(sock_name, "service_%d", inst->pid);
+   sprintf(sock_name, "service_%d", conn->pid);
 
    memset(&unix_sa, 0, sizeof(unix_sa));
 
@@ -176,229 +716,339 @@ void connect_to_inst(inst_t *inst)
             trap_default_socket_path_format,
             sock_name);
 
-   VERBOSE(V3, "Instance '%s' has socket %s", inst->name, unix_sa.sun_path)
+   VERBOSE(V3, "Instance '%s' has socket %s", conn->inst_name, unix_sa.sun_path)
 
-   sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+   sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
    if (sockfd == -1) {
       VERBOSE(N_ERR,"Error while opening socket for connection with inst %s.",
-              inst->name)
-      inst->service_ifc_connected = false;
-      return;
+              conn->inst_name)
+      return -1;
+   }
+   conn->src = evloop_add(&collector.loop, sockfd, EPOLLOUT | EPOLLRDHUP,
+                          svc_conn_handler, conn);
+   if (conn->src == NULL) {
+      VERBOSE(N_ERR, "Failed to watch service socket of inst '%s'", conn->inst_name)
+      close(sockfd);
+      return -1;
    }
+   conn->src->owns_fd = true;
+   conn->sd = sockfd;
+   conn->events = EPOLLOUT | EPOLLRDHUP;
+   conn->state = SVC_CONN_CONNECTING;
+
    if (connect(sockfd, (struct sockaddr *) &unix_sa, sizeof(unix_sa)) == -1) {
+      // Full backlog of UNIX socket is reported as EAGAIN
+      if (errno == EINPROGRESS || errno == EAGAIN) {
+         return 0;
+      }
       VERBOSE(N_ERR,
               "Error while connecting to inst '%s' with socket '%s'",
-              inst->name,
+              conn->inst_name,
               unix_sa.sun_path)
+      return -1;
+   }
 
-      inst->service_ifc_connected = false;
-      close(sockfd);
-      return;
+   // Connected right away, writability is reported by the loop anyway
+   return 0;
+}
+
+static void svc_conn_close(svc_conn_t *conn)
+{
+   // Source owns the socket
+   evloop_del(&collector.loop, conn->src);
+   conn->src = NULL;
+   conn->sd = -1;
+   conn->events = 0;
+   conn->state = SVC_CONN_CLOSED;
+   conn->req_queued = false;
+   conn->io_done = 0;
+}
+
+static void svc_conn_connect_failed(svc_conn_t *conn)
+{
+   svc_conn_close(conn);
+   conn->retry_at = get_mono_time_ms() + SERVICE_RECONNECT_DELAY_MS;
+}
+
+static int svc_conn_watch(svc_conn_t *conn, uint32_t events)
+{
+   if (conn->events == events) {
+      return 0;
    }
-   inst->service_sd = sockfd;
-   inst->service_ifc_connected = true;
-   inst->service_ifc_conn_timer = 0; // Successfully connected, reset connection timer
-   VERBOSE(V3,"Connected to inst '%s'.", inst->name);
+   if (evloop_mod(&collector.loop, conn->src, events) == -1) {
+      return -1;
+   }
+   conn->events = events;
+
+   return 0;
 }
 
-static int load_stats_json(char *data, inst_t *inst)
+static int svc_conn_start_request(svc_conn_t *conn)
 {
-   size_t arr_idx = 0;
-
-   json_error_t error;
-   json_t *json_struct = NULL;
-   json_t *ifces_arr = NULL;
-   json_t *in_ifc_cnts  = NULL;
-   json_t *out_ifc_cnts = NULL;
-   json_t *value = NULL;
-
-   uint32_t ifc_cnt = 0;
-   const char *str = NULL;
-
-   interface_t *ifc;
-   ifc_in_stats_t *in_stats;
-   ifc_out_stats_t *out_stats;
-
-#define FETCH_VALUE_OR_ERR(json_object, key) do { \
-   value = json_object_get((json_object), (key)) ;\
-   if ((key) == NULL) { \
-      VERBOSE(N_ERR, "Could not get JSON key '%s' on line %d", (key), __LINE__) \
-      goto err_cleanup; \
-   } \
-} while (0);
+   conn->req_queued = false;
+   conn->state = SVC_CONN_SEND_REQ;
+   conn->io_done = 0;
 
-#define IS_JSON_OBJ_OR_ERR(json_object) do { \
-   if (json_is_object((json_object)) == 0) { \
-      VERBOSE(N_ERR, "Loaded value is not JSON object on line %d", __LINE__) \
-      goto err_cleanup; \
-   } \
-} while (0);
+   return svc_conn_send(conn);
+}
 
-#define IS_JSON_ARR_OR_ERR(json_object) do { \
-   if (json_is_array((json_object)) == 0) { \
-      VERBOSE(N_ERR, "Loaded value is not JSON array on line %d", __LINE__) \
-      goto err_cleanup; \
-   } \
-} while (0);
+static int svc_conn_send(svc_conn_t *conn)
+{
+   static const service_msg_header_t req_header = {
+         .com = SERVICE_GET_COM,
+         .data_size = 0,
+   };
+   ssize_t sent;
 
-#define FETCH_IFC_ID_OR_ERR(json_object, stats) do { \
-   FETCH_VALUE_OR_ERR((json_object), "ifc_id") \
-   str = json_string_value(value); \
-   if (str == NULL) { \
-      VERBOSE(N_ERR, "Could not get JSON string value of 'id_ifc' on line %d", \
-              __LINE__) \
-      goto err_cleanup; \
-   } \
-   if ((stats)->id == NULL) { \
-      (stats)->id = strdup(str); \
-      if ((stats)->id == NULL) { \
-         NO_MEM_ERR \
-         goto err_cleanup; \
-      } \
-   } else if (strcmp((stats)->id, str) != 0) { \
-      NULLP_TEST_AND_FREE((stats)->id) \
-      (stats)->id = strdup(str); \
-      if ((stats)->id == NULL) { \
-         NO_MEM_ERR \
-         goto err_cleanup; \
-      } \
-   } \
-} while (0); \
+   while (conn->io_done < sizeof(req_header)) {
+      sent = send(conn->sd, (const char *) &req_header + conn->io_done,
+                  sizeof(req_header) - conn->io_done, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (sent == -1) {
+         if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // Rest is sent once the socket becomes writable
+            return svc_conn_watch(conn, EPOLLOUT | EPOLLRDHUP);
+         }
+         VERBOSE(N_ERR, "Error while sending to inst '%s'! (errno=%d)", conn->inst_name, errno)
+         return -1;
+      }
+      conn->io_done += (uint32_t) sent;
+   }
+
+   conn->state = SVC_CONN_RECV_HDR;
+   conn->io_done = 0;
+
+   return svc_conn_watch(conn, EPOLLIN | EPOLLRDHUP);
+}
+
+static int svc_conn_recv(svc_conn_t *conn)
+{
+   ssize_t received;
+   char *dst;
+   uint32_t size;
+
+   while (conn->state == SVC_CONN_RECV_HDR || conn->state == SVC_CONN_RECV_BODY) {
+      if (conn->state == SVC_CONN_RECV_HDR) {
+         dst = (char *) &conn->hdr;
+         size = sizeof(conn->hdr);
+      } else {
+         dst = conn->buf;
+         size = conn->hdr.data_size;
+      }
 
-   // Parse received instances counters in json format
-   json_struct = json_loads(data , 0, &error);
-   if (json_struct == NULL) {
-      VERBOSE(N_ERR, "Could not convert instances stats to json structure on "
-                     "line %d: %s", error.line, error.text);
+      if (conn->io_done < size) {
+         received = recv(conn->sd, dst + conn->io_done, size - conn->io_done, MSG_DONTWAIT);
+         if (received == 0) {
+            VERBOSE(V3, "Instance '%s' closed its service socket", conn->inst_name)
+            return -1;
+         } else if (received == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+               // Rest of reply arrives later
+               return 0;
+            }
+            VERBOSE(N_ERR, "Error while receiving from inst '%s'! (errno=%d)",
+                    conn->inst_name, errno)
+            return -1;
+         }
+         conn->io_done += (uint32_t) received;
+         continue;
+      }
+
+      // Current part of reply is complete
+      conn->io_done = 0;
+      if (conn->state == SVC_CONN_RECV_HDR) {
+         if (conn->hdr.com != SERVICE_OK_REPLY) {
+            VERBOSE(N_ERR, "Wrong reply from inst '%s'.", conn->inst_name)
+            return -1;
+         }
+         // Size comes from the peer, it mustn't overflow nor allocate arbitrary amount
+         if (conn->hdr.data_size > SERVICE_REPLY_MAX_SIZE) {
+            VERBOSE(N_ERR, "Reply of inst '%s' is too long (%u bytes).", conn->inst_name,
+                    conn->hdr.data_size)
+            return -1;
+         }
+         if (conn->hdr.data_size + 1 > conn->buf_size) {
+            char *buf = (char *) realloc(conn->buf, conn->hdr.data_size + 1);
+            IF_NO_MEM_INT_ERR(buf)
+            conn->buf = buf;
+            conn->buf_size = conn->hdr.data_size + 1;
+         }
+         conn->state = SVC_CONN_RECV_BODY;
+      } else {
+         conn->buf[conn->hdr.data_size] = '\0';
+         conn->state = SVC_CONN_IDLE;
+         return svc_conn_reply_done(conn);
+      }
+   }
+
+   return 0;
+}
+
+static int svc_conn_reply_done(svc_conn_t *conn)
+{
+   svc_json_stats_t parsed;
+   svc_result_t *res = svc_result_alloc(conn->pid, conn->in_cnt, conn->out_cnt);
+   if (res == NULL) {
       return -1;
    }
-   IS_JSON_OBJ_OR_ERR(json_struct)
 
-   // Check number of input interfaces the inst is running with
-   FETCH_VALUE_OR_ERR(json_struct, "in_cnt")
-   ifc_cnt = (uint32_t) json_integer_value(value);
+   VERBOSE(V3, "Received JSON: %s", conn->buf)
+   parsed.in_stats = res->in_stats;
+   parsed.in_cap = res->in_cnt;
+   parsed.out_stats = res->out_stats;
+   parsed.out_cap = res->out_cnt;
+   if (svc_json_parse(conn->buf, conn->hdr.data_size, &parsed) == -1) {
+      VERBOSE(N_ERR, "Could not parse stats received from inst '%s'.", conn->inst_name)
+      goto err_cleanup;
+   }
 
-   if (ifc_cnt != inst->in_ifces.total) {
+   if (parsed.in_cnt != conn->in_cnt) {
       /* This could mean that Supervisor has different configuration
        *  than the inst is running with. */
       VERBOSE(N_ERR, "Instance '%s' has different number of IN interfaces (%d)"
                      " than configuration from supervisor (%d).",
-              inst->name, ifc_cnt, inst->in_ifces.total)
+              conn->inst_name, parsed.in_cnt, conn->in_cnt)
       goto err_cleanup;
    }
-
-   // Check number of output interfaces the inst is running with
-   FETCH_VALUE_OR_ERR(json_struct, "out_cnt")
-   ifc_cnt = (uint32_t) json_integer_value(value);
-
-   if (ifc_cnt != inst->out_ifces.total) {
-      /* This could mean that Supervisor has different configuration
-       *  than the inst is running with. */
+   if (parsed.out_cnt != conn->out_cnt) {
       VERBOSE(N_ERR, "Instance '%s' has different number of OUT interfaces (%d)"
                      " than configuration from supervisor (%d).",
-              inst->name, ifc_cnt, inst->out_ifces.total)
+              conn->inst_name, parsed.out_cnt, conn->out_cnt)
       goto err_cleanup;
    }
 
-   if (inst->in_ifces.total > 0) {
-      /* Get value from the key "in" from json root elem (it should be an array
-       *  of json objects - every object contains counters of one input interface) */
-      FETCH_VALUE_OR_ERR(json_struct, "in")
-      ifces_arr = value;
-      IS_JSON_ARR_OR_ERR(ifces_arr)
+   if (svc_conn_take_ifc_ids(conn, res) == -1) {
+      goto err_cleanup;
+   }
+   collector_publish(res);
 
-      json_array_foreach(ifces_arr, arr_idx, in_ifc_cnts) {
-         ifc = inst->in_ifces.items[arr_idx];
-         if (ifc == NULL || (arr_idx + 1) > inst->in_ifces.total) {
-            VERBOSE(N_ERR, "Instance stats specify more IN interfaces than supervisor"
-                           " configured")
-            goto err_cleanup;
-         }
-         IS_JSON_OBJ_OR_ERR(in_ifc_cnts)
-         in_stats = ifc->stats;
-         FETCH_VALUE_OR_ERR(in_ifc_cnts, "messages")
-         in_stats->recv_msg_cnt = (uint64_t) json_integer_value(value);
-         FETCH_VALUE_OR_ERR(in_ifc_cnts, "buffers")
-         in_stats->recv_buff_cnt = (uint64_t) json_integer_value(value);
-         FETCH_VALUE_OR_ERR(in_ifc_cnts, "ifc_type")
-         in_stats->type = (char) json_integer_value(value);
-         FETCH_VALUE_OR_ERR(in_ifc_cnts, "ifc_state")
-         in_stats->state = (uint8_t) json_integer_value(value);
-         FETCH_IFC_ID_OR_ERR(in_ifc_cnts, in_stats)
+   return 0;
+
+err_cleanup:
+   // Ids still point into buf of connection
+   for (uint32_t i = 0; i < res->in_cnt; i++) {
+      res->in_stats[i].id = NULL;
+   }
+   for (uint32_t i = 0; i < res->out_cnt; i++) {
+      res->out_stats[i].id = NULL;
+   }
+   svc_result_free(res);
+   return -1;
+}
+
+static int svc_conn_take_ifc_ids(svc_conn_t *conn, svc_result_t *res)
+{
+   uint32_t cnt = res->in_cnt + res->out_cnt;
+   char **id = NULL;
+   char **cached = NULL;
+
+   if (conn->ifc_ids_cnt != cnt) {
+      svc_conn_free_ifc_ids(conn);
+      if (cnt > 0) {
+         conn->ifc_ids = (char **) calloc(cnt, sizeof(char *));
+         IF_NO_MEM_INT_ERR(conn->ifc_ids)
+         conn->ifc_ids_cnt = cnt;
       }
    }
 
+   for (uint32_t i = 0; i < cnt; i++) {
+      if (i < res->in_cnt) {
+         id = &res->in_stats[i].id;
+      } else {
+         id = &res->out_stats[i - res->in_cnt].id;
+      }
+      cached = &conn->ifc_ids[i];
 
-   if (inst->out_ifces.total > 0) {
-      /* Get value from the key "out" from json root elem (it should be an array
-       *  of json objects - every object contains counters of one output interface) */
-      FETCH_VALUE_OR_ERR(json_struct, "out")
-      ifces_arr = value;
-      IS_JSON_ARR_OR_ERR(ifces_arr)
+      if (*id == NULL || (*cached != NULL && strcmp(*cached, *id) == 0)) {
+         *id = NULL;
+         continue;
+      }
 
-      json_array_foreach(ifces_arr, arr_idx, out_ifc_cnts) {
-         ifc = inst->out_ifces.items[arr_idx];
-         if (ifc == NULL || (arr_idx + 1) > inst->out_ifces.total) {
-            VERBOSE(N_ERR, "Instance stats specify more OUT interfaces than supervisor"
-                           " configured")
-            goto err_cleanup;
-         }
-         IS_JSON_OBJ_OR_ERR(out_ifc_cnts)
-         out_stats = ifc->stats;
-         FETCH_VALUE_OR_ERR(out_ifc_cnts, "sent-messages")
-         out_stats->sent_msg_cnt = (uint64_t) json_integer_value(value);
-         FETCH_VALUE_OR_ERR(out_ifc_cnts, "dropped-messages")
-         out_stats->dropped_msg_cnt = (uint64_t) json_integer_value(value);
-         FETCH_VALUE_OR_ERR(out_ifc_cnts, "buffers")
-         out_stats->sent_buff_cnt = (uint64_t) json_integer_value(value);
-         FETCH_VALUE_OR_ERR(out_ifc_cnts, "autoflushes")
-         out_stats->autoflush_cnt = (uint64_t) json_integer_value(value);
-         FETCH_VALUE_OR_ERR(out_ifc_cnts, "num_clients")
-         out_stats->num_clients = (uint32_t) json_integer_value(value);
-         FETCH_VALUE_OR_ERR(out_ifc_cnts, "type")
-         out_stats->type = (char) json_integer_value(value);
-         FETCH_IFC_ID_OR_ERR(out_ifc_cnts, out_stats)
+      NULLP_TEST_AND_FREE(*cached)
+      *cached = strdup(*id);
+      *id = (*cached == NULL ? NULL : strdup(*cached));
+      if (*id == NULL) {
+         // Id is sent again with next reply
+         NO_MEM_ERR
+         NULLP_TEST_AND_FREE(*cached)
       }
    }
 
-   json_decref(json_struct);
    return 0;
+}
 
-err_cleanup:
-   if (json_struct != NULL) {
-      json_decref(json_struct);
+static void svc_conn_free_ifc_ids(svc_conn_t *conn)
+{
+   if (conn->ifc_ids == NULL) {
+      return;
    }
-   return -1;
+   for (uint32_t i = 0; i < conn->ifc_ids_cnt; i++) {
+      NULLP_TEST_AND_FREE(conn->ifc_ids[i])
+   }
+   NULLP_TEST_AND_FREE(conn->ifc_ids)
+   conn->ifc_ids_cnt = 0;
 }
 
-static int recv_data(inst_t *inst, uint32_t size, void *data)
+static void svc_conn_handler(uint32_t events, void *priv)
 {
-   int num_of_timeouts = 0;
-   int total_received = 0;
-   int last_received = 0;
-
-   while (total_received < size) {
-      last_received = (int) recv(inst->service_sd, data + total_received,
-                                 size - total_received, MSG_DONTWAIT);
-      if (last_received == 0) {
-         VERBOSE(V3, "Instance service thread closed its socket, everything received!")
-         return -1;
-      } else if (last_received == -1) {
-         if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            num_of_timeouts++;
-            if (num_of_timeouts >= 3) {
-               VERBOSE(N_ERR, "Timeout while receiving from inst '%s'!", inst->name)
-               return -1;
-            } else {
-               usleep(SERVICE_WAIT_BEFORE_TIMEOUT);
-               continue;
+   svc_conn_t *conn = priv;
+   int err = 0;
+   socklen_t err_len = sizeof(err);
+
+   switch (conn->state) {
+      case SVC_CONN_CONNECTING:
+         if ((events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) == 0) {
+            return;
+         }
+         if (getsockopt(conn->sd, SOL_SOCKET, SO_ERROR, &err, &err_len) == -1 || err != 0) {
+            VERBOSE(N_ERR, "Error while connecting to inst '%s' (errno=%d)",
+                    conn->inst_name, err)
+            svc_conn_connect_failed(conn);
+            return;
+         }
+         VERBOSE(V3,"Connected to inst '%s'.", conn->inst_name);
+         conn->state = SVC_CONN_IDLE;
+         if (conn->req_queued == false) {
+            if (svc_conn_watch(conn, EPOLLIN | EPOLLRDHUP) == -1) {
+               collector_conn_remove(conn);
             }
+            return;
          }
-         VERBOSE(N_ERR, "Error while receiving from inst '%s'! (errno=%d)",
-                 inst->name, errno)
-         return -1;
-      }
-      total_received += last_received;
+         if (svc_conn_start_request(conn) == -1) {
+            collector_conn_remove(conn);
+         }
+         return;
+
+      case SVC_CONN_SEND_REQ:
+         if ((events & EPOLLOUT) && svc_conn_send(conn) == -1) {
+            collector_conn_remove(conn);
+            return;
+         }
+         break;
+
+      case SVC_CONN_RECV_HDR:
+      case SVC_CONN_RECV_BODY:
+         // Reply might be pending even if instance closed the socket afterwards
+         if ((events & EPOLLIN) && svc_conn_recv(conn) == -1) {
+            collector_conn_remove(conn);
+            return;
+         }
+         break;
+
+      case SVC_CONN_IDLE:
+         if (events & EPOLLIN) {
+            VERBOSE(N_ERR, "Unexpected data from service interface of inst '%s'",
+                    conn->inst_name)
+            collector_conn_remove(conn);
+            return;
+         }
+         break;
+
+      default:
+         return;
    }
-   return 0;
-}
\ No newline at end of file
+
+   if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+      VERBOSE(V3, "Service socket of inst '%s' was closed", conn->inst_name)
+      collector_conn_remove(conn);
+   }
+}
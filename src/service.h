@@ -1,37 +1,106 @@
 /**
  * @file service.h
  * @brief This module provides functions for handling connections to libtrap's service interface of individual instances and gathering statistics via this interface.
+ * @details Service interface I/O is done by collector thread which works on its own
+ *  connection table, so that neither supervisor_routine nor sysrepo callbacks ever wait
+ *  on socket of a module. Requests are posted to the collector under config_lock and
+ *  received statistics are published back to instances by a handler running inside
+ *  main_evloop.
  */
 
 #ifndef SERVICE_H
 #define SERVICE_H
 #include "module.h"
 
+#define SERVICE_RECONNECT_DELAY_MS 45000 ///< Delay in milliseconds before next attempt to connect after failed one
+#define SERVICE_REPLY_TIMEOUT_MS 500 ///< Deadline shared by all exchanges started by one poll round
+#define SERVICE_REPLY_MAX_SIZE (1024 * 1024) ///< Longer replies are rejected, stats of all interfaces fit easily
+
 /**
- * @brief Sends request to receive statistics from instance's service interface
- * @return -1 on error, 0 on success
+ * @brief Types of service interface messages
+ * */
+typedef enum service_msg_header_type_e {
+   SERVICE_GET_COM = 10,
+   SERVICE_OK_REPLY = 12
+} service_msg_header_type_t;
+
+/**
+ * @brief Service interface message header structure
+ * */
+typedef struct service_msg_header_s {
+   service_msg_header_type_t com; ///< Type of service interface message
+   uint32_t data_size; ///< Length of service interface message
+} service_msg_header_t;
+
+/**
+ * @brief State of non-blocking exchange with service interface of one instance.
  * */
-extern int send_ifc_stats_request(const inst_t *inst);
+typedef enum svc_conn_state_e {
+   SVC_CONN_CLOSED, ///< Not connected
+   SVC_CONN_CONNECTING, ///< Non-blocking connect is in progress
+   SVC_CONN_IDLE, ///< Connected, no request is in flight
+   SVC_CONN_SEND_REQ, ///< Sending request header
+   SVC_CONN_RECV_HDR, ///< Receiving reply header
+   SVC_CONN_RECV_BODY, ///< Receiving JSON body of reply
+} svc_conn_state_t;
 
 /**
- * @brief Receives statistics from instance's service interface. This works after calling send_ifc_stats_request
- * @param inst Instance to receive statistics for
+ * @brief Connection to service interface of one instance process, owned by collector thread.
+ * @details Connection never blocks, it advances its state whenever its socket is ready.
+ *  Exchange that doesn't finish until its deadline is aborted.
+ * */
+typedef struct svc_conn_s {
+   pid_t pid; ///< PID of instance process, key of connection table
+   char *inst_name; ///< Name of instance, used for logging
+   uint32_t in_cnt; ///< Number of IN interfaces instance is configured with
+   uint32_t out_cnt; ///< Number of OUT interfaces instance is configured with
+   int sd; ///< Socket descriptor or -1 if not connected
+   ev_source_t *src; ///< Socket registered in event loop of collector or NULL
+   uint32_t events; ///< Epoll events src is registered for
+   svc_conn_state_t state; ///< State of exchange
+   bool req_queued; ///< Request is sent once connecting finishes
+   uint64_t deadline; ///< Monotonic time in ms until which current exchange has to finish
+   uint32_t io_done; ///< Bytes of current message already sent or received
+   service_msg_header_t hdr; ///< Received reply header
+   char *buf; ///< Reusable buffer for body of reply
+   uint32_t buf_size; ///< Allocated size of buf
+   char **ifc_ids; ///< Last published ids of IN and then OUT interfaces, ids are sent only when they change
+   uint32_t ifc_ids_cnt; ///< Number of items of ifc_ids
+   uint64_t retry_at; ///< Monotonic time in ms before which connecting is not attempted
+} svc_conn_t;
+
+/**
+ * @brief Statistics received by collector thread, published to instance of given PID.
+ * */
+typedef struct svc_result_s {
+   pid_t pid; ///< PID of instance process
+   bool connected; ///< False in case connection got closed, no stats are present then
+   uint32_t in_cnt; ///< Number of items of in_stats
+   uint32_t out_cnt; ///< Number of items of out_stats
+   ifc_in_stats_t *in_stats; ///< Statistics of IN interfaces
+   ifc_out_stats_t *out_stats; ///< Statistics of OUT interfaces
+} svc_result_t;
+
+/**
+ * @brief Starts collector thread and registers handler of its results inside main_evloop.
+ * @details main_evloop has to be initialized.
  * @return -1 on error, 0 on success
  * */
-extern int recv_ifc_stats(inst_t *inst);
+extern int service_collector_start();
 
 /**
- * @brief Connect to service interface of given instance
- * @details Success is idicated by instance having service_ifc_connected=true, service_sd != -1 and service_ifc_conn_timer resetted
- * @param inst Instance to which supervisor connects
+ * @brief Stops collector thread, closes all its connections and drops pending results.
+ * @details Has to be called without config_lock held. Does nothing if collector is not running.
  * */
-extern void connect_to_inst(inst_t *inst);
+extern void service_collector_stop();
 
 /**
- * @brief Disconnect from service interface of given instance
- * @details Success is indicated by instance having service_ifc_connected=true, service_ifc=-1
- * @param inst Instance from which supervisor disconnects
+ * @brief Asks collector thread to request statistics from service interface of given instance.
+ * @details Connection is established first if needed. Failed attempts to connect are
+ *  not repeated sooner than after SERVICE_RECONNECT_DELAY_MS. Never blocks on socket.
+ * @param inst Running instance to poll
+ * @return -1 on error, 0 on success
  * */
-extern void disconnect_from_inst(inst_t *inst);
+extern int service_collector_poll(const inst_t *inst);
 
-#endif
\ No newline at end of file
+#endif
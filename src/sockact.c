@@ -0,0 +1,321 @@
+/**
+ * @file sockact.c
+ * @brief Implementation of functions defined in sockact.h
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <libtrap/trap.h>
+#include "sockact.h"
+
+vector_t sockacts_v = {.total = 0, .capacity = 0, .items = NULL};
+
+
+/**
+ * @brief Checks whether given interface is endpoint of given socket
+ * @param sa Listening socket
+ * @param ifc Supported interface
+ * @return true if the interface listens on the socket
+ * */
+static bool sockact_matches(const sockact_t *sa, const interface_t *ifc);
+
+/**
+ * @brief Checks whether some enabled instance other than given one with socket activation
+ *  has OUT interface listening on given socket
+ * @param sa Listening socket
+ * @param inst Instance to skip
+ * @return true if socket is still wanted
+ * */
+static bool sockact_wanted(const sockact_t *sa, const inst_t *inst);
+
+/**
+ * @brief Creates listening socket of given interface and adds it to sockacts_v
+ * @param ifc Supported interface
+ * @return Created socket or NULL on error
+ * */
+static sockact_t * sockact_open(const interface_t *ifc);
+
+/**
+ * @brief Creates listening UNIX socket at libtrap path of given socket name, stale socket
+ *  file is replaced.
+ * @param socket_name Socket name of UNIX interface
+ * @return Descriptor or -1 on error
+ * */
+static int sockact_listen_unix(const char *socket_name);
+
+/**
+ * @brief Creates listening TCP socket on given port of all addresses, IPv4 ones included
+ * @param port Port of TCP interface
+ * @return Descriptor or -1 on error
+ * */
+static int sockact_listen_tcp(uint16_t port);
+
+/**
+ * @brief Closes socket, frees it and removes it from sockacts_v
+ * @param index Index of the socket in sockacts_v
+ * @param unlink_file Whether to remove socket file of UNIX socket
+ * */
+static void sockact_close(uint32_t index, bool unlink_file);
+
+
+bool sockact_ifc_supported(const interface_t *ifc)
+{
+   if (ifc->direction != NS_IF_DIR_OUT) {
+      return false;
+   }
+   if (ifc->type == NS_IF_TYPE_UNIX) {
+      return (ifc->specific_params.nix != NULL
+              && ifc->specific_params.nix->socket_name != NULL);
+   }
+
+   return (ifc->type == NS_IF_TYPE_TCP && ifc->specific_params.tcp != NULL);
+}
+
+static bool sockact_matches(const sockact_t *sa, const interface_t *ifc)
+{
+   if (sa->type != ifc->type) {
+      return false;
+   }
+   if (sa->type == NS_IF_TYPE_UNIX) {
+      return (strcmp(sa->socket_name, ifc->specific_params.nix->socket_name) == 0);
+   }
+
+   return (sa->port == ifc->specific_params.tcp->port);
+}
+
+sockact_t * sockact_find(const interface_t *ifc)
+{
+   sockact_t *sa;
+
+   if (sockact_ifc_supported(ifc) == false) {
+      return NULL;
+   }
+   for (uint32_t i = 0; i < sockacts_v.total; i++) {
+      sa = sockacts_v.items[i];
+      if (sockact_matches(sa, ifc)) {
+         return sa;
+      }
+   }
+
+   return NULL;
+}
+
+static int sockact_listen_unix(const char *socket_name)
+{
+   struct sockaddr_un addr;
+   int fd;
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   if (snprintf(addr.sun_path, sizeof(addr.sun_path), trap_default_socket_path_format,
+                socket_name) >= (int) sizeof(addr.sun_path)) {
+      VERBOSE(N_ERR, "Path of UNIX socket '%s' is too long", socket_name)
+      return -1;
+   }
+
+   fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (fd == -1) {
+      VERBOSE(N_ERR, "Failed to create UNIX socket '%s' (errno=%d)", socket_name, errno)
+      return -1;
+   }
+   // Left behind by process that created it itself or by previous supervisor
+   unlink(addr.sun_path);
+   if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1
+       || listen(fd, SOMAXCONN) == -1) {
+      VERBOSE(N_ERR, "Failed to listen on %s (errno=%d)", addr.sun_path, errno)
+      close(fd);
+      return -1;
+   }
+
+   return fd;
+}
+
+static int sockact_listen_tcp(uint16_t port)
+{
+   struct sockaddr_in6 addr6;
+   struct sockaddr_in addr4;
+   int on = 1;
+   int off = 0;
+   int fd;
+
+   memset(&addr6, 0, sizeof(addr6));
+   addr6.sin6_family = AF_INET6;
+   addr6.sin6_addr = in6addr_any;
+   addr6.sin6_port = htons(port);
+
+   // Dual-stack socket accepts IPv4 clients too, plain IPv4 is used without IPv6 support
+   fd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (fd != -1) {
+      setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      if (bind(fd, (struct sockaddr *) &addr6, sizeof(addr6)) == 0
+          && listen(fd, SOMAXCONN) == 0) {
+         return fd;
+      }
+      if (errno != EAFNOSUPPORT && errno != EADDRNOTAVAIL) {
+         VERBOSE(N_ERR, "Failed to listen on TCP port %u (errno=%d)", port, errno)
+         close(fd);
+         return -1;
+      }
+      close(fd);
+   }
+
+   memset(&addr4, 0, sizeof(addr4));
+   addr4.sin_family = AF_INET;
+   addr4.sin_addr.s_addr = htonl(INADDR_ANY);
+   addr4.sin_port = htons(port);
+
+   fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (fd == -1) {
+      VERBOSE(N_ERR, "Failed to create TCP socket (errno=%d)", errno)
+      return -1;
+   }
+   setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+   if (bind(fd, (struct sockaddr *) &addr4, sizeof(addr4)) == -1
+       || listen(fd, SOMAXCONN) == -1) {
+      VERBOSE(N_ERR, "Failed to listen on TCP port %u (errno=%d)", port, errno)
+      close(fd);
+      return -1;
+   }
+
+   return fd;
+}
+
+static sockact_t * sockact_open(const interface_t *ifc)
+{
+   sockact_t *sa = calloc(1, sizeof(sockact_t));
+   IF_NO_MEM_NULL_ERR(sa)
+
+   sa->type = ifc->type;
+   if (sa->type == NS_IF_TYPE_UNIX) {
+      sa->socket_name = strdup(ifc->specific_params.nix->socket_name);
+      if (sa->socket_name == NULL) {
+         NO_MEM_ERR
+         goto err_cleanup;
+      }
+      sa->fd = sockact_listen_unix(sa->socket_name);
+   } else {
+      sa->port = ifc->specific_params.tcp->port;
+      sa->fd = sockact_listen_tcp(sa->port);
+   }
+   if (sa->fd == -1) {
+      goto err_cleanup;
+   }
+
+   if (vector_add(&sockacts_v, sa) != 0) {
+      NO_MEM_ERR
+      close(sa->fd);
+      goto err_cleanup;
+   }
+
+   return sa;
+
+err_cleanup:
+   NULLP_TEST_AND_FREE(sa->socket_name)
+   NULLP_TEST_AND_FREE(sa)
+
+   return NULL;
+}
+
+int sockact_inst_prepare(inst_t *inst, int *fds, strbuf_t *names)
+{
+   interface_t *ifc;
+   sockact_t *sa;
+   int cnt = 0;
+
+   for (uint32_t i = 0; i < inst->out_ifces.total; i++) {
+      ifc = inst->out_ifces.items[i];
+      if (sockact_ifc_supported(ifc) == false) {
+         continue;
+      }
+
+      sa = sockact_find(ifc);
+      if (sa == NULL) {
+         sa = sockact_open(ifc);
+         if (sa == NULL) {
+            return -1;
+         }
+         VERBOSE(V2, "Listening on OUT interface '%s' of '%s' on its behalf", ifc->name,
+                 inst->name)
+      }
+
+      // Names tell module which descriptor belongs to which interface
+      if ((cnt > 0 && strbuf_append_char(names, ':') != 0)
+          || (sa->type == NS_IF_TYPE_UNIX ? strbuf_append(names, sa->socket_name)
+                                          : strbuf_append_uint(names, sa->port)) != 0) {
+         return -1;
+      }
+      fds[cnt++] = sa->fd;
+   }
+
+   return cnt;
+}
+
+static bool sockact_wanted(const sockact_t *sa, const inst_t *inst)
+{
+   inst_t *other;
+   interface_t *ifc;
+
+   for (uint32_t i = 0; i < insts_v.total; i++) {
+      other = insts_v.items[i];
+      if (other == inst || INST_ENABLED(other) == false || other->socket_activation == false) {
+         continue;
+      }
+      for (uint32_t j = 0; j < other->out_ifces.total; j++) {
+         ifc = other->out_ifces.items[j];
+         if (sockact_ifc_supported(ifc) && sockact_matches(sa, ifc)) {
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+static void sockact_close(uint32_t index, bool unlink_file)
+{
+   sockact_t *sa = sockacts_v.items[index];
+   char path[PATH_MAX];
+
+   close(sa->fd);
+   if (unlink_file && sa->type == NS_IF_TYPE_UNIX) {
+      snprintf(path, sizeof(path), trap_default_socket_path_format, sa->socket_name);
+      unlink(path);
+   }
+   vector_delete(&sockacts_v, index);
+   NULLP_TEST_AND_FREE(sa->socket_name)
+   NULLP_TEST_AND_FREE(sa)
+}
+
+void sockact_inst_release(const inst_t *inst)
+{
+   interface_t *ifc;
+   sockact_t *sa;
+
+   for (uint32_t i = 0; i < inst->out_ifces.total; i++) {
+      ifc = inst->out_ifces.items[i];
+      for (uint32_t j = 0; j < sockacts_v.total; j++) {
+         sa = sockacts_v.items[j];
+         if (sockact_ifc_supported(ifc) == false || sockact_matches(sa, ifc) == false) {
+            continue;
+         }
+         // E.g. replacement of the instance with new configuration takes the socket over
+         if (sockact_wanted(sa, inst)) {
+            break;
+         }
+         VERBOSE(V2, "Closing listening socket of OUT interface '%s' of '%s'", ifc->name,
+                 inst->name)
+         sockact_close(j, true);
+         break;
+      }
+   }
+}
+
+void sockacts_close()
+{
+   while (sockacts_v.total > 0) {
+      sockact_close(sockacts_v.total - 1, false);
+   }
+   vector_free(&sockacts_v);
+}
@@ -0,0 +1,71 @@
+/**
+ * @file sockact.h
+ * @brief Listening sockets of OUT interfaces owned by supervisor (socket activation).
+ * @details For instance with socket activation enabled, supervisor creates listening
+ *  sockets of its UNIX and TCP OUT interfaces before the process is spawned and passes them
+ *  to it as descriptors 3, 4, ... with LISTEN_FDS, LISTEN_PID and LISTEN_FDNAMES (socket
+ *  name of UNIX interface or port of TCP interface) in its environment, see spawn.h.
+ *  The module accepts connections on the inherited sockets instead of creating its own.
+ *
+ *  Sockets are kept by supervisor while the instance restarts, also when the instance is
+ *  replaced by new configuration with the same interface, so consumers connecting
+ *  meanwhile wait in the backlog of the socket instead of failing and backing off.
+ *  Socket is closed (and UNIX socket file removed) only once no enabled instance
+ *  with socket activation has such OUT interface.
+ */
+
+#ifndef SOCKACT_H
+#define SOCKACT_H
+
+#include "module.h"
+
+/**
+ * @brief Listening socket of one OUT interface endpoint
+ * */
+typedef struct sockact_s {
+   interface_type_t type; ///< NS_IF_TYPE_UNIX or NS_IF_TYPE_TCP
+   uint16_t port; ///< Port of TCP socket
+   char *socket_name; ///< Name of UNIX socket
+   int fd; ///< Listening socket
+} sockact_t;
+
+extern vector_t sockacts_v; ///< Listening sockets owned by supervisor
+
+/**
+ * @brief Checks whether listening socket of given interface can be created by supervisor.
+ * @param ifc Interface to check
+ * @return true for UNIX and TCP OUT interfaces
+ * */
+extern bool sockact_ifc_supported(const interface_t *ifc);
+
+/**
+ * @brief Finds listening socket owned by supervisor for given interface.
+ * @param ifc Interface
+ * @return Found socket or NULL
+ * */
+extern sockact_t * sockact_find(const interface_t *ifc);
+
+/**
+ * @brief Gets listening sockets of all supported OUT interfaces of instance, the missing
+ *  ones are created.
+ * @param inst Instance to be started
+ * @param fds Array of at least inst->out_ifces.total descriptors to fill
+ * @param names Buffer LISTEN_FDNAMES value is appended to
+ * @return Number of filled descriptors or -1 on error
+ * */
+extern int sockact_inst_prepare(inst_t *inst, int *fds, strbuf_t *names);
+
+/**
+ * @brief Closes listening sockets of instance that no other enabled instance with socket
+ *  activation uses.
+ * @param inst Instance which process is gone
+ * */
+extern void sockact_inst_release(const inst_t *inst);
+
+/**
+ * @brief Closes all listening sockets at exit of supervisor. UNIX socket files are kept
+ *  since instances left running still listen on them.
+ * */
+extern void sockacts_close();
+
+#endif
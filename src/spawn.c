@@ -0,0 +1,297 @@
+/**
+ * @file spawn.c
+ * @brief Implementation of functions defined in spawn.h
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "spawn.h"
+
+static char *spawn_stack = NULL; ///< Stack of child, mapped by the first spawn_process
+
+extern char **environ;
+
+
+/**
+ * @brief Entry point of cloned child, runs in memory of supervisor until execv.
+ * @details Only async-signal-safe functions can be called, supervisor is suspended in
+ *  the middle of clone and its locks might be held.
+ * @param arg Pointer to spawn_args_t
+ * @return Never returns
+ * */
+static int spawn_child(void *arg);
+
+/**
+ * @brief Redirects descriptor to given descriptor or file
+ * @param fd Descriptor duplicated to target_fd or -1 to open path
+ * @param path File opened in append mode
+ * @param perm Permissions of the file if it is created
+ * @param target_fd Descriptor replaced by the file
+ * */
+static void spawn_redirect(int fd, const char *path, mode_t perm, int target_fd);
+
+/**
+ * @brief Closes all descriptors starting at given one
+ * @param first_fd Lowest descriptor to close
+ * @param max_fd Highest descriptor to close if close_range syscall isn't available
+ * */
+static void spawn_close_fds(int first_fd, int max_fd);
+
+/**
+ * @brief Allocates environment of child with LISTEN_* variables and buffers used by child
+ *  to pass listening sockets, it is the environment of supervisor without its own LISTEN_*.
+ * @param args Arguments with listen_fds, envp, listen_pid and listen_tmp_fds are set
+ * @return -1 on error, 0 on success
+ * */
+static int spawn_env_build(spawn_args_t *args);
+
+/**
+ * @brief Moves listen_fds to descriptors 3, 4, ... and fills LISTEN_PID in envp
+ * @param args Arguments of child
+ * @return -1 on error, 0 on success
+ * */
+static int spawn_pass_listen_fds(spawn_args_t *args);
+
+/**
+ * @brief Resets handled signals to default disposition, ignored ones stay ignored.
+ * @details Handlers of supervisor must not run in child between unblocking of signals and
+ *  execv, they would work with memory of supervisor.
+ * */
+static void spawn_reset_signals();
+
+
+static void spawn_redirect(int fd, const char *path, mode_t perm, int target_fd)
+{
+   // dup2 clears close-on-exec flag of the target
+   if (fd != -1) {
+      dup2(fd, target_fd);
+      return;
+   }
+   if (path == NULL) {
+      return;
+   }
+   fd = open(path, O_RDWR | O_CREAT | O_APPEND, perm);
+   if (fd == -1) {
+      return;
+   }
+   if (fd != target_fd) {
+      dup2(fd, target_fd);
+      close(fd);
+   }
+}
+
+static void spawn_close_fds(int first_fd, int max_fd)
+{
+#ifdef SYS_close_range
+   if (syscall(SYS_close_range, (unsigned int) first_fd, ~0U, 0U) == 0) {
+      return;
+   }
+#endif
+   // Kernel older than 5.9
+   for (int fd = first_fd; fd <= max_fd; fd++) {
+      close(fd);
+   }
+}
+
+static int spawn_env_build(spawn_args_t *args)
+{
+   size_t env_cnt = 0;
+   size_t names_len = (args->listen_fdnames != NULL ? strlen(args->listen_fdnames) : 0);
+   size_t size;
+   char *str;
+   char **envp;
+   size_t e = 0;
+
+   for (char **env = environ; *env != NULL; env++) {
+      env_cnt++;
+   }
+
+   // Pointers, moved descriptors and three variables in one block
+   size = (env_cnt + 4) * sizeof(char *) + args->listen_fds_cnt * sizeof(int)
+          + 2 * 32 + sizeof("LISTEN_FDNAMES=") + names_len;
+   envp = malloc(size);
+   if (envp == NULL) {
+      return -1;
+   }
+   args->listen_tmp_fds = (int *) (envp + env_cnt + 4);
+   str = (char *) (args->listen_tmp_fds + args->listen_fds_cnt);
+
+   for (char **env = environ; *env != NULL; env++) {
+      if (strncmp(*env, "LISTEN_", 7) != 0) {
+         envp[e++] = *env;
+      }
+   }
+
+   envp[e++] = str;
+   str += sprintf(str, "LISTEN_FDS=%u", args->listen_fds_cnt) + 1;
+   // Digits are written by child once its PID is known
+   envp[e++] = str;
+   str += sprintf(str, "LISTEN_PID=%010d", 0) + 1;
+   args->listen_pid = str - 11;
+   if (args->listen_fdnames != NULL) {
+      envp[e++] = str;
+      sprintf(str, "LISTEN_FDNAMES=%s", args->listen_fdnames);
+   }
+   envp[e] = NULL;
+   args->envp = envp;
+
+   return 0;
+}
+
+static int spawn_pass_listen_fds(spawn_args_t *args)
+{
+   int first_free = 3 + (int) args->listen_fds_cnt;
+   pid_t pid = getpid();
+   char digits[10];
+   int pos = sizeof(digits);
+
+   // Sockets are moved above the target range first, dup2 mustn't overwrite any of them
+   for (uint32_t i = 0; i < args->listen_fds_cnt; i++) {
+      args->listen_tmp_fds[i] = fcntl(args->listen_fds[i], F_DUPFD_CLOEXEC, first_free);
+      if (args->listen_tmp_fds[i] == -1) {
+         return -1;
+      }
+   }
+   // dup2 clears close-on-exec flag of the target
+   for (uint32_t i = 0; i < args->listen_fds_cnt; i++) {
+      if (dup2(args->listen_tmp_fds[i], 3 + (int) i) == -1) {
+         return -1;
+      }
+   }
+
+   // sprintf is not async-signal-safe, digits are written from the end and moved to place
+   do {
+      digits[--pos] = (char) ('0' + pid % 10);
+      pid /= 10;
+   } while (pid > 0);
+   for (int d = 0; pos < (int) sizeof(digits); d++, pos++) {
+      args->listen_pid[d] = digits[pos];
+      args->listen_pid[d + 1] = '\0';
+   }
+
+   return 0;
+}
+
+static void spawn_reset_signals()
+{
+   struct sigaction act;
+
+   for (int sig = 1; sig < NSIG; sig++) {
+      // Fails for SIGKILL, SIGSTOP and signals reserved by libc, that's fine
+      if (sigaction(sig, NULL, &act) == -1
+          || act.sa_handler == SIG_DFL || act.sa_handler == SIG_IGN) {
+         continue;
+      }
+      act.sa_handler = SIG_DFL;
+      act.sa_flags = 0;
+      sigaction(sig, &act, NULL);
+   }
+}
+
+static int spawn_child(void *arg)
+{
+   spawn_args_t *args = (spawn_args_t *) arg;
+   sigset_t no_signals;
+
+   spawn_redirect(args->stdout_fd, args->stdout_path, args->log_perm, STDOUT_FILENO);
+   spawn_redirect(args->stderr_fd, args->stderr_path, args->log_perm, STDERR_FILENO);
+
+   /*
+    * Important for sending SIGINT to supervisor.
+    * */
+   setsid();
+
+   // Before exec, so that all processes module forks are accounted to its leaf.
+   // "0" stands for the writing process
+   if (args->cgroup_procs_fd != -1 && write(args->cgroup_procs_fd, "0", 1) != 1) {
+      args->cgroup_errno = errno;
+   }
+   // Affinity and memory policy are kept through execv
+   if (args->pl != NULL && placement_apply(args->pl) == -1) {
+      args->placement_errno = errno;
+   }
+
+   if (args->listen_fds_cnt > 0 && spawn_pass_listen_fds(args) == -1) {
+      args->listen_errno = errno;
+   }
+
+   // Descriptors of supervisor (sysrepo, sockets, epoll, cgroup leaves...) mustn't leak
+   spawn_close_fds(3 + (int) args->listen_fds_cnt, args->max_fd);
+
+   // Signal mask is inherited through execv, unblock signals supervisor reads via signalfd
+   spawn_reset_signals();
+   sigemptyset(&no_signals);
+   sigprocmask(SIG_SETMASK, &no_signals, NULL);
+
+   // Missing message in log isn't a reason not to start the instance
+   if (args->exec_msg != NULL) {
+      (void) !write(STDOUT_FILENO, args->exec_msg, args->exec_msg_len);
+   }
+
+   execve(args->path, args->argv, (args->envp != NULL ? args->envp : environ));
+
+   // If correctly started, this won't be executed
+   args->exec_errno = errno;
+   _exit(EXIT_FAILURE);
+}
+
+pid_t spawn_process(spawn_args_t *args)
+{
+   struct rlimit nofile;
+   sigset_t all_signals;
+   sigset_t old_signals;
+   pid_t pid;
+   int clone_errno;
+
+   if (spawn_stack == NULL) {
+      void *stack = mmap(NULL, SPAWN_STACK_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+      if (stack == MAP_FAILED) {
+         return -1;
+      }
+      spawn_stack = stack;
+   }
+
+   args->cgroup_errno = 0;
+   args->placement_errno = 0;
+   args->listen_errno = 0;
+   args->exec_errno = 0;
+   args->envp = NULL;
+   if (args->listen_fds_cnt > 0 && spawn_env_build(args) == -1) {
+      return -1;
+   }
+   // getrlimit is not async-signal-safe, the limit is read here for the fallback
+   args->max_fd = 1024;
+   if (getrlimit(RLIMIT_NOFILE, &nofile) == 0 && nofile.rlim_cur != RLIM_INFINITY) {
+      args->max_fd = (int) nofile.rlim_cur;
+   }
+
+   // No handler may run in child before it resets dispositions
+   sigfillset(&all_signals);
+   pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+
+   // Stack grows down on all supported architectures
+   pid = clone(spawn_child, spawn_stack + SPAWN_STACK_SIZE, CLONE_VM | CLONE_VFORK | SIGCHLD,
+               args);
+   clone_errno = errno;
+
+   pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+   if (args->envp != NULL) {
+      free(args->envp);
+      args->envp = NULL;
+   }
+   errno = clone_errno;
+
+   return pid;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file spawn.h
+ * @brief Launching of instance processes without copying address space of supervisor.
+ * @details Child is created by clone(CLONE_VM | CLONE_VFORK), it runs on its own small stack
+ *  in memory of supervisor until execv, so start latency doesn't depend on size of supervisor
+ *  heap and page tables the way fork does. Supervisor is suspended until the child calls execv
+ *  or exits.
+ *
+ *  Child performs only async-signal-safe steps: redirection of stdout and stderr to log files
+ *  or log pipes,
+ *  setsid, entering cgroup leaf, CPU and memory placement, passing of listening sockets,
+ *  closing of all other descriptors above stderr, reset of signal handlers and mask and execv.
+ *  Everything that allocates or formats (paths, execution message, environment) is prepared
+ *  by supervisor in advance, failures of the steps are reported back through spawn_args_t.
+ *
+ *  Listening sockets are passed the way systemd socket activation does it: they become
+ *  descriptors 3, 4, ... of the child and LISTEN_FDS, LISTEN_PID and LISTEN_FDNAMES are
+ *  set in its environment.
+ */
+
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include <sys/types.h>
+#include "placement.h"
+
+#define SPAWN_STACK_SIZE (64 * 1024) ///< Size of stack child runs on until execv
+
+/**
+ * @brief Arguments of spawned process and results of its steps before execv
+ * */
+typedef struct spawn_args_s {
+   const char *path; ///< Path of executable
+   char **argv; ///< NULL terminated arguments passed to execv
+   const char *stdout_path; ///< File stdout is appended to or NULL to inherit stdout
+   const char *stderr_path; ///< File stderr is appended to or NULL to inherit stderr
+   int stdout_fd; ///< Descriptor stdout is redirected to instead of stdout_path or -1
+   int stderr_fd; ///< Descriptor stderr is redirected to instead of stderr_path or -1
+   mode_t log_perm; ///< Permissions of log files if they don't exist yet
+   int cgroup_procs_fd; ///< cgroup.procs of leaf child moves itself to or -1
+   const placement_t *pl; ///< Placement applied to child or NULL
+   const char *exec_msg; ///< Message written to redirected stdout right before execv or NULL
+   size_t exec_msg_len; ///< Length of exec_msg
+   const int *listen_fds; ///< Listening sockets passed to child or NULL
+   uint32_t listen_fds_cnt; ///< Number of listen_fds
+   const char *listen_fdnames; ///< Colon separated names of listen_fds or NULL
+
+   int cgroup_errno; ///< Set by child if it couldn't enter cgroup leaf, 0 otherwise
+   int placement_errno; ///< Set by child if placement couldn't be applied, 0 otherwise
+   int listen_errno; ///< Set by child if listening sockets couldn't be passed, 0 otherwise
+   int exec_errno; ///< Set by child if execv failed, 0 otherwise
+   int max_fd; ///< Used internally, highest descriptor closed if close_range isn't available
+   char **envp; ///< Used internally, environment with LISTEN_* variables or NULL
+   char *listen_pid; ///< Used internally, digits of LISTEN_PID inside envp filled by child
+   int *listen_tmp_fds; ///< Used internally, listen_fds moved out of the way of their targets
+} spawn_args_t;
+
+/**
+ * @brief Starts new process according to given arguments.
+ * @details Not thread-safe, stack of child is shared by all calls. When function returns,
+ *  child either executed the binary or failed and exited with EXIT_FAILURE, which is
+ *  indicated by nonzero exec_errno. In both cases it has to be reaped by caller.
+ * @param args Arguments of the process, result fields are filled
+ * @return PID of the child or -1 if it couldn't be created
+ * */
+extern pid_t spawn_process(spawn_args_t *args);
+
+#endif
@@ -0,0 +1,239 @@
+/**
+ * @file startup.c
+ * @brief Implementation of functions defined in startup.h
+ */
+
+#include <libtrap/trap.h>
+#include "startup.h"
+
+/**
+ * @brief Checks whether socket of given libtrap socket name exists
+ * @param name Socket name, e.g. socket_name of UNIX interface or "service_PID"
+ * */
+static bool startup_sock_exists(const char *name);
+
+/**
+ * @brief Counts links per instance and fills CSR arrays of one direction
+ * @param links Producer/consumer pairs
+ * @param links_cnt Number of pairs
+ * @param cnt Number of instances
+ * @param by_producer Whether to group pairs by producer (consumers of each producer)
+ *  or by consumer (producers of each consumer)
+ * @param first Array of cnt + 1 offsets to fill
+ * @param items Array of links_cnt indexes to fill
+ * */
+static void startup_csr_fill(const inst_link_t *links, uint32_t links_cnt, uint32_t cnt,
+                             bool by_producer, uint32_t *first, uint32_t *items);
+
+
+static bool startup_sock_exists(const char *name)
+{
+   char path[PATH_MAX];
+
+   snprintf(path, sizeof(path), trap_default_socket_path_format, name);
+   return (access(path, F_OK) == 0);
+}
+
+static void startup_csr_fill(const inst_link_t *links, uint32_t links_cnt, uint32_t cnt,
+                             bool by_producer, uint32_t *first, uint32_t *items)
+{
+   uint32_t key;
+
+   memset(first, 0, (cnt + 1) * sizeof(uint32_t));
+   for (uint32_t l = 0; l < links_cnt; l++) {
+      key = (by_producer ? links[l].producer : links[l].consumer);
+      first[key + 1]++;
+   }
+   for (uint32_t i = 0; i < cnt; i++) {
+      first[i + 1] += first[i];
+   }
+   // first[key] is used as insert position and restored afterwards
+   for (uint32_t l = 0; l < links_cnt; l++) {
+      key = (by_producer ? links[l].producer : links[l].consumer);
+      items[first[key]++] = (by_producer ? links[l].consumer : links[l].producer);
+   }
+   for (uint32_t i = cnt; i > 0; i--) {
+      first[i] = first[i - 1];
+   }
+   first[0] = 0;
+}
+
+int startup_order_build(inst_t **insts, uint32_t cnt, startup_order_t *so)
+{
+   inst_link_t *links = NULL;
+   uint32_t *consumers_first = NULL;
+   uint32_t *consumers = NULL;
+   uint32_t *pending = NULL;
+   uint32_t *level_cnt = NULL;
+   int links_cnt;
+   uint32_t head = 0;
+   uint32_t tail = 0;
+   uint32_t idx;
+   uint32_t c;
+
+   memset(so, 0, sizeof(startup_order_t));
+   links_cnt = insts_links(insts, cnt, &links);
+   if (links_cnt == -1) {
+      return -1;
+   }
+
+   so->cnt = cnt;
+   so->level = calloc(cnt + 1, sizeof(uint32_t));
+   so->order = malloc((cnt + 1) * sizeof(uint32_t));
+   so->producers_first = malloc((cnt + 1) * sizeof(uint32_t));
+   so->producers = malloc(((uint32_t) links_cnt + 1) * sizeof(uint32_t));
+   consumers_first = malloc((cnt + 1) * sizeof(uint32_t));
+   consumers = malloc(((uint32_t) links_cnt + 1) * sizeof(uint32_t));
+   pending = malloc((cnt + 1) * sizeof(uint32_t));
+   if (so->level == NULL || so->order == NULL || so->producers_first == NULL
+       || so->producers == NULL || consumers_first == NULL || consumers == NULL
+       || pending == NULL) {
+      NO_MEM_ERR
+      goto err_cleanup;
+   }
+
+   startup_csr_fill(links, (uint32_t) links_cnt, cnt, false, so->producers_first, so->producers);
+   startup_csr_fill(links, (uint32_t) links_cnt, cnt, true, consumers_first, consumers);
+
+   // Kahn's algorithm, order is used as queue of instances which producers are all resolved
+   for (uint32_t i = 0; i < cnt; i++) {
+      pending[i] = so->producers_first[i + 1] - so->producers_first[i];
+      if (pending[i] == 0) {
+         so->order[tail++] = i;
+      }
+   }
+   while (head < tail) {
+      idx = so->order[head++];
+      if (so->level[idx] + 1 > so->levels_cnt) {
+         so->levels_cnt = so->level[idx] + 1;
+      }
+      for (uint32_t j = consumers_first[idx]; j < consumers_first[idx + 1]; j++) {
+         c = consumers[j];
+         if (so->level[c] < so->level[idx] + 1) {
+            so->level[c] = so->level[idx] + 1;
+         }
+         if (--pending[c] == 0) {
+            so->order[tail++] = c;
+         }
+      }
+   }
+   // Instances of cycles and their consumers share the last level
+   if (tail < cnt) {
+      for (uint32_t i = 0; i < cnt; i++) {
+         if (pending[i] != 0) {
+            so->level[i] = so->levels_cnt;
+         }
+      }
+      so->levels_cnt++;
+   }
+
+   // Stable counting sort by level, instances of one level keep configuration order
+   level_cnt = calloc(so->levels_cnt + 1, sizeof(uint32_t));
+   if (level_cnt == NULL) {
+      NO_MEM_ERR
+      goto err_cleanup;
+   }
+   for (uint32_t i = 0; i < cnt; i++) {
+      level_cnt[so->level[i] + 1]++;
+   }
+   for (uint32_t l = 0; l < so->levels_cnt; l++) {
+      level_cnt[l + 1] += level_cnt[l];
+   }
+   for (uint32_t i = 0; i < cnt; i++) {
+      so->order[level_cnt[so->level[i]]++] = i;
+   }
+
+   NULLP_TEST_AND_FREE(links)
+   NULLP_TEST_AND_FREE(consumers_first)
+   NULLP_TEST_AND_FREE(consumers)
+   NULLP_TEST_AND_FREE(pending)
+   NULLP_TEST_AND_FREE(level_cnt)
+   return 0;
+
+err_cleanup:
+   NULLP_TEST_AND_FREE(links)
+   NULLP_TEST_AND_FREE(consumers_first)
+   NULLP_TEST_AND_FREE(consumers)
+   NULLP_TEST_AND_FREE(pending)
+   NULLP_TEST_AND_FREE(level_cnt)
+   startup_order_free(so);
+   return -1;
+}
+
+void startup_order_free(startup_order_t *so)
+{
+   NULLP_TEST_AND_FREE(so->level)
+   NULLP_TEST_AND_FREE(so->order)
+   NULLP_TEST_AND_FREE(so->producers_first)
+   NULLP_TEST_AND_FREE(so->producers)
+   so->cnt = 0;
+   so->levels_cnt = 0;
+}
+
+bool startup_inst_waits(const startup_order_t *so, inst_t **insts, uint32_t idx, uint64_t now)
+{
+   inst_t *producer;
+   uint32_t p;
+
+   // Without order (e.g. allocation failed) instances are started as they are configured
+   if (so->producers_first == NULL || idx >= so->cnt) {
+      return false;
+   }
+
+   for (uint32_t j = so->producers_first[idx]; j < so->producers_first[idx + 1]; j++) {
+      p = so->producers[j];
+      producer = insts[p];
+      // Disabled producer (e.g. over its restart limit) won't get ready, members of
+      // a cycle don't wait for each other
+      if (INST_ENABLED(producer) == false || so->level[p] >= so->level[idx]) {
+         continue;
+      }
+      if (startup_inst_ready(producer, now) == false) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+bool startup_inst_ready(inst_t *inst, uint64_t now)
+{
+   char service_sock[32];
+   interface_t *ifc;
+   bool has_unix_out = false;
+   bool ready = true;
+
+   if (INST_RUNNING(inst) == false) {
+      return false;
+   }
+   // Process adopted after restart of supervisor runs for unknown time
+   if (inst->ready || inst->is_my_child == false) {
+      return true;
+   }
+
+   for (uint32_t i = 0; i < inst->out_ifces.total; i++) {
+      ifc = inst->out_ifces.items[i];
+      if (ifc->type != NS_IF_TYPE_UNIX || ifc->specific_params.nix == NULL
+          || ifc->specific_params.nix->socket_name == NULL) {
+         continue;
+      }
+      has_unix_out = true;
+      if (startup_sock_exists(ifc->specific_params.nix->socket_name) == false) {
+         ready = false;
+         break;
+      }
+   }
+   if (has_unix_out == false && inst->mod_ref->trap_mon) {
+      snprintf(service_sock, sizeof(service_sock), "service_%d", INST_PID(inst));
+      ready = startup_sock_exists(service_sock);
+   }
+
+   if (ready == false && now - inst->start_ms >= STARTUP_READY_TIMEOUT_MS) {
+      VERBOSE(V2, "Instance '%s' didn't create its sockets in %d ms, starting its consumers "
+              "anyway", inst->name, STARTUP_READY_TIMEOUT_MS)
+      ready = true;
+   }
+   inst->ready = ready;
+
+   return ready;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file startup.h
+ * @brief Ordering of instance starts by their producer/consumer dependencies.
+ * @details Instance consuming output of another instance (IN interface with the same UNIX
+ *  socket or TCP port as OUT interface of the producer) is started only once all its
+ *  enabled producers are ready, so that it doesn't spin reconnecting and burn its restarts.
+ *  Instances are split into levels, level 0 has no producers and every other instance is
+ *  one level above its highest producer. Instances of one level whose producers are ready
+ *  are started in the same pass without waiting for each other.
+ *
+ *  Producer is ready once all its UNIX output sockets exist, or once its libtrap service
+ *  socket exists if it has no UNIX outputs (it is created by trap_init along with TCP
+ *  interfaces). Producer that doesn't get ready in STARTUP_READY_TIMEOUT_MS
+ *  is considered ready anyway. Instances in dependency cycles don't wait for each other.
+ */
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include "module.h"
+
+#define STARTUP_POLL_MS 20 ///< Period of readiness checks while some instance waits for producers
+#define STARTUP_READY_TIMEOUT_MS 5000 ///< Producer not ready this long after start is
+                                      ///<  considered ready anyway
+
+/**
+ * @brief Start order of instances derived from their interfaces
+ * */
+typedef struct startup_order_s {
+   uint32_t cnt; ///< Number of instances
+   uint32_t levels_cnt; ///< Number of levels
+   uint32_t *level; ///< Level of each instance
+   uint32_t *order; ///< Indexes of instances sorted by level
+   uint32_t *producers_first; ///< Producers of instance i are at indexes from producers_first[i]
+                              ///<  to producers_first[i + 1] of producers
+   uint32_t *producers; ///< Indexes of producers
+} startup_order_t;
+
+/**
+ * @brief Builds start order of given instances.
+ * @param insts Instances
+ * @param cnt Number of instances
+ * @param so Order to build, it is zeroed on error
+ * @return -1 on error, 0 on success
+ * */
+extern int startup_order_build(inst_t **insts, uint32_t cnt, startup_order_t *so);
+
+/**
+ * @brief Frees arrays of start order.
+ * @param so Order to free
+ * */
+extern void startup_order_free(startup_order_t *so);
+
+/**
+ * @brief Checks whether given instance waits for some of its producers to get ready.
+ * @param so Start order built for insts
+ * @param insts Instances
+ * @param idx Index of instance to check
+ * @param now Current monotonic time in milliseconds
+ * @return true if instance shouldn't be started yet
+ * */
+extern bool startup_inst_waits(const startup_order_t *so, inst_t **insts, uint32_t idx,
+                               uint64_t now);
+
+/**
+ * @brief Checks whether given running instance created its sockets, result is cached
+ *  in inst_t.ready until its next start.
+ * @param inst Instance to check
+ * @param now Current monotonic time in milliseconds
+ * @return true if instance is ready to be connected to
+ * */
+extern bool startup_inst_ready(inst_t *inst, uint64_t now);
+
+#endif
@@ -3,43 +3,162 @@
  * @brief Provides callbacks for sysrepo for the purpose of gaining statistics about instances and their interfaces.
  */
 
+#include <stdio.h>
 #include "stats.h"
 #include "module.h"
+#include "statsnap.h"
 #include <sysrepo/values.h>
-#include <sysrepo/xpath.h>
 
+#define STATS_LEAF_LEN_MAX 20 ///< Maximum length of name of stats leaf
 
 /**
  * @brief Helper structure that contains parsed XPATH received from callbacks.
  * */
 typedef struct tree_path_s {
-   char *inst; ///< Name of parsed instance
-   char *ifc; ///< Name of parsed interface
+   char *inst; ///< Name of parsed instance or NULL if XPATH selects all instances
+   char *ifc; ///< Name of parsed interface or NULL if XPATH selects all interfaces
 } tree_path_t;
 
+/**
+ * @brief Effective placement of running instance, read while values are built
+ * */
+typedef struct inst_placement_s {
+   bool has_cpus; ///< Whether cpus is valid
+   bool has_mem_policy; ///< Whether mem_policy is valid
+   char cpus[PLACEMENT_LIST_LEN]; ///< Formatted CPU list
+   char mem_policy[PLACEMENT_LIST_LEN]; ///< Formatted memory policy
+} inst_placement_t;
+
+/**
+ * @brief Values of stats of all instances and interfaces of one snapshot.
+ * @details Built in one pass on the first request served from the snapshot and attached to
+ *  it, so that all following requests, no matter whether they ask for one instance or for
+ *  all of them, only copy a slice of the array.
+ *
+ *  Values don't own their data: XPATHs of leaves are written to one arena from stats XPATHs
+ *  kept by the snapshot and strings point to placements or to exit_reasons. Values are
+ *  therefore never passed to sr_free_values, sysrepo gets copies by sr_dup_values.
+ * */
+typedef struct stats_vals_s {
+   sr_val_t *inst_vals; ///< Stats of all instances, in order of snapshot instances
+   size_t inst_vals_cnt; ///< Number of values in inst_vals
+   sr_val_t *ifc_vals; ///< Stats of all interfaces, in order of snapshot interfaces
+   size_t ifc_vals_cnt; ///< Number of values in ifc_vals
+   uint32_t *inst_off; ///< insts_cnt + 1 offsets of values of instances in inst_vals
+   uint32_t *ifc_off; ///< ifces_cnt + 1 offsets of values of interfaces in ifc_vals
+   inst_placement_t *pls; ///< Placements of instances, string values point here
+   char *xpaths; ///< Arena with XPATHs of all values
+} stats_vals_t;
 
 /**
- * @brief Helper to set val_data of val_type to new_sr_val at stat_xpath+stat_leaf_name.
- * @param new_sr_val Sysrepo value to be set
- * @param stat_xpath Base XPATH for concatenation
- * @param stat_leaf_name Name of XPATH's leaf node
+ * @brief Writes XPATHs of leaves of one stats container to the arena of stats_vals_t
+ * */
+typedef struct leaf_xpaths_s {
+   char *pos; ///< Free space of the arena
+   const char *prefix; ///< XPATH of stats container
+   size_t prefix_len; ///< Length of prefix
+} leaf_xpaths_t;
+
+static const char *exit_reasons[] = {
+   [INST_EXIT_CODE] = "exited",
+   [INST_EXIT_SIGNAL] = "signaled",
+   [INST_EXIT_OOM_KILL] = "oom-killed",
+   [INST_EXIT_EXEC_FAILED] = "exec-failed",
+}; ///< Values of exit-reason leaf
+
+
+/**
+ * @brief Sets val_data of val_type to value at XPATH of stats container + stat_leaf_name.
+ *  XPATH is written to the arena of lx, strings are referenced, not copied.
+ * @param val Sysrepo value to be set
+ * @param lx Arena and XPATH of stats container
+ * @param stat_leaf_name Name of XPATH's leaf node, at most STATS_LEAF_LEN_MAX long
  * @param val_type Data type of sysrepo's value
  * @param val_data Pointer to data to be set
- * @return 0 on success, -1 on error
  * */
-static int set_new_sr_val(sr_val_t *new_sr_val,
-                          const char *stat_xpath,
+static void stats_val_set(sr_val_t *val,
+                          leaf_xpaths_t *lx,
                           const char *stat_leaf_name,
                           sr_type_t val_type,
-                          void *val_data);
+                          const void *val_data);
+
+/**
+ * @brief Returns number of stats values of given instance.
+ * @param inst Instance of snapshot
+ * @param pl Its effective placement
+ * @return Number of values
+ * */
+static uint32_t inst_vals_cnt(const inst_snap_t *inst, const inst_placement_t *pl);
+
+/**
+ * @brief Fills stats values of given instance.
+ * @param vals Array of inst_vals_cnt values to fill
+ * @param lx Arena to write XPATHs to
+ * @param inst Instance of snapshot
+ * @param pl Its effective placement
+ * */
+static void inst_vals_fill(sr_val_t *vals,
+                           leaf_xpaths_t *lx,
+                           const inst_snap_t *inst,
+                           const inst_placement_t *pl);
+
+/**
+ * @brief Returns number of stats values of given interface.
+ * @param ifc Interface of snapshot
+ * @return Number of values
+ * */
+static uint32_t ifc_vals_cnt(const ifc_snap_t *ifc);
+
+/**
+ * @brief Fills stats values of given interface.
+ * @param vals Array of ifc_vals_cnt values to fill
+ * @param lx Arena to write XPATHs to
+ * @param ifc Interface of snapshot
+ * */
+static void ifc_vals_fill(sr_val_t *vals, leaf_xpaths_t *lx, const ifc_snap_t *ifc);
+
+/**
+ * @brief Builds values of all instances and interfaces of given snapshot.
+ * @param snap Acquired snapshot
+ * @return Values or NULL on error
+ * */
+static stats_vals_t * stats_vals_build(const stats_snap_t *snap);
+
+/**
+ * @brief Frees values built by stats_vals_build, stats_snap_cache_free_t callback
+ * @param cache Values to free
+ * */
+static void stats_vals_free(void *cache);
+
+/**
+ * @brief Returns values attached to given snapshot, builds them if there are none yet.
+ * @param snap Acquired snapshot
+ * @return Values or NULL on error
+ * */
+static const stats_vals_t * stats_vals_get(const stats_snap_t *snap);
 
 /**
- * @brief Returns interface_t from given XPATH.
- * @param xpath XPATH to be processed
- * @return Interface or NULL on error
+ * @brief Copies slice of prebuilt values for sysrepo, which frees returned values itself.
+ * @param vals First value of the slice
+ * @param cnt Number of values in the slice
+ * @param[out] values Copied values
+ * @param[out] values_cnt Number of copied values
+ * @return sysrepo error code
  * */
-static interface_t * interface_get_by_xpath(const char *xpath);
+static int stats_vals_dup(const sr_val_t *vals,
+                          size_t cnt,
+                          sr_val_t **values,
+                          size_t *values_cnt);
 
+/**
+ * @brief Finds value of name key of given node in XPATH.
+ * @param xpath XPATH to search
+ * @param node Name of list node
+ * @param[out] val Start of the key value
+ * @param[out] len Length of the key value
+ * @return 1 if found, 0 if node has no key (i.e. all entries are requested), -1 on error
+ * */
+static int xpath_node_name(const char *xpath, const char *node, const char **val, size_t *len);
 
 /**
  * @brief Frees given tpath.
@@ -63,89 +182,72 @@ int interface_get_stats_cb(const char *xpath,
    VERBOSE(V3, "Request for interface stats at xpath=%s", xpath)
 
    int rc;
-   uint8_t vals_cnt;
-   interface_t *ifc = NULL;
-   sr_val_t *new_vals = NULL;
+   tree_path_t *tpath = NULL;
+   const stats_snap_t *snap = NULL;
+   const stats_vals_t *sv = NULL;
+   const inst_snap_t *inst = NULL;
+   const ifc_snap_t *ifc = NULL;
+   uint32_t first;
+   uint32_t last;
+   uint32_t slot;
+
+   // Published copy is read, instances might be changed or freed meanwhile
+   snap = stats_snap_acquire(&slot);
 
-   ifc = interface_get_by_xpath(xpath);
-   if (ifc == NULL) {
-      VERBOSE(N_ERR, "Interface at '%s' is not loaded", xpath)
+   tpath = tree_path_load(xpath);
+   if (tpath == NULL) {
+      rc = SR_ERR_INVAL_ARG;
+      goto err_cleanup;
+   }
+   if (snap == NULL) {
       rc = SR_ERR_NOT_FOUND;
       goto err_cleanup;
    }
 
-   if (ifc->direction == NS_IF_DIR_IN) {
-      vals_cnt = 2;
-      ifc_in_stats_t *stats = ifc->stats;
-
-      rc = sr_new_values(vals_cnt, &new_vals);
-      if (rc != SR_ERR_OK) {
-         VERBOSE(N_ERR, "Failed create stats output values: %s", sr_strerror(rc));
-         goto err_cleanup;
-      }
-
-      rc = set_new_sr_val(&new_vals[0], xpath, "recv-msg-cnt", SR_UINT64_T,
-                          &stats->recv_msg_cnt);
-      if (rc != 0) {
-         VERBOSE(N_ERR, "Setting node value for /recv-msg-cnt failed")
+   // Interfaces of one instance are next to each other, so any request is one slice
+   first = 0;
+   last = snap->ifces_cnt;
+   if (tpath->inst != NULL) {
+      inst = stats_snap_inst_get(snap, tpath->inst);
+      if (inst == NULL) {
+         VERBOSE(N_ERR, "Instance '%s' was not found for stats data.", tpath->inst)
+         rc = SR_ERR_NOT_FOUND;
          goto err_cleanup;
       }
-
-      rc = set_new_sr_val(&new_vals[1], xpath, "recv-buff-cnt", SR_UINT64_T,
-                          &stats->recv_buff_cnt);
-      if (rc != 0) {
-         VERBOSE(N_ERR, "Setting node value for /recv-buff-cnt failed")
-         goto err_cleanup;
-      }
-   } else { // ifc->direction == NS_IF_DIR_OUT
-      vals_cnt = 4;
-      ifc_out_stats_t *stats = ifc->stats;
-
-      rc = sr_new_values(vals_cnt, &new_vals);
-      if (rc != SR_ERR_OK) {
-         VERBOSE(N_ERR, "Failed create stats output values: %s", sr_strerror(rc));
-         goto err_cleanup;
-      }
-
-      rc = set_new_sr_val(&new_vals[0], xpath, "sent-msg-cnt", SR_UINT64_T,
-                          &stats->sent_msg_cnt);
-      if (rc != 0) {
-         VERBOSE(N_ERR, "Setting node value for /sent-msg-cnt failed")
-         goto err_cleanup;
-      }
-
-      rc = set_new_sr_val(&new_vals[1], xpath, "sent-buff-cnt", SR_UINT64_T,
-                          &stats->sent_buff_cnt);
-      if (rc != 0) {
-         VERBOSE(N_ERR, "Setting node value for /sent-buff-cnt failed")
-         goto err_cleanup;
-      }
-
-      rc = set_new_sr_val(&new_vals[2], xpath, "dropped-msg-cnt", SR_UINT64_T,
-                          &stats->dropped_msg_cnt);
-      if (rc != 0) {
-         VERBOSE(N_ERR, "Setting node value for /dropped-msg-cnt failed")
+      first = (uint32_t) (inst->ifces - snap->ifces);
+      last = first + inst->ifces_cnt;
+   }
+   if (tpath->ifc != NULL) {
+      ifc = (inst != NULL ? stats_snap_ifc_get(inst, tpath->ifc) : NULL);
+      if (ifc == NULL) {
+         VERBOSE(N_ERR, "Interface at '%s' is not loaded", xpath)
+         rc = SR_ERR_NOT_FOUND;
          goto err_cleanup;
       }
+      first = (uint32_t) (ifc - snap->ifces);
+      last = first + 1;
+   }
 
-      rc = set_new_sr_val(&new_vals[3], xpath, "autoflush-cnt", SR_UINT64_T,
-                          &stats->autoflush_cnt);
-      if (rc != 0) {
-         VERBOSE(N_ERR, "Setting node value for /autoflush-cnt failed")
-         goto err_cleanup;
-      }
+   sv = stats_vals_get(snap);
+   if (sv == NULL) {
+      rc = SR_ERR_NOMEM;
+      goto err_cleanup;
+   }
+   rc = stats_vals_dup(&sv->ifc_vals[sv->ifc_off[first]],
+                       sv->ifc_off[last] - sv->ifc_off[first], values, values_cnt);
+   if (rc != SR_ERR_OK) {
+      goto err_cleanup;
    }
 
-   *values_cnt = vals_cnt;
-   *values = new_vals;
+   stats_snap_release(slot);
+   tree_path_free(tpath);
 
    VERBOSE(V3, "Successfully leaving interface_get_stats_cb")
    return SR_ERR_OK;
 
 err_cleanup:
-   if (new_vals != NULL) {
-      sr_free_values(new_vals, *values_cnt);
-   }
+   stats_snap_release(slot);
+   tree_path_free(tpath);
 
    VERBOSE(N_ERR, "Retrieving stats for xpath=%s failed.", xpath)
    return rc;
@@ -159,284 +261,442 @@ int inst_get_stats_cb(const char *xpath,
    VERBOSE(V3, "Request for instance stats at xpath=%s", xpath)
 
    int rc;
-   uint8_t vals_cnt = 6;
    tree_path_t *tpath = NULL;
-   inst_t *inst = NULL;
-   sr_val_t *new_vals = NULL;
-   time_t time_now;
-   uint8_t restarts_cnt = 0;
-   uint64_t zero_val = 0;
+   const stats_snap_t *snap = NULL;
+   const stats_vals_t *sv = NULL;
+   const inst_snap_t *inst = NULL;
+   uint32_t first;
+   uint32_t last;
+   uint32_t slot;
+
+   // Published copy is read, instances might be changed or freed meanwhile
+   snap = stats_snap_acquire(&slot);
 
    tpath = tree_path_load(xpath);
    if (tpath == NULL) {
-      NO_MEM_ERR
-      rc = SR_ERR_NOMEM;
+      rc = SR_ERR_INVAL_ARG;
       goto err_cleanup;
    }
-
-   rc = sr_new_values(vals_cnt, &new_vals);
-   if (rc != SR_ERR_OK) {
-      VERBOSE(N_ERR, "Failed create stats output values: %s", sr_strerror(rc));
-      goto err_cleanup;
-   }
-
-   VERBOSE(V3, "Stats requested for inst '%s'", tpath->inst)
-
-   inst = inst_get_by_name(tpath->inst, NULL);
-   if (inst == NULL) {
-      VERBOSE(N_ERR, "Instance '%s' was not found for stats data.", tpath->inst)
+   if (snap == NULL) {
       rc = SR_ERR_NOT_FOUND;
       goto err_cleanup;
    }
-   tree_path_free(tpath);
-
-   rc = set_new_sr_val(&new_vals[0], xpath, "running", SR_BOOL_T, &inst->running);
-   if (rc != 0) {
-      VERBOSE(N_ERR, "Setting node value for /running failed")
-      goto err_cleanup;
-   }
 
-   {
-      /* Find out whether it was more than a minute since last restart and if it was,
-       * reset restarts_cnt to provide correct value to the caller */
-      time(&time_now);
-      if (time_now - inst->restart_time <= 60) {
-         restarts_cnt = inst->restarts_cnt;
+   // XPATH without instance name asks for all of them at once
+   first = 0;
+   last = snap->insts_cnt;
+   if (tpath->inst != NULL) {
+      VERBOSE(V3, "Stats requested for inst '%s'", tpath->inst)
+      inst = stats_snap_inst_get(snap, tpath->inst);
+      if (inst == NULL) {
+         VERBOSE(N_ERR, "Instance '%s' was not found for stats data.", tpath->inst)
+         rc = SR_ERR_NOT_FOUND;
+         goto err_cleanup;
       }
+      first = (uint32_t) (inst - snap->insts);
+      last = first + 1;
    }
 
-   rc = set_new_sr_val(&new_vals[1], xpath, "restart-counter", SR_UINT8_T,
-                       &restarts_cnt);
-   if (rc != 0) {
-      VERBOSE(N_ERR, "Setting node value for /restart-counter failed")
-      goto err_cleanup;
-   }
-
-   rc = set_new_sr_val(&new_vals[2], xpath, "cpu-user", SR_UINT64_T,
-                       inst->running ? &inst->last_cpu_perc_umode : &zero_val);
-   if (rc != 0) {
-      VERBOSE(N_ERR, "Setting node value for /cpu-user failed")
-      goto err_cleanup;
-   }
-
-   rc = set_new_sr_val(&new_vals[3], xpath, "cpu-kern", SR_UINT64_T,
-                       inst->running ? &inst->last_cpu_perc_kmode : &zero_val);
-   if (rc != 0) {
-      VERBOSE(N_ERR, "Setting node value for /cpu-kern failed")
-      goto err_cleanup;
-   }
-
-   rc = set_new_sr_val(&new_vals[4], xpath, "mem-vms", SR_UINT64_T,
-                       inst->running ? &inst->mem_vms : &zero_val);
-   if (rc != 0) {
-      VERBOSE(N_ERR, "Setting node value for /mem-vms failed")
+   sv = stats_vals_get(snap);
+   if (sv == NULL) {
+      rc = SR_ERR_NOMEM;
       goto err_cleanup;
    }
-
-   rc = set_new_sr_val(&new_vals[5], xpath, "mem-rss", SR_UINT64_T,
-                       inst->running ? &inst->mem_rss : &zero_val);
-   if (rc != 0) {
-      VERBOSE(N_ERR, "Setting node value for /mem-rss failed")
+   rc = stats_vals_dup(&sv->inst_vals[sv->inst_off[first]],
+                       sv->inst_off[last] - sv->inst_off[first], values, values_cnt);
+   if (rc != SR_ERR_OK) {
       goto err_cleanup;
    }
 
-   *values_cnt = vals_cnt;
-   *values = new_vals;
+   stats_snap_release(slot);
+   tree_path_free(tpath);
    VERBOSE(V3, "Successfully leaving inst_get_stats_cb")
    return SR_ERR_OK;
 
 err_cleanup:
-   if (new_vals != NULL) {
-      sr_free_values(new_vals, *values_cnt);
-   }
+   stats_snap_release(slot);
    tree_path_free(tpath);
 
    VERBOSE(N_ERR, "Retrieving stats for xpath=%s failed.", xpath)
-
    return rc;
 }
 
-static int set_new_sr_val(sr_val_t *new_sr_val,
-                          const char *stat_xpath,
-                          const char *stat_leaf_name,
-                          sr_type_t val_type,
-                          void *val_data)
+static uint32_t inst_vals_cnt(const inst_snap_t *inst, const inst_placement_t *pl)
 {
-   int rc;
-   char *stat_leaf_xpath = NULL;
-   uint64_t stat_xpath_len = strlen(stat_xpath) + strlen(stat_leaf_name) + 2;
+   uint32_t cnt = 6;
 
-   stat_leaf_xpath = (char *) calloc(stat_xpath_len, sizeof(char));
-   if (stat_leaf_xpath == NULL) {
-      NO_MEM_ERR
-      goto err_cleanup;
+   // start-time, cgroup accounting and exit-* leaves are present only when known
+   if (inst->start_time != 0) {
+      cnt += 1;
+   }
+   if (inst->has_cgroup) {
+      cnt += 3;
+   }
+   if (inst->last_exit.valid) {
+      cnt += 8;
+   }
+   if (inst->backoff_ms != 0) {
+      cnt += 1;
+   }
+   if (inst->has_logs) {
+      cnt += 2;
    }
+   cnt += (pl->has_cpus ? 1 : 0) + (pl->has_mem_policy ? 1 : 0);
 
-   sprintf(stat_leaf_xpath, "%s/%s", stat_xpath, stat_leaf_name);
-   rc = sr_val_set_xpath(new_sr_val, stat_leaf_xpath);
-   if (rc != 0) {
-      VERBOSE(N_ERR, "Failed to set output stats value xpath=%s", stat_leaf_xpath)
-      goto err_cleanup;
+   return cnt;
+}
+
+static void inst_vals_fill(sr_val_t *vals,
+                           leaf_xpaths_t *lx,
+                           const inst_snap_t *inst,
+                           const inst_placement_t *pl)
+{
+   uint32_t vi = 6; // Index of next optional value
+   uint64_t zero_val = 0;
+   uint64_t time_val;
+   int32_t exit_code;
+   uint8_t exit_signal;
+
+   stats_val_set(&vals[0], lx, "running", SR_BOOL_T, &inst->running);
+   stats_val_set(&vals[1], lx, "restart-counter", SR_UINT8_T, &inst->restarts_cnt);
+   stats_val_set(&vals[2], lx, "cpu-user", SR_UINT64_T,
+                 inst->running ? &inst->cpu_user : &zero_val);
+   stats_val_set(&vals[3], lx, "cpu-kern", SR_UINT64_T,
+                 inst->running ? &inst->cpu_kern : &zero_val);
+   stats_val_set(&vals[4], lx, "mem-vms", SR_UINT64_T,
+                 inst->running ? &inst->mem_vms : &zero_val);
+   stats_val_set(&vals[5], lx, "mem-rss", SR_UINT64_T,
+                 inst->running ? &inst->mem_rss : &zero_val);
+
+   if (inst->start_time != 0) {
+      time_val = (uint64_t) inst->start_time;
+      stats_val_set(&vals[vi++], lx, "start-time", SR_UINT64_T, &time_val);
    }
 
-   switch (val_type) {
-      case SR_BOOL_T:
-         new_sr_val->type = SR_BOOL_T;
-         new_sr_val->data.bool_val = *(bool *)  val_data;
-         break;
-      case SR_UINT8_T:
-         new_sr_val->type = SR_UINT8_T;
-         new_sr_val->data.uint8_val = *(uint8_t *) val_data;
-         break;
-      case SR_UINT64_T:
-         new_sr_val->type = SR_UINT64_T;
-         new_sr_val->data.uint64_val = *(uint64_t *) val_data;
-         break;
+   if (inst->has_cgroup) {
+      stats_val_set(&vals[vi++], lx, "mem-peak", SR_UINT64_T, &inst->mem_peak);
+      stats_val_set(&vals[vi++], lx, "io-read-bytes", SR_UINT64_T, &inst->io_read_bytes);
+      stats_val_set(&vals[vi++], lx, "io-write-bytes", SR_UINT64_T, &inst->io_write_bytes);
+   }
 
-      default:
-         break;
+   if (pl->has_cpus) {
+      stats_val_set(&vals[vi++], lx, "cpus", SR_STRING_T, pl->cpus);
+   }
+   if (pl->has_mem_policy) {
+      stats_val_set(&vals[vi++], lx, "mem-policy", SR_STRING_T, pl->mem_policy);
    }
 
-   return 0;
+   if (inst->last_exit.valid) {
+      exit_code = (int32_t) inst->last_exit.code;
+      exit_signal = (uint8_t) inst->last_exit.signal;
+      time_val = (uint64_t) inst->last_exit.time;
 
-err_cleanup:
-   NULLP_TEST_AND_FREE(stat_leaf_xpath)
-   VERBOSE(N_ERR, "set_new_sr_val failed")
+      stats_val_set(&vals[vi++], lx, "exit-code", SR_INT32_T, &exit_code);
+      stats_val_set(&vals[vi++], lx, "exit-signal", SR_UINT8_T, &exit_signal);
+      stats_val_set(&vals[vi++], lx, "exit-core-dumped", SR_BOOL_T,
+                    &inst->last_exit.core_dumped);
+      stats_val_set(&vals[vi++], lx, "exit-time", SR_UINT64_T, &time_val);
+      stats_val_set(&vals[vi++], lx, "exit-cpu-user", SR_UINT64_T,
+                    &inst->last_exit.cpu_user_us);
+      stats_val_set(&vals[vi++], lx, "exit-cpu-kern", SR_UINT64_T,
+                    &inst->last_exit.cpu_kern_us);
+      stats_val_set(&vals[vi++], lx, "exit-mem-max-rss", SR_UINT64_T,
+                    &inst->last_exit.max_rss);
+      stats_val_set(&vals[vi++], lx, "exit-reason", SR_ENUM_T,
+                    exit_reasons[inst->last_exit.reason]);
+   }
+
+   if (inst->backoff_ms != 0) {
+      stats_val_set(&vals[vi++], lx, "restart-backoff", SR_UINT32_T, &inst->backoff_ms);
+   }
 
-   return -1;
+   if (inst->has_logs) {
+      stats_val_set(&vals[vi++], lx, "log-bytes-written", SR_UINT64_T,
+                    &inst->log_bytes_written);
+      stats_val_set(&vals[vi++], lx, "log-bytes-dropped", SR_UINT64_T,
+                    &inst->log_bytes_dropped);
+   }
 }
 
-static tree_path_t * tree_path_load(const char *xpath)
+static uint32_t ifc_vals_cnt(const ifc_snap_t *ifc)
 {
-   char * dyn_xpath;
-   char * res;
-   tree_path_t *tpath = NULL;
-   sr_xpath_ctx_t state = {0};
+   return (ifc->direction == NS_IF_DIR_IN ? 2 : 4);
+}
 
-   // sysrepo xpath functions require xpath to be dynamically allocated
-   dyn_xpath = strdup(xpath);
-   if (dyn_xpath == NULL) {
-      NO_MEM_ERR
-      goto err_cleanup;
+static void ifc_vals_fill(sr_val_t *vals, leaf_xpaths_t *lx, const ifc_snap_t *ifc)
+{
+   if (ifc->direction == NS_IF_DIR_IN) {
+      stats_val_set(&vals[0], lx, "recv-msg-cnt", SR_UINT64_T, &ifc->recv_msg_cnt);
+      stats_val_set(&vals[1], lx, "recv-buff-cnt", SR_UINT64_T, &ifc->recv_buff_cnt);
+   } else { // ifc->direction == NS_IF_DIR_OUT
+      stats_val_set(&vals[0], lx, "sent-msg-cnt", SR_UINT64_T, &ifc->sent_msg_cnt);
+      stats_val_set(&vals[1], lx, "sent-buff-cnt", SR_UINT64_T, &ifc->sent_buff_cnt);
+      stats_val_set(&vals[2], lx, "dropped-msg-cnt", SR_UINT64_T, &ifc->dropped_msg_cnt);
+      stats_val_set(&vals[3], lx, "autoflush-cnt", SR_UINT64_T, &ifc->autoflush_cnt);
    }
+}
 
-   tpath = calloc(1, sizeof(tree_path_t));
-   if (tpath == NULL) {
+static stats_vals_t * stats_vals_build(const stats_snap_t *snap)
+{
+   const inst_snap_t *inst;
+   const ifc_snap_t *ifc;
+   stats_vals_t *sv;
+   leaf_xpaths_t lx;
+   size_t xpaths_size = 0;
+   uint32_t cnt;
+
+   sv = calloc(1, sizeof(stats_vals_t)
+                  + (snap->insts_cnt + 1 + snap->ifces_cnt + 1) * sizeof(uint32_t));
+   if (sv == NULL) {
       NO_MEM_ERR
-      goto err_cleanup;
+      return NULL;
    }
-   tpath->inst = NULL;
-   tpath->ifc = NULL;
+   sv->inst_off = (uint32_t *) (sv + 1);
+   sv->ifc_off = sv->inst_off + snap->insts_cnt + 1;
 
-   res = sr_xpath_next_node(dyn_xpath, &state);
-   if (res == NULL) {
-      VERBOSE(N_ERR, "Failed to parse tree_path_load on line %d", __LINE__)
+   sv->pls = calloc(snap->insts_cnt + 1, sizeof(inst_placement_t));
+   if (sv->pls == NULL) {
+      NO_MEM_ERR
       goto err_cleanup;
    }
 
-   res = sr_xpath_next_node(NULL, &state);
-   if (res == NULL) {
-      VERBOSE(N_ERR, "Failed to parse tree_path_load on line %d", __LINE__)
+   // Sizes first, so that each array and all XPATHs are allocated at once
+   for (uint32_t i = 0; i < snap->insts_cnt; i++) {
+      inst = &snap->insts[i];
+      // Effective placement is read from the running process itself
+      if (inst->running) {
+         sv->pls[i].has_cpus = (placement_get_cpus(inst->pid, sv->pls[i].cpus,
+                                                   sizeof(sv->pls[i].cpus)) == 0);
+         sv->pls[i].has_mem_policy =
+               (placement_get_mem_policy(inst->pid, sv->pls[i].mem_policy,
+                                         sizeof(sv->pls[i].mem_policy)) == 0);
+      }
+      cnt = inst_vals_cnt(inst, &sv->pls[i]);
+      sv->inst_off[i] = (uint32_t) sv->inst_vals_cnt;
+      sv->inst_vals_cnt += cnt;
+      xpaths_size += cnt * (inst->stats_xpath_len + 1 + STATS_LEAF_LEN_MAX + 1);
+   }
+   sv->inst_off[snap->insts_cnt] = (uint32_t) sv->inst_vals_cnt;
+   for (uint32_t i = 0; i < snap->ifces_cnt; i++) {
+      ifc = &snap->ifces[i];
+      cnt = ifc_vals_cnt(ifc);
+      sv->ifc_off[i] = (uint32_t) sv->ifc_vals_cnt;
+      sv->ifc_vals_cnt += cnt;
+      xpaths_size += cnt * (ifc->stats_xpath_len + 1 + STATS_LEAF_LEN_MAX + 1);
+   }
+   sv->ifc_off[snap->ifces_cnt] = (uint32_t) sv->ifc_vals_cnt;
+
+   sv->inst_vals = calloc(sv->inst_vals_cnt + 1, sizeof(sr_val_t));
+   sv->ifc_vals = calloc(sv->ifc_vals_cnt + 1, sizeof(sr_val_t));
+   sv->xpaths = malloc(xpaths_size + 1);
+   if (sv->inst_vals == NULL || sv->ifc_vals == NULL || sv->xpaths == NULL) {
+      NO_MEM_ERR
       goto err_cleanup;
    }
 
-   res = sr_xpath_node_key_value(NULL, "name", &state);
-   if (res == NULL) {
-      VERBOSE(N_ERR, "Failed to parse tree_path_load on line %d", __LINE__)
-      goto err_cleanup;
-      return NULL;
+   lx.pos = sv->xpaths;
+   for (uint32_t i = 0; i < snap->insts_cnt; i++) {
+      lx.prefix = snap->insts[i].stats_xpath;
+      lx.prefix_len = snap->insts[i].stats_xpath_len;
+      inst_vals_fill(&sv->inst_vals[sv->inst_off[i]], &lx, &snap->insts[i], &sv->pls[i]);
    }
-   tpath->inst = strdup(res);
-   if (tpath->inst == NULL) {
-      NO_MEM_ERR
-      goto err_cleanup;
+   for (uint32_t i = 0; i < snap->ifces_cnt; i++) {
+      lx.prefix = snap->ifces[i].stats_xpath;
+      lx.prefix_len = snap->ifces[i].stats_xpath_len;
+      ifc_vals_fill(&sv->ifc_vals[sv->ifc_off[i]], &lx, &snap->ifces[i]);
    }
 
-   // /stats OR /interface[name='xxxx']
-   res = sr_xpath_next_node(NULL, &state);
-   if (res == NULL) {
-      VERBOSE(N_ERR, "Failed to parse tree_path_load on line %d", __LINE__)
-      goto err_cleanup;
-   }
+   return sv;
+
+err_cleanup:
+   stats_vals_free(sv);
+   VERBOSE(N_ERR, "Failed to build stats values")
 
-   if (strcmp(res, "stats") == 0) {
-      // No /interface node, return
-      sr_xpath_recover(&state);
-      NULLP_TEST_AND_FREE(dyn_xpath)
-      return tpath;
+   return NULL;
+}
+
+static void stats_vals_free(void *cache)
+{
+   stats_vals_t *sv = cache;
+
+   // Values reference data of the arena and placements, there is nothing else to free
+   NULLP_TEST_AND_FREE(sv->inst_vals)
+   NULLP_TEST_AND_FREE(sv->ifc_vals)
+   NULLP_TEST_AND_FREE(sv->xpaths)
+   NULLP_TEST_AND_FREE(sv->pls)
+   free(sv);
+}
+
+static const stats_vals_t * stats_vals_get(const stats_snap_t *snap)
+{
+   stats_vals_t *sv = stats_snap_cache_get(snap);
+   stats_vals_t *attached;
+
+   if (sv != NULL) {
+      return sv;
    }
 
-   res = sr_xpath_node_key_value(NULL, "name", &state);
-   if (res == NULL) {
-      VERBOSE(N_ERR, "Failed to parse tree_path_load on line %d", __LINE__)
-      goto err_cleanup;
+   sv = stats_vals_build(snap);
+   if (sv == NULL) {
       return NULL;
    }
-   tpath->ifc = strdup(res);
-   if (tpath->ifc == NULL) {
-      NO_MEM_ERR
-      goto err_cleanup;
+   attached = stats_snap_cache_set(snap, sv, stats_vals_free);
+   if (attached != sv) {
+      // Concurrent request of the same snapshot was faster
+      stats_vals_free(sv);
    }
 
-   return tpath;
+   return attached;
+}
 
-err_cleanup:
-   sr_xpath_recover(&state);
-   NULLP_TEST_AND_FREE(dyn_xpath)
-   tree_path_free(tpath);
-   VERBOSE(N_ERR, "Failed tree_path_load with XPATH=%s", xpath)
+static int stats_vals_dup(const sr_val_t *vals,
+                          size_t cnt,
+                          sr_val_t **values,
+                          size_t *values_cnt)
+{
+   int rc;
 
-   return NULL;
+   if (cnt == 0) {
+      *values = NULL;
+      *values_cnt = 0;
+      return SR_ERR_OK;
+   }
+
+   rc = sr_dup_values(vals, cnt, values);
+   if (rc != SR_ERR_OK) {
+      VERBOSE(N_ERR, "Failed to copy stats output values: %s", sr_strerror(rc))
+      return rc;
+   }
+   *values_cnt = cnt;
+
+   return SR_ERR_OK;
 }
 
-static void tree_path_free(tree_path_t * tpath)
+static void stats_val_set(sr_val_t *val,
+                          leaf_xpaths_t *lx,
+                          const char *stat_leaf_name,
+                          sr_type_t val_type,
+                          const void *val_data)
 {
-   if (tpath != NULL) {
-      NULLP_TEST_AND_FREE(tpath->inst)
-      NULLP_TEST_AND_FREE(tpath->ifc)
-      NULLP_TEST_AND_FREE(tpath)
+   size_t leaf_len = strlen(stat_leaf_name);
+
+   // <stats xpath>/<leaf>, prefix was built once when the instance was loaded
+   val->xpath = lx->pos;
+   memcpy(lx->pos, lx->prefix, lx->prefix_len);
+   lx->pos += lx->prefix_len;
+   *lx->pos++ = '/';
+   memcpy(lx->pos, stat_leaf_name, leaf_len + 1);
+   lx->pos += leaf_len + 1;
+
+   val->type = val_type;
+   switch (val_type) {
+      case SR_BOOL_T:
+         val->data.bool_val = *(const bool *) val_data;
+         break;
+      case SR_UINT8_T:
+         val->data.uint8_val = *(const uint8_t *) val_data;
+         break;
+      case SR_UINT32_T:
+         val->data.uint32_val = *(const uint32_t *) val_data;
+         break;
+      case SR_INT32_T:
+         val->data.int32_val = *(const int32_t *) val_data;
+         break;
+      case SR_UINT64_T:
+         val->data.uint64_val = *(const uint64_t *) val_data;
+         break;
+      case SR_STRING_T:
+         val->data.string_val = (char *) val_data;
+         break;
+      case SR_ENUM_T:
+         val->data.enum_val = (char *) val_data;
+         break;
+
+      default:
+         break;
    }
 }
 
-static interface_t * interface_get_by_xpath(const char *xpath)
+static int xpath_node_name(const char *xpath, const char *node, const char **val, size_t *len)
 {
-   tree_path_t *tpath = NULL;
-   inst_t *inst = NULL;
-   interface_t *ifc = NULL;
-
-   tpath = tree_path_load(xpath);
-   if (tpath == NULL) {
-      goto err_cleanup;
+   static const char key[] = "[name=";
+   size_t node_len = strlen(node);
+   const char *p = xpath;
+   const char *end;
+   char quote;
+
+   // Node has to be a whole step of the path, not a part of a name
+   while ((p = strstr(p, node)) != NULL) {
+      if (p > xpath && p[-1] == '/'
+          && (p[node_len] == '/' || p[node_len] == '[' || p[node_len] == '\0')) {
+         break;
+      }
+      p += node_len;
    }
-   if (tpath->ifc == NULL) {
-      VERBOSE(V2, "No interface parsed from given XPATH")
-      goto err_cleanup;
+   if (p == NULL || p[node_len] != '[') {
+      return 0;
    }
 
-   inst = inst_get_by_name(tpath->inst, NULL);
-   if (inst == NULL) {
-      VERBOSE(V2, "No instance named '%s' is loaded in supervisor", tpath->inst)
-      goto err_cleanup;
+   p += node_len;
+   if (strncmp(p, key, sizeof(key) - 1) != 0) {
+      return -1;
    }
+   p += sizeof(key) - 1;
+   quote = *p;
+   if (quote != '\'' && quote != '"') {
+      return -1;
+   }
+   end = strchr(++p, quote);
+   if (end == NULL || end[1] != ']') {
+      return -1;
+   }
+   *val = p;
+   *len = (size_t) (end - p);
 
-   vector_t *ifces_vec[2] = { &(inst->in_ifces), &(inst->out_ifces) };
-
-   for (uint32_t j = 0; j < 2; j++) {
-      for (uint32_t i = 0; i < ifces_vec[j]->total; i++) {
-         ifc = ifces_vec[j]->items[i];
+   return 1;
+}
 
-         if (strcmp(ifc->name, tpath->ifc) == 0) {
-            tree_path_free(tpath);
-            return ifc;
-         }
-      }
+static tree_path_t * tree_path_load(const char *xpath)
+{
+   tree_path_t *tpath = NULL;
+   const char *inst = NULL;
+   const char *ifc = NULL;
+   size_t inst_len = 0;
+   size_t ifc_len = 0;
+   int inst_found;
+   int ifc_found;
+   char *str;
+
+   // /instance[name='xxxx']/stats OR /instance[name='xxxx']/interface[name='xxxx']/stats
+   inst_found = xpath_node_name(xpath, "instance", &inst, &inst_len);
+   ifc_found = xpath_node_name(inst_found == 1 ? inst + inst_len : xpath, "interface",
+                               &ifc, &ifc_len);
+   if (inst_found == -1 || ifc_found == -1 || (inst_found == 0 && ifc_found == 1)) {
+      VERBOSE(N_ERR, "Failed to parse XPATH=%s", xpath)
+      return NULL;
    }
 
-   return ifc;
+   // Names are stored right after the structure, freed by single free
+   tpath = calloc(1, sizeof(tree_path_t) + inst_len + 1 + ifc_len + 1);
+   if (tpath == NULL) {
+      NO_MEM_ERR
+      return NULL;
+   }
+   str = (char *) (tpath + 1);
+   if (inst_found == 1) {
+      memcpy(str, inst, inst_len);
+      tpath->inst = str;
+      str += inst_len + 1;
+   }
+   if (ifc_found == 1) {
+      memcpy(str, ifc, ifc_len);
+      tpath->ifc = str;
+   }
 
-err_cleanup:
-   tree_path_free(tpath);
-   VERBOSE(N_ERR, "Failed interface_get_by_xpath with XPATH=%s", xpath)
+   return tpath;
+}
 
-   return NULL;
-}
\ No newline at end of file
+static void tree_path_free(tree_path_t * tpath)
+{
+   NULLP_TEST_AND_FREE(tpath)
+}
@@ -10,6 +10,8 @@
 
 /**
  * @brief Callback that should be subscribed at /nemea:supervisor/instance/interface/stats to provide stats about interfaces.
+ * @details XPATH without name of interface selects all interfaces of the instance, XPATH
+ *  without name of instance selects all interfaces of all instances.
  * @param xpath Received XPATH of interface
  * @param[out] values Array of returned values
  * @param[out] values_cnt Size of returned array
@@ -23,6 +25,7 @@ extern int interface_get_stats_cb(const char *xpath,
 
 /**
  * @brief Callback that should be subscribed at /nemea:supervisor/instance/stats to provide stats about instances.
+ * @details XPATH without name of instance selects all instances.
  * @param xpath Received XPATH of instance
  * @param[out] values Array of returned values
  * @param[out] values_cnt Size of returned array
@@ -0,0 +1,381 @@
+/**
+ * @file statsnap.c
+ * @brief Implementation of functions defined in statsnap.h
+ */
+
+#include <stdatomic.h>
+#include "statsnap.h"
+
+static _Atomic(stats_snap_t *) snap_cur = NULL; ///< Published snapshot
+static atomic_uint_fast64_t snap_epoch = 1; ///< Global epoch, advanced by every publication
+static atomic_uint_fast64_t snap_readers[STATS_SNAP_READERS]; ///< Epochs announced by
+                                                              ///<  readers, 0 for free slot
+static atomic_uint snap_next_slot = 0; ///< Slot the next reader starts looking from
+static stats_snap_t *snap_retired = NULL; ///< Replaced snapshots, guarded by config_lock
+
+
+/**
+ * @brief Allocates snapshot of instances in insts_v
+ * @return Snapshot or NULL on error
+ * */
+static stats_snap_t * stats_snap_build();
+
+/**
+ * @brief Copies statistics of given interface
+ * @param ifc Interface to copy
+ * @param is Interface of snapshot to fill, its name is set by caller
+ * */
+static void ifc_snap_fill(const interface_t *ifc, ifc_snap_t *is);
+
+/**
+ * @brief Copies statistics of given instance, except for name and interfaces
+ * @param inst Instance to copy
+ * @param is Instance of snapshot to fill
+ * */
+static void inst_snap_fill(const inst_t *inst, inst_snap_t *is);
+
+/**
+ * @brief Returns length of stats XPATH of instance or interface. XPATH is formatted from
+ *  names if there is none, i.e. instance wasn't loaded from configuration.
+ * @param xpath Stored XPATH or NULL
+ * @param inst_name Name of instance
+ * @param ifc_name Name of interface or NULL for instance
+ * @return Length of XPATH
+ * */
+static size_t snap_xpath_len(const char *xpath, const char *inst_name, const char *ifc_name);
+
+/**
+ * @brief Copies stats XPATH to strings of snapshot, see snap_xpath_len.
+ * @param str Position in strings of snapshot, moved past the copy
+ * @param len Length returned by snap_xpath_len
+ * @param xpath Stored XPATH or NULL
+ * @param inst_name Name of instance
+ * @param ifc_name Name of interface or NULL for instance
+ * @return Copied XPATH
+ * */
+static const char * snap_xpath_copy(char **str, size_t len, const char *xpath,
+                                    const char *inst_name, const char *ifc_name);
+
+/**
+ * @brief Compares names of two instances of snapshot, qsort callback
+ * */
+static int inst_snap_name_cmp(const void *a, const void *b);
+
+/**
+ * @brief Frees retired snapshots that no reader can use anymore
+ * */
+static void stats_snap_reclaim();
+
+/**
+ * @brief Frees snapshot together with its cache
+ * @param snap Snapshot to free
+ * */
+static void stats_snap_destroy(stats_snap_t *snap);
+
+
+static void ifc_snap_fill(const interface_t *ifc, ifc_snap_t *is)
+{
+   const ifc_in_stats_t *in_stats;
+   const ifc_out_stats_t *out_stats;
+
+   is->direction = ifc->direction;
+   if (ifc->stats == NULL) {
+      return;
+   }
+   if (ifc->direction == NS_IF_DIR_IN) {
+      in_stats = ifc->stats;
+      is->recv_msg_cnt = in_stats->recv_msg_cnt;
+      is->recv_buff_cnt = in_stats->recv_buff_cnt;
+   } else {
+      out_stats = ifc->stats;
+      is->sent_msg_cnt = out_stats->sent_msg_cnt;
+      is->sent_buff_cnt = out_stats->sent_buff_cnt;
+      is->dropped_msg_cnt = out_stats->dropped_msg_cnt;
+      is->autoflush_cnt = out_stats->autoflush_cnt;
+   }
+}
+
+static void inst_snap_fill(const inst_t *inst, inst_snap_t *is)
+{
+   is->pid = INST_PID(inst);
+   is->running = INST_RUNNING(inst);
+   // restarts_cnt gets reset once restart window of the instance closes
+   is->restarts_cnt = inst->restarts_cnt;
+   is->cpu_user = inst->last_cpu_perc_umode;
+   is->cpu_kern = inst->last_cpu_perc_kmode;
+   is->mem_vms = inst->mem_vms;
+   is->mem_rss = inst->mem_rss;
+   is->start_time = inst->start_time;
+   is->has_cgroup = (inst->cg.dir_fd != -1);
+   is->mem_peak = inst->mem_peak;
+   is->io_read_bytes = inst->io_read_bytes;
+   is->io_write_bytes = inst->io_write_bytes;
+   is->last_exit = inst->last_exit;
+   is->backoff_ms = inst->backoff_ms;
+   // Counters exist only for instances which output went through log pipes
+   is->has_logs = (inst->log_out.path != NULL);
+   is->log_bytes_written = inst->log_out.bytes_written + inst->log_err.bytes_written;
+   is->log_bytes_dropped = inst->log_out.bytes_dropped + inst->log_err.bytes_dropped;
+}
+
+static int inst_snap_name_cmp(const void *a, const void *b)
+{
+   const inst_snap_t *ia = *(const inst_snap_t **) a;
+   const inst_snap_t *ib = *(const inst_snap_t **) b;
+
+   return strcmp(ia->name, ib->name);
+}
+
+static size_t snap_xpath_len(const char *xpath, const char *inst_name, const char *ifc_name)
+{
+   if (xpath != NULL) {
+      return strlen(xpath);
+   }
+   return (size_t) stats_xpath_format(NULL, 0, inst_name, ifc_name);
+}
+
+static const char * snap_xpath_copy(char **str, size_t len, const char *xpath,
+                                    const char *inst_name, const char *ifc_name)
+{
+   char *copy = *str;
+
+   if (xpath != NULL) {
+      memcpy(copy, xpath, len + 1);
+   } else {
+      stats_xpath_format(copy, len + 1, inst_name, ifc_name);
+   }
+   *str += len + 1;
+
+   return copy;
+}
+
+static stats_snap_t * stats_snap_build()
+{
+   const vector_t *ifces_vec[2];
+   const interface_t *ifc;
+   const inst_t *inst;
+   stats_snap_t *snap;
+   inst_snap_t *insts;
+   ifc_snap_t *ifces;
+   char *str;
+   uint32_t cnt = insts_v.total;
+   uint32_t ifces_cnt = 0;
+   size_t str_len = 0;
+   size_t len;
+   uint32_t fi = 0;
+
+   for (uint32_t i = 0; i < cnt; i++) {
+      inst = insts_v.items[i];
+      str_len += strlen(inst->name != NULL ? inst->name : "") + 1;
+      str_len += snap_xpath_len(inst->stats_xpath, inst->name, NULL) + 1;
+      ifces_vec[0] = &inst->in_ifces;
+      ifces_vec[1] = &inst->out_ifces;
+      for (int j = 0; j < 2; j++) {
+         for (uint32_t k = 0; k < ifces_vec[j]->total; k++) {
+            ifc = ifces_vec[j]->items[k];
+            str_len += strlen(ifc->name != NULL ? ifc->name : "") + 1;
+            str_len += snap_xpath_len(ifc->stats_xpath, inst->name, ifc->name) + 1;
+            ifces_cnt++;
+         }
+      }
+   }
+
+   // Everything in one block, so that reclamation is a single free
+   snap = calloc(1, sizeof(stats_snap_t) + cnt * (sizeof(inst_snap_t) + sizeof(inst_snap_t *))
+                    + ifces_cnt * sizeof(ifc_snap_t) + str_len);
+   if (snap == NULL) {
+      NO_MEM_ERR
+      return NULL;
+   }
+   insts = (inst_snap_t *) (snap + 1);
+   snap->by_name = (const inst_snap_t **) (insts + cnt);
+   ifces = (ifc_snap_t *) (snap->by_name + cnt);
+   str = (char *) (ifces + ifces_cnt);
+   snap->insts = insts;
+   snap->insts_cnt = cnt;
+   snap->ifces = ifces;
+   snap->ifces_cnt = ifces_cnt;
+
+   for (uint32_t i = 0; i < cnt; i++) {
+      inst = insts_v.items[i];
+      len = strlen(inst->name != NULL ? inst->name : "") + 1;
+      memcpy(str, inst->name != NULL ? inst->name : "", len);
+      insts[i].name = str;
+      str += len;
+      len = snap_xpath_len(inst->stats_xpath, inst->name, NULL);
+      insts[i].stats_xpath = snap_xpath_copy(&str, len, inst->stats_xpath, inst->name, NULL);
+      insts[i].stats_xpath_len = (uint32_t) len;
+      inst_snap_fill(inst, &insts[i]);
+
+      insts[i].ifces = &ifces[fi];
+      ifces_vec[0] = &inst->in_ifces;
+      ifces_vec[1] = &inst->out_ifces;
+      for (int j = 0; j < 2; j++) {
+         for (uint32_t k = 0; k < ifces_vec[j]->total; k++) {
+            ifc = ifces_vec[j]->items[k];
+            len = strlen(ifc->name != NULL ? ifc->name : "") + 1;
+            memcpy(str, ifc->name != NULL ? ifc->name : "", len);
+            ifces[fi].name = str;
+            str += len;
+            len = snap_xpath_len(ifc->stats_xpath, inst->name, ifc->name);
+            ifces[fi].stats_xpath = snap_xpath_copy(&str, len, ifc->stats_xpath,
+                                                    inst->name, ifc->name);
+            ifces[fi].stats_xpath_len = (uint32_t) len;
+            ifc_snap_fill(ifc, &ifces[fi++]);
+         }
+      }
+      insts[i].ifces_cnt = (uint32_t) (&ifces[fi] - insts[i].ifces);
+      snap->by_name[i] = &insts[i];
+   }
+   qsort(snap->by_name, cnt, sizeof(inst_snap_t *), inst_snap_name_cmp);
+
+   return snap;
+}
+
+int stats_snap_publish()
+{
+   stats_snap_t *snap = stats_snap_build();
+   stats_snap_t *old;
+
+   if (snap == NULL) {
+      return -1;
+   }
+
+   old = atomic_exchange(&snap_cur, snap);
+   if (old != NULL) {
+      // Readers that announced this epoch or older one might still use old snapshot
+      old->retire_epoch = atomic_fetch_add(&snap_epoch, 1);
+      old->next_retired = snap_retired;
+      snap_retired = old;
+   }
+   stats_snap_reclaim();
+
+   return 0;
+}
+
+static void stats_snap_reclaim()
+{
+   uint64_t min_epoch = UINT64_MAX;
+   uint64_t epoch;
+   stats_snap_t **prev = &snap_retired;
+   stats_snap_t *snap;
+
+   for (uint32_t i = 0; i < STATS_SNAP_READERS; i++) {
+      epoch = atomic_load(&snap_readers[i]);
+      if (epoch != 0 && epoch < min_epoch) {
+         min_epoch = epoch;
+      }
+   }
+
+   while ((snap = *prev) != NULL) {
+      if (snap->retire_epoch < min_epoch) {
+         *prev = snap->next_retired;
+         stats_snap_destroy(snap);
+      } else {
+         prev = &snap->next_retired;
+      }
+   }
+}
+
+static void stats_snap_destroy(stats_snap_t *snap)
+{
+   void *cache = atomic_load(&snap->cache);
+
+   if (cache != NULL) {
+      snap->cache_free(cache);
+   }
+   free(snap);
+}
+
+const stats_snap_t * stats_snap_acquire(uint32_t *slot)
+{
+   uint64_t epoch = atomic_load(&snap_epoch);
+   uint32_t i = atomic_fetch_add(&snap_next_slot, 1) % STATS_SNAP_READERS;
+   uint_fast64_t free_slot;
+
+   // Each failed attempt means the slot is taken, the next one is tried
+   for (;; i = (i + 1) % STATS_SNAP_READERS) {
+      free_slot = 0;
+      if (atomic_compare_exchange_strong(&snap_readers[i], &free_slot, epoch)) {
+         break;
+      }
+   }
+   *slot = i;
+
+   // Writer that didn't see the announcement has already published the new snapshot
+   return atomic_load(&snap_cur);
+}
+
+void stats_snap_release(uint32_t slot)
+{
+   atomic_store(&snap_readers[slot], 0);
+}
+
+const inst_snap_t * stats_snap_inst_get(const stats_snap_t *snap, const char *name)
+{
+   uint32_t lo = 0;
+   uint32_t hi = snap->insts_cnt;
+   uint32_t mid;
+   int cmp;
+
+   while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      cmp = strcmp(snap->by_name[mid]->name, name);
+      if (cmp == 0) {
+         return snap->by_name[mid];
+      }
+      if (cmp < 0) {
+         lo = mid + 1;
+      } else {
+         hi = mid;
+      }
+   }
+
+   return NULL;
+}
+
+const ifc_snap_t * stats_snap_ifc_get(const inst_snap_t *is, const char *name)
+{
+   for (uint32_t i = 0; i < is->ifces_cnt; i++) {
+      if (strcmp(is->ifces[i].name, name) == 0) {
+         return &is->ifces[i];
+      }
+   }
+
+   return NULL;
+}
+
+void * stats_snap_cache_get(const stats_snap_t *snap)
+{
+   return atomic_load(&((stats_snap_t *) snap)->cache);
+}
+
+void * stats_snap_cache_set(const stats_snap_t *snap, void *cache,
+                            stats_snap_cache_free_t cache_free)
+{
+   stats_snap_t *s = (stats_snap_t *) snap;
+   void *cur = NULL;
+
+   if (atomic_compare_exchange_strong(&s->cache, &cur, cache)) {
+      // Read only once the snapshot is retired and its last reader released it
+      s->cache_free = cache_free;
+      return cache;
+   }
+
+   return cur;
+}
+
+void stats_snap_free()
+{
+   stats_snap_t *snap = atomic_exchange(&snap_cur, NULL);
+   stats_snap_t *next;
+
+   if (snap != NULL) {
+      stats_snap_destroy(snap);
+   }
+   for (snap = snap_retired; snap != NULL; snap = next) {
+      next = snap->next_retired;
+      stats_snap_destroy(snap);
+   }
+   snap_retired = NULL;
+}
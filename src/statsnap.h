@@ -0,0 +1,153 @@
+/**
+ * @file statsnap.h
+ * @brief Published snapshot of statistics of instances and their interfaces.
+ * @details Statistics are maintained by supervisor_routine under config_lock, while sysrepo
+ *  data provider callbacks run in threads of sysrepo. Instead of reading inst_t, which might
+ *  be modified or freed meanwhile, callbacks read immutable snapshot of all instances.
+ *
+ *  Snapshot is built by supervisor_routine (and by configuration change callback) with
+ *  config_lock held and published by swapping a single pointer. Replaced snapshot is freed
+ *  using epoch based reclamation: reader announces global epoch in one of reader slots for
+ *  the time it uses the snapshot, writer advances the epoch on every publication and frees
+ *  retired snapshots only once no reader announced epoch of their retirement or older one.
+ *  Readers never wait for the writer nor for each other, unless there are more concurrent
+ *  readers than STATS_SNAP_READERS.
+ */
+
+#ifndef STATSNAP_H
+#define STATSNAP_H
+
+#include <stdatomic.h>
+#include "module.h"
+
+#define STATS_SNAP_READERS 64 ///< Number of reader slots, i.e. readers that don't wait
+#define STATS_SNAP_PERIOD_MS 100 ///< Minimum period between publications by supervisor_routine
+
+/**
+ * @brief Statistics of one interface
+ * */
+typedef struct ifc_snap_s {
+   const char *name; ///< Name of interface
+   const char *stats_xpath; ///< XPATH of its stats container
+   uint32_t stats_xpath_len; ///< Length of stats_xpath
+   interface_dir_t direction; ///< Direction, decides which counters are valid
+   uint64_t recv_msg_cnt; ///< IN interface only
+   uint64_t recv_buff_cnt; ///< IN interface only
+   uint64_t sent_msg_cnt; ///< OUT interface only
+   uint64_t sent_buff_cnt; ///< OUT interface only
+   uint64_t dropped_msg_cnt; ///< OUT interface only
+   uint64_t autoflush_cnt; ///< OUT interface only
+} ifc_snap_t;
+
+/**
+ * @brief Statistics of one instance, see inst_t for meaning of fields
+ * */
+typedef struct inst_snap_s {
+   const char *name; ///< Name of instance
+   const char *stats_xpath; ///< XPATH of its stats container
+   uint32_t stats_xpath_len; ///< Length of stats_xpath
+   pid_t pid; ///< PID of the process, valid only if running
+   bool running;
+   uint8_t restarts_cnt;
+   uint64_t cpu_user; ///< last_cpu_perc_umode
+   uint64_t cpu_kern; ///< last_cpu_perc_kmode
+   uint64_t mem_vms;
+   uint64_t mem_rss;
+   time_t start_time;
+   bool has_cgroup; ///< Whether mem_peak and io_* are valid
+   uint64_t mem_peak;
+   uint64_t io_read_bytes;
+   uint64_t io_write_bytes;
+   inst_exit_info_t last_exit;
+   uint32_t backoff_ms;
+   bool has_logs; ///< Whether log_bytes_* are valid
+   uint64_t log_bytes_written; ///< Sum of stdout and stderr
+   uint64_t log_bytes_dropped; ///< Sum of stdout and stderr
+   uint32_t ifces_cnt; ///< Number of interfaces
+   const ifc_snap_t *ifces; ///< IN interfaces followed by OUT interfaces
+} inst_snap_t;
+
+/**
+ * @brief Frees data readers derived from snapshot, see stats_snap_cache_set
+ * */
+typedef void (*stats_snap_cache_free_t)(void *cache);
+
+/**
+ * @brief Snapshot of all instances, allocated as one block
+ * */
+typedef struct stats_snap_s {
+   uint32_t insts_cnt; ///< Number of instances
+   const inst_snap_t *insts; ///< Instances in configuration order
+   const inst_snap_t **by_name; ///< Instances sorted by name
+   uint32_t ifces_cnt; ///< Number of interfaces of all instances
+   const ifc_snap_t *ifces; ///< Interfaces of all instances, ifces of each instance point here
+   _Atomic(void *) cache; ///< Data derived by readers, the only mutable part of snapshot
+   stats_snap_cache_free_t cache_free; ///< Frees cache, set together with it
+   uint64_t retire_epoch; ///< Epoch the snapshot was replaced in
+   struct stats_snap_s *next_retired; ///< Next snapshot waiting to be freed
+} stats_snap_t;
+
+/**
+ * @brief Builds snapshot of instances in insts_v and publishes it, previous snapshot is
+ *  freed once no reader uses it.
+ * @details Has to be called with config_lock held.
+ * @return 0 on success, -1 on error (previous snapshot stays published)
+ * */
+extern int stats_snap_publish();
+
+/**
+ * @brief Gets current snapshot for reading. Every call has to be paired with
+ *  stats_snap_release, snapshot mustn't be used afterwards.
+ * @param[out] slot Reader slot to pass to stats_snap_release
+ * @return Snapshot or NULL if nothing was published yet
+ * */
+extern const stats_snap_t * stats_snap_acquire(uint32_t *slot);
+
+/**
+ * @brief Ends reading of snapshot acquired by stats_snap_acquire.
+ * @param slot Reader slot returned by stats_snap_acquire
+ * */
+extern void stats_snap_release(uint32_t slot);
+
+/**
+ * @brief Finds instance of given name in snapshot.
+ * @param snap Snapshot to search
+ * @param name Name of instance
+ * @return Instance or NULL if not found
+ * */
+extern const inst_snap_t * stats_snap_inst_get(const stats_snap_t *snap, const char *name);
+
+/**
+ * @brief Finds interface of given name of instance in snapshot.
+ * @param is Instance from snapshot
+ * @param name Name of interface
+ * @return Interface or NULL if not found
+ * */
+extern const ifc_snap_t * stats_snap_ifc_get(const inst_snap_t *is, const char *name);
+
+/**
+ * @brief Gets data derived from snapshot by stats_snap_cache_set.
+ * @param snap Acquired snapshot
+ * @return Cache or NULL if it wasn't set yet
+ * */
+extern void * stats_snap_cache_get(const stats_snap_t *snap);
+
+/**
+ * @brief Attaches data derived from snapshot to it, so that readers of the same snapshot
+ *  don't derive it again. Cache is freed together with the snapshot.
+ * @details Concurrent readers may build the cache at the same time, only the first one is
+ *  attached. Caller has to free its cache if other one is returned.
+ * @param snap Acquired snapshot
+ * @param cache Data to attach
+ * @param cache_free Function to free the cache with
+ * @return Attached cache, i.e. given one or the one of faster reader
+ * */
+extern void * stats_snap_cache_set(const stats_snap_t *snap, void *cache,
+                                   stats_snap_cache_free_t cache_free);
+
+/**
+ * @brief Frees published and retired snapshots at exit, there mustn't be any readers.
+ * */
+extern void stats_snap_free();
+
+#endif
@@ -5,6 +5,7 @@
 #include <limits.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/signalfd.h>
 #include <sysrepo.h>
 #include <sysrepo/trees.h>
 #include <sysrepo/values.h>
@@ -16,18 +17,14 @@
 #include "stats.h"
 #include "service.h"
 #include "main.h"
+#include "evloop.h"
+#include "proc_stats.h"
+#include "cgroup.h"
+#include "autoplace.h"
+#include "statsnap.h"
 
 
 #define PROGRAM_IDENTIFIER_FSR "nemea-supervisor" ///< Program identifier supplied to Sysrepo
-#define NUM_SERVICE_IFC_PERIOD 30 ///< Defines number of supervisor_routine loops to take before reconnecting again
-/**
- * @brief Time in micro seconds for which the service thread spends sleeping
- *  after each period.
- * @details The period means all tasks service thread has to complete -
- *  restart/stop instances according to their enable flag, receive their
- *  statistics etc.
- */
-#define SERVICE_THREAD_SLEEP_IN_MICSEC 1500000
 
 
 /**
@@ -39,16 +36,38 @@ typedef struct sr_conn_link_s {
  sr_subscription_ctx_t *subscr; ///< Sysrepo subscription for runtime changes and statistics requests
 } sr_conn_link_t;
 
+/**
+ * @brief Event sources and cadences of supervisor_routine
+ * @details Exits of instances are handled as soon as SIGCHLD or pidfd event arrives and
+ *  SIGKILL deadlines wake the routine up on their own. Liveness timer only retries starts
+ *  and polls instances which exit can't be observed otherwise. Resources and service
+ *  interface cadences are kept per instance, see insts_schedule_sampling().
+ * */
+typedef struct routine_events_s {
+   ev_source_t *signal_src; ///< Signalfd for SIGCHLD and termination signals
+   tw_timer_t liveness_timer; ///< Periodic fallback check of instances
+   bool resources_pending; ///< Some instance is due for resources sampling
+   bool service_ifc_pending; ///< Some instance is due for service interface request
+   tw_timer_t stats_timer; ///< Deferred publication of stats snapshot
+   uint64_t stats_published_ms; ///< Monotonic time stats snapshot was last published at
+} routine_events_t;
+
 
 bool supervisor_stopped = false; ///< Controls loop of supervisor_routine
 bool supervisor_initialized = false; ///< Specifies whether supervisor_initialization completed successfully
 bool terminate_insts_at_exit = false; ///< Specifies whether signal handler wants to terminate all instances at exit
 int supervisor_exit_code = EXIT_SUCCESS; ///< What exit code to return at exit
-uint64_t last_total_cpu = 0; ///< Variable with total cpu usage of whole operating system
+bool liveness_check_pending = false; ///< Set by event handlers that need instances to be checked
 sr_conn_link_t sr_conn_link = {
       .conn = NULL,
       .sess = NULL,
 }; ///< Sysrepo connection link
+sigset_t routine_sigmask; ///< Signals handled via signalfd inside supervisor_routine
+routine_events_t routine_evs = {
+      .signal_src = NULL,
+      .resources_pending = false,
+      .service_ifc_pending = false,
+}; ///< Event sources of supervisor_routine
 
 /**
  * @brief Validates if file at given path is directory and has valid permissions
@@ -83,17 +102,101 @@ static int load_configuration();
 static void sig_handler(int catched_signal);
 
 /**
- * @brief Tries to fetch stats about interfaces from libtrap's service interface
+ * @brief Sends requests for stats about interfaces to libtrap's service interface
+ *  of instances that are due and connects to the ones that are not connected yet.
+ * @details Replies are received once the service socket of instance becomes readable.
+ * */
+static inline void send_service_ifces_requests();
+
+/**
+ * @brief Blocks signals that are handled via signalfd inside supervisor_routine.
+ * @details Has to be called before any thread is created so that the mask is inherited.
+ * @param mask[out] Set of blocked signals
+ * @return -1 on error, 0 on success
+ * */
+static int block_routine_signals(sigset_t *mask);
+
+/**
+ * @brief Registers signalfd and timers of supervisor_routine inside main event loop.
+ * @return -1 on error, 0 on success
+ * */
+static int routine_register_events();
+
+/**
+ * @brief Removes signalfd and timers of supervisor_routine from main event loop.
+ * */
+static void routine_unregister_events();
+
+/**
+ * @brief Handler of signalfd, dispatches SIGCHLD and termination signals.
+ * @param events Epoll events
+ * @param priv unused
+ * */
+static void signalfd_handler(uint32_t events, void *priv);
+
+/**
+ * @brief Returns delay until the next multiple of period on monotonic clock.
+ * @details Instances with the same period get due at the same tick, so that they are
+ *  handled by one pass.
+ * @param now Current monotonic time in milliseconds
+ * @param period_ms Period in milliseconds
+ * @return Delay in milliseconds
+ * */
+static inline uint64_t period_aligned_delay(uint64_t now, uint32_t period_ms);
+
+/**
+ * @brief Expire function of liveness timer.
+ * @param priv unused
+ * */
+static void liveness_timer_cb(void *priv);
+
+/**
+ * @brief Expire function of resources timer of instance, marks the instance as due.
+ * @param priv Instance
+ * */
+static void inst_resources_timer_cb(void *priv);
+
+/**
+ * @brief Expire function of service interface timer of instance, marks the instance as due.
+ * @param priv Instance
+ * */
+static void inst_service_ifc_timer_cb(void *priv);
+
+/**
+ * @brief Expire function of stats timer, the wake up itself leads to publication.
+ * @param priv unused
+ * */
+static void stats_timer_cb(void *priv);
+
+/**
+ * @brief Publishes stats snapshot for sysrepo callbacks, at most once per
+ *  STATS_SNAP_PERIOD_MS. Publication that is too early is deferred by stats timer,
+ *  so that the final state after a burst of events gets published as well.
+ * */
+static void stats_publish_limited();
+
+/**
+ * @brief Arms cadence timers of instances that have none armed yet.
+ * @details All timers are re-armed in case intervals were reloaded.
+ * */
+static void insts_schedule_sampling();
+
+/**
+ * @brief Starts, stops and releases instances according to their state.
  * */
-static inline void get_service_ifces_stats();
+static void insts_check_liveness();
 
 /**
- * @brief Wrapper function for inst_get_sys_stats and inst_get_vmrss
+ * @brief Wrapper function for inst_get_sys_stats and inst_get_vmrss, samples
+ *  running instances that are due
+ * @details /proc/stat is read once per pass and all instances sampled by the pass
+ *  share the same total CPU time.
  * */
 static void insts_update_resources_usage();
 
 /**
  * @brief Reads /proc/stat to compute total cpu usage
+ * @details /proc/stat is opened on first call and then only re-read.
  * @param total_cpu_usage Return pointer for total CPU usage
  * @return -1 on error, 0 on success
  * */
@@ -101,12 +204,32 @@ static int get_total_cpu_usage(uint64_t *total_cpu_usage);
 
 /**
  * @brief Parses /proc/PID/stat and loads CPU and vms
+ * @details Instance's /proc descriptors have to be open. CPU usage is computed against
+ *  total CPU time elapsed since previous sample of the instance. First sample of
+ *  instance process only sets the baseline.
  * @param inst Instance to load stats to
+ * @param total_cpu Total CPU time of system read by current pass
+ * */
+static inline void inst_get_sys_stats(inst_t *inst, uint64_t total_cpu);
+
+/**
+ * @brief Loads CPU and memory usage of instance placed into cgroup from its leaf.
+ * @details Accounting covers all processes of the instance including its children.
+ *  Total CPU time is wall clock time multiplied by number of CPUs, so that percentages
+ *  have the same meaning as the ones computed from /proc. Only VMS, which has no
+ *  counterpart in cgroup, is read from /proc/PID/stat.
+ * @param inst Running instance with prepared leaf
  * */
-static inline void inst_get_sys_stats(inst_t *inst);
+static void inst_get_cgroup_stats(inst_t *inst);
 
 /**
- * @brief Loads vmrss from /proc/PID/status
+ * @brief Returns number of online CPUs, it is read only once.
+ * */
+static uint64_t online_cpus_cnt();
+
+/**
+ * @brief Loads vmrss from /proc/PID/statm
+ * @details Instance's /proc descriptors have to be open.
  * @param inst Instance for which vmrss should be found out
  * */
 static inline void inst_get_vmrss(inst_t *inst);
@@ -189,6 +312,27 @@ int supervisor_initialization()
    // Initialize main mutex
    pthread_mutex_init(&config_lock, NULL);
 
+   /* Signals handled by supervisor_routine have to be blocked before sysrepo
+    * spawns its threads, otherwise they could be delivered to them */
+   if (block_routine_signals(&routine_sigmask) != 0) {
+      return -1;
+   }
+
+   if (evloop_init(&main_evloop, &config_lock) != 0) {
+      VERBOSE(N_ERR, "Failed to initialize event loop")
+      return -1;
+   }
+
+   // Supervisor runs without cgroups if they are not delegated to it
+   (void) cgroup_init();
+   // Without topology instances are started without automatic placement
+   (void) autoplace_init();
+
+   // Thread inherits blocked signals
+   if (service_collector_start() != 0) {
+      return -1;
+   }
+
 
    // Connect to sysrepo
    rc = sr_connect(PROGRAM_IDENTIFIER_FSR, SR_CONN_DEFAULT, &sr_conn_link.conn);
@@ -263,7 +407,7 @@ int supervisor_initialization()
       VERBOSE(V2, "Susbscribed to %s", NS_ROOT_XPATH"/instance/interface/stats")
    }
 
-   // Signal handling
+   // Signal handling, SIGINT, SIGTERM and SIGQUIT are read from signalfd in supervisor_routine
    struct sigaction sig_action;
    sig_action.sa_handler = sig_handler;
    sig_action.sa_flags = 0;
@@ -272,18 +416,9 @@ int supervisor_initialization()
    if (sigaction(SIGPIPE, &sig_action, NULL) == -1) {
       VERBOSE(N_ERR, "Sigaction: signal handler won't catch SIGPIPE!")
    }
-   if (sigaction(SIGINT, &sig_action, NULL) == -1) {
-      VERBOSE(N_ERR, "Sigaction: signal handler won't catch SIGINT!")
-   }
-   if (sigaction(SIGTERM, &sig_action, NULL) == -1) {
-      VERBOSE(N_ERR, "Sigaction: signal handler won't catch SIGTERM!")
-   }
    if (sigaction(SIGSEGV, &sig_action, NULL) == -1) {
       VERBOSE(N_ERR, "Sigaction: signal handler won't catch SIGSEGV!")
    }
-   if (sigaction(SIGQUIT,&sig_action, NULL) == -1) {
-      VERBOSE(N_ERR, "action: signal handler won't catch SIGQUIT!")
-   }
 
    supervisor_initialized = true;
    VERBOSE(V3, "Supervisor successfuly initialized")
@@ -309,10 +444,16 @@ void terminate_supervisor(bool should_terminate_insts)
       }
    }
 
+   // Collector publishes to instances, stop it before they are freed
+   service_collector_stop();
+   stats_snap_free();
    VERBOSE(V3, "Freeing instances vector")
    insts_free();
+   cgroup_deinit();
+   autoplace_deinit();
    VERBOSE(V3, "Freeing modules vector")
    av_modules_free();
+   evloop_free(&main_evloop);
    VERBOSE(V3, "Freeing output strigns and streams")
    close_log();
 
@@ -334,37 +475,6 @@ void terminate_supervisor(bool should_terminate_insts)
 
 }
 
-void check_insts_connections()
-{
-    inst_t * inst = NULL;
-    bool inst_not_connected;
-
-    for (uint32_t i = 0; i < insts_v.total; i++) {
-       inst = insts_v.items[i];
-
-       // Only connect to modules that implement TRAP service interface
-       if (inst->mod_ref->trap_mon == false) {
-          continue;
-       }
-
-       inst_not_connected = (inst->service_ifc_connected == false);
-       // Check connection between instance and supervisor
-       if (inst->running && inst_not_connected) {
-          // Connect to instances only once per NUM_SERVICE_IFC_PERIOD
-          inst->service_ifc_conn_timer++;
-          if ((inst->service_ifc_conn_timer % NUM_SERVICE_IFC_PERIOD) == 1) {
-             // Check inst socket descriptor, closed socket has descriptor set to -1
-             if (inst->service_sd != -1) {
-                close(inst->service_sd);
-                inst->service_sd = -1;
-             }
-             VERBOSE(V3, "Trying to connect to inst '%s'", inst->name)
-             connect_to_inst(inst);
-          }
-       }
-    }
-}
-
 static int check_dir_perm(char *path, int perm)
 {
    struct stat st;
@@ -458,6 +568,10 @@ int load_configuration()
 
    pthread_mutex_lock(&config_lock);
    rc = ns_startup_config_load(sr_conn_link.sess);
+   if (rc == 0) {
+      // Stats can be requested as soon as callbacks are subscribed
+      rc = stats_snap_publish();
+   }
    pthread_mutex_unlock(&config_lock);
    if (rc != 0) {
       VERBOSE(N_ERR, "Failed to load config from sysrepo tree")
@@ -520,281 +634,427 @@ static void sig_handler(int catched_signal)
 
 void supervisor_routine()
 {
-   uint32_t running_insts_cnt = 0;
+   int timeout;
 
    VERBOSE(V3, "Starting supervisor routine")
-   while (supervisor_stopped == false) {
-      VERBOSE(V3, "-----routine loop-----")
+   if (routine_register_events() != 0) {
+      VERBOSE(N_ERR, "Failed to register events of supervisor routine")
+      supervisor_exit_code = EXIT_FAILURE;
+      supervisor_stopped = true;
+   }
 
+   // Start instances right away, don't wait for the first timer expiration
+   liveness_check_pending = true;
+
+   while (supervisor_stopped == false) {
       /* Lock instances list so that async changes from sysrepo don't
        * interfere with this routine */
       pthread_mutex_lock(&config_lock);
-      {
-         // Start instances that should be running
-         insts_start();
-         running_insts_cnt = get_running_insts_cnt();
-         VERBOSE(V3, "Found %d running instances", running_insts_cnt)
-
-         // Check which instances need to be killed and kill them
-         VERBOSE(V3, "Trying to kill instances that should die")
-         insts_stop_sigint();
-         insts_stop_sigkill();
-         running_insts_cnt = get_running_insts_cnt();
-         VERBOSE(V3, "Found %d running instances", running_insts_cnt)
-
-         // Update CPU and memory usage
+      // Only instances which deadlines expired are touched
+      tw_advance(&main_wheel, get_mono_time_ms());
+      if (liveness_check_pending || main_evloop.woken_up) {
+         liveness_check_pending = false;
+         main_evloop.woken_up = false;
+         insts_check_liveness();
+         insts_schedule_sampling();
+      }
+      if (routine_evs.resources_pending) {
+         routine_evs.resources_pending = false;
          insts_update_resources_usage();
-
-         // Handle connection between supervisor and instances via service interface
-         check_insts_connections();
-         get_service_ifces_stats();
-         (void) get_running_insts_cnt();
+         // Chains are rebalanced according to freshly measured usage
+         autoplace_rebalance();
+      }
+      if (routine_evs.service_ifc_pending) {
+         routine_evs.service_ifc_pending = false;
+         send_service_ifces_requests();
       }
+      stats_publish_limited();
+      // Wake up in time for nearest deadline
+      timeout = tw_next_timeout(&main_wheel, get_mono_time_ms());
       pthread_mutex_unlock(&config_lock);
-      usleep(SERVICE_THREAD_SLEEP_IN_MICSEC);
-   }
-   VERBOSE(V3, "Supervisor routine finished")
 
-   { // Disconnect from running instances
-      VERBOSE(V3, "Disconnecting from running instances")
-      pthread_mutex_lock(&config_lock);
-      {
-         for (uint32_t i = 0; i < insts_v.total; i++) {
-            disconnect_from_inst(insts_v.items[i]);
-         }
+      // Handlers are dispatched with config_lock held
+      if (evloop_run_once(&main_evloop, timeout) == -1) {
+         supervisor_exit_code = EXIT_FAILURE;
+         break;
       }
-      pthread_mutex_unlock(&config_lock);
    }
+   VERBOSE(V3, "Supervisor routine finished")
+
+   pthread_mutex_lock(&config_lock);
+   routine_unregister_events();
+   pthread_mutex_unlock(&config_lock);
+
+   // Disconnect from running instances
+   VERBOSE(V3, "Disconnecting from running instances")
+   service_collector_stop();
 
    terminate_supervisor(terminate_insts_at_exit);
    exit(supervisor_exit_code);
 }
 
+static int block_routine_signals(sigset_t *mask)
+{
+   sigemptyset(mask);
+   sigaddset(mask, SIGCHLD);
+   sigaddset(mask, SIGINT);
+   sigaddset(mask, SIGTERM);
+   sigaddset(mask, SIGQUIT);
+
+   if (pthread_sigmask(SIG_BLOCK, mask, NULL) != 0) {
+      VERBOSE(N_ERR, "Failed to block signals handled by supervisor routine")
+      return -1;
+   }
 
+   return 0;
+}
 
-static void insts_update_resources_usage()
+static int routine_register_events()
 {
-   inst_t *inst = NULL;
-
-   for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
+   int sfd;
 
-      if (inst->running) {
-         inst_get_sys_stats(inst);
-         inst_get_vmrss(inst);
-      }
+   sfd = signalfd(-1, &routine_sigmask, SFD_NONBLOCK | SFD_CLOEXEC);
+   if (sfd == -1) {
+      VERBOSE(N_ERR, "Failed to create signalfd (errno=%d)", errno)
+      return -1;
    }
+   routine_evs.signal_src = evloop_add(&main_evloop, sfd, EPOLLIN, signalfd_handler, NULL);
+   if (routine_evs.signal_src == NULL) {
+      close(sfd);
+      return -1;
+   }
+   routine_evs.signal_src->owns_fd = true;
+
+   tw_timer_init(&routine_evs.liveness_timer, liveness_timer_cb, NULL);
+   tw_arm(&main_wheel, &routine_evs.liveness_timer, get_mono_time_ms(), intervals.liveness_ms);
+   tw_timer_init(&routine_evs.stats_timer, stats_timer_cb, NULL);
+
+   return 0;
 }
-static inline void inst_get_vmrss(inst_t *inst)
+
+static void routine_unregister_events()
 {
-   const char delim[2] = " ";
-   char *line = NULL,
-         *token = NULL,
-         *endptr = NULL;
-   size_t line_len = 0;
-   FILE *fd = NULL;
-   char path[DEFAULT_SIZE_OF_BUFFER];
-   uint64_t resident_set_size = 0;
-
-   memset(path, 0, DEFAULT_SIZE_OF_BUFFER * sizeof(char));
-   snprintf(path, DEFAULT_SIZE_OF_BUFFER * sizeof(char), "/proc/%d/status", inst->pid);
-
-   fd = fopen(path, "r");
-   if (fd == NULL) {
-      VERBOSE(V2, "Failed to open stats file of '%s' (PID=%d)",
-              inst->name, inst->pid)
-      goto err_cleanup;
-   }
-
-   while (getline(&line, &line_len, fd) != -1) {
-      if (strstr(line, "VmRSS") != NULL) {
-         token = strtok(line, delim);
-         while (token != NULL) {
-            resident_set_size = strtoul(token, &endptr, 10);
-            if (resident_set_size > 0) {
-               inst->mem_rss = resident_set_size;
-               break;
-            }
-            token = strtok(NULL, delim);
-         }
-         break;
+   evloop_del(&main_evloop, routine_evs.signal_src);
+   tw_cancel(&main_wheel, &routine_evs.liveness_timer);
+   tw_cancel(&main_wheel, &routine_evs.stats_timer);
+   memset(&routine_evs, 0, sizeof(routine_evs));
+}
+
+static void signalfd_handler(uint32_t events, void *priv)
+{
+   struct signalfd_siginfo si;
+
+   while (read(routine_evs.signal_src->fd, &si, sizeof(si)) == sizeof(si)) {
+      if (si.ssi_signo == SIGCHLD) {
+         // Pending SIGCHLDs are merged, so every child gets checked
+         liveness_check_pending = true;
+      } else {
+         sig_handler((int) si.ssi_signo);
       }
    }
+}
+
+static inline uint64_t period_aligned_delay(uint64_t now, uint32_t period_ms)
+{
+   return period_ms - (now % period_ms);
+}
+
+static void liveness_timer_cb(void *priv)
+{
+   liveness_check_pending = true;
+   tw_arm(&main_wheel, &routine_evs.liveness_timer, get_mono_time_ms(), intervals.liveness_ms);
+}
+
+static void inst_resources_timer_cb(void *priv)
+{
+   inst_t *inst = priv;
+   uint32_t period = inst_resources_period(inst);
+
+   INST_RESOURCES_DUE(inst) = true;
+   routine_evs.resources_pending = true;
+   tw_arm(&main_wheel, &inst->resources_timer, get_mono_time_ms(),
+          period_aligned_delay(get_mono_time_ms(), period));
+}
+
+static void inst_service_ifc_timer_cb(void *priv)
+{
+   inst_t *inst = priv;
+   uint32_t period = inst_service_ifc_period(inst);
+
+   INST_SERVICE_IFC_DUE(inst) = true;
+   routine_evs.service_ifc_pending = true;
+   tw_arm(&main_wheel, &inst->service_ifc_timer, get_mono_time_ms(),
+          period_aligned_delay(get_mono_time_ms(), period));
+}
+
+static void stats_timer_cb(void *priv)
+{
+}
+
+static void stats_publish_limited()
+{
+   uint64_t now = get_mono_time_ms();
+   uint64_t elapsed = now - routine_evs.stats_published_ms;
 
-err_cleanup:
-   if (fd != NULL) {
-      fclose(fd);
+   if (elapsed >= STATS_SNAP_PERIOD_MS) {
+      tw_cancel(&main_wheel, &routine_evs.stats_timer);
+      if (stats_snap_publish() == 0) {
+         routine_evs.stats_published_ms = now;
+      }
+   } else if (tw_armed(&routine_evs.stats_timer) == false) {
+      tw_arm(&main_wheel, &routine_evs.stats_timer, now, STATS_SNAP_PERIOD_MS - elapsed);
    }
-   NULLP_TEST_AND_FREE(line)
 }
 
-static inline void get_service_ifces_stats()
+static void insts_schedule_sampling()
 {
    inst_t *inst = NULL;
+   uint64_t now = get_mono_time_ms();
+   bool rearm = intervals.changed;
+
+   if (rearm) {
+      intervals.changed = false;
+      VERBOSE(V3, "Intervals changed, re-arming timers of supervisor routine")
+      tw_arm(&main_wheel, &routine_evs.liveness_timer, now, intervals.liveness_ms);
+   }
 
    for (uint32_t i = 0; i < insts_v.total; i++) {
       inst = insts_v.items[i];
 
-      if (inst->service_ifc_connected == false) {
+      if (rearm || tw_armed(&inst->resources_timer) == false) {
+         tw_timer_init(&inst->resources_timer, inst_resources_timer_cb, inst);
+         tw_arm(&main_wheel, &inst->resources_timer, now,
+                period_aligned_delay(now, inst_resources_period(inst)));
+      }
+      if (rearm || tw_armed(&inst->service_ifc_timer) == false) {
+         tw_timer_init(&inst->service_ifc_timer, inst_service_ifc_timer_cb, inst);
+         tw_arm(&main_wheel, &inst->service_ifc_timer, now,
+                period_aligned_delay(now, inst_service_ifc_period(inst)));
+      }
+   }
+}
+
+static void insts_check_liveness()
+{
+   uint32_t running_insts_cnt = 0;
+
+   VERBOSE(V3, "-----liveness check-----")
+
+   // Release exited children first so that they can be restarted immediately
+   insts_reap_children();
+
+   // Start instances that should be running
+   insts_start();
+   running_insts_cnt = get_running_insts_cnt();
+   VERBOSE(V3, "Found %d running instances", running_insts_cnt)
+
+   // Check which instances need to be killed and kill them
+   VERBOSE(V3, "Trying to kill instances that should die")
+   insts_stop_sigint();
+   insts_stop_sigkill();
+   running_insts_cnt = get_running_insts_cnt();
+   VERBOSE(V3, "Found %d running instances", running_insts_cnt)
+}
+
+static void insts_update_resources_usage()
+{
+   inst_t *inst = NULL;
+   uint64_t total_cpu = 0;
+   bool total_cpu_read = false;
+
+   // Due flags are scanned in the hot table, only due running instances are dereferenced
+   for (uint32_t s = 0; s < insts_hot.used; s++) {
+      if (insts_hot.resources_due[s] == false) {
          continue;
       }
+      insts_hot.resources_due[s] = false;
 
-      VERBOSE(V3, "Sending request for stats of instance '%s'", inst->name)
-      if (send_ifc_stats_request(inst) == -1) {
-         VERBOSE(N_ERR," Error while sending request to instance '%s'", inst->name);
-         disconnect_from_inst(inst);
+      if (insts_hot.listed[s] == false || insts_hot.running[s] == false) {
+         continue;
+      }
+      inst = insts_hot.inst[s];
+      if (inst->cg.dir_fd != -1) {
+         inst_get_cgroup_stats(inst);
+         continue;
       }
+
+      // Lazily, so that passes without running instances don't touch /proc/stat
+      if (total_cpu_read == false) {
+         if (get_total_cpu_usage(&total_cpu) == -1) {
+            VERBOSE(N_ERR, "Failed to read total CPU usage from /proc/stat")
+            total_cpu = 0;
+         }
+         total_cpu_read = true;
+      }
+      if (inst_proc_open(inst) == -1) {
+         continue;
+      }
+      if (total_cpu != 0) {
+         inst_get_sys_stats(inst, total_cpu);
+      }
+      inst_get_vmrss(inst);
    }
+}
 
-   // Loops are separated so that there is some time for clients to respond
-   for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
+static void inst_get_cgroup_stats(inst_t *inst)
+{
+   char buf[PROC_READ_BUF_SIZE];
+   ssize_t len;
+   cgroup_stats_t cg_stats;
+   proc_pid_stat_t st;
+   uint64_t total_cpu;
+   uint64_t diff_total_cpu;
+
+   if (cgroup_inst_sample(inst, &cg_stats) == -1) {
+      VERBOSE(V2, "Failed to read cgroup stats of '%s' (PID=%d)", inst->name, INST_PID(inst))
+      return;
+   }
 
-      inst_set_running_status(inst);
-      if (inst->running == false) {
-         continue;
+   total_cpu = get_mono_time_ms() * 1000 * online_cpus_cnt();
+   diff_total_cpu = total_cpu - inst->last_total_cpu;
+   if (diff_total_cpu == 0) {
+      return;
+   }
+   if (inst->last_total_cpu != 0) {
+      inst->last_cpu_perc_umode = (uint64_t)
+            (100 * ((double)(cg_stats.user_usec - inst->last_cpu_umode) / (double)diff_total_cpu));
+      inst->last_cpu_perc_kmode = (uint64_t)
+            (100 * ((double)(cg_stats.system_usec - inst->last_cpu_kmode) / (double)diff_total_cpu));
+      inst->cpu_load = (uint64_t) (1000 * online_cpus_cnt() *
+            ((double)(cg_stats.user_usec + cg_stats.system_usec
+                      - inst->last_cpu_umode - inst->last_cpu_kmode) / (double)diff_total_cpu));
+   }
+   inst->last_total_cpu = total_cpu;
+   inst->last_cpu_umode = cg_stats.user_usec;
+   inst->last_cpu_kmode = cg_stats.system_usec;
+   inst->mem_rss = cg_stats.mem_current / 1024;
+   inst->mem_peak = cg_stats.mem_peak / 1024;
+   inst->io_read_bytes = cg_stats.io_rbytes;
+   inst->io_write_bytes = cg_stats.io_wbytes;
+
+   if (inst_proc_open(inst) == 0) {
+      len = proc_pread(inst->proc_stat_fd, buf, sizeof(buf));
+      if (len != -1 && proc_parse_pid_stat(buf, (size_t) len, &st) == 0) {
+         inst->mem_vms = st.vsize;
       }
-      recv_ifc_stats(inst);
    }
 }
 
-static inline void inst_get_sys_stats(inst_t *inst)
+static uint64_t online_cpus_cnt()
 {
+   static uint64_t cpus_cnt = 0;
 
-   const char delim[2] = " ";
-   char *line = NULL,
-         *token = NULL,
-         *endptr = NULL;
-   FILE *proc_stat_fd = NULL;
-   char path[DEFAULT_SIZE_OF_BUFFER];
-   uint64_t tmp_num = 0,
-         diff_total_cpu = 0,
-         new_total_cpu = 0;
+   if (cpus_cnt == 0) {
+      long cnt = sysconf(_SC_NPROCESSORS_ONLN);
+      cpus_cnt = (cnt > 0 ? (uint64_t) cnt : 1);
+   }
 
+   return cpus_cnt;
+}
 
+static inline void inst_get_vmrss(inst_t *inst)
+{
+   static uint64_t page_kb = 0;
+   char buf[PROC_READ_BUF_SIZE];
+   ssize_t len;
+   uint64_t rss_pages = 0;
 
-   if (get_total_cpu_usage(&new_total_cpu) == -1) {
-      return;
+   if (page_kb == 0) {
+      page_kb = (uint64_t) sysconf(_SC_PAGESIZE) / 1024;
    }
 
-   diff_total_cpu = new_total_cpu - last_total_cpu;
-   if (0 == diff_total_cpu) {
+   len = proc_pread(inst->proc_statm_fd, buf, sizeof(buf));
+   if (len == -1 || proc_parse_statm_rss(buf, (size_t) len, &rss_pages) == -1) {
+      VERBOSE(V2, "Failed to read memory stats of '%s' (PID=%d)", inst->name, INST_PID(inst))
       return;
    }
-   last_total_cpu = new_total_cpu;
-
-   memset(path, 0, DEFAULT_SIZE_OF_BUFFER * sizeof(char));
-   snprintf(path, DEFAULT_SIZE_OF_BUFFER * sizeof(char), "/proc/%d/stat", inst->pid);
-   proc_stat_fd = fopen(path, "r");
-
-   if (proc_stat_fd == NULL) {
-      VERBOSE(V1, "Failed to open stats file of inst with PID=%d", inst->pid)
-      goto err_cleanup;
-   }
-
-   if (getline(&line, &tmp_num, proc_stat_fd) == -1) {
-      VERBOSE(V1, "Failed to read stats of inst with PID=%d", inst->pid)
-      goto err_cleanup;
-   }
-
-   token = strtok(line, delim);
-   if (token == NULL) {
-      goto err_cleanup;
-   }
-
-   for (int position = 1; token != NULL && position <= 23; position++) {
-      switch (position) {
-         case 14:
-            // position of "user mode time" field in /proc/pid/stat file is 14
-            tmp_num = strtoul(token, &endptr, 10);
-            if (endptr == token) {
-               VERBOSE(N_ERR, "Unable to get user mode time for inst PID=%d", inst->pid)
-               continue;
-            }
-            inst->last_cpu_perc_umode = (uint64_t)
-                  (100 * ((double)(tmp_num - inst->last_cpu_umode) / (double)diff_total_cpu));
-            inst->last_cpu_umode = tmp_num;
-            break;
-
-         case 15:
-            // position of "kernel mode time" field in /proc/pid/stat file is 15
-            tmp_num = strtoul(token, &endptr, 10);
-            if (endptr == token) {
-               VERBOSE(N_ERR, "Unable to get kernel mode time for inst PID=%d", inst->pid)
-               continue;
-            }
-            inst->last_cpu_perc_kmode = (uint64_t)
-                  (100 * ((double)(tmp_num - inst->last_cpu_kmode) / (double)diff_total_cpu));
-            inst->last_cpu_kmode = tmp_num;
-            break;
-
-         case 23:
-            // position of "virtual memory size" field in /proc/pid/stat file is 23
-            tmp_num = strtoul(token, &endptr, 10);
-            if (endptr == token) {
-               continue;
-            }
-            inst->mem_vms = tmp_num;
-            break;
-
-         default:break;
+   inst->mem_rss = rss_pages * page_kb;
+}
+
+static inline void send_service_ifces_requests()
+{
+   inst_t *inst = NULL;
+
+   for (uint32_t s = 0; s < insts_hot.used; s++) {
+      if (insts_hot.service_ifc_due[s] == false) {
+         continue;
       }
+      insts_hot.service_ifc_due[s] = false;
 
-      token = strtok(NULL, delim);
-   }
+      if (insts_hot.listed[s] == false || insts_hot.running[s] == false) {
+         continue;
+      }
+      inst = insts_hot.inst[s];
 
-err_cleanup:
-   if (proc_stat_fd != NULL) {
-      fclose(proc_stat_fd);
+      // Only connect to modules that implement TRAP service interface
+      if (inst->mod_ref->trap_mon == false) {
+         continue;
+      }
+
+      // Collector thread connects if needed, sends the request and receives the reply
+      if (service_collector_poll(inst) == -1) {
+         VERBOSE(N_ERR, "Failed to post request for stats of instance '%s'", inst->name)
+      }
    }
-   NULLP_TEST_AND_FREE(line)
 }
 
-static int get_total_cpu_usage(uint64_t *total_cpu_usage)
+static inline void inst_get_sys_stats(inst_t *inst, uint64_t total_cpu)
 {
-   uint64_t num = 0;
-   const char delim[2] = " ";
-   char *line = NULL,
-         *token = NULL,
-         *endptr = NULL;
-   int rc = 0;
-   size_t line_len = 0;
-   FILE *proc_stat_fd = fopen("/proc/stat","r");
-
-   if (proc_stat_fd == NULL) {
-      return -1;
-   }
-   if (getline(&line, &line_len, proc_stat_fd) == -1) {
-      rc = -1;
-      goto err_cleanup;
+   char buf[PROC_READ_BUF_SIZE];
+   ssize_t len;
+   proc_pid_stat_t st;
+   uint64_t diff_total_cpu = 0;
+   bool has_baseline = (inst->last_total_cpu != 0);
+
+   diff_total_cpu = total_cpu - inst->last_total_cpu;
+   if (0 == diff_total_cpu) {
+      return;
    }
 
-   token = strtok(line, delim);
-   if (token == NULL) {
-      rc = -1;
-      goto err_cleanup;
+   len = proc_pread(inst->proc_stat_fd, buf, sizeof(buf));
+   if (len == -1) {
+      VERBOSE(V1, "Failed to read stats of inst with PID=%d", INST_PID(inst))
+      return;
+   }
+   if (proc_parse_pid_stat(buf, (size_t) len, &st) == -1) {
+      VERBOSE(N_ERR, "Unable to parse stats of inst PID=%d", INST_PID(inst))
+      return;
    }
-   if (strcmp(token, "cpu") != 0) {
-      rc = -1;
-      goto err_cleanup;
+   inst->last_total_cpu = total_cpu;
+
+   if (has_baseline) {
+      inst->last_cpu_perc_umode = (uint64_t)
+            (100 * ((double)(st.utime - inst->last_cpu_umode) / (double)diff_total_cpu));
+      inst->last_cpu_perc_kmode = (uint64_t)
+            (100 * ((double)(st.stime - inst->last_cpu_kmode) / (double)diff_total_cpu));
+      inst->cpu_load = (uint64_t) (1000 * online_cpus_cnt() *
+            ((double)(st.utime + st.stime - inst->last_cpu_umode - inst->last_cpu_kmode)
+             / (double)diff_total_cpu));
    }
-   token = strtok(NULL, delim);
+   inst->last_cpu_umode = st.utime;
+   inst->last_cpu_kmode = st.stime;
+   inst->mem_vms = st.vsize;
+}
 
-   while (token != NULL) {
-      num = strtoul(token, &endptr, 10);
-      if (endptr == token) {
-         // if there were no character convertable to numeric in token
-         rc = -1;
-         break;
+static int get_total_cpu_usage(uint64_t *total_cpu_usage)
+{
+   static int proc_stat_fd = -1;
+   char buf[PROC_READ_BUF_SIZE];
+   ssize_t len;
+
+   if (proc_stat_fd == -1) {
+      proc_stat_fd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+      if (proc_stat_fd == -1) {
+         return -1;
       }
-      *total_cpu_usage += num;
-      token = strtok(NULL, delim);
    }
 
-err_cleanup:
-   fclose(proc_stat_fd);
-   NULLP_TEST_AND_FREE(line);
-   return rc;
+   len = proc_pread(proc_stat_fd, buf, sizeof(buf));
+   if (len == -1) {
+      return -1;
+   }
+
+   return proc_parse_total_cpu(buf, (size_t) len, total_cpu_usage);
 }
 
 static void insts_save_running_pids() {
@@ -830,14 +1090,14 @@ static void insts_save_running_pids() {
 
    for (uint32_t i = 0; i < insts_v.total; i++) {
       inst = insts_v.items[i];
-      if (inst->running == false) {
+      if (INST_RUNNING(inst) == false) {
          continue;
       }
 
       memset(xpath, 0, NS_ROOT_XPATH_LEN + 255 + 25 + 1);
       sprintf(xpath, NS_ROOT_XPATH"/instance[name='%s']/last-pid", inst->name);
 
-      val->data.uint32_val = (uint32_t) inst->pid;
+      val->data.uint32_val = (uint32_t) INST_PID(inst);
       rc = sr_set_item(sr_conn_link.sess, xpath, val,
                        SR_EDIT_DEFAULT | SR_EDIT_NON_RECURSIVE);
       if (rc != SR_ERR_OK) {
@@ -845,7 +1105,7 @@ static void insts_save_running_pids() {
                  inst->name,
                  sr_strerror(rc))
       } else {
-         VERBOSE(V2, "PID %d for instance '%s' set.", inst->pid, inst->name)
+         VERBOSE(V2, "PID %d for instance '%s' set.", INST_PID(inst), inst->name)
       }
    }
 
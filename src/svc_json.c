@@ -0,0 +1,569 @@
+/**
+ * @file svc_json.c
+ * @brief Implementation of functions defined in svc_json.h
+ */
+
+#include <string.h>
+#include "svc_json.h"
+
+#define SVC_JSON_MAX_DEPTH 32 ///< Maximum nesting of skipped unknown values
+
+/**
+ * @brief Checks whether parsed key of given length equals string literal
+ * */
+#define KEY_IS(key, key_len, lit) \
+   ((key_len) == sizeof(lit) - 1 && memcmp((key), (lit), sizeof(lit) - 1) == 0)
+
+/**
+ * @brief Position of parser inside parsed data
+ * */
+typedef struct svc_json_cur_s {
+   char *p; ///< Next character to parse
+   char *end; ///< End of data
+} svc_json_cur_t;
+
+
+/**
+ * @brief Moves cursor past whitespace
+ * @return Next character or 0 at the end of data
+ * */
+static inline char svc_json_peek(svc_json_cur_t *cur);
+
+/**
+ * @brief Consumes given character preceded by optional whitespace
+ * @return -1 if next character differs, 0 on success
+ * */
+static inline int svc_json_expect(svc_json_cur_t *cur, char c);
+
+/**
+ * @brief Moves to next key of object and consumes the colon after it
+ * @param cur Cursor after '{' or after value of previous key
+ * @param first Whether no key of object was read yet, gets cleared
+ * @param key Set to decoded key
+ * @param key_len Set to length of decoded key
+ * @return -1 on error, 0 if object ended, 1 if key was read
+ * */
+static int svc_json_next_key(svc_json_cur_t *cur, bool *first, char **key, size_t *key_len);
+
+/**
+ * @brief Moves to next item of array
+ * @param cur Cursor after '[' or after previous item
+ * @param first Whether no item of array was read yet, gets cleared
+ * @return -1 on error, 0 if array ended, 1 if item follows
+ * */
+static int svc_json_next_item(svc_json_cur_t *cur, bool *first);
+
+/**
+ * @brief Decodes string in place and terminates it with zero.
+ * @param cur Cursor at opening quote (whitespace allowed)
+ * @param str Set to decoded string
+ * @param len Set to length of decoded string
+ * @return -1 on error, 0 on success
+ * */
+static int svc_json_string(svc_json_cur_t *cur, char **str, size_t *len);
+
+/**
+ * @brief Parses integer number, fraction and exponent are accepted and dropped.
+ * @details Negative numbers are stored in two's complement.
+ * @return -1 on error, 0 on success
+ * */
+static int svc_json_number(svc_json_cur_t *cur, uint64_t *val);
+
+/**
+ * @brief Skips any value including nested objects and arrays
+ * @return -1 on error, 0 on success
+ * */
+static int svc_json_skip(svc_json_cur_t *cur, uint32_t depth);
+
+/**
+ * @brief Parses object with counters of one IN interface
+ * @return -1 on error, 0 on success
+ * */
+static int svc_json_in_ifc(svc_json_cur_t *cur, ifc_in_stats_t *stats);
+
+/**
+ * @brief Parses object with counters of one OUT interface
+ * @return -1 on error, 0 on success
+ * */
+static int svc_json_out_ifc(svc_json_cur_t *cur, ifc_out_stats_t *stats);
+
+/**
+ * @brief Parses array of interfaces of given direction into destination
+ * @return -1 on error or if destination is full, 0 on success
+ * */
+static int svc_json_ifces(svc_json_cur_t *cur, svc_json_stats_t *stats, bool in);
+
+
+static inline char svc_json_peek(svc_json_cur_t *cur)
+{
+   while (cur->p < cur->end) {
+      switch (*cur->p) {
+         case ' ':
+         case '\t':
+         case '\n':
+         case '\r':
+            cur->p++;
+            break;
+         default:
+            return *cur->p;
+      }
+   }
+   return 0;
+}
+
+static inline int svc_json_expect(svc_json_cur_t *cur, char c)
+{
+   if (svc_json_peek(cur) != c) {
+      return -1;
+   }
+   cur->p++;
+   return 0;
+}
+
+static int svc_json_next_key(svc_json_cur_t *cur, bool *first, char **key, size_t *key_len)
+{
+   char c = svc_json_peek(cur);
+
+   if (c == '}') {
+      cur->p++;
+      return 0;
+   }
+   if (*first) {
+      *first = false;
+   } else if (c == ',') {
+      cur->p++;
+   } else {
+      return -1;
+   }
+
+   if (svc_json_string(cur, key, key_len) == -1 || svc_json_expect(cur, ':') == -1) {
+      return -1;
+   }
+   return 1;
+}
+
+static int svc_json_next_item(svc_json_cur_t *cur, bool *first)
+{
+   char c = svc_json_peek(cur);
+
+   if (c == ']') {
+      cur->p++;
+      return 0;
+   }
+   if (*first) {
+      *first = false;
+   } else if (c == ',') {
+      cur->p++;
+   } else {
+      return -1;
+   }
+   return 1;
+}
+
+static int svc_json_string(svc_json_cur_t *cur, char **str, size_t *len)
+{
+   char *w;
+   uint32_t cp;
+   uint32_t lo;
+   unsigned char c;
+
+#define HEX4_OR_ERR(res) do { \
+   if (cur->end - cur->p < 4) { \
+      return -1; \
+   } \
+   (res) = 0; \
+   for (int i = 0; i < 4; i++) { \
+      c = (unsigned char) *cur->p++; \
+      (res) <<= 4; \
+      if (c >= '0' && c <= '9') { \
+         (res) |= c - '0'; \
+      } else if (c >= 'a' && c <= 'f') { \
+         (res) |= c - 'a' + 10; \
+      } else if (c >= 'A' && c <= 'F') { \
+         (res) |= c - 'A' + 10; \
+      } else { \
+         return -1; \
+      } \
+   } \
+} while (0);
+
+   if (svc_json_expect(cur, '"') == -1) {
+      return -1;
+   }
+
+   // Decoded string is never longer than its encoded form, so it's written over it
+   *str = w = cur->p;
+   while (cur->p < cur->end) {
+      c = (unsigned char) *cur->p++;
+      if (c == '"') {
+         *len = (size_t) (w - *str);
+         *w = '\0';
+         return 0;
+      }
+      if (c < 0x20) {
+         return -1;
+      }
+      if (c != '\\') {
+         *w++ = (char) c;
+         continue;
+      }
+
+      if (cur->p == cur->end) {
+         return -1;
+      }
+      c = (unsigned char) *cur->p++;
+      switch (c) {
+         case '"':
+         case '\\':
+         case '/':
+            *w++ = (char) c;
+            break;
+         case 'b':
+            *w++ = '\b';
+            break;
+         case 'f':
+            *w++ = '\f';
+            break;
+         case 'n':
+            *w++ = '\n';
+            break;
+         case 'r':
+            *w++ = '\r';
+            break;
+         case 't':
+            *w++ = '\t';
+            break;
+         case 'u':
+            HEX4_OR_ERR(cp)
+            if (cp >= 0xDC00 && cp <= 0xDFFF) {
+               return -1;
+            }
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+               // High surrogate has to be followed by low one
+               if (cur->end - cur->p < 2 || cur->p[0] != '\\' || cur->p[1] != 'u') {
+                  return -1;
+               }
+               cur->p += 2;
+               HEX4_OR_ERR(lo)
+               if (lo < 0xDC00 || lo > 0xDFFF) {
+                  return -1;
+               }
+               cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            }
+            if (cp == 0) {
+               return -1;
+            } else if (cp < 0x80) {
+               *w++ = (char) cp;
+            } else if (cp < 0x800) {
+               *w++ = (char) (0xC0 | (cp >> 6));
+               *w++ = (char) (0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+               *w++ = (char) (0xE0 | (cp >> 12));
+               *w++ = (char) (0x80 | ((cp >> 6) & 0x3F));
+               *w++ = (char) (0x80 | (cp & 0x3F));
+            } else {
+               *w++ = (char) (0xF0 | (cp >> 18));
+               *w++ = (char) (0x80 | ((cp >> 12) & 0x3F));
+               *w++ = (char) (0x80 | ((cp >> 6) & 0x3F));
+               *w++ = (char) (0x80 | (cp & 0x3F));
+            }
+            break;
+         default:
+            return -1;
+      }
+   }
+
+   // Missing closing quote
+   return -1;
+#undef HEX4_OR_ERR
+}
+
+static int svc_json_number(svc_json_cur_t *cur, uint64_t *val)
+{
+   bool neg = false;
+   uint64_t num = 0;
+   char *start;
+
+   svc_json_peek(cur);
+   if (cur->p < cur->end && *cur->p == '-') {
+      neg = true;
+      cur->p++;
+   }
+
+   start = cur->p;
+   while (cur->p < cur->end && *cur->p >= '0' && *cur->p <= '9') {
+      num = num * 10 + (uint64_t) (*cur->p - '0');
+      cur->p++;
+   }
+   if (cur->p == start) {
+      return -1;
+   }
+
+   if (cur->p < cur->end && *cur->p == '.') {
+      cur->p++;
+      start = cur->p;
+      while (cur->p < cur->end && *cur->p >= '0' && *cur->p <= '9') {
+         cur->p++;
+      }
+      if (cur->p == start) {
+         return -1;
+      }
+   }
+   if (cur->p < cur->end && (*cur->p == 'e' || *cur->p == 'E')) {
+      cur->p++;
+      if (cur->p < cur->end && (*cur->p == '+' || *cur->p == '-')) {
+         cur->p++;
+      }
+      start = cur->p;
+      while (cur->p < cur->end && *cur->p >= '0' && *cur->p <= '9') {
+         cur->p++;
+      }
+      if (cur->p == start) {
+         return -1;
+      }
+   }
+
+   *val = neg ? (uint64_t) 0 - num : num;
+   return 0;
+}
+
+static int svc_json_skip(svc_json_cur_t *cur, uint32_t depth)
+{
+   bool first = true;
+   char *key;
+   size_t key_len;
+   uint64_t num;
+   int rc;
+
+   if (depth > SVC_JSON_MAX_DEPTH) {
+      return -1;
+   }
+
+   switch (svc_json_peek(cur)) {
+      case '{':
+         cur->p++;
+         while ((rc = svc_json_next_key(cur, &first, &key, &key_len)) == 1) {
+            if (svc_json_skip(cur, depth + 1) == -1) {
+               return -1;
+            }
+         }
+         return rc;
+      case '[':
+         cur->p++;
+         while ((rc = svc_json_next_item(cur, &first)) == 1) {
+            if (svc_json_skip(cur, depth + 1) == -1) {
+               return -1;
+            }
+         }
+         return rc;
+      case '"':
+         return svc_json_string(cur, &key, &key_len);
+      case 't':
+         key = "true";
+         break;
+      case 'f':
+         key = "false";
+         break;
+      case 'n':
+         key = "null";
+         break;
+      default:
+         return svc_json_number(cur, &num);
+   }
+
+   key_len = strlen(key);
+   if ((size_t) (cur->end - cur->p) < key_len || memcmp(cur->p, key, key_len) != 0) {
+      return -1;
+   }
+   cur->p += key_len;
+   return 0;
+}
+
+static int svc_json_in_ifc(svc_json_cur_t *cur, ifc_in_stats_t *stats)
+{
+   bool first = true;
+   char *key;
+   size_t key_len;
+   uint64_t num;
+   size_t id_len;
+   int rc;
+
+   memset(stats, 0, sizeof(ifc_in_stats_t));
+   if (svc_json_expect(cur, '{') == -1) {
+      return -1;
+   }
+
+   while ((rc = svc_json_next_key(cur, &first, &key, &key_len)) == 1) {
+      if (KEY_IS(key, key_len, "ifc_id")) {
+         if (svc_json_string(cur, &stats->id, &id_len) == -1) {
+            return -1;
+         }
+      } else if (KEY_IS(key, key_len, "messages")) {
+         if (svc_json_number(cur, &stats->recv_msg_cnt) == -1) {
+            return -1;
+         }
+      } else if (KEY_IS(key, key_len, "buffers")) {
+         if (svc_json_number(cur, &stats->recv_buff_cnt) == -1) {
+            return -1;
+         }
+      } else if (KEY_IS(key, key_len, "ifc_type")) {
+         if (svc_json_number(cur, &num) == -1) {
+            return -1;
+         }
+         stats->type = (char) num;
+      } else if (KEY_IS(key, key_len, "ifc_state")) {
+         if (svc_json_number(cur, &num) == -1) {
+            return -1;
+         }
+         stats->state = (uint8_t) num;
+      } else if (svc_json_skip(cur, 0) == -1) {
+         return -1;
+      }
+   }
+
+   if (rc == -1 || stats->id == NULL) {
+      return -1;
+   }
+   return 0;
+}
+
+static int svc_json_out_ifc(svc_json_cur_t *cur, ifc_out_stats_t *stats)
+{
+   bool first = true;
+   char *key;
+   size_t key_len;
+   uint64_t num;
+   size_t id_len;
+   int rc;
+
+   memset(stats, 0, sizeof(ifc_out_stats_t));
+   if (svc_json_expect(cur, '{') == -1) {
+      return -1;
+   }
+
+   while ((rc = svc_json_next_key(cur, &first, &key, &key_len)) == 1) {
+      if (KEY_IS(key, key_len, "ifc_id")) {
+         if (svc_json_string(cur, &stats->id, &id_len) == -1) {
+            return -1;
+         }
+      } else if (KEY_IS(key, key_len, "sent-messages")) {
+         if (svc_json_number(cur, &stats->sent_msg_cnt) == -1) {
+            return -1;
+         }
+      } else if (KEY_IS(key, key_len, "dropped-messages")) {
+         if (svc_json_number(cur, &stats->dropped_msg_cnt) == -1) {
+            return -1;
+         }
+      } else if (KEY_IS(key, key_len, "buffers")) {
+         if (svc_json_number(cur, &stats->sent_buff_cnt) == -1) {
+            return -1;
+         }
+      } else if (KEY_IS(key, key_len, "autoflushes")) {
+         if (svc_json_number(cur, &stats->autoflush_cnt) == -1) {
+            return -1;
+         }
+      } else if (KEY_IS(key, key_len, "num_clients")) {
+         if (svc_json_number(cur, &num) == -1) {
+            return -1;
+         }
+         stats->num_clients = (int32_t) num;
+      } else if (KEY_IS(key, key_len, "type")) {
+         if (svc_json_number(cur, &num) == -1) {
+            return -1;
+         }
+         stats->type = (char) num;
+      } else if (svc_json_skip(cur, 0) == -1) {
+         return -1;
+      }
+   }
+
+   if (rc == -1 || stats->id == NULL) {
+      return -1;
+   }
+   return 0;
+}
+
+static int svc_json_ifces(svc_json_cur_t *cur, svc_json_stats_t *stats, bool in)
+{
+   bool first = true;
+   int rc;
+
+   if (svc_json_expect(cur, '[') == -1) {
+      return -1;
+   }
+
+   while ((rc = svc_json_next_item(cur, &first)) == 1) {
+      if (in) {
+         if (stats->in_parsed == stats->in_cap
+             || svc_json_in_ifc(cur, &stats->in_stats[stats->in_parsed]) == -1) {
+            return -1;
+         }
+         stats->in_parsed++;
+      } else {
+         if (stats->out_parsed == stats->out_cap
+             || svc_json_out_ifc(cur, &stats->out_stats[stats->out_parsed]) == -1) {
+            return -1;
+         }
+         stats->out_parsed++;
+      }
+   }
+
+   return rc;
+}
+
+int svc_json_parse(char *data, size_t len, svc_json_stats_t *stats)
+{
+   svc_json_cur_t cur = { .p = data, .end = data + len };
+   bool first = true;
+   bool in_cnt_found = false;
+   bool out_cnt_found = false;
+   char *key;
+   size_t key_len;
+   uint64_t num;
+   int rc;
+
+   stats->in_cnt = 0;
+   stats->out_cnt = 0;
+   stats->in_parsed = 0;
+   stats->out_parsed = 0;
+
+   if (svc_json_expect(&cur, '{') == -1) {
+      return -1;
+   }
+
+   while ((rc = svc_json_next_key(&cur, &first, &key, &key_len)) == 1) {
+      if (KEY_IS(key, key_len, "in_cnt")) {
+         if (svc_json_number(&cur, &num) == -1) {
+            return -1;
+         }
+         stats->in_cnt = (uint32_t) num;
+         in_cnt_found = true;
+      } else if (KEY_IS(key, key_len, "out_cnt")) {
+         if (svc_json_number(&cur, &num) == -1) {
+            return -1;
+         }
+         stats->out_cnt = (uint32_t) num;
+         out_cnt_found = true;
+      } else if (KEY_IS(key, key_len, "in")) {
+         if (stats->in_parsed > 0 || svc_json_ifces(&cur, stats, true) == -1) {
+            return -1;
+         }
+      } else if (KEY_IS(key, key_len, "out")) {
+         if (stats->out_parsed > 0 || svc_json_ifces(&cur, stats, false) == -1) {
+            return -1;
+         }
+      } else if (svc_json_skip(&cur, 0) == -1) {
+         return -1;
+      }
+   }
+   if (rc == -1 || in_cnt_found == false || out_cnt_found == false) {
+      return -1;
+   }
+
+   // Only whitespace may follow, zero terminator sent along with reply is allowed
+   if (svc_json_peek(&cur) != 0) {
+      return -1;
+   }
+
+   return 0;
+}
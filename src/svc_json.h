@@ -0,0 +1,44 @@
+/**
+ * @file svc_json.h
+ * @brief Streaming parser of statistics JSON sent by libtrap's service interface.
+ * @details Parser knows the fixed schema of reply to SERVICE_GET_COM and writes counters
+ *  straight into interface stats structures in a single pass, without building
+ *  a document tree and without any allocation. Strings are decoded in place, so the
+ *  parsed buffer gets modified and interface ids point into it.
+ */
+
+#ifndef SVC_JSON_H
+#define SVC_JSON_H
+
+#include <stddef.h>
+#include "module.h"
+
+/**
+ * @brief Destination and outcome of parsing of one stats reply
+ * */
+typedef struct svc_json_stats_s {
+   ifc_in_stats_t *in_stats; ///< Array receiving items of "in", caller provided
+   uint32_t in_cap; ///< Number of items of in_stats
+   ifc_out_stats_t *out_stats; ///< Array receiving items of "out", caller provided
+   uint32_t out_cap; ///< Number of items of out_stats
+
+   uint32_t in_cnt; ///< Value of "in_cnt" reported by instance
+   uint32_t out_cnt; ///< Value of "out_cnt" reported by instance
+   uint32_t in_parsed; ///< Number of items of "in" that were parsed
+   uint32_t out_parsed; ///< Number of items of "out" that were parsed
+} svc_json_stats_t;
+
+/**
+ * @brief Parses stats reply and fills in interface stats of given destination.
+ * @details Keys of reply may come in any order and unknown keys are skipped. Counters
+ *  missing in interface object are set to 0. Ids of interfaces are borrowed, they point
+ *  into data and remain valid only until data is modified or freed.
+ * @param data JSON to parse, doesn't have to be zero terminated, it's modified in place
+ * @param len Length of data
+ * @param stats Destination with in_stats, in_cap, out_stats and out_cap set
+ * @return -1 on malformed JSON, missing in_cnt, out_cnt or ifc_id, or if there are more
+ *  interfaces than destination can hold, 0 on success
+ * */
+extern int svc_json_parse(char *data, size_t len, svc_json_stats_t *stats);
+
+#endif
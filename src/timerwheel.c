@@ -0,0 +1,243 @@
+/**
+ * @file timerwheel.c
+ * @brief Implementation of timerwheel.h
+ */
+
+#include <limits.h>
+#include <stddef.h>
+#include "timerwheel.h"
+
+#define TW_MAX_DELTA ((1ULL << (TW_SLOT_BITS * TW_LEVELS)) - 1) ///< Farthest tick wheel can hold
+
+tw_wheel_t main_wheel;
+
+/**
+ * @brief Converts monotonic time to tick of given wheel (rounded down)
+ * */
+static inline uint64_t tw_ms_to_tick(const tw_wheel_t *wheel, uint64_t ms);
+
+/**
+ * @brief Links timer into slot given by its expiration and current tick of wheel
+ * @param wheel Wheel to use
+ * @param timer Timer with expires set
+ * */
+static void tw_link(tw_wheel_t *wheel, tw_timer_t *timer);
+
+/**
+ * @brief Unlinks timer from its slot list
+ * @param timer Armed timer
+ * */
+static inline void tw_unlink(tw_timer_t *timer);
+
+/**
+ * @brief Moves timers of current slot of given level to lower levels
+ * @details Slot of higher level is cascaded first in case current slot index of
+ *  given level is 0.
+ * @param wheel Wheel to use
+ * @param level Level to cascade, at least 1
+ * */
+static void tw_cascade(tw_wheel_t *wheel, uint8_t level);
+
+
+static inline uint64_t tw_ms_to_tick(const tw_wheel_t *wheel, uint64_t ms)
+{
+   if (ms <= wheel->base_ms) {
+      return 0;
+   }
+   return (ms - wheel->base_ms) / TW_TICK_MS;
+}
+
+static void tw_link(tw_wheel_t *wheel, tw_timer_t *timer)
+{
+   uint64_t expires = timer->expires;
+   uint64_t delta;
+   uint8_t level;
+   tw_timer_t **head;
+
+   if (expires < wheel->cur_tick) {
+      expires = wheel->cur_tick;
+   }
+   delta = expires - wheel->cur_tick;
+   if (delta > TW_MAX_DELTA) {
+      // Timer gets placed again once it's cascaded from the last level
+      delta = TW_MAX_DELTA;
+      expires = wheel->cur_tick + delta;
+   }
+
+   for (level = 0; level < TW_LEVELS - 1; level++) {
+      if (delta < (1ULL << (TW_SLOT_BITS * (level + 1)))) {
+         break;
+      }
+   }
+
+   head = &wheel->slots[level][(expires >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK];
+   timer->next = *head;
+   if (timer->next != NULL) {
+      timer->next->pprev = &timer->next;
+   }
+   timer->pprev = head;
+   *head = timer;
+}
+
+static inline void tw_unlink(tw_timer_t *timer)
+{
+   *timer->pprev = timer->next;
+   if (timer->next != NULL) {
+      timer->next->pprev = timer->pprev;
+   }
+   timer->next = NULL;
+   timer->pprev = NULL;
+}
+
+static void tw_cascade(tw_wheel_t *wheel, uint8_t level)
+{
+   uint32_t idx = (wheel->cur_tick >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK;
+   tw_timer_t **head = &wheel->slots[level][idx];
+   tw_timer_t *timer;
+
+   if (idx == 0 && level + 1 < TW_LEVELS) {
+      tw_cascade(wheel, level + 1);
+   }
+
+   while ((timer = *head) != NULL) {
+      tw_unlink(timer);
+      tw_link(wheel, timer);
+   }
+}
+
+void tw_timer_init(tw_timer_t *timer, tw_timer_fn fn, void *priv)
+{
+   timer->next = NULL;
+   timer->pprev = NULL;
+   timer->expires = 0;
+   timer->fn = fn;
+   timer->priv = priv;
+}
+
+void tw_arm(tw_wheel_t *wheel, tw_timer_t *timer, uint64_t now_ms, uint64_t delay_ms)
+{
+   if (wheel->started == false) {
+      wheel->started = true;
+      wheel->base_ms = now_ms;
+      wheel->cur_tick = 0;
+   }
+
+   tw_cancel(wheel, timer);
+
+   // First tick starting at or after the deadline, so timer never expires sooner
+   timer->expires = (now_ms + delay_ms - wheel->base_ms + TW_TICK_MS - 1) / TW_TICK_MS;
+
+   tw_link(wheel, timer);
+   wheel->armed_cnt++;
+}
+
+void tw_cancel(tw_wheel_t *wheel, tw_timer_t *timer)
+{
+   if (timer->pprev == NULL) {
+      return;
+   }
+   tw_unlink(timer);
+   wheel->armed_cnt--;
+}
+
+bool tw_armed(const tw_timer_t *timer)
+{
+   return timer->pprev != NULL;
+}
+
+uint32_t tw_advance(tw_wheel_t *wheel, uint64_t now_ms)
+{
+   uint64_t target;
+   uint32_t expired = 0;
+   tw_timer_t **head;
+   tw_timer_t *pending;
+   tw_timer_t *timer;
+
+   if (wheel->started == false) {
+      return 0;
+   }
+
+   target = tw_ms_to_tick(wheel, now_ms);
+   while (wheel->cur_tick <= target) {
+      if (wheel->armed_cnt == 0) {
+         // Nothing to expire, skip idle ticks at once
+         wheel->cur_tick = target + 1;
+         break;
+      }
+
+      if ((wheel->cur_tick & TW_SLOT_MASK) == 0) {
+         tw_cascade(wheel, 1);
+      }
+
+      /* Expired timers are detached from the slot first so that timers armed by
+       * expired functions can't land in the list being processed. They are popped
+       * one by one since expired function can cancel other expired timers. */
+      head = &wheel->slots[0][wheel->cur_tick & TW_SLOT_MASK];
+      pending = *head;
+      *head = NULL;
+      if (pending != NULL) {
+         pending->pprev = &pending;
+      }
+      wheel->cur_tick++;
+
+      while ((timer = pending) != NULL) {
+         tw_unlink(timer);
+         wheel->armed_cnt--;
+         expired++;
+         timer->fn(timer->priv);
+      }
+   }
+
+   return expired;
+}
+
+int tw_next_timeout(const tw_wheel_t *wheel, uint64_t now_ms)
+{
+   uint64_t next_tick = UINT64_MAX;
+   uint64_t tick;
+   uint64_t next_ms;
+   uint32_t idx;
+
+   if (wheel->armed_cnt == 0) {
+      return -1;
+   }
+
+   // Exact expiration in the lowest level
+   for (uint32_t d = 0; d < TW_SLOTS; d++) {
+      tick = wheel->cur_tick + d;
+      if (wheel->slots[0][tick & TW_SLOT_MASK] != NULL) {
+         next_tick = tick;
+         break;
+      }
+   }
+
+   // Cascade time of the nearest non-empty slot of each higher level
+   for (uint8_t level = 1; level < TW_LEVELS; level++) {
+      uint8_t shift = TW_SLOT_BITS * level;
+      for (uint32_t d = 0; d < TW_SLOTS; d++) {
+         idx = ((wheel->cur_tick >> shift) + d) & TW_SLOT_MASK;
+         if (wheel->slots[level][idx] != NULL) {
+            tick = ((wheel->cur_tick >> shift) + d) << shift;
+            /* Current slot was already cascaded in this rotation unless its cascade at
+             * cur_tick is pending, its timers are cascaded one rotation later */
+            if (tick < wheel->cur_tick) {
+               tick += (uint64_t) TW_SLOTS << shift;
+            }
+            if (tick < next_tick) {
+               next_tick = tick;
+            }
+            break;
+         }
+      }
+   }
+
+   next_ms = wheel->base_ms + next_tick * TW_TICK_MS;
+   if (next_ms <= now_ms) {
+      return 0;
+   }
+   if (next_ms - now_ms > INT_MAX) {
+      return INT_MAX;
+   }
+
+   return (int) (next_ms - now_ms);
+}
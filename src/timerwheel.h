@@ -0,0 +1,104 @@
+/**
+ * @file timerwheel.h
+ * @brief Hierarchical timer wheel on monotonic clock. Arming and canceling of timer is O(1) and only timers that expired are touched when the wheel advances.
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TW_TICK_MS 10 ///< Resolution of wheel in milliseconds
+#define TW_LEVELS 4 ///< Number of wheel levels, each level covers TW_SLOTS times more ticks
+#define TW_SLOT_BITS 6 ///< Number of bits of tick used as slot index of one level
+#define TW_SLOTS (1 << TW_SLOT_BITS) ///< Number of slots in each level
+#define TW_SLOT_MASK (TW_SLOTS - 1) ///< Mask of slot index of one level
+
+/**
+ * @brief Function called once timer expires
+ * @param priv Private pointer given at timer initialization
+ * */
+typedef void (*tw_timer_fn)(void *priv);
+
+/**
+ * @brief Timer embedded inside structure it belongs to.
+ * @details Timer is member of intrusive list of wheel slot, no allocation is needed
+ *  to arm it. Timer is armed if pprev is not NULL.
+ * */
+typedef struct tw_timer_s {
+   struct tw_timer_s *next; ///< Next timer in the same slot
+   struct tw_timer_s **pprev; ///< Pointer to previous next pointer or NULL if not armed
+   uint64_t expires; ///< Tick at which the timer expires
+   tw_timer_fn fn; ///< Function to call once timer expires
+   void *priv; ///< Private pointer passed to fn
+} tw_timer_t;
+
+/**
+ * @brief Timer wheel structure.
+ * @details Zero initialized wheel is valid, its clock starts with the first tw_arm call.
+ * */
+typedef struct tw_wheel_s {
+   bool started; ///< Whether base_ms was set
+   uint64_t base_ms; ///< Monotonic time of tick 0
+   uint64_t cur_tick; ///< Next tick to be processed
+   uint32_t armed_cnt; ///< Number of armed timers
+   tw_timer_t *slots[TW_LEVELS][TW_SLOTS]; ///< Heads of slot lists
+} tw_wheel_t;
+
+extern tw_wheel_t main_wheel; ///< Timer wheel of supervisor_routine, used under config_lock
+
+/**
+ * @brief Initializes timer, does not arm it.
+ * @param timer Timer to initialize
+ * @param fn Function to call once timer expires
+ * @param priv Private pointer passed to fn
+ * */
+extern void tw_timer_init(tw_timer_t *timer, tw_timer_fn fn, void *priv);
+
+/**
+ * @brief Arms timer to expire after delay_ms milliseconds. Already armed timer is re-armed.
+ * @details Timer never expires sooner than after delay_ms, but it can expire up to
+ *  TW_TICK_MS later.
+ * @param wheel Wheel to use
+ * @param timer Initialized timer
+ * @param now_ms Current monotonic time in milliseconds
+ * @param delay_ms Delay in milliseconds
+ * */
+extern void tw_arm(tw_wheel_t *wheel, tw_timer_t *timer, uint64_t now_ms, uint64_t delay_ms);
+
+/**
+ * @brief Cancels timer. Canceling of timer that is not armed does nothing.
+ * @param wheel Wheel the timer was armed in
+ * @param timer Timer to cancel
+ * */
+extern void tw_cancel(tw_wheel_t *wheel, tw_timer_t *timer);
+
+/**
+ * @brief Returns whether timer is armed
+ * @param timer Timer to check
+ * @return true if armed
+ * */
+extern bool tw_armed(const tw_timer_t *timer);
+
+/**
+ * @brief Advances wheel to given time and calls functions of expired timers.
+ * @details Timer is disarmed before its function is called, so the function can
+ *  re-arm it or free the structure the timer is embedded in.
+ * @param wheel Wheel to advance
+ * @param now_ms Current monotonic time in milliseconds
+ * @return Number of expired timers
+ * */
+extern uint32_t tw_advance(tw_wheel_t *wheel, uint64_t now_ms);
+
+/**
+ * @brief Returns time until wheel has to be advanced next time.
+ * @details For timers in higher levels it returns time of their cascade, which
+ *  is never later than their expiration.
+ * @param wheel Wheel to use
+ * @param now_ms Current monotonic time in milliseconds
+ * @return Timeout in milliseconds usable for epoll_wait or -1 if no timer is armed
+ * */
+extern int tw_next_timeout(const tw_wheel_t *wheel, uint64_t now_ms);
+
+#endif
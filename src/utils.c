@@ -6,7 +6,7 @@
 #include <time.h>
 #include "utils.h"
 
-char verbose_msg[4096];
+_Thread_local char verbose_msg[4096];
 FILE *output_fd = NULL;
 FILE *supervisor_log_fd = NULL;
 uint8_t verbosity_level = V1;
@@ -19,20 +19,43 @@ uint8_t verbosity_level = V1;
  * */
 static int vector_resize(vector_t *v, uint32_t capacity);
 
+/**
+ * @brief Computes FNV-1a hash of given name
+ * @param name Name to hash
+ * @return Hash of name
+ * */
+static uint32_t name_index_hash(const char *name);
+
+/**
+ * @brief Moves entries of index to new table of given capacity
+ * @param idx Index to resize
+ * @param capacity New capacity, power of two
+ * @return -1 on error, 0 on success
+ * */
+static int name_index_resize(name_index_t *idx, uint32_t capacity);
+
 
 char *get_formatted_time()
 {
    time_t raw_time;
-   static char buffer[28];
-   struct tm* tm_info;
+   static _Thread_local char buffer[28];
+   struct tm tm_info;
 
    time(&raw_time);
-   tm_info = localtime(&raw_time);
-   strftime(buffer, 28, "[%Y-%m-%d %H:%M:%S]", tm_info);
+   localtime_r(&raw_time, &tm_info);
+   strftime(buffer, 28, "[%Y-%m-%d %H:%M:%S]", &tm_info);
 
    return buffer;
 }
 
+uint64_t get_mono_time_ms()
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
 void print_msg(int level, char *string)
 {
    switch (level) {
@@ -112,6 +135,18 @@ void vector_delete(vector_t *v, uint32_t index)
    v->total--;
 }
 
+int vector_remove_item(vector_t *v, void *item)
+{
+   for (uint32_t i = 0; i < v->total; i++) {
+      if (v->items[i] == item) {
+         vector_delete(v, i);
+         return 0;
+      }
+   }
+
+   return -1;
+}
+
 void vector_free(vector_t *v)
 {
    v->total = 0;
@@ -128,4 +163,206 @@ static int vector_resize(vector_t *v, uint32_t capacity)
    v->capacity = capacity;
 
    return 0;
-}
\ No newline at end of file
+}
+
+int strbuf_reserve(strbuf_t *sb, uint32_t size)
+{
+   uint32_t capacity;
+   char *data;
+
+   // One more for the terminating '\0'
+   if (sb->len + size + 1 <= sb->capacity) {
+      return 0;
+   }
+
+   capacity = (sb->capacity < 64 ? 64 : sb->capacity);
+   while (capacity < sb->len + size + 1) {
+      capacity *= 2;
+   }
+   data = realloc(sb->data, capacity);
+   IF_NO_MEM_INT_ERR(data)
+
+   sb->data = data;
+   sb->capacity = capacity;
+   sb->data[sb->len] = '\0';
+
+   return 0;
+}
+
+int strbuf_append(strbuf_t *sb, const char *str)
+{
+   uint32_t len = (uint32_t) strlen(str);
+
+   if (strbuf_reserve(sb, len) != 0) {
+      return -1;
+   }
+   memcpy(sb->data + sb->len, str, len + 1);
+   sb->len += len;
+
+   return 0;
+}
+
+int strbuf_append_char(strbuf_t *sb, char c)
+{
+   if (strbuf_reserve(sb, 1) != 0) {
+      return -1;
+   }
+   sb->data[sb->len++] = c;
+   sb->data[sb->len] = '\0';
+
+   return 0;
+}
+
+int strbuf_append_uint(strbuf_t *sb, uint32_t num)
+{
+   char digits[11];
+   uint32_t pos = sizeof(digits);
+
+   // Digits are written from the end
+   do {
+      digits[--pos] = (char) ('0' + num % 10);
+      num /= 10;
+   } while (num > 0);
+
+   if (strbuf_reserve(sb, sizeof(digits) - pos) != 0) {
+      return -1;
+   }
+   memcpy(sb->data + sb->len, digits + pos, sizeof(digits) - pos);
+   sb->len += sizeof(digits) - pos;
+   sb->data[sb->len] = '\0';
+
+   return 0;
+}
+
+void strbuf_free(strbuf_t *sb)
+{
+   sb->len = 0;
+   sb->capacity = 0;
+   NULLP_TEST_AND_FREE(sb->data)
+}
+
+static uint32_t name_index_hash(const char *name)
+{
+   uint32_t hash = 2166136261U;
+
+   for (const unsigned char *c = (const unsigned char *) name; *c != '\0'; c++) {
+      hash = (hash ^ *c) * 16777619U;
+   }
+
+   return hash;
+}
+
+static int name_index_resize(name_index_t *idx, uint32_t capacity)
+{
+   name_index_entry_t *entries = calloc(capacity, sizeof(name_index_entry_t));
+   name_index_entry_t *old = idx->entries;
+   uint32_t pos;
+
+   IF_NO_MEM_INT_ERR(entries)
+
+   for (uint32_t i = 0; i < idx->capacity; i++) {
+      if (old[i].name == NULL) {
+         continue;
+      }
+      pos = old[i].hash & (capacity - 1);
+      while (entries[pos].name != NULL) {
+         pos = (pos + 1) & (capacity - 1);
+      }
+      entries[pos] = old[i];
+   }
+   NULLP_TEST_AND_FREE(old)
+   idx->entries = entries;
+   idx->capacity = capacity;
+
+   return 0;
+}
+
+int name_index_add(name_index_t *idx, const char *name, void *item)
+{
+   uint32_t hash = name_index_hash(name);
+   uint32_t pos;
+
+   // Load is kept under 3/4, so that probe sequences stay short
+   if ((idx->total + 1) * 4 > idx->capacity * 3) {
+      if (name_index_resize(idx, (idx->capacity == 0 ? 16 : idx->capacity * 2)) != 0) {
+         return -1;
+      }
+   }
+
+   pos = hash & (idx->capacity - 1);
+   while (idx->entries[pos].name != NULL) {
+      pos = (pos + 1) & (idx->capacity - 1);
+   }
+   idx->entries[pos].hash = hash;
+   idx->entries[pos].name = name;
+   idx->entries[pos].item = item;
+   idx->total++;
+
+   return 0;
+}
+
+void * name_index_get(const name_index_t *idx, const char *name)
+{
+   uint32_t hash;
+   uint32_t pos;
+
+   if (idx->total == 0) {
+      return NULL;
+   }
+
+   hash = name_index_hash(name);
+   pos = hash & (idx->capacity - 1);
+   while (idx->entries[pos].name != NULL) {
+      if (idx->entries[pos].hash == hash && strcmp(idx->entries[pos].name, name) == 0) {
+         return idx->entries[pos].item;
+      }
+      pos = (pos + 1) & (idx->capacity - 1);
+   }
+
+   return NULL;
+}
+
+void name_index_delete(name_index_t *idx, const char *name, const void *item)
+{
+   uint32_t mask = idx->capacity - 1;
+   uint32_t hole;
+   uint32_t pos;
+   uint32_t home;
+
+   if (idx->total == 0) {
+      return;
+   }
+
+   hole = name_index_hash(name) & mask;
+   while (idx->entries[hole].item != item) {
+      if (idx->entries[hole].name == NULL) {
+         return;
+      }
+      hole = (hole + 1) & mask;
+   }
+
+   // Following entries of the probe sequence are shifted back, no tombstones are needed
+   pos = hole;
+   for (;;) {
+      pos = (pos + 1) & mask;
+      if (idx->entries[pos].name == NULL) {
+         break;
+      }
+      home = idx->entries[pos].hash & mask;
+      // Entry can fill the hole only if the hole lies between its home and its position
+      if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+         idx->entries[hole] = idx->entries[pos];
+         hole = pos;
+      }
+   }
+   idx->entries[hole].name = NULL;
+   idx->entries[hole].item = NULL;
+   idx->total--;
+}
+
+void name_index_free(name_index_t *idx)
+{
+   idx->total = 0;
+   idx->capacity = 0;
+   NULLP_TEST_AND_FREE(idx->entries)
+}
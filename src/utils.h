@@ -94,7 +94,37 @@ typedef struct vector_s {
    void **items; ///< Actual dynamic array
 } vector_t;
 
-extern char verbose_msg[4096]; ///< String buffer for VERBOSE macro
+/**
+ * @brief Growing string buffer, several strings can be stored in it one after another
+ *  separated by '\0'
+ * */
+typedef struct strbuf_s {
+   uint32_t capacity; ///< Allocated size of data
+   uint32_t len; ///< Length of content without the terminating '\0' that always follows it
+   char *data; ///< Content or NULL if nothing was allocated yet
+} strbuf_t;
+
+/**
+ * @brief Entry of name_index_t
+ * */
+typedef struct name_index_entry_s {
+   uint32_t hash; ///< Hash of name
+   const char *name; ///< Name of item, owned by the item, NULL marks free entry
+   void *item; ///< Indexed item
+} name_index_entry_t;
+
+/**
+ * @brief Open addressing hash table of items by their names with linear probing.
+ * @details Names aren't copied, item has to keep its name unchanged while it is indexed.
+ * */
+typedef struct name_index_s {
+   uint32_t capacity; ///< Number of entries, power of two or 0
+   uint32_t total; ///< Number of used entries
+   name_index_entry_t *entries; ///< Table of entries or NULL if nothing was added yet
+} name_index_t;
+
+extern _Thread_local char verbose_msg[4096]; ///< String buffer for VERBOSE macro, one per thread
+                                             ///<  since the collector thread of service logs too
 extern FILE *output_fd; ///< Output file descriptor for VERBOSE macro. stdout or supervisor_log_fd is used
 extern FILE *supervisor_log_fd; ///< File descriptor of supervisor's log file
 extern uint8_t verbosity_level; ///< Global application's verbosity level to use
@@ -108,10 +138,16 @@ extern void print_msg(int level, char *string);
 
 /**
  * @brief Returns formatted time as string
- * @return Time as string in format [%Y-%m-%d %H:%M:%S]
+ * @return Time as string in format [%Y-%m-%d %H:%M:%S], buffer is owned by calling thread
  * */
 extern char * get_formatted_time();
 
+/**
+ * @brief Returns time of monotonic clock in milliseconds
+ * @return Milliseconds since unspecified starting point
+ * */
+extern uint64_t get_mono_time_ms();
+
 /**
  * @brief Initializes given vector
  * @param v Vector to initialize
@@ -135,9 +171,87 @@ extern int vector_add(vector_t *v, void * item);
  * */
 extern void vector_delete(vector_t *v, uint32_t index);
 
+/**
+ * @brief Removes given item from vector, keeps order of the other items
+ * @details Only pointers are compared, no item is dereferenced.
+ * @param v Vector to remove item from
+ * @param item Item to remove
+ * @return 0 if item was removed, -1 if it isn't in vector
+ * */
+extern int vector_remove_item(vector_t *v, void *item);
+
 /**
  * @brief Resets vector to default values and clears items array
  * @param v Vector to free
  * */
 extern void vector_free(vector_t *v);
+
+/**
+ * @brief Makes sure given number of characters can be appended to buffer without reallocation
+ * @param sb Buffer to grow
+ * @param size Number of characters to make room for
+ * @return -1 on error, 0 on success
+ * */
+extern int strbuf_reserve(strbuf_t *sb, uint32_t size);
+
+/**
+ * @brief Appends given string to buffer
+ * @param sb Buffer to append to
+ * @param str String to append
+ * @return -1 on error, 0 on success
+ * */
+extern int strbuf_append(strbuf_t *sb, const char *str);
+
+/**
+ * @brief Appends single character to buffer, '\0' can be used to separate strings
+ * @param sb Buffer to append to
+ * @param c Character to append
+ * @return -1 on error, 0 on success
+ * */
+extern int strbuf_append_char(strbuf_t *sb, char c);
+
+/**
+ * @brief Appends decimal representation of given number to buffer
+ * @param sb Buffer to append to
+ * @param num Number to append
+ * @return -1 on error, 0 on success
+ * */
+extern int strbuf_append_uint(strbuf_t *sb, uint32_t num);
+
+/**
+ * @brief Frees content of buffer and resets it to empty one
+ * @param sb Buffer to free
+ * */
+extern void strbuf_free(strbuf_t *sb);
+
+/**
+ * @brief Adds item to index under given name, the index grows as needed.
+ * @param idx Index to add to
+ * @param name Name of item, it is not copied
+ * @param item Item to add
+ * @return -1 on error, 0 on success
+ * */
+extern int name_index_add(name_index_t *idx, const char *name, void *item);
+
+/**
+ * @brief Finds item of given name in index
+ * @param idx Index to search
+ * @param name Name to find
+ * @return Found item or NULL if not found
+ * */
+extern void * name_index_get(const name_index_t *idx, const char *name);
+
+/**
+ * @brief Removes given item from index
+ * @param idx Index to remove from
+ * @param name Name the item was added under
+ * @param item Item to remove
+ * */
+extern void name_index_delete(name_index_t *idx, const char *name, const void *item);
+
+/**
+ * @brief Frees entries of index and resets it to empty one
+ * @param idx Index to free
+ * */
+extern void name_index_free(name_index_t *idx);
 #endif
@@ -0,0 +1,184 @@
+/**
+ * @file bench_insts.c
+ * @brief Microbenchmark of periodic passes over all instances: walk over instances with
+ *  hot state inline in the instance structure, as it was before insts_hot, compared to
+ *  scan of hot state arrays in insts_hot.
+ * @details Both passes evaluate what insts_stop_sigint and insts_start_needed check in
+ *  the steady state, i.e. all instances are enabled and running and nothing matches.
+ *  Usage: ./bench_insts [ROUNDS [INSTANCES]]
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/module.c"
+
+/**
+ * @brief Instance with the previous layout: hot fields at their former places among the
+ *  other fields of inst_t, enabled near the start and running, should_die and pid after
+ *  logging state, i.e. in different cache lines.
+ * */
+typedef struct old_inst_s {
+   char head[offsetof(inst_t, use_sysrepo)]; ///< Interface vectors
+   bool enabled;
+   char mid[offsetof(inst_t, stop_state) - offsetof(inst_t, use_sysrepo)]; ///< To mod_ref
+   bool running;
+   bool should_die;
+   char stop[offsetof(inst_t, pidfd) - offsetof(inst_t, stop_state)]; ///< Stop state and timer
+   pid_t pid;
+   char tail[sizeof(inst_t) - offsetof(inst_t, pidfd)]; ///< Rest of inst_t
+   bool resources_due;
+   bool service_ifc_due;
+} old_inst_t;
+
+static vector_t old_insts_v; ///< Instances with the previous layout
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Loads enabled running instances, each with one IN and one OUT interface so
+ *  that instances are spread over the heap as after configuration load. Instance with
+ *  the previous layout is allocated along with each of them.
+ * */
+static int insts_load(uint32_t cnt)
+{
+   char name[64];
+   inst_t *inst;
+   old_inst_t *old;
+   interface_t *ifc;
+
+   if (vector_init(&insts_v, cnt) != 0 || vector_init(&old_insts_v, cnt) != 0) {
+      return -1;
+   }
+   for (uint32_t i = 0; i < cnt; i++) {
+      inst = inst_alloc();
+      old = calloc(1, sizeof(old_inst_t));
+      if (inst == NULL || old == NULL || vector_add(&old_insts_v, old) != 0) {
+         return -1;
+      }
+      old->enabled = true;
+      old->running = true;
+      old->pid = (pid_t) (1000 + i);
+      snprintf(name, sizeof(name), "detector_%u", i);
+      inst->name = strdup(name);
+      if (inst->name == NULL || insts_add(inst) != 0) {
+         return -1;
+      }
+      INST_ENABLED(inst) = true;
+      INST_RUNNING(inst) = true;
+      INST_PID(inst) = (pid_t) (1000 + i);
+
+      for (int dir = 0; dir < 2; dir++) {
+         ifc = interface_alloc();
+         if (ifc == NULL) {
+            return -1;
+         }
+         ifc->name = strdup(dir == 0 ? "in" : "out");
+         ifc->direction = (dir == 0 ? NS_IF_DIR_IN : NS_IF_DIR_OUT);
+         ifc->type = NS_IF_TYPE_BH;
+         if (ifc->name == NULL || inst_interface_add(inst, ifc) != 0) {
+            return -1;
+         }
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Pass over instances with the previous layout, every one is dereferenced to read
+ *  its inline state
+ * */
+static uint32_t pass_old_insts()
+{
+   uint32_t matched = 0;
+   old_inst_t *old;
+
+   for (uint32_t i = 0; i < old_insts_v.total; i++) {
+      old = old_insts_v.items[i];
+      if (old->running && (old->enabled == false || old->should_die)) {
+         matched++;
+      }
+      if (old->enabled && old->running == false) {
+         matched++;
+      }
+   }
+
+   return matched;
+}
+
+/**
+ * @brief Pass over hot state arrays, instances aren't dereferenced unless they match
+ * */
+static uint32_t pass_insts_hot()
+{
+   uint32_t matched = 0;
+
+   for (uint32_t s = 0; s < insts_hot.used; s++) {
+      if (insts_hot.listed[s] == false) {
+         continue;
+      }
+      if (insts_hot.running[s] && (insts_hot.enabled[s] == false || insts_hot.should_die[s])) {
+         matched++;
+      }
+      if (insts_hot.enabled[s] && insts_hot.running[s] == false) {
+         matched++;
+      }
+   }
+
+   return matched;
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t rounds = (argc > 1 ? (uint32_t) atoi(argv[1]) : 10000);
+   uint32_t cnt = (argc > 2 ? (uint32_t) atoi(argv[2]) : 10000);
+   volatile uint32_t matched = 0;
+   uint64_t start;
+   uint64_t old_ns;
+   uint64_t hot_ns;
+
+   if (rounds == 0 || cnt == 0) {
+      fprintf(stderr, "Usage: %s [ROUNDS [INSTANCES]]\n", argv[0]);
+      return 1;
+   }
+   verbosity_level = N_ERR;
+
+   if (insts_load(cnt) != 0) {
+      fprintf(stderr, "Failed to load instances\n");
+      return 1;
+   }
+
+   start = now_ns();
+   for (uint32_t r = 0; r < rounds; r++) {
+      matched += pass_old_insts();
+   }
+   old_ns = now_ns() - start;
+
+   start = now_ns();
+   for (uint32_t r = 0; r < rounds; r++) {
+      matched += pass_insts_hot();
+   }
+   hot_ns = now_ns() - start;
+
+   printf("%u rounds, %u instances, %u matched\n", rounds, cnt, matched);
+   printf("inline:    %8.2f us/pass, %6.2f ns/instance\n",
+          (double) old_ns / 1e3 / rounds, (double) old_ns / rounds / cnt);
+   printf("insts_hot: %8.2f us/pass, %6.2f ns/instance\n",
+          (double) hot_ns / 1e3 / rounds, (double) hot_ns / rounds / cnt);
+
+   insts_free();
+   for (uint32_t i = 0; i < old_insts_v.total; i++) {
+      free(old_insts_v.items[i]);
+   }
+   vector_free(&old_insts_v);
+
+   return 0;
+}
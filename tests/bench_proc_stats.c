@@ -0,0 +1,186 @@
+/**
+ * @file bench_proc_stats.c
+ * @brief Microbenchmark of resources sampling of one instance, previous fopen, getline
+ *  and strtok based sampling compared to persistent descriptors and proc_stats.c parsers.
+ * @details Sampled process is the benchmark itself.
+ *  Usage: ./bench_proc_stats [ITERATIONS]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "../src/proc_stats.c"
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Sampling the way it was done before, /proc/stat was read for every instance
+ * */
+static int sample_before(pid_t pid, uint64_t *out)
+{
+   char path[256];
+   char *line = NULL;
+   char *token = NULL;
+   char *endptr = NULL;
+   size_t line_len = 0;
+   FILE *fd = NULL;
+   uint64_t sum = 0;
+
+   fd = fopen("/proc/stat", "r");
+   if (fd == NULL || getline(&line, &line_len, fd) == -1) {
+      return -1;
+   }
+   token = strtok(line, " ");
+   for (token = strtok(NULL, " "); token != NULL; token = strtok(NULL, " ")) {
+      sum += strtoul(token, &endptr, 10);
+   }
+   fclose(fd);
+
+   snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+   fd = fopen(path, "r");
+   if (fd == NULL || getline(&line, &line_len, fd) == -1) {
+      return -1;
+   }
+   token = strtok(line, " ");
+   for (int position = 1; token != NULL && position <= 23; position++) {
+      if (position == 14 || position == 15 || position == 23) {
+         sum += strtoul(token, &endptr, 10);
+      }
+      token = strtok(NULL, " ");
+   }
+   fclose(fd);
+
+   snprintf(path, sizeof(path), "/proc/%d/status", pid);
+   fd = fopen(path, "r");
+   if (fd == NULL) {
+      return -1;
+   }
+   while (getline(&line, &line_len, fd) != -1) {
+      if (strstr(line, "VmRSS") != NULL) {
+         for (token = strtok(line, " "); token != NULL; token = strtok(NULL, " ")) {
+            if (strtoul(token, &endptr, 10) > 0) {
+               sum += strtoul(token, &endptr, 10);
+               break;
+            }
+         }
+         break;
+      }
+   }
+   fclose(fd);
+   free(line);
+
+   *out = sum;
+   return 0;
+}
+
+/**
+ * @brief Current sampling of one instance, /proc/stat is read once per pass separately
+ * */
+static int sample_after(int stat_fd, int statm_fd, uint64_t *out)
+{
+   char buf[PROC_READ_BUF_SIZE];
+   ssize_t len;
+   proc_pid_stat_t st;
+   uint64_t rss;
+
+   len = proc_pread(stat_fd, buf, sizeof(buf));
+   if (len == -1 || proc_parse_pid_stat(buf, (size_t) len, &st) == -1) {
+      return -1;
+   }
+   len = proc_pread(statm_fd, buf, sizeof(buf));
+   if (len == -1 || proc_parse_statm_rss(buf, (size_t) len, &rss) == -1) {
+      return -1;
+   }
+
+   *out = st.utime + st.stime + st.vsize + rss;
+   return 0;
+}
+
+/**
+ * @brief Current read of total CPU time done once per sampling pass
+ * */
+static int sample_pass(int proc_stat_fd, uint64_t *out)
+{
+   char buf[PROC_READ_BUF_SIZE];
+   ssize_t len = proc_pread(proc_stat_fd, buf, sizeof(buf));
+
+   if (len == -1) {
+      return -1;
+   }
+   return proc_parse_total_cpu(buf, (size_t) len, out);
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t iters = (argc > 1 ? (uint32_t) atoi(argv[1]) : 20000);
+   pid_t pid = getpid();
+   char path[256];
+   uint64_t val;
+   uint64_t start;
+   uint64_t before_ns;
+   uint64_t after_ns;
+   uint64_t pass_ns;
+   int stat_fd;
+   int statm_fd;
+   int proc_stat_fd;
+
+   if (iters == 0) {
+      fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+      return 1;
+   }
+
+   start = now_ns();
+   for (uint32_t i = 0; i < iters; i++) {
+      if (sample_before(pid, &val) == -1) {
+         fprintf(stderr, "Previous sampling failed\n");
+         return 1;
+      }
+   }
+   before_ns = now_ns() - start;
+
+   snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+   stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+   snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+   statm_fd = open(path, O_RDONLY | O_CLOEXEC);
+   proc_stat_fd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+   if (stat_fd == -1 || statm_fd == -1 || proc_stat_fd == -1) {
+      fprintf(stderr, "Failed to open /proc files\n");
+      return 1;
+   }
+
+   start = now_ns();
+   for (uint32_t i = 0; i < iters; i++) {
+      if (sample_after(stat_fd, statm_fd, &val) == -1) {
+         fprintf(stderr, "Sampling failed\n");
+         return 1;
+      }
+   }
+   after_ns = now_ns() - start;
+
+   start = now_ns();
+   for (uint32_t i = 0; i < iters; i++) {
+      if (sample_pass(proc_stat_fd, &val) == -1) {
+         fprintf(stderr, "Reading of /proc/stat failed\n");
+         return 1;
+      }
+   }
+   pass_ns = now_ns() - start;
+
+   printf("%u iterations\n", iters);
+   printf("before: %8.1f ns/instance (incl. /proc/stat)\n", (double) before_ns / iters);
+   printf("after:  %8.1f ns/instance (%.1fx) + %.1f ns/pass for /proc/stat\n",
+          (double) after_ns / iters, (double) before_ns / (double) after_ns,
+          (double) pass_ns / iters);
+
+   close(stat_fd);
+   close(statm_fd);
+   close(proc_stat_fd);
+   return 0;
+}
@@ -0,0 +1,166 @@
+/**
+ * @file bench_spawn.c
+ * @brief Microbenchmark of start of instance process, previous fork of the whole supervisor
+ *  compared to spawn.c clone(CLONE_VM | CLONE_VFORK) launcher.
+ * @details /bin/true is started STARTS times by both launchers and reaped right away, first
+ *  with small heap and then with HEAP_MB of touched heap that emulates supervisor managing
+ *  many instances. Latency of fork grows with the heap because page tables are copied,
+ *  latency of spawn stays flat.
+ *  Usage: ./bench_spawn [STARTS [HEAP_MB]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "../src/spawn.h"
+
+#define BENCH_BINARY "/bin/true"
+#define BENCH_LOG "/dev/null"
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Start the way it was done before, forked child redirected its output and exec'd
+ * */
+static pid_t start_before(char **argv)
+{
+   pid_t pid = fork();
+
+   if (pid == 0) {
+      int fd = open(BENCH_LOG, O_RDWR | O_APPEND);
+      if (fd != -1) {
+         dup2(fd, 1);
+         dup2(fd, 2);
+         close(fd);
+      }
+      setsid();
+      execv(BENCH_BINARY, argv);
+      _exit(EXIT_FAILURE);
+   }
+   return pid;
+}
+
+/**
+ * @brief Current start via spawn_process
+ * */
+static pid_t start_after(char **argv)
+{
+   spawn_args_t args = {
+      .path = BENCH_BINARY,
+      .argv = argv,
+      .stdout_path = BENCH_LOG,
+      .stderr_path = BENCH_LOG,
+      .stdout_fd = -1,
+      .stderr_fd = -1,
+      .log_perm = 0600,
+      .cgroup_procs_fd = -1,
+      .pl = NULL,
+   };
+   pid_t pid = spawn_process(&args);
+
+   if (pid != -1 && args.exec_errno != 0) {
+      waitpid(pid, NULL, 0);
+      return -1;
+   }
+   return pid;
+}
+
+/**
+ * @brief Starts and reaps process given number of times
+ * @return -1 if some start failed, 0 on success
+ * */
+static int run(pid_t (*start)(char **), char **argv, uint32_t starts, uint64_t *total_ns,
+               uint64_t *max_ns)
+{
+   uint64_t begin;
+   uint64_t took;
+   pid_t pid;
+
+   *total_ns = 0;
+   *max_ns = 0;
+   for (uint32_t i = 0; i < starts; i++) {
+      // Only start itself is measured, the supervisor doesn't wait for the instance either
+      begin = now_ns();
+      pid = start(argv);
+      took = now_ns() - begin;
+      if (pid == -1 || waitpid(pid, NULL, 0) != pid) {
+         return -1;
+      }
+      *total_ns += took;
+      if (took > *max_ns) {
+         *max_ns = took;
+      }
+   }
+   return 0;
+}
+
+/**
+ * @brief Runs both launchers with current heap and prints their latencies
+ * */
+static int run_both(char **argv, uint32_t starts, uint32_t heap_mb)
+{
+   uint64_t before_ns;
+   uint64_t before_max;
+   uint64_t after_ns;
+   uint64_t after_max;
+
+   if (run(start_before, argv, starts, &before_ns, &before_max) == -1
+       || run(start_after, argv, starts, &after_ns, &after_max) == -1) {
+      fprintf(stderr, "Failed to start %s\n", BENCH_BINARY);
+      return -1;
+   }
+
+   printf("heap %5u MB  fork:  %8.1f us/start (max %8.1f us)\n", heap_mb,
+          (double) before_ns / starts / 1000, (double) before_max / 1000);
+   printf("heap %5u MB  spawn: %8.1f us/start (max %8.1f us, %.1fx)\n", heap_mb,
+          (double) after_ns / starts / 1000, (double) after_max / 1000,
+          (double) before_ns / (double) after_ns);
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t starts = (argc > 1 ? (uint32_t) atoi(argv[1]) : 1000);
+   uint32_t heap_mb = (argc > 2 ? (uint32_t) atoi(argv[2]) : 512);
+   char *child_argv[] = { BENCH_BINARY, NULL };
+   char *heap;
+
+   if (starts == 0) {
+      fprintf(stderr, "Usage: %s [STARTS [HEAP_MB]]\n", argv[0]);
+      return 1;
+   }
+
+   printf("%u starts of %s\n", starts, BENCH_BINARY);
+   if (run_both(child_argv, starts, 0) == -1) {
+      return 1;
+   }
+
+   if (heap_mb == 0) {
+      return 0;
+   }
+   heap = malloc((size_t) heap_mb << 20);
+   if (heap == NULL) {
+      fprintf(stderr, "Failed to allocate %u MB\n", heap_mb);
+      return 1;
+   }
+   // Pages have to be present so that fork copies their page tables
+   memset(heap, 1, (size_t) heap_mb << 20);
+   if (run_both(child_argv, starts, heap_mb) == -1) {
+      free(heap);
+      return 1;
+   }
+
+   free(heap);
+   return 0;
+}
@@ -0,0 +1,184 @@
+/**
+ * @file bench_stats.c
+ * @brief Microbenchmark of serving stats of instances to sysrepo: requests of single
+ *  instances (as sysrepo asks for every list entry) compared to one request of all of them.
+ * @details Snapshot is published before every round in the first case, so that the values
+ *  are built again, like when stats are polled less often than snapshot is published.
+ *  Usage: ./bench_stats [ROUNDS [INSTANCES]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/stats.c"
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Loads instances with one IN and one OUT interface each
+ * */
+static int insts_load(uint32_t cnt)
+{
+   char name[64];
+   inst_t *inst;
+   interface_t *ifc;
+
+   if (vector_init(&insts_v, cnt) != 0) {
+      return -1;
+   }
+   for (uint32_t i = 0; i < cnt; i++) {
+      inst = inst_alloc();
+      if (inst == NULL || vector_add(&insts_v, inst) != 0) {
+         return -1;
+      }
+      snprintf(name, sizeof(name), "detector_%u", i);
+      inst->name = strdup(name);
+      inst->restarts_cnt = (uint8_t) i;
+      inst->start_time = time(NULL);
+
+      for (int dir = 0; dir < 2; dir++) {
+         ifc = interface_alloc();
+         if (ifc == NULL) {
+            return -1;
+         }
+         ifc->name = strdup(dir == 0 ? "in" : "out");
+         ifc->direction = (dir == 0 ? NS_IF_DIR_IN : NS_IF_DIR_OUT);
+         ifc->type = NS_IF_TYPE_BH;
+         if (inst->name == NULL || ifc->name == NULL || interface_stats_alloc(ifc) != 0
+             || inst_interface_add(inst, ifc) != 0) {
+            return -1;
+         }
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Requests stats of every instance one by one, as sysrepo does
+ * */
+static int request_each(char **xpaths, uint32_t cnt)
+{
+   sr_val_t *vals;
+   size_t vals_cnt;
+
+   for (uint32_t i = 0; i < cnt; i++) {
+      if (inst_get_stats_cb(xpaths[i], &vals, &vals_cnt, NULL) != SR_ERR_OK) {
+         return -1;
+      }
+      sr_free_values(vals, vals_cnt);
+      if (interface_get_stats_cb(xpaths[cnt + i], &vals, &vals_cnt, NULL) != SR_ERR_OK) {
+         return -1;
+      }
+      sr_free_values(vals, vals_cnt);
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Requests stats of all instances and all interfaces in one request each
+ * */
+static int request_all()
+{
+   sr_val_t *vals;
+   size_t vals_cnt;
+
+   if (inst_get_stats_cb(NS_ROOT_XPATH"/instance/stats", &vals, &vals_cnt, NULL) != SR_ERR_OK) {
+      return -1;
+   }
+   sr_free_values(vals, vals_cnt);
+   if (interface_get_stats_cb(NS_ROOT_XPATH"/instance/interface/stats",
+                              &vals, &vals_cnt, NULL) != SR_ERR_OK) {
+      return -1;
+   }
+   sr_free_values(vals, vals_cnt);
+
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t rounds = (argc > 1 ? (uint32_t) atoi(argv[1]) : 50);
+   uint32_t cnt = (argc > 2 ? (uint32_t) atoi(argv[2]) : 1000);
+   char **xpaths;
+   uint64_t start;
+   uint64_t fresh_ns;
+   uint64_t each_ns;
+   uint64_t all_ns;
+   double reqs;
+
+   if (rounds == 0 || cnt == 0) {
+      fprintf(stderr, "Usage: %s [ROUNDS [INSTANCES]]\n", argv[0]);
+      return 1;
+   }
+   verbosity_level = N_ERR;
+
+   xpaths = calloc(2 * cnt, sizeof(char *));
+   if (xpaths == NULL || insts_load(cnt) != 0) {
+      fprintf(stderr, "Failed to load instances\n");
+      return 1;
+   }
+   for (uint32_t i = 0; i < cnt; i++) {
+      xpaths[i] = calloc(256, 1);
+      xpaths[cnt + i] = calloc(256, 1);
+      if (xpaths[i] == NULL || xpaths[cnt + i] == NULL) {
+         return 1;
+      }
+      snprintf(xpaths[i], 256, INST_STATS_XPATH_FMT, ((inst_t *) insts_v.items[i])->name);
+      snprintf(xpaths[cnt + i], 256, NS_ROOT_XPATH"/instance[name='%s']/interface/stats",
+               ((inst_t *) insts_v.items[i])->name);
+   }
+
+   start = now_ns();
+   for (uint32_t r = 0; r < rounds; r++) {
+      if (stats_snap_publish() != 0 || request_each(xpaths, cnt) != 0) {
+         fprintf(stderr, "Request failed\n");
+         return 1;
+      }
+   }
+   fresh_ns = now_ns() - start;
+
+   start = now_ns();
+   for (uint32_t r = 0; r < rounds; r++) {
+      if (request_each(xpaths, cnt) != 0) {
+         fprintf(stderr, "Request failed\n");
+         return 1;
+      }
+   }
+   each_ns = now_ns() - start;
+
+   start = now_ns();
+   for (uint32_t r = 0; r < rounds; r++) {
+      if (stats_snap_publish() != 0 || request_all() != 0) {
+         fprintf(stderr, "Request failed\n");
+         return 1;
+      }
+   }
+   all_ns = now_ns() - start;
+
+   // One instance request and one request of its interfaces per instance
+   reqs = 2.0 * cnt * rounds;
+   printf("%u rounds, %u instances\n", rounds, cnt);
+   printf("each, new snapshot:  %10.0f requests/s, %8.2f ms/round\n",
+          reqs * 1e9 / (double) fresh_ns, (double) fresh_ns / 1e6 / rounds);
+   printf("each, same snapshot: %10.0f requests/s, %8.2f ms/round\n",
+          reqs * 1e9 / (double) each_ns, (double) each_ns / 1e6 / rounds);
+   printf("all, new snapshot:   %10.0f rounds/s,   %8.2f ms/round\n",
+          (double) rounds * 1e9 / (double) all_ns, (double) all_ns / 1e6 / rounds);
+
+   stats_snap_free();
+   insts_free();
+   for (uint32_t i = 0; i < 2 * cnt; i++) {
+      free(xpaths[i]);
+   }
+   free(xpaths);
+
+   return 0;
+}
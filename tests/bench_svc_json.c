@@ -0,0 +1,146 @@
+/**
+ * @file bench_svc_json.c
+ * @brief Microbenchmark of parsing of service interface stats reply, svc_json_parse
+ *  compared to jansson DOM that was used before.
+ * @details Usage: ./bench_svc_json [ITERATIONS [IFCES_PER_DIRECTION]]
+ */
+
+#include <stdio.h>
+#include <jansson.h>
+
+#include "../src/svc_json.c"
+
+#define BENCH_MAX_IFCES 32
+
+static ifc_in_stats_t in_stats[BENCH_MAX_IFCES];
+static ifc_out_stats_t out_stats[BENCH_MAX_IFCES];
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Builds reply the way libtrap formats it
+ * */
+static size_t build_reply(char *buf, size_t size, uint32_t ifces)
+{
+   size_t len = (size_t) snprintf(buf, size, "{\"in_cnt\": %u, \"out_cnt\": %u, \"in\": [",
+                                  ifces, ifces);
+
+   for (uint32_t i = 0; i < ifces; i++) {
+      len += (size_t) snprintf(buf + len, size - len,
+                               "%s{\"messages\": %u, \"buffers\": %u, \"ifc_type\": 116,"
+                               " \"ifc_state\": 1, \"ifc_id\": \"%u\"}",
+                               i == 0 ? "" : ", ", 1234567 * (i + 1), 4321 * (i + 1), 7600 + i);
+   }
+   len += (size_t) snprintf(buf + len, size - len, "], \"out\": [");
+   for (uint32_t i = 0; i < ifces; i++) {
+      len += (size_t) snprintf(buf + len, size - len,
+                               "%s{\"sent-messages\": %u, \"dropped-messages\": %u,"
+                               " \"buffers\": %u, \"autoflushes\": %u, \"num_clients\": %u,"
+                               " \"type\": 117, \"ifc_id\": \"/tmp/ifc_%u\"}",
+                               i == 0 ? "" : ", ", 7654321 * (i + 1), 12 * i, 6543 * (i + 1),
+                               10 * i, i, i);
+   }
+   len += (size_t) snprintf(buf + len, size - len, "]}");
+
+   return len;
+}
+
+/**
+ * @brief Extracts the same values as svc_json_parse via jansson
+ * */
+static int jansson_parse(const char *data, uint32_t ifces)
+{
+   json_error_t error;
+   json_t *root = json_loads(data, 0, &error);
+   json_t *arr;
+   json_t *item;
+   size_t idx;
+
+   if (root == NULL) {
+      return -1;
+   }
+   if ((uint32_t) json_integer_value(json_object_get(root, "in_cnt")) != ifces) {
+      json_decref(root);
+      return -1;
+   }
+   arr = json_object_get(root, "in");
+   json_array_foreach(arr, idx, item) {
+      in_stats[idx].recv_msg_cnt = (uint64_t) json_integer_value(json_object_get(item, "messages"));
+      in_stats[idx].recv_buff_cnt = (uint64_t) json_integer_value(json_object_get(item, "buffers"));
+      in_stats[idx].type = (char) json_integer_value(json_object_get(item, "ifc_type"));
+      in_stats[idx].state = (uint8_t) json_integer_value(json_object_get(item, "ifc_state"));
+      in_stats[idx].id = strdup(json_string_value(json_object_get(item, "ifc_id")));
+      free(in_stats[idx].id);
+   }
+   arr = json_object_get(root, "out");
+   json_array_foreach(arr, idx, item) {
+      out_stats[idx].sent_msg_cnt = (uint64_t) json_integer_value(json_object_get(item, "sent-messages"));
+      out_stats[idx].dropped_msg_cnt = (uint64_t) json_integer_value(json_object_get(item, "dropped-messages"));
+      out_stats[idx].sent_buff_cnt = (uint64_t) json_integer_value(json_object_get(item, "buffers"));
+      out_stats[idx].autoflush_cnt = (uint64_t) json_integer_value(json_object_get(item, "autoflushes"));
+      out_stats[idx].num_clients = (int32_t) json_integer_value(json_object_get(item, "num_clients"));
+      out_stats[idx].type = (char) json_integer_value(json_object_get(item, "type"));
+      out_stats[idx].id = strdup(json_string_value(json_object_get(item, "ifc_id")));
+      free(out_stats[idx].id);
+   }
+   json_decref(root);
+
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   static char reply[64 * 1024];
+   static char buf[64 * 1024];
+   uint32_t iters = (argc > 1 ? (uint32_t) atoi(argv[1]) : 200000);
+   uint32_t ifces = (argc > 2 ? (uint32_t) atoi(argv[2]) : 2);
+   size_t len;
+   uint64_t start;
+   uint64_t streaming_ns;
+   uint64_t jansson_ns;
+   svc_json_stats_t stats = {
+         .in_stats = in_stats, .in_cap = BENCH_MAX_IFCES,
+         .out_stats = out_stats, .out_cap = BENCH_MAX_IFCES,
+   };
+
+   if (iters == 0 || ifces > BENCH_MAX_IFCES) {
+      fprintf(stderr, "Usage: %s [ITERATIONS [IFCES_PER_DIRECTION <= %d]]\n",
+              argv[0], BENCH_MAX_IFCES);
+      return 1;
+   }
+   len = build_reply(reply, sizeof(reply), ifces);
+
+   // Buffer is copied in both cases since streaming parser modifies it
+   start = now_ns();
+   for (uint32_t i = 0; i < iters; i++) {
+      memcpy(buf, reply, len + 1);
+      if (svc_json_parse(buf, len, &stats) != 0) {
+         fprintf(stderr, "svc_json_parse failed\n");
+         return 1;
+      }
+   }
+   streaming_ns = now_ns() - start;
+
+   start = now_ns();
+   for (uint32_t i = 0; i < iters; i++) {
+      memcpy(buf, reply, len + 1);
+      if (jansson_parse(buf, ifces) != 0) {
+         fprintf(stderr, "jansson parsing failed\n");
+         return 1;
+      }
+   }
+   jansson_ns = now_ns() - start;
+
+   printf("reply of %zu B with %u IN and %u OUT interfaces, %u iterations\n",
+          len, ifces, ifces, iters);
+   printf("svc_json_parse: %8.1f ns/reply\n", (double) streaming_ns / iters);
+   printf("jansson:        %8.1f ns/reply (%.1fx)\n", (double) jansson_ns / iters,
+          (double) jansson_ns / (double) streaming_ns);
+
+   return 0;
+}
@@ -6,7 +6,7 @@ msg() {
 
 SCHEMA='nemea-test-1'
 THIS_DIR="$(dirname $0)"
-TESTS=( test_conf test_inst_control test_module test_run_changes test_stats test_supervisor test_utils )
+TESTS=( test_autoplace test_cgroup test_conf test_evloop test_inst_control test_logpipe test_module test_placement test_proc_stats test_run_changes test_sockact test_spawn test_startup test_stats test_statsnap test_supervisor test_svc_json test_timerwheel test_utils )
 #TESTS=( test_inst_control test_module test_run_changes test_stats test_supervisor test_utils )
 
 
@@ -0,0 +1,165 @@
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <cmocka.h>
+
+#include "../src/autoplace.c"
+
+static inst_t * get_test_inst()
+{
+   inst_t *inst = inst_alloc();
+   if (inst == NULL) { fail_msg("Failed to allocate tests instance."); }
+   return inst;
+}
+
+static void add_test_ifc(inst_t *inst, interface_dir_t dir, interface_type_t type,
+                         const char *socket_name, uint16_t port)
+{
+   interface_t *ifc = interface_alloc();
+   if (ifc == NULL) { fail_msg("Failed to allocate tests interface."); }
+
+   ifc->direction = dir;
+   ifc->type = type;
+   if (interface_specific_params_alloc(ifc) != 0) { fail_msg("Failed to allocate params."); }
+   if (type == NS_IF_TYPE_UNIX) {
+      ifc->specific_params.nix->socket_name = strdup(socket_name);
+   } else if (type == NS_IF_TYPE_TCP) {
+      ifc->specific_params.tcp->port = port;
+   }
+   if (inst_interface_add(inst, ifc) != 0) { fail_msg("Failed to add tests interface."); }
+}
+
+static void write_sysfs_file(const char *root, const char *rel_path, const char *content)
+{
+   char path[PATH_MAX];
+   FILE *f;
+
+   // Create parent directories of the file
+   snprintf(path, sizeof(path), "%s/%s", root, rel_path);
+   for (char *p = path + strlen(root) + 1; *p != '\0'; p++) {
+      if (*p == '/') {
+         *p = '\0';
+         mkdir(path, 0700);
+         *p = '/';
+      }
+   }
+   f = fopen(path, "w");
+   if (f == NULL) { fail_msg("Failed to create %s", path); }
+   fprintf(f, "%s\n", content);
+   fclose(f);
+}
+
+void test_autoplace_chains(void **state)
+{
+   inst_t *insts[5];
+   uint32_t chain_of[5];
+
+   for (int i = 0; i < 5; i++) {
+      insts[i] = get_test_inst();
+   }
+   // collector -> detector -> reporter over UNIX sockets
+   add_test_ifc(insts[0], NS_IF_DIR_OUT, NS_IF_TYPE_UNIX, "flow_data", 0);
+   add_test_ifc(insts[1], NS_IF_DIR_IN, NS_IF_TYPE_UNIX, "flow_data", 0);
+   add_test_ifc(insts[1], NS_IF_DIR_OUT, NS_IF_TYPE_UNIX, "alerts", 0);
+   add_test_ifc(insts[4], NS_IF_DIR_IN, NS_IF_TYPE_UNIX, "alerts", 0);
+   // Unrelated pair over TCP
+   add_test_ifc(insts[2], NS_IF_DIR_OUT, NS_IF_TYPE_TCP, NULL, 9000);
+   add_test_ifc(insts[3], NS_IF_DIR_IN, NS_IF_TYPE_TCP, NULL, 9000);
+   // Same number as port of UNIX type doesn't connect anything
+   add_test_ifc(insts[3], NS_IF_DIR_IN, NS_IF_TYPE_UNIX, "other", 0);
+
+   assert_int_equal(autoplace_chains(insts, 5, chain_of), 2);
+   assert_int_equal(chain_of[0], chain_of[1]);
+   assert_int_equal(chain_of[0], chain_of[4]);
+   assert_int_equal(chain_of[2], chain_of[3]);
+   assert_int_not_equal(chain_of[0], chain_of[2]);
+
+   for (int i = 0; i < 5; i++) {
+      inst_free(insts[i]);
+   }
+}
+
+void test_autoplace_plan(void **state)
+{
+   autoplace_topology_t topo = { .cnt = 2 };
+   uint64_t chain_load[4] = { 100, 900, 400, 300 };
+   int32_t chain_domain[4];
+
+   topo.domains[0].cpus_cnt = 4;
+   topo.domains[1].cpus_cnt = 4;
+
+   // The heaviest chain goes first, the rest fills up the other domain
+   assert_int_equal(autoplace_plan(chain_load, 4, &topo, chain_domain), 0);
+   assert_int_equal(chain_domain[1], 0);
+   assert_int_equal(chain_domain[2], 1);
+   assert_int_equal(chain_domain[3], 1);
+   assert_int_equal(chain_domain[0], 1);
+   assert_int_equal(topo.domains[0].load, 900);
+   assert_int_equal(topo.domains[1].load, 800);
+   assert_int_equal(autoplace_imbalance(&topo), 11);
+
+   // Load is compared per CPU
+   topo.domains[1].cpus_cnt = 12;
+   assert_int_equal(autoplace_plan(chain_load, 4, &topo, chain_domain), 0);
+   assert_int_equal(chain_domain[1], 0);
+   assert_int_equal(chain_domain[2], 1);
+   assert_int_equal(chain_domain[3], 1);
+   assert_int_equal(chain_domain[0], 1);
+}
+
+void test_autoplace_topology_load(void **state)
+{
+   char root[] = "/tmp/test_autoplace_XXXXXX";
+   autoplace_topology_t topo;
+   char path[64];
+   char cpus[PLACEMENT_LIST_LEN];
+   unsigned long allowed[AUTOPLACE_CPU_WORDS];
+
+   if (mkdtemp(root) == NULL) { fail_msg("Failed to create fake sysfs."); }
+
+   // Two nodes with 4 CPUs, L3 of node 0 is split into two halves
+   write_sysfs_file(root, "devices/system/cpu/online", "0-7");
+   write_sysfs_file(root, "devices/system/node/online", "0-1");
+   write_sysfs_file(root, "devices/system/node/node0/cpulist", "0-3");
+   write_sysfs_file(root, "devices/system/node/node1/cpulist", "4-7");
+   for (int cpu = 0; cpu < 8; cpu++) {
+      snprintf(path, sizeof(path), "devices/system/cpu/cpu%d/cache/index0/level", cpu);
+      write_sysfs_file(root, path, "1");
+      snprintf(path, sizeof(path), "devices/system/cpu/cpu%d/cache/index1/level", cpu);
+      write_sysfs_file(root, path, "3");
+      snprintf(path, sizeof(path), "devices/system/cpu/cpu%d/cache/index1/shared_cpu_list", cpu);
+      write_sysfs_file(root, path, cpu < 2 ? "0-1" : (cpu < 4 ? "2-3" : "4-7"));
+   }
+
+   assert_int_equal(autoplace_topology_load(root, NULL, &topo), 0);
+   assert_int_equal(topo.cnt, 3);
+   assert_int_equal(topo.domains[0].node, 0);
+   assert_int_equal(topo.domains[0].cpus_cnt, 2);
+   assert_int_equal(topo.domains[1].node, 0);
+   assert_int_equal(topo.domains[2].node, 1);
+   assert_int_equal(topo.domains[2].cpus_cnt, 4);
+   placement_format_list(topo.domains[1].cpus, PLACEMENT_MAX_CPUS, cpus, sizeof(cpus));
+   assert_string_equal(cpus, "2-3");
+
+   // CPUs supervisor isn't allowed to use are left out
+   assert_int_equal(placement_parse_list("1-2,6", allowed, PLACEMENT_MAX_CPUS), 0);
+   assert_int_equal(autoplace_topology_load(root, allowed, &topo), 0);
+   assert_int_equal(topo.cnt, 3);
+   placement_format_list(topo.domains[2].cpus, PLACEMENT_MAX_CPUS, cpus, sizeof(cpus));
+   assert_string_equal(cpus, "6");
+
+   snprintf(path, sizeof(path), "rm -rf %s", root);
+   assert_int_equal(system(path), 0);
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_autoplace_chains),
+         cmocka_unit_test(test_autoplace_plan),
+         cmocka_unit_test(test_autoplace_topology_load),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,50 @@
+#include <string.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+
+#include "../src/cgroup.c"
+
+void test_cgroup_parse_cpu_stat(void **state)
+{
+   cgroup_stats_t stats;
+   const char *cpu_stat = "usage_usec 1523467\nuser_usec 1023456\nsystem_usec 500011\n"
+                          "nr_periods 0\nnr_throttled 0\nthrottled_usec 0\n";
+
+   assert_int_equal(cgroup_parse_cpu_stat(cpu_stat, strlen(cpu_stat), &stats), 0);
+   assert_int_equal(stats.user_usec, 1023456);
+   assert_int_equal(stats.system_usec, 500011);
+
+   // Key has to match whole name at the beginning of line
+   assert_int_equal(cgroup_parse_cpu_stat("xuser_usec 1\nsystem_usec 2\n", 27, &stats), -1);
+   assert_int_equal(cgroup_parse_cpu_stat("user_usec 1\n", 12, &stats), -1);
+}
+
+void test_cgroup_parse_io_stat(void **state)
+{
+   cgroup_stats_t stats;
+   const char *io_stat = "8:0 rbytes=4096 wbytes=1024 rios=1 wios=1 dbytes=0 dios=0\n"
+                         "259:0 rbytes=100 wbytes=200 rios=2 wios=3 dbytes=0 dios=0\n";
+
+   assert_int_equal(cgroup_parse_io_stat(io_stat, strlen(io_stat), &stats), 0);
+   assert_int_equal(stats.io_rbytes, 4196);
+   assert_int_equal(stats.io_wbytes, 1224);
+
+   // Leaf which hasn't done any IO yet has empty io.stat
+   assert_int_equal(cgroup_parse_io_stat("", 0, &stats), 0);
+   assert_int_equal(stats.io_rbytes, 0);
+   assert_int_equal(stats.io_wbytes, 0);
+
+   assert_int_equal(cgroup_parse_io_stat("8:0 rbytes=x\n", 13, &stats), -1);
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_cgroup_parse_cpu_stat),
+         cmocka_unit_test(test_cgroup_parse_io_stat),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -185,26 +185,15 @@ void test_interface_is_loaded(const interface_t *ifc)
 void test_inst_is_loaded(const inst_t *inst)
 {
    assert_string_equal(inst->name, "intable_module");
-   assert_int_equal(inst->enabled, true);
+   assert_int_equal(INST_ENABLED(inst), true);
    assert_int_equal(inst->max_restarts_minute, 4);
 }
 
 void cleanup_structs_and_vectors()
 {
-   inst_t *inst = NULL;
-   for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
-      inst_free(inst);
-   }
-   vector_free(&insts_v);
-
-
-   av_module_t *avmod = NULL;
-   for (uint32_t i = 0; i < avmods_v.total; i++) {
-      avmod = avmods_v.items[i];
-      av_module_free(avmod);
-   }
-   vector_free(&avmods_v);
+   // Frees indexes of instances and modules by name too
+   insts_free();
+   av_modules_free();
 }
 
 ///////////////////////////TESTS
@@ -345,8 +334,8 @@ void test_inst_pid_restore(void **state)
 
    { // Test that nothing changes when provided hopefully non existing PID
       inst_pid_restore(1999999, inst, sr_conn_link.sess);
-      assert_int_equal(inst->pid, 0);
-      assert_int_equal(inst->running, false);
+      assert_int_equal(INST_PID(inst), 0);
+      assert_int_equal(INST_RUNNING(inst), false);
    }
 
    { // Start intable_module, insert it to sysrepo and verify it's there
@@ -360,8 +349,8 @@ void test_inst_pid_restore(void **state)
 
    { // Restore PID and see that pid & running was set
       inst_pid_restore(intable_pid, inst, sr_conn_link.sess);
-      assert_int_equal(inst->pid, intable_pid);
-      assert_int_equal(inst->running, true);
+      assert_int_equal(INST_PID(inst), intable_pid);
+      assert_int_equal(INST_RUNNING(inst), true);
       // Verify PID was removed from sysrepo
       rc = get_intable_pid_from_sr(&fetched_pid);
       assert_int_equal(0, fetched_pid);
@@ -436,10 +425,7 @@ void test_av_module_load(void **state)
    assert_int_equal(amod1->sr_rdy, false);
 
    sr_free_tree(node);
-   av_module_free(avmods_v.items[0]);
-   av_module_free(avmods_v.items[1]);
-   vector_delete(&avmods_v, 0);
-   vector_delete(&avmods_v, 0);
+   av_modules_free();
 
    disconnect_sr();
 }
@@ -457,7 +443,7 @@ void test_inst_load(void **state)
    IF_NO_MEM_FAIL(avmod)
    avmod->name = strdup("module A");
    IF_NO_MEM_FAIL(avmod->name)
-   rc = vector_add(&avmods_v, avmod);
+   rc = av_modules_add(avmod);
    assert_int_equal(rc, 0);
 
    assert_int_equal(insts_v.total, 0);
@@ -468,10 +454,16 @@ void test_inst_load(void **state)
    mod = insts_v.items[0];
    assert_string_equal(mod->name, "intable_module");
    assert_ptr_equal(mod->mod_ref, avmod);
+   assert_int_equal(mod->resources_period_ms, 0);
+   assert_int_equal(mod->service_ifc_period_ms, 1000);
 
    assert_int_equal(insts_v.total, 1);
-   vector_delete(&insts_v, 0);
+   assert_true(inst_get_by_name("intable_module", NULL) == mod);
+   assert_int_equal(avmod->insts.total, 1);
+   insts_delete(mod);
    assert_int_equal(insts_v.total, 0);
+   assert_null(inst_get_by_name("intable_module", NULL));
+   assert_int_equal(avmod->insts.total, 0);
    inst_free(mod);
 
    cleanup_structs_and_vectors();
@@ -490,7 +482,7 @@ void test_inst_load_by_name(void **state)
    IF_NO_MEM_FAIL(avmod)
    avmod->name = strdup("module A");
    IF_NO_MEM_FAIL(avmod->name)
-   assert_int_equal(vector_add(&avmods_v, avmod), 0);
+   assert_int_equal(av_modules_add(avmod), 0);
 
    {
       assert_int_equal(insts_v.total, 0);
@@ -551,6 +543,14 @@ void test_ns_startup_config_load(void **state)
    assert_int_equal(avmods_v.total, 2);
    assert_int_equal(insts_v.total, 1);
 
+   // Global intervals with instance overrides
+   assert_int_equal(intervals.liveness_ms, DEFAULT_LIVENESS_PERIOD_MS);
+   assert_int_equal(intervals.resources_ms, 5000);
+   assert_int_equal(intervals.service_ifc_ms, DEFAULT_SERVICE_IFC_PERIOD_MS);
+   assert_true(intervals.changed);
+   assert_int_equal(inst_resources_period(insts_v.items[0]), 5000);
+   assert_int_equal(inst_service_ifc_period(insts_v.items[0]), 1000);
+
    cleanup_structs_and_vectors();
 }
 
@@ -0,0 +1,209 @@
+#include "../src/evloop.c"
+
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <cmocka.h>
+
+/**
+ * @brief Pipe watched by test loop, handler counts its calls and may remove sources
+ * */
+typedef struct test_src_s {
+   int fds[2]; ///< Read and write end of pipe
+   ev_source_t *src; ///< Source of read end
+   ev_source_t *to_del; ///< Source the handler removes, might be src itself
+   uint32_t calls; ///< Number of handler calls
+} test_src_t;
+
+static void test_pipe_handler(uint32_t events, void *priv)
+{
+   test_src_t *ts = priv;
+   char c;
+
+   (void) read(ts->fds[0], &c, 1);
+   ts->calls++;
+   if (ts->to_del != NULL) {
+      evloop_del(&main_evloop, ts->to_del);
+      ts->to_del = NULL;
+   }
+}
+
+static void test_src_open(test_src_t *ts)
+{
+   memset(ts, 0, sizeof(*ts));
+   if (pipe(ts->fds) == -1) { fail_msg("Failed to create pipe."); }
+   ts->src = evloop_add(&main_evloop, ts->fds[0], EPOLLIN, test_pipe_handler, ts);
+   if (ts->src == NULL) { fail_msg("Failed to add pipe to loop."); }
+   if (write(ts->fds[1], "x", 1) != 1) { fail_msg("Failed to write to pipe."); }
+}
+
+static void test_src_close(test_src_t *ts)
+{
+   close(ts->fds[0]);
+   close(ts->fds[1]);
+}
+
+void test_evloop_del_in_handler(void **state)
+{
+   test_src_t a;
+   test_src_t b;
+
+   assert_int_equal(evloop_init(&main_evloop, NULL), 0);
+
+   // Both are ready, handler of whichever runs first removes the other one and itself
+   test_src_open(&a);
+   test_src_open(&b);
+   a.to_del = b.src;
+   b.to_del = a.src;
+   assert_int_equal(evloop_run_once(&main_evloop, 0), 2);
+   assert_int_equal(a.calls + b.calls, 1);
+   assert_int_equal(main_evloop.garbage.total, 0);
+
+   // Removed source isn't dispatched anymore even with data pending, the other one is
+   if (write(a.fds[1], "x", 1) != 1 || write(b.fds[1], "x", 1) != 1) {
+      fail_msg("Failed to write to pipe.");
+   }
+   assert_int_equal(evloop_run_once(&main_evloop, 0), 1);
+   assert_int_equal(a.calls + b.calls, 2);
+   assert_true(a.calls == 2 || b.calls == 2);
+   evloop_del(&main_evloop, a.calls == 2 ? a.src : b.src);
+   test_src_close(&a);
+   test_src_close(&b);
+
+   // Source removing itself is freed only after the dispatch
+   test_src_open(&a);
+   a.to_del = a.src;
+   assert_int_equal(evloop_run_once(&main_evloop, 0), 1);
+   assert_int_equal(a.calls, 1);
+   assert_int_equal(main_evloop.garbage.total, 0);
+   test_src_close(&a);
+
+   evloop_free(&main_evloop);
+}
+
+static void * test_waker(void *arg)
+{
+   usleep(50000);
+   evloop_wakeup(arg);
+   return NULL;
+}
+
+void test_evloop_wakeup(void **state)
+{
+   pthread_t thread;
+
+   assert_int_equal(evloop_init(&main_evloop, NULL), 0);
+
+   // Blocking wait returns once other thread wakes the loop up
+   assert_false(main_evloop.woken_up);
+   assert_int_equal(pthread_create(&thread, NULL, test_waker, &main_evloop), 0);
+   assert_int_equal(evloop_run_once(&main_evloop, -1), 1);
+   assert_true(main_evloop.woken_up);
+   assert_int_equal(pthread_join(thread, NULL), 0);
+
+   // Eventfd was drained, the loop doesn't wake up again by itself
+   main_evloop.woken_up = false;
+   assert_int_equal(evloop_run_once(&main_evloop, 0), 0);
+   assert_false(main_evloop.woken_up);
+
+   // Several wakeups before the wait are delivered as one
+   evloop_wakeup(&main_evloop);
+   evloop_wakeup(&main_evloop);
+   assert_int_equal(evloop_run_once(&main_evloop, 0), 1);
+   assert_true(main_evloop.woken_up);
+
+   evloop_free(&main_evloop);
+}
+
+static void test_count_handler(uint32_t events, void *priv)
+{
+   (*(uint32_t *) priv)++;
+}
+
+void test_evloop_timeout_and_timer(void **state)
+{
+   uint32_t expired = 0;
+   ev_source_t *timer;
+   uint64_t start;
+
+   assert_int_equal(evloop_init(&main_evloop, NULL), 0);
+
+   // Nothing is ready, the wait ends by its timeout
+   start = get_mono_time_ms();
+   assert_int_equal(evloop_run_once(&main_evloop, 30), 0);
+   assert_true(get_mono_time_ms() - start >= 29);
+
+   // Periodic timer is dispatched once per wait, expirations are read by the loop
+   timer = evloop_add_timer(&main_evloop, 10, test_count_handler, &expired);
+   assert_non_null(timer);
+   assert_int_equal(evloop_run_once(&main_evloop, 1000), 1);
+   assert_int_equal(expired, 1);
+   assert_int_equal(evloop_run_once(&main_evloop, 1000), 1);
+   assert_int_equal(expired, 2);
+
+   // Timer owns its fd, which is closed by removal
+   evloop_del(&main_evloop, timer);
+   assert_int_equal(evloop_run_once(&main_evloop, 30), 0);
+   assert_int_equal(expired, 2);
+
+   evloop_free(&main_evloop);
+}
+
+/**
+ * @brief Signal has to be read from signalfd, it would be delivered once unblocked otherwise
+ * */
+static int test_sig_fd = -1;
+
+static void test_signal_handler(uint32_t events, void *priv)
+{
+   struct signalfd_siginfo si;
+
+   if (read(test_sig_fd, &si, sizeof(si)) == sizeof(si) && si.ssi_signo == SIGUSR1) {
+      (*(uint32_t *) priv)++;
+   }
+}
+
+void test_evloop_signalfd(void **state)
+{
+   uint32_t received = 0;
+   ev_source_t *src;
+   sigset_t mask;
+   sigset_t old_mask;
+   int fd;
+
+   assert_int_equal(evloop_init(&main_evloop, NULL), 0);
+
+   sigemptyset(&mask);
+   sigaddset(&mask, SIGUSR1);
+   assert_int_equal(pthread_sigmask(SIG_BLOCK, &mask, &old_mask), 0);
+   fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+   assert_int_not_equal(fd, -1);
+   test_sig_fd = fd;
+   src = evloop_add(&main_evloop, fd, EPOLLIN, test_signal_handler, &received);
+   assert_non_null(src);
+   src->owns_fd = true;
+
+   // Blocked signal is delivered through signalfd as a regular event
+   assert_int_equal(raise(SIGUSR1), 0);
+   assert_int_equal(evloop_run_once(&main_evloop, 1000), 1);
+   assert_int_equal(received, 1);
+   assert_int_equal(evloop_run_once(&main_evloop, 0), 0);
+
+   evloop_del(&main_evloop, src);
+   evloop_free(&main_evloop);
+   assert_int_equal(pthread_sigmask(SIG_SETMASK, &old_mask, NULL), 0);
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_evloop_del_in_handler),
+         cmocka_unit_test(test_evloop_wakeup),
+         cmocka_unit_test(test_evloop_timeout_and_timer),
+         cmocka_unit_test(test_evloop_signalfd),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
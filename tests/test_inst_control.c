@@ -73,14 +73,14 @@ static int load_config()
 
 void start_intable_module(inst_t *inst, char *faked_name)
 {
-   inst->pid = fork();
-   if (inst->pid == -1) {
+   INST_PID(inst) = fork();
+   if (INST_PID(inst) == -1) {
       fail_msg("Fork: could not fork supervisor process");
    }
 
-   if (inst->pid != 0) {
+   if (INST_PID(inst) != 0) {
       inst->is_my_child = true;
-      inst->running = true;
+      INST_RUNNING(inst) = true;
    } else {
       setsid();
       char *exec_args[2] = {faked_name, NULL};
@@ -123,11 +123,128 @@ void test_av_module_stop_remove_by_name(void **state)
    disconnect_and_unload_config();
 }
 
+void test_insts_reap_children(void **state)
+{
+   system("helpers/import_conf.sh -s nemea-test-1-startup-5.data.json");
+   assert_int_equal(load_config(), 0);
+
+   inst_t *intable_module = insts_v.items[2];
+   start_intable_module(intable_module, "intable_module");
+   assert_false(intable_module->last_exit.valid);
+
+   // Nothing exited yet, running instance must not be touched
+   insts_reap_children();
+   assert_true(INST_RUNNING(intable_module));
+   assert_true(INST_PID(intable_module) > 0);
+
+   kill(INST_PID(intable_module), SIGKILL);
+   usleep(100000);
+   insts_reap_children();
+
+   assert_false(INST_RUNNING(intable_module));
+   assert_int_equal(INST_PID(intable_module), 0);
+   assert_true(intable_module->last_exit.valid);
+   assert_int_equal(intable_module->last_exit.code, -1);
+   assert_int_equal(intable_module->last_exit.signal, SIGKILL);
+   assert_true(intable_module->last_exit.time > 0);
+   // Test machine isn't out of memory, SIGKILL came from the test itself
+   assert_int_equal(intable_module->last_exit.reason, INST_EXIT_SIGNAL);
+   // Enabled instance gets restarted after initial backoff
+   assert_int_equal(intable_module->backoff_ms,
+                    intable_module->restart_policy.initial_backoff_ms);
+   assert_true(tw_armed(&intable_module->backoff_timer));
+
+   disconnect_and_unload_config();
+}
+
+void test_inst_restart_plan(void **state)
+{
+   inst_t *inst = inst_alloc();
+   IF_NO_MEM_FAIL(inst)
+   inst->name = strdup("backoff_inst");
+   IF_NO_MEM_FAIL(inst->name)
+   INST_ENABLED(inst) = true;
+   inst->restart_policy.initial_backoff_ms = 100;
+   inst->restart_policy.max_backoff_ms = 300;
+   inst->restart_policy.jitter_perc = 0;
+   inst->restart_policy.stable_uptime_ms = 1000;
+   inst->start_ms = 5000;
+
+   // Delay doubles with every failure up to max_backoff_ms
+   inst->last_exit.reason = INST_EXIT_CODE;
+   inst_restart_plan(inst, 5010);
+   assert_int_equal(inst->backoff_ms, 100);
+   assert_true(tw_armed(&inst->backoff_timer));
+   tw_cancel(&main_wheel, &inst->backoff_timer);
+   inst_restart_plan(inst, 5010);
+   assert_int_equal(inst->backoff_ms, 200);
+   tw_cancel(&main_wheel, &inst->backoff_timer);
+   inst_restart_plan(inst, 5010);
+   assert_int_equal(inst->backoff_ms, 300);
+   tw_cancel(&main_wheel, &inst->backoff_timer);
+
+   // Stable run resets the delay
+   inst_restart_plan(inst, 6000);
+   assert_int_equal(inst->backoff_ms, 100);
+   tw_cancel(&main_wheel, &inst->backoff_timer);
+
+   // OOM kill is restarted right away without changing the delay
+   inst->last_exit.reason = INST_EXIT_OOM_KILL;
+   inst_restart_plan(inst, 5010);
+   assert_int_equal(inst->backoff_ms, 100);
+   assert_false(tw_armed(&inst->backoff_timer));
+
+   // Binary that can't be executed isn't restarted
+   inst->last_exit.reason = INST_EXIT_EXEC_FAILED;
+   inst_restart_plan(inst, 5010);
+   assert_false(INST_ENABLED(inst));
+   assert_false(tw_armed(&inst->backoff_timer));
+
+   // Jitter stays within bounds
+   for (int i = 0; i < 1000; i++) {
+      uint32_t delay = inst_backoff_jitter(1000, 20);
+      assert_true(delay >= 800 && delay <= 1200);
+   }
+
+   inst_free(inst);
+}
+
+void test_inst_stop_remove_by_name(void **state)
+{
+   system("helpers/import_conf.sh -s nemea-test-1-startup-5.data.json");
+   assert_int_equal(load_config(), 0);
+   assert_int_equal(insts_v.total, 4);
+
+   inst_t *intable_module = insts_v.items[2];
+   start_intable_module(intable_module, "intable_module");
+   char *name = strdup(intable_module->name);
+   IF_NO_MEM_FAIL(name)
+
+   // Must not wait for the instance to exit
+   inst_stop_remove_by_name(name);
+   assert_int_equal(insts_v.total, 3);
+   assert_int_equal(dying_insts_v.total, 1);
+   assert_int_equal(intable_module->stop_state, INST_STOP_SIGINT_SENT);
+   assert_true(tw_armed(&intable_module->stop_timer));
+
+   // intable_module exits on SIGINT, it gets released once reaped
+   usleep(100000);
+   insts_stop_sigkill();
+   assert_int_equal(dying_insts_v.total, 0);
+   assert_int_equal(main_wheel.armed_cnt, 0);
+
+   free(name);
+   disconnect_and_unload_config();
+}
+
 int main(void)
 {
    //verbosity_level = V3;
    const struct CMUnitTest tests[] = {
          cmocka_unit_test(test_av_module_stop_remove_by_name),
+         cmocka_unit_test(test_insts_reap_children),
+         cmocka_unit_test(test_inst_restart_plan),
+         cmocka_unit_test(test_inst_stop_remove_by_name),
    };
 
    return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,186 @@
+#include "../src/logpipe.c"
+
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+
+#define TEST_LOGPIPE_FILE "/tmp/test_logpipe_out"
+
+static uint64_t test_file_size(const char *path)
+{
+   struct stat st;
+
+   if (stat(path, &st) == -1) {
+      return 0;
+   }
+   return (uint64_t) st.st_size;
+}
+
+static void test_write(int fd, size_t len)
+{
+   char buf[256];
+
+   memset(buf, 'x', sizeof(buf));
+   if (write(fd, buf, len) != (ssize_t) len) { fail_msg("Failed to write to log pipe."); }
+}
+
+static void test_files_remove()
+{
+   unlink(TEST_LOGPIPE_FILE);
+   unlink(TEST_LOGPIPE_FILE".1");
+   unlink(TEST_LOGPIPE_FILE".2");
+   unlink(TEST_LOGPIPE_FILE".3");
+}
+
+void test_logpipe_rotation(void **state)
+{
+   log_conf_t conf;
+   log_stream_t ls;
+   uint64_t now;
+   int fd;
+
+   test_files_remove();
+   assert_int_equal(evloop_init(&main_evloop, NULL), 0);
+   log_conf_init(&conf);
+   conf.max_size = 16;
+   conf.keep = 2;
+   logpipe_init(&ls, &conf);
+
+   fd = logpipe_open(&ls, TEST_LOGPIPE_FILE, 0600);
+   assert_int_not_equal(fd, -1);
+   now = ls.opened_ms;
+
+   test_write(fd, 10);
+   logpipe_drain(&ls, now);
+   assert_int_equal(ls.bytes_written, 10);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE), 10);
+
+   // Size limit would be exceeded, data go to new file
+   test_write(fd, 10);
+   logpipe_drain(&ls, now);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE), 10);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE".1"), 10);
+   test_write(fd, 12);
+   logpipe_drain(&ls, now);
+   test_write(fd, 14);
+   logpipe_drain(&ls, now);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE), 14);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE".1"), 12);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE".2"), 10);
+   assert_int_equal(access(TEST_LOGPIPE_FILE".3", F_OK), -1);
+
+   // Age limit
+   conf.max_size = 0;
+   conf.rotate_interval_s = 1;
+   test_write(fd, 1);
+   logpipe_drain(&ls, now + 999);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE), 15);
+   test_write(fd, 1);
+   logpipe_drain(&ls, now + 1000);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE), 1);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE".1"), 15);
+   assert_int_equal(ls.bytes_written, 48);
+   assert_int_equal(ls.bytes_dropped, 0);
+
+   // Once the process exits, rest of its output is drained and pipe is closed
+   conf.rotate_interval_s = 0;
+   test_write(fd, 5);
+   close(fd);
+   assert_int_equal(evloop_run_once(&main_evloop, 0), 1);
+   assert_int_equal(ls.pipe_fd, -1);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE), 6);
+
+   logpipe_close(&ls);
+   evloop_free(&main_evloop);
+   test_files_remove();
+}
+
+void test_logpipe_rate_limit(void **state)
+{
+   log_conf_t conf;
+   log_stream_t ls;
+   int fd;
+
+   test_files_remove();
+   log_conf_init(&conf);
+   conf.rate_limit = 100;
+   logpipe_init(&ls, &conf);
+
+   // Without loop the pipe can't be drained, process writes to the file itself
+   assert_int_equal(logpipe_open(&ls, TEST_LOGPIPE_FILE, 0600), -1);
+   assert_int_equal(evloop_init(&main_evloop, NULL), 0);
+   fd = logpipe_open(&ls, TEST_LOGPIPE_FILE, 0600);
+   assert_int_not_equal(fd, -1);
+
+   // Full bucket at start, over the limit data don't stay in the pipe
+   test_write(fd, 150);
+   logpipe_drain(&ls, 1000);
+   assert_int_equal(ls.bytes_written, 100);
+   assert_int_equal(ls.bytes_dropped, 50);
+   assert_int_equal(ls.tokens, 0);
+
+   // Half a second refills half of the bucket
+   test_write(fd, 100);
+   logpipe_drain(&ls, 1500);
+   assert_int_equal(ls.bytes_written, 150);
+   assert_int_equal(ls.bytes_dropped, 100);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE), 150);
+
+   // New process continues in the same file
+   close(fd);
+   fd = logpipe_open(&ls, TEST_LOGPIPE_FILE, 0600);
+   assert_int_not_equal(fd, -1);
+   test_write(fd, 20);
+   close(fd);
+   logpipe_close(&ls);
+   assert_int_equal(ls.bytes_written, 170);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE), 170);
+
+   evloop_free(&main_evloop);
+   test_files_remove();
+}
+
+void test_logpipe_rate_limit_frequent_drains(void **state)
+{
+   log_conf_t conf;
+   log_stream_t ls;
+   int fd;
+
+   test_files_remove();
+   assert_int_equal(evloop_init(&main_evloop, NULL), 0);
+   log_conf_init(&conf);
+   conf.rate_limit = 100;
+   logpipe_init(&ls, &conf);
+   fd = logpipe_open(&ls, TEST_LOGPIPE_FILE, 0600);
+   assert_int_not_equal(fd, -1);
+
+   test_write(fd, 150);
+   logpipe_drain(&ls, 1000);
+   assert_int_equal(ls.bytes_written, 100);
+
+   // Drains every 1 ms are shorter than a token takes, the bucket still refills
+   for (uint64_t now = 1001; now <= 3000; now++) {
+      test_write(fd, 1);
+      logpipe_drain(&ls, now);
+   }
+   assert_int_equal(ls.bytes_written, 300);
+   assert_int_equal(ls.bytes_dropped, 50 + 1800);
+   assert_int_equal(test_file_size(TEST_LOGPIPE_FILE), 300);
+
+   close(fd);
+   logpipe_close(&ls);
+   evloop_free(&main_evloop);
+   test_files_remove();
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_logpipe_rotation),
+         cmocka_unit_test(test_logpipe_rate_limit),
+         cmocka_unit_test(test_logpipe_rate_limit_frequent_drains),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
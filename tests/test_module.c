@@ -115,11 +115,6 @@ static void test_module_load_exec_args(void **state)
       assert_string_equal(inst->exec_args[5], "-i");
       assert_string_equal(inst->exec_args[6], "t:192.168.0.1:1");
       assert_null(inst->exec_args[7]);
-
-      for (int i = 0; inst->exec_args[i] != NULL; i++) {
-         free(inst->exec_args[i]);
-      }
-      free(inst->exec_args);
    }
 
    ifc = get_test_ifc(NS_IF_DIR_IN, NS_IF_TYPE_UNIX, 2);
@@ -135,11 +130,6 @@ static void test_module_load_exec_args(void **state)
       assert_string_equal(inst->exec_args[5], "-i");
       assert_string_equal(inst->exec_args[6], "u:sock_2,t:192.168.0.1:1");
       assert_null(inst->exec_args[7]);
-
-      for (int i = 0; inst->exec_args[i] != NULL; i++) {
-         free(inst->exec_args[i]);
-      }
-      free(inst->exec_args);
    }
 
    { // test with trap_ifces_cli == false (eg. IPFIXCOL)
@@ -152,11 +142,6 @@ static void test_module_load_exec_args(void **state)
       assert_string_equal(inst->exec_args[2], "-p2");
       assert_string_equal(inst->exec_args[3], "--p3");
       assert_string_equal(inst->exec_args[4], "p4");
-
-      for (int i = 0; inst->exec_args[i] != NULL; i++) {
-         free(inst->exec_args[i]);
-      }
-      free(inst->exec_args);
    }
 
    { // test only interfaces param
@@ -169,11 +154,6 @@ static void test_module_load_exec_args(void **state)
       assert_string_equal(inst->exec_args[1], "-i");
       assert_string_equal(inst->exec_args[2], "u:sock_2,t:192.168.0.1:1");
       assert_null(inst->exec_args[3]);
-
-      for (int i = 0; inst->exec_args[i] != NULL; i++) {
-         free(inst->exec_args[i]);
-      }
-      free(inst->exec_args);
    }
 
    { // test sysrepo params
@@ -198,9 +178,9 @@ static void test_module_load_exec_args(void **state)
 
 static void test_module_params_no_ifc_arr(void **state)
 {
-   int rc;
    uint32_t params_num;
-   char **parsed_params;
+   strbuf_t sb = { 0 };
+   const char *param;
    inst_t *i1 = inst_alloc();
    if (i1 == NULL) { fail_msg("Failed to allocate new module."); }
    i1->name = strdup("tests-module");
@@ -209,40 +189,57 @@ static void test_module_params_no_ifc_arr(void **state)
    IF_NO_MEM_FAIL(i1->params)
 
    {
-      parsed_params = inst_params_to_arr(i1, &params_num, &rc);
-      assert_int_equal(rc, 0);
+      assert_int_equal(inst_params_to_arr(i1, &sb, &params_num), 0);
       assert_int_equal(params_num, 1);
-      assert_string_equal(parsed_params[0], i1->params);
-      assert_null(parsed_params[params_num]);
+      assert_string_equal(sb.data, i1->params);
+      assert_int_equal(sb.len, strlen(i1->params) + 1);
 
       // cleanup
-      NULLP_TEST_AND_FREE(parsed_params[0])
-      NULLP_TEST_AND_FREE(parsed_params)
+      sb.len = 0;
       NULLP_TEST_AND_FREE(i1->params)
    }
 
    {
+      const char *expected[] = { "-v", "v", "xxv", "tt", "rr", "-vv", "--yyy" };
       i1->params = strdup("-v v xxv tt rr -vv --yyy");
       IF_NO_MEM_FAIL(i1->params)
-      parsed_params = inst_params_to_arr(i1, &params_num, &rc);
-      assert_int_equal(rc, 0);
+      assert_int_equal(inst_params_to_arr(i1, &sb, &params_num), 0);
       assert_int_equal(params_num, 7);
-      assert_string_equal(parsed_params[0], "-v");
-      assert_string_equal(parsed_params[1], "v");
-      assert_string_equal(parsed_params[2], "xxv");
-      assert_string_equal(parsed_params[3], "tt");
-      assert_string_equal(parsed_params[4], "rr");
-      assert_string_equal(parsed_params[5], "-vv");
-      assert_string_equal(parsed_params[6], "--yyy");
-      assert_null(parsed_params[params_num]);
+      param = sb.data;
+      for (int i = 0; i < 7; i++) {
+         assert_string_equal(param, expected[i]);
+         param += strlen(param) + 1;
+      }
+      assert_int_equal(param - sb.data, sb.len);
 
       // cleanup
-      for (int i = 0; i < 7; i++) {
-         NULLP_TEST_AND_FREE(parsed_params[i])
+      sb.len = 0;
+      NULLP_TEST_AND_FREE(i1->params)
+   }
+
+   {
+      const char *expected[] = { "a b", "-c", "d e" };
+      i1->params = strdup("'a b' -c \"d e\"");
+      IF_NO_MEM_FAIL(i1->params)
+      assert_int_equal(inst_params_to_arr(i1, &sb, &params_num), 0);
+      assert_int_equal(params_num, 3);
+      param = sb.data;
+      for (int i = 0; i < 3; i++) {
+         assert_string_equal(param, expected[i]);
+         param += strlen(param) + 1;
       }
-      NULLP_TEST_AND_FREE(parsed_params)
+
+      // Failed parsing leaves buffer as it was
+      NULLP_TEST_AND_FREE(i1->params)
+      i1->params = strdup("-a 'unterminated");
+      IF_NO_MEM_FAIL(i1->params)
+      uint32_t len = sb.len;
+      assert_int_equal(inst_params_to_arr(i1, &sb, &params_num), -1);
+      assert_int_equal(params_num, 0);
+      assert_int_equal(sb.len, len);
    }
 
+   strbuf_free(&sb);
    inst_free(i1);
 }
 
@@ -250,38 +247,34 @@ static void test_module_get_ifcs_as_arg(void **state)
 {
    inst_t *mod;
    interface_t *ifc;
-   char *params;
+   strbuf_t sb = { 0 };
 
    mod = inst_alloc();
    IF_NO_MEM_FAIL_MSG(mod, "mod");
 
    ifc = get_test_ifc(NS_IF_DIR_IN, NS_IF_TYPE_TCP, 1);
    inst_interface_add(mod, ifc);
-   params = inst_get_ifcs_as_arg(mod);
-   assert_non_null(params);
-   assert_string_equal(params, "t:1");
-   free(params);
+   assert_int_equal(inst_ifcs_to_arg(mod, &sb), 0);
+   assert_string_equal(sb.data, "t:1");
+   sb.len = 0;
 
    ifc = get_test_ifc(NS_IF_DIR_OUT, NS_IF_TYPE_UNIX, 2);
    inst_interface_add(mod, ifc);
-   params = inst_get_ifcs_as_arg(mod);
-   assert_non_null(params);
-   assert_string_equal(params, "t:1,u:sock_2:123");
-   free(params);
+   assert_int_equal(inst_ifcs_to_arg(mod, &sb), 0);
+   assert_string_equal(sb.data, "t:1,u:sock_2:123");
+   sb.len = 0;
 
    ifc = get_test_ifc(NS_IF_DIR_IN, NS_IF_TYPE_UNIX, 3);
    inst_interface_add(mod, ifc);
-   params = inst_get_ifcs_as_arg(mod);
-   assert_non_null(params);
-   assert_string_equal(params, "t:1,u:sock_3,u:sock_2:123");
-   free(params);
+   assert_int_equal(inst_ifcs_to_arg(mod, &sb), 0);
+   assert_string_equal(sb.data, "t:1,u:sock_3,u:sock_2:123");
+   sb.len = 0;
 
    ifc = get_test_ifc(NS_IF_DIR_OUT, NS_IF_TYPE_TCP, 4);
    inst_interface_add(mod, ifc);
-   params = inst_get_ifcs_as_arg(mod);
-   assert_non_null(params);
-   assert_string_equal(params, "t:1,u:sock_3,u:sock_2:123,t:192.168.0.1:4");
-   free(params);
+   assert_int_equal(inst_ifcs_to_arg(mod, &sb), 0);
+   assert_string_equal(sb.data, "t:1,u:sock_3,u:sock_2:123,t:192.168.0.1:4");
+   sb.len = 0;
 
    ifc->autoflush = strdup("off");
    IF_NO_MEM_FAIL_MSG(ifc->autoflush, "ifc->autoflush")
@@ -289,13 +282,13 @@ static void test_module_get_ifcs_as_arg(void **state)
    IF_NO_MEM_FAIL_MSG(ifc->buffer, "ifc->buffer")
    ifc->timeout = strdup("HALF_WAIT");
    IF_NO_MEM_FAIL_MSG(ifc->timeout, "ifc->timeout")
-   params = inst_get_ifcs_as_arg(mod);
-   assert_non_null(params);
-   assert_string_equal(params,
+   assert_int_equal(inst_ifcs_to_arg(mod, &sb), 0);
+   assert_string_equal(sb.data,
                        "t:1,u:sock_3,u:sock_2:123,""t:192.168.0.1:4:"
                              "buffer=on:autoflush=off:timeout=HALF_WAIT");
-   free(params);
+   sb.len = 0;
 
+   strbuf_free(&sb);
    inst_free(mod);
 }
 
@@ -303,7 +296,7 @@ static void test_tcp_ifc_to_cli_arg(void **state)
 {
    inst_t *mod;
    interface_t *ifc;
-   char * params;
+   strbuf_t sb = { 0 };
 
    alloc_module_and_ifc(&mod, &ifc);
    ifc->type = NS_IF_TYPE_TCP;
@@ -311,24 +304,22 @@ static void test_tcp_ifc_to_cli_arg(void **state)
 
    // Required params
    ifc->specific_params.tcp->port = 1111;
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "t:1111");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "t:1111");
+   sb.len = 0;
 
    ifc->specific_params.tcp->host = strdup("192.168.0.1");
    IF_NO_MEM_FAIL_MSG(ifc->specific_params.tcp->host, "ifc->specific_params.tcp->host")
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "t:192.168.0.1:1111");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "t:192.168.0.1:1111");
+   sb.len = 0;
 
    ifc->specific_params.tcp->max_clients = 123;
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "t:192.168.0.1:1111:123");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "t:192.168.0.1:1111:123");
+   sb.len = 0;
 
+   strbuf_free(&sb);
    inst_free(mod);
    interface_free(ifc);
 }
@@ -337,7 +328,7 @@ static void test_tcp_tls_ifc_to_cli_arg(void **state)
 {
    inst_t *mod;
    interface_t *ifc;
-   char * params;
+   strbuf_t sb = { 0 };
 
    alloc_module_and_ifc(&mod, &ifc);
    ifc->type = NS_IF_TYPE_TCP_TLS;
@@ -351,25 +342,23 @@ static void test_tcp_tls_ifc_to_cli_arg(void **state)
    IF_NO_MEM_FAIL_MSG(ifc->specific_params.tcp_tls->certfile, "ifc->specific_params.tcp_tls->certfile")
    ifc->specific_params.tcp_tls->cafile = strdup("/ca/path");
    IF_NO_MEM_FAIL_MSG(ifc->specific_params.tcp_tls->cafile, "ifc->specific_params.tcp_tls->cafile")
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "T:1111:/key/path:/cert/path:/ca/path");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "T:1111:/key/path:/cert/path:/ca/path");
+   sb.len = 0;
 
    ifc->specific_params.tcp_tls->host = strdup("host.com");
    IF_NO_MEM_FAIL_MSG(ifc->specific_params.tcp_tls->host, "ifc->specific_params.tcp_tls->host")
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "T:host.com:1111:/key/path:/cert/path:/ca/path");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "T:host.com:1111:/key/path:/cert/path:/ca/path");
+   sb.len = 0;
 
 
    ifc->specific_params.tcp_tls->max_clients = 123;
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "T:host.com:1111:123:/key/path:/cert/path:/ca/path");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "T:host.com:1111:123:/key/path:/cert/path:/ca/path");
+   sb.len = 0;
 
+   strbuf_free(&sb);
    inst_free(mod);
    interface_free(ifc);
 }
@@ -378,7 +367,7 @@ static void test_unix_ifc_to_cli_arg(void **state)
 {
    inst_t *mod;
    interface_t *ifc;
-   char * params;
+   strbuf_t sb = { 0 };
 
    alloc_module_and_ifc(&mod, &ifc);
    ifc->type = NS_IF_TYPE_UNIX;
@@ -386,17 +375,16 @@ static void test_unix_ifc_to_cli_arg(void **state)
 
    ifc->specific_params.nix->socket_name = strdup("socket_name");
    IF_NO_MEM_FAIL_MSG(ifc->specific_params.nix->socket_name, "ifc->specific_params.nix->socket_name")
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "u:socket_name");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "u:socket_name");
+   sb.len = 0;
 
    ifc->specific_params.nix->max_clients = 123;
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "u:socket_name:123");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "u:socket_name:123");
+   sb.len = 0;
 
+   strbuf_free(&sb);
    inst_free(mod);
    interface_free(ifc);
 }
@@ -405,7 +393,7 @@ static void test_file_ifc_to_cli_arg(void **state)
 {
    inst_t *mod;
    interface_t *ifc;
-   char * params;
+   strbuf_t sb = { 0 };
 
    alloc_module_and_ifc(&mod, &ifc);
    ifc->type = NS_IF_TYPE_FILE;
@@ -413,30 +401,27 @@ static void test_file_ifc_to_cli_arg(void **state)
 
    ifc->specific_params.file->name = strdup("/file/path");
    IF_NO_MEM_FAIL(ifc->specific_params.file->name)
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "f:/file/path");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "f:/file/path");
+   sb.len = 0;
 
    ifc->specific_params.file->time = 123;
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "f:/file/path:123");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "f:/file/path:123");
+   sb.len = 0;
 
    ifc->specific_params.file->size = 223;
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "f:/file/path:223:123");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "f:/file/path:223:123");
+   sb.len = 0;
 
    ifc->specific_params.file->mode = strdup("a");
    IF_NO_MEM_FAIL(ifc->specific_params.file->mode)
-   params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "f:/file/path:a:223:123");
-   NULLP_TEST_AND_FREE(params)
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "f:/file/path:a:223:123");
+   sb.len = 0;
 
+   strbuf_free(&sb);
    inst_free(mod);
    interface_free(ifc);
 }
@@ -449,22 +434,204 @@ static void test_bh_ifc_to_cli_arg(void **state)
    ifc->type = NS_IF_TYPE_BH;
    assert_int_equal(interface_specific_params_alloc(ifc), 0);
 
-   char * params = ifc->ifc_to_cli_arg_fn(ifc);
-   assert_non_null(params);
-   assert_string_equal(params, "b");
-   NULLP_TEST_AND_FREE(params)
+   strbuf_t sb = { 0 };
+   assert_int_equal(ifc->ifc_to_cli_arg_fn(ifc, &sb), 0);
+   assert_string_equal(sb.data, "b");
+   sb.len = 0;
 
+   strbuf_free(&sb);
    inst_free(mod);
    interface_free(ifc);
 }
 
-static void test_strcat_many(void **state)
+static void test_strbuf_append(void **state)
 {
-   char *a = strcat_many(3, "a", "b", "c");
-   assert_string_equal(a, "abc");
-   NULLP_TEST_AND_FREE(a)
+   strbuf_t sb = { 0 };
+
+   assert_int_equal(strbuf_append(&sb, "a"), 0);
+   assert_int_equal(strbuf_append_char(&sb, '\0'), 0);
+   assert_int_equal(strbuf_append_uint(&sb, 0), 0);
+   assert_int_equal(strbuf_append_uint(&sb, 4294967295U), 0);
+   assert_int_equal(sb.len, 13);
+   assert_string_equal(sb.data, "a");
+   assert_string_equal(sb.data + 2, "04294967295");
+
+   // Growing keeps content
+   for (int i = 0; i < 100; i++) {
+      assert_int_equal(strbuf_append(&sb, "bc"), 0);
+   }
+   assert_int_equal(sb.len, 213);
+   assert_true(sb.capacity > sb.len);
+   assert_int_equal(strncmp(sb.data + 2, "04294967295bc", 13), 0);
+   assert_int_equal(sb.data[212], 'c');
+   assert_int_equal(sb.data[213], '\0');
+
+   strbuf_free(&sb);
+   assert_null(sb.data);
+}
 
+static void test_insts_add_delete(void **state)
+{
+   av_module_t *mod_a = av_module_alloc();
+   av_module_t *mod_b = av_module_alloc();
+   inst_t *insts[4];
+   char name[8];
+   uint32_t index;
+
+   IF_NO_MEM_FAIL(mod_a)
+   IF_NO_MEM_FAIL(mod_b)
+   mod_a->name = strdup("module A");
+   mod_b->name = strdup("module B");
+   assert_int_equal(av_modules_add(mod_a), 0);
+   assert_int_equal(av_modules_add(mod_b), 0);
+
+   for (int i = 0; i < 4; i++) {
+      insts[i] = inst_alloc();
+      IF_NO_MEM_FAIL(insts[i])
+      snprintf(name, sizeof(name), "inst%d", i);
+      insts[i]->name = strdup(name);
+      insts[i]->mod_ref = (i % 2 == 0 ? mod_a : mod_b);
+      assert_int_equal(insts_add(insts[i]), 0);
+   }
+
+   assert_true(av_module_get_by_name("module B") == mod_b);
+   assert_null(av_module_get_by_name("module C"));
+   assert_true(inst_get_by_name("inst2", &index) == insts[2]);
+   assert_int_equal(index, 2);
+   assert_null(inst_get_by_name("inst4", NULL));
+   assert_int_equal(mod_a->insts.total, 2);
+   assert_int_equal(mod_b->insts.total, 2);
+
+   // Indexes of following instances shift, all indexes stay in sync
+   insts_delete(insts[1]);
+   assert_null(inst_get_by_name("inst1", NULL));
+   assert_true(inst_get_by_name("inst3", &index) == insts[3]);
+   assert_int_equal(index, 2);
+   assert_int_equal(mod_b->insts.total, 1);
+   assert_true(mod_b->insts.items[0] == insts[3]);
+   inst_free(insts[1]);
+
+   // All instances of module are removed at once, they stay in its reverse index
+   insts_delete_module(mod_a);
+   assert_int_equal(insts_v.total, 1);
+   assert_true(insts_v.items[0] == insts[3]);
+   assert_null(inst_get_by_name("inst0", NULL));
+   assert_null(inst_get_by_name("inst2", NULL));
+   assert_int_equal(mod_a->insts.total, 2);
+   inst_free(insts[0]);
+   inst_free(insts[2]);
+   vector_free(&mod_a->insts);
+
+   av_modules_delete(mod_a);
+   assert_null(av_module_get_by_name("module A"));
+   assert_true(av_module_get_by_name("module B") == mod_b);
+   assert_int_equal(avmods_v.total, 1);
+
+   insts_free();
+   assert_null(inst_get_by_name("inst3", NULL));
+   assert_int_equal(mod_b->insts.total, 0);
+   av_module_free(mod_a);
+   av_modules_free();
+}
 
+static void test_insts_hot_slots(void **state)
+{
+   inst_t *insts[100];
+   inst_t *inst;
+   uint32_t slot;
+
+   // Table grows past its initial capacity, state of instances is kept
+   for (int i = 0; i < 100; i++) {
+      insts[i] = inst_alloc();
+      IF_NO_MEM_FAIL(insts[i])
+      assert_int_equal(insts[i]->slot, i);
+      INST_PID(insts[i]) = 1000 + i;
+      INST_RUNNING(insts[i]) = (i % 2 == 0);
+   }
+   assert_int_equal(insts_hot.used, 100);
+   assert_true(insts_hot.capacity >= 100);
+   assert_true(inst_get_by_pid(1070) == insts[70]);
+   assert_true(INST_RUNNING(insts[70]));
+   assert_false(INST_RUNNING(insts[71]));
+
+   // Slot of freed instance is reused with cleared state
+   slot = insts[10]->slot;
+   inst_free(insts[10]);
+   assert_null(inst_get_by_pid(1010));
+   inst = inst_alloc();
+   IF_NO_MEM_FAIL(inst)
+   assert_int_equal(inst->slot, slot);
+   assert_int_equal(INST_PID(inst), 0);
+   assert_false(INST_RUNNING(inst));
+   assert_false(INST_ENABLED(inst));
+   insts[10] = inst;
+
+   // Table is freed together with the last instance
+   for (int i = 0; i < 100; i++) {
+      inst_free(insts[i]);
+   }
+   assert_int_equal(insts_hot.used, 0);
+   assert_null(insts_hot.inst);
+}
+
+static volatile sig_atomic_t test_sigusr1_cnt = 0;
+
+static void test_sigusr1_handler(int sig)
+{
+   test_sigusr1_cnt++;
+}
+
+static void test_inst_send_signal_exited(void **state)
+{
+   inst_t *inst = inst_alloc();
+   pid_t child;
+
+   IF_NO_MEM_FAIL(inst)
+   assert_int_equal(evloop_init(&main_evloop, NULL), 0);
+   child = fork();
+   if (child == 0) {
+      pause();
+      _exit(0);
+   }
+   assert_true(child > 0);
+   INST_PID(inst) = child;
+
+   // Kernel without pidfd can't tell exited process from the one that reused its PID
+   if (inst_pidfd_open(inst) == 0) {
+      assert_int_equal(inst_send_signal(inst, SIGKILL), 0);
+      assert_int_equal(waitpid(child, NULL, 0), child);
+
+      // PID now belongs to other process, which mustn't get the signal
+      signal(SIGUSR1, test_sigusr1_handler);
+      INST_PID(inst) = getpid();
+      assert_int_equal(inst_send_signal(inst, SIGUSR1), -1);
+      assert_int_equal(errno, ESRCH);
+      assert_int_equal(test_sigusr1_cnt, 0);
+      signal(SIGUSR1, SIG_DFL);
+   } else {
+      kill(child, SIGKILL);
+      waitpid(child, NULL, 0);
+   }
+
+   INST_PID(inst) = 0;
+   inst_free(inst);
+   evloop_free(&main_evloop);
+}
+
+static void test_stats_xpath_alloc(void **state)
+{
+   char *xpath;
+
+   xpath = stats_xpath_alloc("inst1", NULL);
+   assert_non_null(xpath);
+   assert_string_equal(xpath, NS_ROOT_XPATH"/instance[name='inst1']/stats");
+   NULLP_TEST_AND_FREE(xpath)
+
+   xpath = stats_xpath_alloc("inst1", "ifc_out");
+   assert_non_null(xpath);
+   assert_string_equal(xpath, NS_ROOT_XPATH"/instance[name='inst1']/interface[name='ifc_out']/stats");
+   assert_int_equal(stats_xpath_format(NULL, 0, "inst1", "ifc_out"), strlen(xpath));
+   NULLP_TEST_AND_FREE(xpath)
 }
 
 int main(void)
@@ -477,9 +644,13 @@ int main(void)
          cmocka_unit_test(test_module_get_ifcs_as_arg),
          cmocka_unit_test(test_tcp_ifc_to_cli_arg),
          cmocka_unit_test(test_tcp_tls_ifc_to_cli_arg),
-         cmocka_unit_test(test_strcat_many),
+         cmocka_unit_test(test_strbuf_append),
          cmocka_unit_test(test_bh_ifc_to_cli_arg),
          cmocka_unit_test(test_file_ifc_to_cli_arg),
+         cmocka_unit_test(test_stats_xpath_alloc),
+         cmocka_unit_test(test_insts_add_delete),
+         cmocka_unit_test(test_insts_hot_slots),
+         cmocka_unit_test(test_inst_send_signal_exited),
    };
 
    return cmocka_run_group_tests(tests, NULL, NULL);
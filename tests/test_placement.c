@@ -0,0 +1,79 @@
+#include <string.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+
+#include "../src/placement.c"
+
+void test_placement_lists(void **state)
+{
+   unsigned long mask[PLACEMENT_MAX_CPUS / PLACEMENT_LONG_BITS];
+   char buf[PLACEMENT_LIST_LEN];
+
+   assert_int_equal(placement_parse_list("0-3,8,10-11,64", mask, PLACEMENT_MAX_CPUS), 0);
+   assert_true(placement_mask_isset(mask, 0) && placement_mask_isset(mask, 3));
+   assert_false(placement_mask_isset(mask, 4));
+   assert_true(placement_mask_isset(mask, 64));
+   assert_int_equal(placement_format_list(mask, PLACEMENT_MAX_CPUS, buf, sizeof(buf)), 0);
+   assert_string_equal(buf, "0-3,8,10-11,64");
+
+   // Adjacent ranges are merged
+   assert_int_equal(placement_parse_list("5,1-2,3-4", mask, PLACEMENT_MAX_CPUS), 0);
+   assert_int_equal(placement_format_list(mask, PLACEMENT_MAX_CPUS, buf, sizeof(buf)), 0);
+   assert_string_equal(buf, "1-5");
+   assert_int_equal(placement_format_list(mask, PLACEMENT_MAX_CPUS, buf, 3), -1);
+
+   assert_int_equal(placement_parse_list("", mask, PLACEMENT_MAX_CPUS), -1);
+   assert_int_equal(placement_parse_list("3-1", mask, PLACEMENT_MAX_CPUS), -1);
+   assert_int_equal(placement_parse_list("1,", mask, PLACEMENT_MAX_CPUS), -1);
+   assert_int_equal(placement_parse_list("0-1024", mask, PLACEMENT_MAX_CPUS), -1);
+}
+
+void test_placement_load(void **state)
+{
+   placement_t pl;
+
+   assert_int_equal(placement_load(&pl, NULL, NULL, NULL), 0);
+   assert_false(pl.has_cpus);
+   assert_false(pl.has_mem_policy);
+
+   assert_int_equal(placement_load(&pl, "2-3", "bind", "1"), 0);
+   assert_true(pl.has_cpus);
+   assert_true(pl.has_mem_policy);
+   assert_int_equal(pl.mem_mode, MPOL_BIND);
+   assert_int_equal(pl.mem_nodes[0], 2);
+
+   assert_int_equal(placement_load(&pl, NULL, "local", NULL), 0);
+   assert_int_equal(pl.mem_mode, MPOL_LOCAL);
+
+   assert_int_equal(placement_load(&pl, NULL, "interleave", NULL), -1);
+   assert_int_equal(placement_load(&pl, NULL, "default", "0"), -1);
+   assert_int_equal(placement_load(&pl, NULL, NULL, "0"), -1);
+   assert_int_equal(placement_load(&pl, NULL, "firsttouch", NULL), -1);
+}
+
+void test_placement_apply_self(void **state)
+{
+   placement_t pl;
+   char before[PLACEMENT_LIST_LEN];
+   char after[PLACEMENT_LIST_LEN];
+
+   // Binding to all currently allowed CPUs doesn't change anything
+   assert_int_equal(placement_get_cpus(0, before, sizeof(before)), 0);
+   assert_int_equal(placement_load(&pl, before, "default", NULL), 0);
+   assert_int_equal(placement_apply(&pl), 0);
+   assert_int_equal(placement_get_cpus(getpid(), after, sizeof(after)), 0);
+   assert_string_equal(before, after);
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_placement_lists),
+         cmocka_unit_test(test_placement_load),
+         cmocka_unit_test(test_placement_apply_self),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
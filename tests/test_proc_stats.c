@@ -0,0 +1,81 @@
+#include <string.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <cmocka.h>
+
+#include "../src/proc_stats.c"
+
+void test_proc_parse_pid_stat(void **state)
+{
+   proc_pid_stat_t st;
+   const char *stat = "7462 (cat) R 7457 7462 7457 0 -1 4194304 85 0 0 0 12 34 0 0 20 0 1 0"
+                      " 320725 2703360 311 18446744073709551615 94078462627840\n";
+   // Name of process can contain spaces and parentheses
+   const char *odd = "42 (a) b (c) S 1 42 42 0 -1 0 0 0 0 0 5 6 0 0 20 0 1 0 1 4096 1\n";
+
+   assert_int_equal(proc_parse_pid_stat(stat, strlen(stat), &st), 0);
+   assert_int_equal(st.utime, 12);
+   assert_int_equal(st.stime, 34);
+   assert_int_equal(st.vsize, 2703360);
+
+   assert_int_equal(proc_parse_pid_stat(odd, strlen(odd), &st), 0);
+   assert_int_equal(st.utime, 5);
+   assert_int_equal(st.stime, 6);
+   assert_int_equal(st.vsize, 4096);
+
+   assert_int_equal(proc_parse_pid_stat("42 cat R 1", 10, &st), -1);
+   assert_int_equal(proc_parse_pid_stat(stat, 60, &st), -1);
+}
+
+void test_proc_parse_statm_and_total(void **state)
+{
+   uint64_t val = 0;
+   const char *cpu = "cpu  7859 0 1780 310459 348 0 5 470 0 0\ncpu0 1 2 3 4 5 6 7 8 9 10\n";
+
+   assert_int_equal(proc_parse_statm_rss("660 313 287 5 0 123 0\n", 22, &val), 0);
+   assert_int_equal(val, 313);
+   assert_int_equal(proc_parse_statm_rss("660\n", 4, &val), -1);
+
+   assert_int_equal(proc_parse_total_cpu(cpu, strlen(cpu), &val), 0);
+   assert_int_equal(val, 7859 + 1780 + 310459 + 348 + 5 + 470);
+   assert_int_equal(proc_parse_total_cpu("intr 1 2\n", 9, &val), -1);
+}
+
+void test_proc_pread_self(void **state)
+{
+   char buf[PROC_READ_BUF_SIZE];
+   proc_pid_stat_t st;
+   uint64_t rss = 0;
+   ssize_t len;
+   int stat_fd = open("/proc/self/stat", O_RDONLY);
+   int statm_fd = open("/proc/self/statm", O_RDONLY);
+
+   assert_true(stat_fd != -1 && statm_fd != -1);
+   // Descriptor is re-read from offset 0
+   for (int i = 0; i < 2; i++) {
+      len = proc_pread(stat_fd, buf, sizeof(buf));
+      assert_true(len > 0);
+      assert_int_equal(proc_parse_pid_stat(buf, (size_t) len, &st), 0);
+      assert_true(st.vsize > 0);
+
+      len = proc_pread(statm_fd, buf, sizeof(buf));
+      assert_true(len > 0);
+      assert_int_equal(proc_parse_statm_rss(buf, (size_t) len, &rss), 0);
+      assert_true(rss > 0);
+   }
+   close(stat_fd);
+   close(statm_fd);
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_proc_parse_pid_stat),
+         cmocka_unit_test(test_proc_parse_statm_and_total),
+         cmocka_unit_test(test_proc_pread_self),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -22,20 +22,9 @@ bool sv_thread_running = true;
 
 void cleanup_structs_and_vectors()
 {
-   inst_t *inst = NULL;
-   for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
-      inst_free(inst);
-   }
-   vector_free(&insts_v);
-
-
-   av_module_t *avmod = NULL;
-   for (uint32_t i = 0; i < avmods_v.total; i++) {
-      avmod = avmods_v.items[i];
-      av_module_free(avmod);
-   }
-   vector_free(&avmods_v);
+   // Frees indexes of instances and modules by name too
+   insts_free();
+   av_modules_free();
 }
 
 
@@ -90,14 +79,14 @@ static int load_config()
 
 void start_intable_module(inst_t *inst, char *faked_name)
 {
-   inst->pid = fork();
-   if (inst->pid == -1) {
+   INST_PID(inst) = fork();
+   if (INST_PID(inst) == -1) {
       fail_msg("Fork: could not fork supervisor process");
    }
 
-   if (inst->pid != 0) {
+   if (INST_PID(inst) != 0) {
       inst->is_my_child = true;
-      inst->running = true;
+      INST_RUNNING(inst) = true;
    } else {
       setsid();
       char *exec_args[2] = {faked_name, NULL};
@@ -256,7 +245,7 @@ void test_ns_config_change_cb_with_module_modified_1(void **state)
    { // fake pid in instance m3
       inst = insts_v.items[2];
       assert_string_equal(inst->name, "m3");
-      inst->pid = 123;
+      INST_PID(inst) = 123;
    }
 
    VERBOSE(V3, "Making async change")
@@ -273,7 +262,7 @@ void test_ns_config_change_cb_with_module_modified_1(void **state)
    inst = insts_v.items[3];
 
    assert_string_equal(inst->name, "m3");
-   assert_int_equal(inst->pid, 0);
+   assert_int_equal(INST_PID(inst), 0);
 
    disconnect_and_unload_config();
 }
@@ -288,7 +277,7 @@ void test_ns_config_change_cb_with_inst_modified_1(void **state)
    assert_int_equal(inst->in_ifces.total, 0);
    assert_int_equal(inst->out_ifces.total, 1);
    start_intable_module(inst, "inst");
-   pid_t old_pid = inst->pid;
+   pid_t old_pid = INST_PID(inst);
 
    VERBOSE(V3, "Making async change")
    make_async_change("instance_modified_1");
@@ -304,7 +293,7 @@ void test_ns_config_change_cb_with_inst_modified_1(void **state)
    assert_int_equal(ifc->type, NS_IF_TYPE_UNIX);
    assert_string_equal(ifc->name, "tcp-in-4-1");
    // Module should be stopped by the configuration and therefore have default PID 0
-   assert_int_not_equal(old_pid, inst->pid);
+   assert_int_not_equal(old_pid, INST_PID(inst));
 
    disconnect_and_unload_config();
 }
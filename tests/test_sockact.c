@@ -0,0 +1,102 @@
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <arpa/inet.h>
+#include <cmocka.h>
+
+#include "../src/sockact.c"
+
+#define TEST_SOCKACT_PORT 47631
+
+static inst_t * get_test_inst(av_module_t *mod, const char *name)
+{
+   inst_t *inst = inst_alloc();
+   if (inst == NULL) { fail_msg("Failed to allocate tests instance."); }
+   inst->name = strdup(name);
+   inst->mod_ref = mod;
+   INST_ENABLED(inst) = true;
+   inst->socket_activation = true;
+   if (vector_add(&insts_v, inst) != 0) { fail_msg("Failed to add tests instance."); }
+   return inst;
+}
+
+static interface_t * add_test_tcp_ifc(inst_t *inst, interface_dir_t dir, uint16_t port)
+{
+   interface_t *ifc = interface_alloc();
+   if (ifc == NULL) { fail_msg("Failed to allocate tests interface."); }
+
+   ifc->name = strdup("tcp_ifc");
+   ifc->direction = dir;
+   ifc->type = NS_IF_TYPE_TCP;
+   if (interface_specific_params_alloc(ifc) != 0) { fail_msg("Failed to allocate params."); }
+   ifc->specific_params.tcp->port = port;
+   if (inst_interface_add(inst, ifc) != 0) { fail_msg("Failed to add tests interface."); }
+   return ifc;
+}
+
+static bool test_port_accepts(uint16_t port)
+{
+   struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+   int fd = socket(AF_INET, SOCK_STREAM, 0);
+   bool connected;
+
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   connected = (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+   close(fd);
+   return connected;
+}
+
+void test_sockact_keep_and_release(void **state)
+{
+   av_module_t mod = { .trap_mon = false, .trap_ifces_cli = true };
+   inst_t *inst = get_test_inst(&mod, "producer");
+   inst_t *twin = get_test_inst(&mod, "producer");
+   strbuf_t names = { 0 };
+   int fds[2];
+   int fd;
+
+   add_test_tcp_ifc(inst, NS_IF_DIR_IN, TEST_SOCKACT_PORT + 1);
+   add_test_tcp_ifc(inst, NS_IF_DIR_OUT, TEST_SOCKACT_PORT);
+   assert_false(sockact_ifc_supported(inst->in_ifces.items[0]));
+
+   // Only OUT interface gets socket, nobody has to be started yet for it to accept
+   assert_int_equal(sockact_inst_prepare(inst, fds, &names), 1);
+   assert_string_equal(names.data, "47631");
+   assert_int_equal(sockacts_v.total, 1);
+   assert_true(test_port_accepts(TEST_SOCKACT_PORT));
+   fd = fds[0];
+
+   // Restart of the process gets the same socket
+   names.len = 0;
+   assert_int_equal(sockact_inst_prepare(inst, fds, &names), 1);
+   assert_int_equal(fds[0], fd);
+   assert_int_equal(sockacts_v.total, 1);
+
+   // Replacement with the same interface takes the socket over
+   add_test_tcp_ifc(twin, NS_IF_DIR_OUT, TEST_SOCKACT_PORT);
+   INST_ENABLED(inst) = false;
+   sockact_inst_release(inst);
+   assert_int_equal(sockacts_v.total, 1);
+   names.len = 0;
+   assert_int_equal(sockact_inst_prepare(twin, fds, &names), 1);
+   assert_int_equal(fds[0], fd);
+
+   // Nobody wants it anymore
+   INST_ENABLED(twin) = false;
+   sockact_inst_release(twin);
+   assert_int_equal(sockacts_v.total, 0);
+   assert_false(test_port_accepts(TEST_SOCKACT_PORT));
+
+   strbuf_free(&names);
+   sockacts_close();
+   insts_free();
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_sockact_keep_and_release),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
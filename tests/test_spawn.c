@@ -0,0 +1,154 @@
+#include "../src/spawn.c"
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <sys/wait.h>
+#include <cmocka.h>
+
+#define TEST_SPAWN_OUT "/tmp/test_spawn_stdout"
+#define TEST_SPAWN_ERR "/tmp/test_spawn_stderr"
+
+void test_spawn_redirect_and_close(void **state)
+{
+   // Counts descriptors of the child, only 0, 1, 2 and the one of ls itself are expected
+   char *argv[] = { "/bin/sh", "-c", "ls /proc/self/fd | wc -l; echo err >&2", NULL };
+   const char msg[] = "executed\n";
+   spawn_args_t args = {
+      .path = "/bin/sh",
+      .argv = argv,
+      .stdout_path = TEST_SPAWN_OUT,
+      .stderr_path = TEST_SPAWN_ERR,
+      .stdout_fd = -1,
+      .stderr_fd = -1,
+      .log_perm = 0600,
+      .cgroup_procs_fd = -1,
+      .pl = NULL,
+      .exec_msg = msg,
+      .exec_msg_len = sizeof(msg) - 1,
+   };
+   char buf[64] = { 0 };
+   int leaked_fd = open("/dev/null", O_RDONLY);
+   int status;
+   FILE *f;
+   pid_t pid;
+
+   unlink(TEST_SPAWN_OUT);
+   unlink(TEST_SPAWN_ERR);
+   assert_int_not_equal(leaked_fd, -1);
+
+   pid = spawn_process(&args);
+   assert_int_not_equal(pid, -1);
+   assert_int_equal(args.exec_errno, 0);
+   assert_int_equal(waitpid(pid, &status, 0), pid);
+   assert_true(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+   f = fopen(TEST_SPAWN_OUT, "r");
+   assert_non_null(f);
+   assert_non_null(fgets(buf, sizeof(buf), f));
+   assert_string_equal(buf, "executed\n");
+   assert_non_null(fgets(buf, sizeof(buf), f));
+   assert_int_equal(atoi(buf), 4);
+   fclose(f);
+
+   f = fopen(TEST_SPAWN_ERR, "r");
+   assert_non_null(f);
+   assert_non_null(fgets(buf, sizeof(buf), f));
+   assert_string_equal(buf, "err\n");
+   fclose(f);
+
+   close(leaked_fd);
+   unlink(TEST_SPAWN_OUT);
+   unlink(TEST_SPAWN_ERR);
+}
+
+void test_spawn_listen_fds(void **state)
+{
+   // Descriptors 0, 1, 2, two passed ones and the one of ls itself are expected
+   char *argv[] = { "/bin/sh", "-c",
+                    "echo $LISTEN_FDS $LISTEN_FDNAMES; [ \"$LISTEN_PID\" = \"$$\" ] && echo pid; "
+                    "ls /proc/self/fd | wc -l", NULL };
+   int pipe_fds[2];
+   int listen_fds[2];
+   spawn_args_t args = {
+      .path = "/bin/sh",
+      .argv = argv,
+      .stdout_path = TEST_SPAWN_OUT,
+      .stdout_fd = -1,
+      .stderr_fd = -1,
+      .log_perm = 0600,
+      .cgroup_procs_fd = -1,
+      .listen_fds = listen_fds,
+      .listen_fds_cnt = 2,
+      .listen_fdnames = "sock_a:7600",
+   };
+   char buf[64] = { 0 };
+   int status;
+   FILE *f;
+   pid_t pid;
+
+   unlink(TEST_SPAWN_OUT);
+   assert_int_equal(pipe2(pipe_fds, O_CLOEXEC), 0);
+   // Reversed so that the first one has to be moved out of the way of the second one
+   listen_fds[0] = pipe_fds[1];
+   listen_fds[1] = pipe_fds[0];
+   setenv("LISTEN_FDS", "7", 1);
+
+   pid = spawn_process(&args);
+   assert_int_not_equal(pid, -1);
+   assert_int_equal(args.listen_errno, 0);
+   assert_int_equal(args.exec_errno, 0);
+   assert_null(args.envp);
+   assert_int_equal(waitpid(pid, &status, 0), pid);
+   assert_true(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+   // Environment of supervisor itself is untouched
+   assert_string_equal(getenv("LISTEN_FDS"), "7");
+   unsetenv("LISTEN_FDS");
+
+   f = fopen(TEST_SPAWN_OUT, "r");
+   assert_non_null(f);
+   assert_non_null(fgets(buf, sizeof(buf), f));
+   assert_string_equal(buf, "2 sock_a:7600\n");
+   assert_non_null(fgets(buf, sizeof(buf), f));
+   assert_string_equal(buf, "pid\n");
+   assert_non_null(fgets(buf, sizeof(buf), f));
+   assert_int_equal(atoi(buf), 6);
+   fclose(f);
+
+   close(pipe_fds[0]);
+   close(pipe_fds[1]);
+   unlink(TEST_SPAWN_OUT);
+}
+
+void test_spawn_exec_failure(void **state)
+{
+   char *argv[] = { "/nonexistent/module", NULL };
+   spawn_args_t args = {
+      .path = "/nonexistent/module",
+      .argv = argv,
+      .stdout_fd = -1,
+      .stderr_fd = -1,
+      .cgroup_procs_fd = -1,
+   };
+   int status;
+   pid_t pid;
+
+   pid = spawn_process(&args);
+   assert_int_not_equal(pid, -1);
+   assert_int_equal(args.exec_errno, ENOENT);
+   assert_int_equal(waitpid(pid, &status, 0), pid);
+   assert_true(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_FAILURE);
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_spawn_redirect_and_close),
+         cmocka_unit_test(test_spawn_listen_fds),
+         cmocka_unit_test(test_spawn_exec_failure),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,121 @@
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+
+#include "../src/startup.c"
+
+static inst_t * get_test_inst(av_module_t *mod)
+{
+   inst_t *inst = inst_alloc();
+   if (inst == NULL) { fail_msg("Failed to allocate tests instance."); }
+   inst->mod_ref = mod;
+   INST_ENABLED(inst) = true;
+   return inst;
+}
+
+static void add_test_ifc(inst_t *inst, interface_dir_t dir, const char *socket_name)
+{
+   interface_t *ifc = interface_alloc();
+   if (ifc == NULL) { fail_msg("Failed to allocate tests interface."); }
+
+   ifc->direction = dir;
+   ifc->type = NS_IF_TYPE_UNIX;
+   if (interface_specific_params_alloc(ifc) != 0) { fail_msg("Failed to allocate params."); }
+   ifc->specific_params.nix->socket_name = strdup(socket_name);
+   if (inst_interface_add(inst, ifc) != 0) { fail_msg("Failed to add tests interface."); }
+}
+
+void test_startup_order(void **state)
+{
+   av_module_t mod = { .trap_mon = false };
+   inst_t *insts[6];
+   startup_order_t so;
+
+   for (int i = 0; i < 6; i++) {
+      insts[i] = get_test_inst(&mod);
+   }
+   // Configured in reverse: reporter <- detector <- collector
+   add_test_ifc(insts[0], NS_IF_DIR_IN, "startup_alerts");
+   add_test_ifc(insts[1], NS_IF_DIR_IN, "startup_flows");
+   add_test_ifc(insts[1], NS_IF_DIR_OUT, "startup_alerts");
+   add_test_ifc(insts[2], NS_IF_DIR_OUT, "startup_flows");
+   // Independent instance and a cycle of two
+   add_test_ifc(insts[4], NS_IF_DIR_IN, "startup_loop_a");
+   add_test_ifc(insts[4], NS_IF_DIR_OUT, "startup_loop_b");
+   add_test_ifc(insts[5], NS_IF_DIR_IN, "startup_loop_b");
+   add_test_ifc(insts[5], NS_IF_DIR_OUT, "startup_loop_a");
+
+   assert_int_equal(startup_order_build(insts, 6, &so), 0);
+   assert_int_equal(so.levels_cnt, 4);
+   assert_int_equal(so.level[2], 0);
+   assert_int_equal(so.level[3], 0);
+   assert_int_equal(so.level[1], 1);
+   assert_int_equal(so.level[0], 2);
+   assert_int_equal(so.level[4], 3);
+   assert_int_equal(so.level[5], 3);
+   // Sorted by level, configuration order within level
+   uint32_t expected[] = { 2, 3, 1, 0, 4, 5 };
+   for (int i = 0; i < 6; i++) {
+      assert_int_equal(so.order[i], expected[i]);
+   }
+
+   // Nothing runs, collector and the independent one can start right away
+   assert_false(startup_inst_waits(&so, insts, 2, 0));
+   assert_false(startup_inst_waits(&so, insts, 3, 0));
+   assert_true(startup_inst_waits(&so, insts, 1, 0));
+   // Members of cycle don't wait for each other
+   assert_false(startup_inst_waits(&so, insts, 4, 0));
+   assert_false(startup_inst_waits(&so, insts, 5, 0));
+
+   // Collector was started, its socket doesn't exist until timeout
+   INST_RUNNING(insts[2]) = true;
+   insts[2]->is_my_child = true;
+   insts[2]->start_ms = 1000;
+   assert_true(startup_inst_waits(&so, insts, 1, 1000 + STARTUP_READY_TIMEOUT_MS - 1));
+   assert_false(startup_inst_waits(&so, insts, 1, 1000 + STARTUP_READY_TIMEOUT_MS));
+   assert_true(insts[2]->ready);
+
+   // Disabled producer doesn't block its consumer
+   INST_ENABLED(insts[1]) = false;
+   assert_false(startup_inst_waits(&so, insts, 0, 0));
+
+   startup_order_free(&so);
+   for (int i = 0; i < 6; i++) {
+      inst_free(insts[i]);
+   }
+}
+
+void test_startup_ready(void **state)
+{
+   av_module_t mod = { .trap_mon = false };
+   inst_t *inst = get_test_inst(&mod);
+
+   // Not running instance is never ready
+   assert_false(startup_inst_ready(inst, 0));
+
+   // Without UNIX outputs and service interface there is nothing to wait for
+   INST_RUNNING(inst) = true;
+   inst->is_my_child = true;
+   assert_true(startup_inst_ready(inst, 0));
+
+   // Adopted process is ready regardless of its sockets
+   inst->ready = false;
+   inst->is_my_child = false;
+   add_test_ifc(inst, NS_IF_DIR_OUT, "startup_never_created");
+   assert_true(startup_inst_ready(inst, 0));
+   inst->is_my_child = true;
+   assert_false(startup_inst_ready(inst, 0));
+
+   inst_free(inst);
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_startup_order),
+         cmocka_unit_test(test_startup_ready),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -171,20 +171,11 @@ void run_async_caller_and_sv_routine(char * async_option)
 
 void cleanup_structs_and_vectors()
 {
-   inst_t *inst = NULL;
-   for (uint32_t i = 0; i < insts_v.total; i++) {
-      inst = insts_v.items[i];
-      inst_free(inst);
-   }
-   vector_free(&insts_v);
-
+   stats_snap_free();
 
-   av_module_t *avmod = NULL;
-   for (uint32_t i = 0; i < avmods_v.total; i++) {
-      avmod = avmods_v.items[i];
-      av_module_free(avmod);
-   }
-   vector_free(&avmods_v);
+   // Frees indexes of instances and modules by name too
+   insts_free();
+   av_modules_free();
 }
 
 ///////////////////////////TESTS
@@ -215,6 +206,8 @@ void test_get_intable_interface_stats_cb(void **state)
       in_stats->recv_msg_cnt = 12333;
       in_stats->recv_buff_cnt = 12334;
    }
+   // Callbacks read published snapshot, not the instances
+   assert_int_equal(stats_snap_publish(), 0);
 
    run_async_caller_and_sv_routine("intable_interfaces_stats");
    cleanup_structs_and_vectors();
@@ -233,14 +226,15 @@ void test_get_inst_stats(void **state)
    {
       // Load dummy stats
       inst_t *inst = insts_v.items[0];
-      inst->running = true;
-      time(&inst->restart_time);
+      INST_RUNNING(inst) = true;
       inst->restarts_cnt = 2;
       inst->last_cpu_perc_umode = 9999;
       inst->last_cpu_perc_kmode = 8888;
       inst->mem_vms = 7777;
       inst->mem_rss = 6666;
    }
+   // Callbacks read published snapshot, not the instances
+   assert_int_equal(stats_snap_publish(), 0);
 
    run_async_caller_and_sv_routine("intable_module_stats");
    cleanup_structs_and_vectors();
@@ -262,8 +256,7 @@ void test_get_intable_inst_stats_including_ifc_stats(void **state)
 
    { // load dummy data
       inst_t *inst = insts_v.items[0];
-      inst->running = true;
-      time(&inst->restart_time);
+      INST_RUNNING(inst) = true;
       inst->restarts_cnt = 2;
       inst->last_cpu_perc_umode = 9999;
       inst->last_cpu_perc_kmode = 8888;
@@ -283,6 +276,8 @@ void test_get_intable_inst_stats_including_ifc_stats(void **state)
       in_stats->recv_msg_cnt = 12333;
       in_stats->recv_buff_cnt = 12334;
    }
+   // Callbacks read published snapshot, not the instances
+   assert_int_equal(stats_snap_publish(), 0);
 
    run_async_caller_and_sv_routine("intable_inst_stats_including_ifc_stats");
    cleanup_structs_and_vectors();
@@ -318,48 +313,127 @@ void test_tree_path_load(void **state)
       NULLP_TEST_AND_FREE(xpath)
       tree_path_free(tpath);
    }
+
+   {
+      tpath = tree_path_load(NS_ROOT_XPATH"/instance/stats");
+      assert_non_null(tpath);
+      assert_null(tpath->inst);
+      assert_null(tpath->ifc);
+      tree_path_free(tpath);
+   }
+
+   {
+      tpath = tree_path_load(NS_ROOT_XPATH"/instance[name=Intable1]/stats");
+      assert_null(tpath);
+   }
 }
 
-void test_interface_get_by_tree_path(void **state)
+static inst_t * add_test_inst(const char *name)
 {
-   char * xpath;
-   inst_t * inst;
-   interface_t * ifc;
-   interface_t * stored_ifc;
-
-   inst = inst_alloc();
+   inst_t *inst = inst_alloc();
    IF_NO_MEM_FAIL(inst)
-   inst->name = strdup("intable_module");
+   inst->name = strdup(name);
    IF_NO_MEM_FAIL(inst->name)
    assert_int_equal(vector_add(&insts_v, inst), 0);
+   return inst;
+}
 
-   stored_ifc = interface_alloc();
-   IF_NO_MEM_FAIL(stored_ifc)
-   stored_ifc->direction = NS_IF_DIR_IN;
-   stored_ifc->type = NS_IF_TYPE_UNIX;
-   stored_ifc->name = strdup("ifc1");
-   IF_NO_MEM_FAIL(stored_ifc->name)
-   assert_int_equal(inst_interface_add(inst, stored_ifc), 0);
+static void add_test_ifc(inst_t *inst, const char *name, interface_dir_t dir)
+{
+   interface_t *ifc = interface_alloc();
+   IF_NO_MEM_FAIL(ifc)
+   ifc->direction = dir;
+   ifc->type = NS_IF_TYPE_BH;
+   ifc->name = strdup(name);
+   IF_NO_MEM_FAIL(ifc->name)
+   assert_int_equal(interface_stats_alloc(ifc), 0);
+   assert_int_equal(inst_interface_add(inst, ifc), 0);
+}
+
+void test_interface_get_by_tree_path(void **state)
+{
+   inst_t * inst;
+   sr_val_t * vals = NULL;
+   size_t vals_cnt = 0;
+
+   assert_int_equal(vector_init(&insts_v, 10), 0);
+   inst = add_test_inst("intable_module");
+   add_test_ifc(inst, "ifc1", NS_IF_DIR_IN);
+   add_test_ifc(inst, "ifc2", NS_IF_DIR_OUT);
+   ((ifc_in_stats_t *) ((interface_t *) inst->in_ifces.items[0])->stats)->recv_msg_cnt = 12333;
+   assert_int_equal(stats_snap_publish(), 0);
 
    {
-      xpath = strdup(NS_ROOT_XPATH"/instance[name='intable_module']"
-                           "/interface[name='if1']/stats");
-      ifc = interface_get_by_xpath(xpath);
-      assert_non_null(ifc);
-      stored_ifc = inst->in_ifces.items[0];
-      assert_ptr_equal(ifc, stored_ifc);
+      assert_int_equal(interface_get_stats_cb(NS_ROOT_XPATH"/instance[name='intable_module']"
+                                              "/interface[name='ifc1']/stats",
+                                              &vals, &vals_cnt, NULL), SR_ERR_OK);
+      assert_int_equal(vals_cnt, 2);
+      assert_string_equal(vals[0].xpath, NS_ROOT_XPATH"/instance[name='intable_module']"
+                                         "/interface[name='ifc1']/stats/recv-msg-cnt");
+      assert_int_equal(vals[0].data.uint64_val, 12333);
+      sr_free_values(vals, vals_cnt);
    }
 
    {
-      xpath = strdup(NS_ROOT_XPATH"/instance[name='intable_module']"
-                           "/stats");
-      ifc = interface_get_by_xpath(xpath);
-      assert_null(ifc);
+      assert_int_equal(interface_get_stats_cb(NS_ROOT_XPATH"/instance[name='intable_module']"
+                                              "/interface[name='ifc3']/stats",
+                                              &vals, &vals_cnt, NULL), SR_ERR_NOT_FOUND);
    }
 
-   vector_delete(&insts_v, 0);
-   NULLP_TEST_AND_FREE(inst)
-   NULLP_TEST_AND_FREE(stored_ifc)
+   { // All interfaces of the instance
+      assert_int_equal(interface_get_stats_cb(NS_ROOT_XPATH"/instance[name='intable_module']"
+                                              "/interface/stats",
+                                              &vals, &vals_cnt, NULL), SR_ERR_OK);
+      assert_int_equal(vals_cnt, 6);
+      assert_string_equal(vals[5].xpath, NS_ROOT_XPATH"/instance[name='intable_module']"
+                                         "/interface[name='ifc2']/stats/autoflush-cnt");
+      sr_free_values(vals, vals_cnt);
+   }
+
+   insts_free();
+   stats_snap_free();
+}
+
+void test_get_all_insts_stats(void **state)
+{
+   inst_t * inst;
+   sr_val_t * vals = NULL;
+   size_t vals_cnt = 0;
+   const stats_snap_t * snap;
+   uint32_t slot;
+
+   assert_int_equal(vector_init(&insts_v, 10), 0);
+   inst = add_test_inst("inst_b");
+   inst->restarts_cnt = 2;
+   add_test_inst("inst_a");
+   assert_int_equal(stats_snap_publish(), 0);
+
+   // One request is served with values of all instances, in configuration order
+   assert_int_equal(inst_get_stats_cb(NS_ROOT_XPATH"/instance/stats",
+                                      &vals, &vals_cnt, NULL), SR_ERR_OK);
+   assert_int_equal(vals_cnt, 12);
+   assert_string_equal(vals[0].xpath, NS_ROOT_XPATH"/instance[name='inst_b']/stats/running");
+   assert_string_equal(vals[1].xpath,
+                       NS_ROOT_XPATH"/instance[name='inst_b']/stats/restart-counter");
+   assert_int_equal(vals[1].data.uint8_val, 2);
+   assert_string_equal(vals[6].xpath, NS_ROOT_XPATH"/instance[name='inst_a']/stats/running");
+   sr_free_values(vals, vals_cnt);
+
+   // Values of the snapshot were built once, single instance is a slice of them
+   snap = stats_snap_acquire(&slot);
+   assert_non_null(stats_snap_cache_get(snap));
+   stats_snap_release(slot);
+   assert_int_equal(inst_get_stats_cb(NS_ROOT_XPATH"/instance[name='inst_a']/stats",
+                                      &vals, &vals_cnt, NULL), SR_ERR_OK);
+   assert_int_equal(vals_cnt, 6);
+   assert_string_equal(vals[0].xpath, NS_ROOT_XPATH"/instance[name='inst_a']/stats/running");
+   sr_free_values(vals, vals_cnt);
+
+   assert_int_equal(inst_get_stats_cb(NS_ROOT_XPATH"/instance[name='inst_c']/stats",
+                                      &vals, &vals_cnt, NULL), SR_ERR_NOT_FOUND);
+
+   insts_free();
+   stats_snap_free();
 }
 
 int main(void)
@@ -370,6 +444,7 @@ int main(void)
          cmocka_unit_test(test_get_intable_interface_stats_cb),
          cmocka_unit_test(test_tree_path_load),
          cmocka_unit_test(test_interface_get_by_tree_path),
+         cmocka_unit_test(test_get_all_insts_stats),
          cmocka_unit_test(test_get_inst_stats),
          cmocka_unit_test(test_get_intable_inst_stats_including_ifc_stats),
    };
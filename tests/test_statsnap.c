@@ -0,0 +1,199 @@
+#include "../src/statsnap.c"
+
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <cmocka.h>
+
+#define TEST_STATSNAP_READERS 4
+#define TEST_STATSNAP_PUBLISHES 2000
+
+static inst_t * get_test_inst(const char *name)
+{
+   inst_t *inst = inst_alloc();
+   if (inst == NULL) { fail_msg("Failed to allocate tests instance."); }
+   inst->name = strdup(name);
+   if (vector_add(&insts_v, inst) != 0) { fail_msg("Failed to add tests instance."); }
+   return inst;
+}
+
+static interface_t * add_test_ifc(inst_t *inst, const char *name, interface_dir_t dir)
+{
+   interface_t *ifc = interface_alloc();
+   if (ifc == NULL) { fail_msg("Failed to allocate tests interface."); }
+   ifc->name = strdup(name);
+   ifc->direction = dir;
+   ifc->type = NS_IF_TYPE_BH;
+   if (interface_stats_alloc(ifc) != 0) { fail_msg("Failed to allocate interface stats."); }
+   if (inst_interface_add(inst, ifc) != 0) { fail_msg("Failed to add tests interface."); }
+   return ifc;
+}
+
+static void test_insts_load()
+{
+   inst_t *inst;
+   interface_t *ifc;
+
+   if (vector_init(&insts_v, 10) != 0) { fail_msg("Failed to init instances vector."); }
+
+   inst = get_test_inst("inst2");
+   INST_RUNNING(inst) = true;
+   INST_PID(inst) = 1234;
+   inst->restarts_cnt = 3;
+   inst->mem_rss = 4096;
+   ifc = add_test_ifc(inst, "ifc_in", NS_IF_DIR_IN);
+   ((ifc_in_stats_t *) ifc->stats)->recv_msg_cnt = 11;
+   ifc = add_test_ifc(inst, "ifc_out", NS_IF_DIR_OUT);
+   ((ifc_out_stats_t *) ifc->stats)->sent_msg_cnt = 22;
+   ((ifc_out_stats_t *) ifc->stats)->dropped_msg_cnt = 2;
+
+   get_test_inst("inst1");
+   get_test_inst("inst3");
+}
+
+void test_statsnap_lookup(void **state)
+{
+   const stats_snap_t *snap;
+   const inst_snap_t *is;
+   const ifc_snap_t *ifs;
+   uint32_t slot;
+
+   // Nothing published yet
+   snap = stats_snap_acquire(&slot);
+   assert_null(snap);
+   stats_snap_release(slot);
+
+   test_insts_load();
+   assert_int_equal(stats_snap_publish(), 0);
+
+   snap = stats_snap_acquire(&slot);
+   assert_non_null(snap);
+   assert_int_equal(snap->insts_cnt, 3);
+   assert_string_equal(snap->insts[0].name, "inst2");
+   assert_string_equal(snap->by_name[0]->name, "inst1");
+   assert_null(stats_snap_inst_get(snap, "inst4"));
+
+   is = stats_snap_inst_get(snap, "inst2");
+   assert_non_null(is);
+   assert_true(is->running);
+   assert_int_equal(is->pid, 1234);
+   assert_int_equal(is->restarts_cnt, 3);
+   assert_int_equal(is->mem_rss, 4096);
+   assert_int_equal(is->ifces_cnt, 2);
+
+   ifs = stats_snap_ifc_get(is, "ifc_in");
+   assert_non_null(ifs);
+   assert_int_equal(ifs->direction, NS_IF_DIR_IN);
+   assert_int_equal(ifs->recv_msg_cnt, 11);
+   ifs = stats_snap_ifc_get(is, "ifc_out");
+   assert_non_null(ifs);
+   assert_int_equal(ifs->sent_msg_cnt, 22);
+   assert_int_equal(ifs->dropped_msg_cnt, 2);
+   assert_null(stats_snap_ifc_get(is, "ifc_none"));
+   assert_int_equal(stats_snap_inst_get(snap, "inst3")->ifces_cnt, 0);
+
+   // Snapshot is a copy, it isn't affected by freeing of instances
+   ((inst_t *) insts_v.items[0])->mem_rss = 0;
+   insts_free();
+   assert_int_equal(is->mem_rss, 4096);
+   assert_string_equal(stats_snap_ifc_get(is, "ifc_out")->name, "ifc_out");
+   stats_snap_release(slot);
+
+   stats_snap_free();
+}
+
+void test_statsnap_reclaim(void **state)
+{
+   const stats_snap_t *snap;
+   uint32_t slot;
+   uint32_t other;
+
+   test_insts_load();
+   assert_int_equal(stats_snap_publish(), 0);
+
+   // Retired snapshot is kept while the reader that got it holds its slot
+   snap = stats_snap_acquire(&slot);
+   assert_int_equal(stats_snap_publish(), 0);
+   assert_int_equal(stats_snap_publish(), 0);
+   assert_true(snap_retired->next_retired == snap);
+   assert_int_equal(snap->insts_cnt, 3);
+
+   // Later readers don't hold back snapshots retired before they came
+   assert_true(stats_snap_acquire(&other) != snap);
+   assert_int_not_equal(other, slot);
+   assert_int_equal(stats_snap_publish(), 0);
+   assert_non_null(snap_retired);
+   stats_snap_release(slot);
+   stats_snap_release(other);
+
+   assert_int_equal(stats_snap_publish(), 0);
+   assert_null(snap_retired);
+
+   insts_free();
+   stats_snap_free();
+}
+
+static void * test_reader(void *arg)
+{
+   atomic_bool *stop = arg;
+   const stats_snap_t *snap;
+   const inst_snap_t *is;
+   uint64_t *reads = calloc(1, sizeof(uint64_t));
+   uint32_t slot;
+
+   while (atomic_load(stop) == false) {
+      snap = stats_snap_acquire(&slot);
+      is = stats_snap_inst_get(snap, "inst2");
+      // Every published snapshot is complete
+      if (is == NULL || is->ifces_cnt != 2 || stats_snap_ifc_get(is, "ifc_out") == NULL) {
+         stats_snap_release(slot);
+         free(reads);
+         return NULL;
+      }
+      stats_snap_release(slot);
+      (*reads)++;
+   }
+
+   return reads;
+}
+
+void test_statsnap_concurrent_readers(void **state)
+{
+   pthread_t readers[TEST_STATSNAP_READERS];
+   atomic_bool stop = false;
+   uint64_t *reads;
+
+   test_insts_load();
+   assert_int_equal(stats_snap_publish(), 0);
+
+   for (int i = 0; i < TEST_STATSNAP_READERS; i++) {
+      assert_int_equal(pthread_create(&readers[i], NULL, test_reader, &stop), 0);
+   }
+   // Freed snapshot still in use would be reported by sanitizers
+   for (int i = 0; i < TEST_STATSNAP_PUBLISHES; i++) {
+      ((inst_t *) insts_v.items[0])->mem_rss = (uint64_t) i;
+      assert_int_equal(stats_snap_publish(), 0);
+   }
+   atomic_store(&stop, true);
+
+   for (int i = 0; i < TEST_STATSNAP_READERS; i++) {
+      assert_int_equal(pthread_join(readers[i], (void **) &reads), 0);
+      assert_non_null(reads);
+      free(reads);
+   }
+
+   insts_free();
+   stats_snap_free();
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_statsnap_lookup),
+         cmocka_unit_test(test_statsnap_reclaim),
+         cmocka_unit_test(test_statsnap_concurrent_readers),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -60,9 +60,9 @@ void test_insts_save_running_pids(void **state)
       inst = inst_alloc();
       IF_NO_MEM_FAIL(inst)
       inst->name = "inst1";
-      inst->running = true;
+      INST_RUNNING(inst) = true;
       inst->mod_ref = mod;
-      inst->pid = 12312;
+      INST_PID(inst) = 12312;
       vector_add(&insts_v, inst);
    }
 
@@ -77,11 +77,13 @@ void test_insts_save_running_pids(void **state)
    { // tests PID was successfuly stored in sysrepo
       rc = sr_get_item(sr_conn_link.sess, xpath, &value);
       IF_SR_ERR_FAIL(rc)
-      assert_int_equal(inst->pid, value->data.uint32_val);
+      assert_int_equal(INST_PID(inst), value->data.uint32_val);
       sr_free_val(value);
    }
 
-   NULLP_TEST_AND_FREE(inst)
+   // Name is a literal, inst_free releases the hot table slot of instance
+   inst->name = NULL;
+   inst_free(inst);
    NULLP_TEST_AND_FREE(mod)
    vector_free(&insts_v);
    disconnect_sr();
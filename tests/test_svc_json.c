@@ -0,0 +1,128 @@
+#include <string.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+
+#include "../src/svc_json.c"
+
+#define REPLY \
+   "{\"in_cnt\": 1, \"out_cnt\": 2, " \
+   "\"in\": [{\"messages\": 1234, \"buffers\": 56, \"ifc_type\": 116, " \
+   "\"ifc_state\": 1, \"ifc_id\": \"7600\"}], " \
+   "\"out\": [{\"sent-messages\": 18446744073709551615, \"dropped-messages\": 7, " \
+   "\"buffers\": 8, \"autoflushes\": 9, \"num_clients\": 3, \"type\": 117, " \
+   "\"ifc_id\": \"/tmp/out\"}, " \
+   "{\"sent-messages\": 1, \"dropped-messages\": 2, \"buffers\": 3, \"autoflushes\": 4, " \
+   "\"num_clients\": 0, \"type\": 98, \"ifc_id\": \"dev/null\"}]}"
+
+static ifc_in_stats_t in_stats[2];
+static ifc_out_stats_t out_stats[2];
+
+/**
+ * @brief Parses copy of given string into static stats arrays
+ * */
+static int parse_str(const char *json, char *buf, svc_json_stats_t *stats)
+{
+   strcpy(buf, json);
+   memset(in_stats, 0, sizeof(in_stats));
+   memset(out_stats, 0, sizeof(out_stats));
+   stats->in_stats = in_stats;
+   stats->in_cap = 2;
+   stats->out_stats = out_stats;
+   stats->out_cap = 2;
+
+   return svc_json_parse(buf, strlen(buf), stats);
+}
+
+void test_svc_json_reply(void **state)
+{
+   char buf[1024];
+   svc_json_stats_t stats;
+
+   assert_int_equal(parse_str(REPLY, buf, &stats), 0);
+   assert_int_equal(stats.in_cnt, 1);
+   assert_int_equal(stats.out_cnt, 2);
+   assert_int_equal(stats.in_parsed, 1);
+   assert_int_equal(stats.out_parsed, 2);
+
+   assert_int_equal(in_stats[0].recv_msg_cnt, 1234);
+   assert_int_equal(in_stats[0].recv_buff_cnt, 56);
+   assert_int_equal(in_stats[0].type, 't');
+   assert_int_equal(in_stats[0].state, 1);
+   assert_string_equal(in_stats[0].id, "7600");
+
+   assert_true(out_stats[0].sent_msg_cnt == UINT64_MAX);
+   assert_int_equal(out_stats[0].dropped_msg_cnt, 7);
+   assert_int_equal(out_stats[0].sent_buff_cnt, 8);
+   assert_int_equal(out_stats[0].autoflush_cnt, 9);
+   assert_int_equal(out_stats[0].num_clients, 3);
+   assert_int_equal(out_stats[0].type, 'u');
+   assert_string_equal(out_stats[0].id, "/tmp/out");
+   assert_string_equal(out_stats[1].id, "dev/null");
+
+   // Ids are decoded in place
+   assert_true(in_stats[0].id > buf && in_stats[0].id < buf + sizeof(buf));
+}
+
+void test_svc_json_order_and_unknown_keys(void **state)
+{
+   char buf[1024];
+   svc_json_stats_t stats;
+
+   assert_int_equal(parse_str(
+         "{\"out\": [], \"extra\": {\"a\": [1, 2.5e3, true, null, \"x\"]},"
+         " \"in\": [{\"ifc_id\": \"a\\\"b\\\\c\\u00e9\\ud83d\\ude00\", \"new\": false}],"
+         " \"out_cnt\": 0, \"in_cnt\": 1}", buf, &stats), 0);
+   assert_int_equal(stats.in_cnt, 1);
+   assert_int_equal(stats.in_parsed, 1);
+   assert_int_equal(stats.out_parsed, 0);
+   assert_string_equal(in_stats[0].id, "a\"b\\c\xc3\xa9\xf0\x9f\x98\x80");
+   assert_int_equal(in_stats[0].recv_msg_cnt, 0);
+
+   // Zero terminator sent along with reply
+   strcpy(buf, "{\"in_cnt\": 0, \"out_cnt\": 0}\n");
+   assert_int_equal(svc_json_parse(buf, strlen(buf) + 1, &stats), 0);
+}
+
+void test_svc_json_errors(void **state)
+{
+   char buf[1024];
+   svc_json_stats_t stats;
+   const char *invalid[] = {
+         "",
+         "[]",
+         "{\"in_cnt\": 1}",
+         "{\"in_cnt\": 1, \"out_cnt\": 0",
+         "{\"in_cnt\": 1 \"out_cnt\": 0}",
+         "{\"in_cnt\": 1, \"out_cnt\": 0,}",
+         "{\"in_cnt\": \"1\", \"out_cnt\": 0}",
+         "{\"in_cnt\": 1, \"out_cnt\": 0} x",
+         "{\"in_cnt\": 1, \"out_cnt\": 0, \"in\": [{\"messages\": 1}]}",
+         "{\"in_cnt\": 3, \"out_cnt\": 0, \"in\": [{\"ifc_id\": \"1\"}, {\"ifc_id\": \"2\"},"
+               " {\"ifc_id\": \"3\"}]}",
+         "{\"in_cnt\": 0, \"out_cnt\": 0, \"x\": \"\\ud83d\"}",
+         "{\"in_cnt\": 0, \"out_cnt\": 0, \"x\": \"\\q\"}",
+         "{\"in_cnt\": 0, \"out_cnt\": 0, \"x\": tru}",
+         "{\"in_cnt\": -, \"out_cnt\": 0}",
+   };
+
+   for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+      assert_int_equal(parse_str(invalid[i], buf, &stats), -1);
+   }
+
+   // Truncated reply is never read past its length
+   strcpy(buf, REPLY);
+   assert_int_equal(svc_json_parse(buf, 40, &stats), -1);
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_svc_json_reply),
+         cmocka_unit_test(test_svc_json_order_and_unknown_keys),
+         cmocka_unit_test(test_svc_json_errors),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
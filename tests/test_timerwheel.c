@@ -0,0 +1,192 @@
+#include <string.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+
+#include "../src/timerwheel.c"
+
+static int fired_cnt;
+static uint64_t fired_at;
+static uint64_t fake_now;
+
+static void count_fired(void *priv)
+{
+   fired_cnt++;
+   fired_at = fake_now;
+   if (priv != NULL) {
+      *((int *) priv) += 1;
+   }
+}
+
+static void rearm_self(void *priv)
+{
+   tw_timer_t *timer = (tw_timer_t *) priv;
+   fired_cnt++;
+   if (fired_cnt < 3) {
+      tw_arm(&main_wheel, timer, fake_now, 100);
+   }
+}
+
+static void reset_wheel(void)
+{
+   memset(&main_wheel, 0, sizeof(main_wheel));
+   fired_cnt = 0;
+   fired_at = 0;
+   fake_now = 1000;
+}
+
+/**
+ * @brief Advances main_wheel tick by tick until given time
+ * */
+static void advance_to(uint64_t until)
+{
+   while (fake_now < until) {
+      fake_now += TW_TICK_MS;
+      tw_advance(&main_wheel, fake_now);
+   }
+}
+
+void test_tw_arm_cancel(void **state)
+{
+   tw_timer_t timer;
+   reset_wheel();
+   tw_timer_init(&timer, count_fired, NULL);
+
+   assert_false(tw_armed(&timer));
+   assert_int_equal(tw_next_timeout(&main_wheel, fake_now), -1);
+
+   tw_arm(&main_wheel, &timer, fake_now, 50);
+   assert_true(tw_armed(&timer));
+   assert_int_equal(main_wheel.armed_cnt, 1);
+   assert_int_equal(tw_next_timeout(&main_wheel, fake_now), 50);
+
+   // re-arming keeps only one instance of the timer in the wheel
+   tw_arm(&main_wheel, &timer, fake_now, 30);
+   assert_int_equal(main_wheel.armed_cnt, 1);
+   assert_int_equal(tw_next_timeout(&main_wheel, fake_now), 30);
+
+   tw_cancel(&main_wheel, &timer);
+   assert_false(tw_armed(&timer));
+   assert_int_equal(main_wheel.armed_cnt, 0);
+   tw_cancel(&main_wheel, &timer);
+   assert_int_equal(main_wheel.armed_cnt, 0);
+
+   advance_to(2000);
+   assert_int_equal(fired_cnt, 0);
+}
+
+void test_tw_expiry(void **state)
+{
+   tw_timer_t timers[3];
+   int hits[3] = {0, 0, 0};
+   reset_wheel();
+
+   for (int i = 0; i < 3; i++) {
+      tw_timer_init(&timers[i], count_fired, &hits[i]);
+   }
+   tw_arm(&main_wheel, &timers[0], fake_now, 0);
+   tw_arm(&main_wheel, &timers[1], fake_now, 25);
+   tw_arm(&main_wheel, &timers[2], fake_now, 500);
+
+   assert_int_equal(tw_advance(&main_wheel, fake_now), 1);
+   assert_int_equal(hits[0], 1);
+
+   advance_to(fake_now + 20);
+   assert_int_equal(hits[1], 0);
+   advance_to(fake_now + 10);
+   assert_int_equal(hits[1], 1);
+   assert_int_equal(fired_at, 1030);
+   assert_false(tw_armed(&timers[1]));
+
+   // skipping many ticks at once still fires timer
+   assert_int_equal(tw_advance(&main_wheel, fake_now + 5000), 1);
+   assert_int_equal(hits[2], 1);
+   assert_int_equal(main_wheel.armed_cnt, 0);
+}
+
+void test_tw_cascade(void **state)
+{
+   tw_timer_t near, far;
+   reset_wheel();
+   tw_timer_init(&near, count_fired, NULL);
+   tw_timer_init(&far, count_fired, NULL);
+
+   // level 1 and level 2 timers
+   tw_arm(&main_wheel, &near, fake_now, 2000);
+   tw_arm(&main_wheel, &far, fake_now, 60000);
+
+   assert_true(tw_next_timeout(&main_wheel, fake_now) <= 2000);
+
+   advance_to(1000 + 1990);
+   assert_int_equal(fired_cnt, 0);
+   advance_to(1000 + 2000);
+   assert_int_equal(fired_cnt, 1);
+   assert_int_equal(fired_at, 3000);
+
+   advance_to(1000 + 59990);
+   assert_int_equal(fired_cnt, 1);
+   advance_to(1000 + 60000);
+   assert_int_equal(fired_cnt, 2);
+   assert_int_equal(fired_at, 61000);
+}
+
+/**
+ * @brief Arms timer at given time and advances main_wheel tick by tick until it fires,
+ *  next timeout mustn't be 0 meanwhile, supervisor_routine would spin otherwise
+ * */
+static void arm_and_check_timeout(uint64_t at, uint64_t delay_ms)
+{
+   tw_timer_t timer;
+   int timeout;
+   reset_wheel();
+   tw_timer_init(&timer, count_fired, NULL);
+
+   tw_arm(&main_wheel, &timer, fake_now, 0);
+   advance_to(at);
+   assert_int_equal(fired_cnt, 1);
+
+   tw_arm(&main_wheel, &timer, fake_now, delay_ms);
+   while (fired_cnt == 1) {
+      timeout = tw_next_timeout(&main_wheel, fake_now);
+      assert_true(timeout > 0);
+      assert_true(fake_now + (uint64_t) timeout <= at + delay_ms);
+      fake_now += TW_TICK_MS;
+      tw_advance(&main_wheel, fake_now);
+   }
+   assert_int_equal(fired_at, at + delay_ms);
+}
+
+void test_tw_next_timeout_next_rotation(void **state)
+{
+   // Expiration lands in current slot of level 1, it is cascaded only in next rotation
+   arm_and_check_timeout(1000 + 300, 40900);
+   // The same for level 2
+   arm_and_check_timeout(1000 + 50000, 2615000);
+}
+
+void test_tw_rearm_in_callback(void **state)
+{
+   tw_timer_t timer;
+   reset_wheel();
+   tw_timer_init(&timer, rearm_self, &timer);
+
+   tw_arm(&main_wheel, &timer, fake_now, 100);
+   advance_to(1000 + 1000);
+   assert_int_equal(fired_cnt, 3);
+   assert_false(tw_armed(&timer));
+   assert_int_equal(main_wheel.armed_cnt, 0);
+}
+
+int main(void)
+{
+   const struct CMUnitTest tests[] = {
+         cmocka_unit_test(test_tw_arm_cancel),
+         cmocka_unit_test(test_tw_expiry),
+         cmocka_unit_test(test_tw_cascade),
+         cmocka_unit_test(test_tw_rearm_in_callback),
+         cmocka_unit_test(test_tw_next_timeout_next_rotation),
+   };
+
+   return cmocka_run_group_tests(tests, NULL, NULL);
+}
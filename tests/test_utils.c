@@ -76,12 +76,103 @@ void test_vector_delete(void **state)
    }
 }
 
+void test_name_index(void **state)
+{
+   name_index_t idx = {0};
+   char names[100][8];
+   int ints[100];
+
+   assert_null(name_index_get(&idx, "name0"));
+
+   // Enough items to make the index grow a few times
+   for (int i = 0; i < 100; i++) {
+      snprintf(names[i], sizeof(names[i]), "name%d", i);
+      assert_int_equal(name_index_add(&idx, names[i], &ints[i]), 0);
+   }
+   assert_int_equal(idx.total, 100);
+   assert_true(idx.capacity * 3 >= idx.total * 4);
+   for (int i = 0; i < 100; i++) {
+      assert_true(name_index_get(&idx, names[i]) == &ints[i]);
+   }
+   assert_null(name_index_get(&idx, "name100"));
+
+   // Items left in probe sequences of removed ones are still found
+   for (int i = 0; i < 100; i += 2) {
+      name_index_delete(&idx, names[i], &ints[i]);
+   }
+   name_index_delete(&idx, "name100", &ints[0]);
+   assert_int_equal(idx.total, 50);
+   for (int i = 0; i < 100; i++) {
+      if (i % 2 == 0) {
+         assert_null(name_index_get(&idx, names[i]));
+      } else {
+         assert_true(name_index_get(&idx, names[i]) == &ints[i]);
+      }
+   }
+
+   name_index_free(&idx);
+   assert_null(idx.entries);
+   assert_null(name_index_get(&idx, "name1"));
+}
+
+#define TEST_LOG_LINES 20000
+
+static pthread_barrier_t test_log_start;
+
+static void * test_logger(void *arg)
+{
+   const char *who = arg;
+
+   pthread_barrier_wait(&test_log_start);
+   for (int i = 0; i < TEST_LOG_LINES; i++) {
+      VERBOSE(N_ERR, "%s %d %s", who, i, who)
+   }
+   return NULL;
+}
+
+void test_verbose_threads(void **state)
+{
+   pthread_t threads[2];
+   char *who[2] = {"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"};
+   char line[256];
+   char first[64];
+   char last[64];
+   int lines = 0;
+   int n;
+
+   output_fd = tmpfile();
+   assert_non_null(output_fd);
+   assert_int_equal(pthread_barrier_init(&test_log_start, NULL, 2), 0);
+
+   // Each thread formats into its own buffer, no line mixes messages of both
+   for (int i = 0; i < 2; i++) {
+      assert_int_equal(pthread_create(&threads[i], NULL, test_logger, who[i]), 0);
+   }
+   for (int i = 0; i < 2; i++) {
+      assert_int_equal(pthread_join(threads[i], NULL), 0);
+   }
+
+   rewind(output_fd);
+   while (fgets(line, sizeof(line), output_fd) != NULL) {
+      assert_int_equal(sscanf(line, "[ERR][%*[^]]] %63s %d %63s", first, &n, last), 3);
+      assert_string_equal(first, last);
+      lines++;
+   }
+   assert_int_equal(lines, 2 * TEST_LOG_LINES);
+
+   pthread_barrier_destroy(&test_log_start);
+   fclose(output_fd);
+   output_fd = NULL;
+}
+
 int main(void)
 {
    //verbosity_level = V3;
 
    const struct CMUnitTest tests[] = {
          cmocka_unit_test(test_vector_delete),
+         cmocka_unit_test(test_name_index),
+         cmocka_unit_test(test_verbose_threads),
    };
 
    return cmocka_run_group_tests(tests, NULL, NULL);